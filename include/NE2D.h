@@ -9,6 +9,7 @@
 
 #include <nds.h>
 
+#include "NEAtlas.h"
 #include "NETexture.h"
 
 /// @file   NE2D.h
@@ -136,6 +137,16 @@ void NE_SpriteSetMaterial(NE_Sprite *sprite, NE_Material *mat);
 /// @param tb Texture bottom Y coordinate.
 void NE_SpriteSetMaterialCanvas(NE_Sprite *sprite, int tl, int tt, int tr, int tb);
 
+/// Assign an image of a texture atlas to a sprite.
+///
+/// This sets the material of the sprite to the material of the atlas, the
+/// canvas of the sprite to the rectangle of the image, and the size of the
+/// sprite to the size of the image.
+///
+/// @param sprite Sprite.
+/// @param image Image of a texture atlas.
+void NE_SpriteSetAtlasImage(NE_Sprite *sprite, const NE_AtlasImage *image);
+
 /// Set priority of a sprite.
 ///
 /// The lower the vaue is, the higher the priority is. High priority sprites are
@@ -23,16 +23,31 @@ typedef struct NEChunk {
     struct NEChunk *next;     // Pointer to next chunk. NULL if this is the last one
     ne_chunk_state state;     // Used, free or locked
     void *start, *end;        // Pointers to the start and end of this memory chunk
+
+    // Internal use. All chunks are also stored in a tree sorted by address.
+    struct NEChunk *left, *right; // Children of this node of the tree
+    int height;                   // Height of the subtree of this node
+    size_t max_free;              // Size of the biggest free chunk of the subtree
 } NEChunk;
 
 typedef struct {
     // Values in bytes. Total memory does not include locked memory
     size_t free, used, total, locked;
     unsigned int free_percent; // Locked memory doesn't count
+    size_t largest_free;       // Size of the biggest free chunk
+    size_t free_fragments;     // Number of free chunks
+    // Percentage of free memory that isn't part of the biggest free chunk. It
+    // is 0 when all free memory is contiguous.
+    unsigned int fragmentation;
 } NEMemInfo;
 
 #define NE_ALLOC_MIN_SIZE (16)
 
+// Chunks are taken from a pool of nodes owned by the allocator instead of being
+// allocated one by one with malloc(). When the pool runs out of nodes, it grows
+// by this number of nodes. The first block is allocated by NE_AllocInit().
+#define NE_ALLOC_NODES_PER_BLOCK (32)
+
 // They return 0 on success. On error, they return a negative number.
 int NE_AllocInit(NEChunk **first_element, void *start, void *end);
 int NE_AllocEnd(NEChunk **first_element);
@@ -43,6 +58,12 @@ int NE_AllocEnd(NEChunk **first_element);
 // function returns NULL.
 void *NE_AllocFindInRange(NEChunk *first_chunk, void *start, void *end, size_t size);
 
+// This function is like NE_AllocFindInRange(), but it looks for the free space
+// with the highest address inside the range. On error, this function returns
+// NULL.
+void *NE_AllocFindInRangeFromEnd(NEChunk *first_chunk, void *start, void *end,
+                                 size_t size);
+
 // It returns 0 on success. On error, it returns a negative number.
 int NE_AllocAddress(NEChunk *first_chunk, void *address, size_t size);
 
@@ -54,6 +75,11 @@ void *NE_Alloc(NEChunk *first_element, size_t size);
 // memory pool. Returns NULL on error, or a valid pointer on success.
 void *NE_AllocFromEnd(NEChunk *first_element, size_t size);
 
+// Allocates data at the end of the smallest free chunk with enough space. If
+// there are several of them, it uses the one with the highest address. Returns
+// NULL on error, or a valid pointer on success.
+void *NE_AllocBestFit(NEChunk *first_element, size_t size);
+
 // Returns 0 on success. On error, it returns a negative number.
 int NE_Free(NEChunk *first_element, void *pointer);
 
@@ -69,4 +95,61 @@ int NE_Unlock(NEChunk *first_element, void *pointer);
 // Returns 0 on success. On error, it returns a negative number.
 int NE_MemGetInformation(NEChunk *first_element, NEMemInfo *info);
 
+// Allocation tracing
+// ------------------
+//
+// When tracing is enabled, all calls to NE_Alloc(), NE_AllocFromEnd(),
+// NE_AllocBestFit(), NE_AllocAddress(), NE_Free(), NE_Lock() and NE_Unlock()
+// are saved to a ring buffer. Addresses are saved as offsets from the start of
+// the memory pool so that the trace can be replayed on a PC with
+// tools/alloc_replay.
+//
+// When tracing starts, the chunks that are already in use are saved as
+// NE_AllocAddress() and NE_Lock() calls with tag NE_TRACE_TAG_SNAPSHOT, so that
+// the trace can be replayed starting from an empty memory pool. This snapshot
+// is kept outside of the ring buffer, and it's saved before all other entries.
+//
+// If the ring buffer wraps around, the oldest operations after the snapshot are
+// lost (NETraceHeader.dropped is the number of lost entries). The trace can
+// still be loaded, but the replay won't match the real state of the pool.
+
+typedef enum {
+    NE_TRACE_ALLOC = 1,
+    NE_TRACE_ALLOC_FROM_END = 2,
+    NE_TRACE_ALLOC_ADDRESS = 3,
+    NE_TRACE_FREE = 4,
+    NE_TRACE_LOCK = 5,
+    NE_TRACE_UNLOCK = 6,
+    NE_TRACE_ALLOC_BEST_FIT = 7,
+} ne_trace_op;
+
+#define NE_TRACE_TAG_SNAPSHOT (0xFFFF)
+
+// This struct is saved as it is to the trace files, so its layout must not
+// change without changing NE_TRACE_VERSION.
+typedef struct {
+    uint8_t op;      // One of the values of ne_trace_op
+    uint8_t failed;  // 1 if the call failed, 0 if not
+    uint16_t tag;    // Tag set with NE_AllocTraceSetTag() by the caller
+    uint32_t offset; // Offset of the address from the start of the pool
+    uint32_t size;   // Size requested by the caller (0 if not used)
+} NETraceEntry;
+
+#define NE_TRACE_MAGIC      { 'N', 'E', 'A', 'T' }
+#define NE_TRACE_VERSION    (1)
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t pool_size;   // Size of the memory pool in bytes
+    uint32_t num_entries; // Number of entries saved after this header
+    uint32_t dropped;     // Number of entries lost because the buffer was full
+} NETraceHeader;
+
+// They return 0 on success. On error, they return a negative number.
+int NE_AllocTraceStart(NEChunk *first_element, size_t num_entries);
+int NE_AllocTraceStop(NEChunk *first_element);
+int NE_AllocTraceSetTag(NEChunk *first_element, uint16_t tag);
+int NE_AllocTraceDump(NEChunk *first_element, const char *path);
+
 #endif // NE_ALLOC_H__
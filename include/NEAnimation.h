@@ -43,6 +43,10 @@ int NE_AnimationLoad(NE_Animation *animation, const void *pointer);
 
 /// Loads a DSA file in FAT to an animation object.
 ///
+/// If the asset cache is enabled and the same file is already loaded, the data
+/// in RAM is shared instead of loading the file again. See
+/// NE_AssetCacheSetEnabled().
+///
 /// @param animation Pointer to the animation.
 /// @param path Path to the file.
 /// @return It returns 1 on success.
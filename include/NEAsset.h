@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2024 Antonio Niño Díaz
+//
+// This file is part of Nitro Engine
+
+#ifndef NE_ASSET_H__
+#define NE_ASSET_H__
+
+#include <nds.h>
+
+/// @file   NEAsset.h
+/// @brief  Cache of assets loaded from the filesystem.
+
+/// @defgroup asset_cache Asset cache
+///
+/// Cache of assets loaded from the filesystem, shared by all the objects that
+/// load the same file. It's disabled by default, enable it with
+/// NE_AssetCacheSetEnabled().
+///
+/// When the cache is enabled and a file is loaded with NE_ModelLoadStaticMeshFAT(), NE_ModelLoadDSMFAT()
+/// or NE_AnimationLoadFAT() and the same file is already loaded in RAM, the
+/// data in RAM is reused instead of reading the file again. Textures loaded with
+/// NE_MaterialTexLoadFAT() reuse the texture in VRAM if the same file has
+/// already been loaded with the same format, size and flags, like materials
+/// created with NE_MaterialClone(). The number of users of each asset is
+/// counted, and the asset is freed when the last user is deleted.
+///
+/// Shared textures are the same texture in VRAM, so modifying one of them with
+/// NE_TextureDrawingStart() modifies all of them. Disable the cache with
+/// NE_AssetCacheSetEnabled() before loading textures that need to be modified.
+///
+/// @{
+
+/// Types of assets tracked by the cache.
+typedef enum {
+    NE_ASSET_MESH,      ///< Meshes of models (DSM files and static meshes)
+    NE_ASSET_ANIMATION, ///< Animations (DSA files)
+    NE_ASSET_TEXTURE,   ///< Textures
+    NE_ASSET_TYPES      ///< Number of types of assets
+} NE_AssetType;
+
+/// Statistics of one type of asset of the cache.
+typedef struct {
+    u32 hits;           ///< Loads that have reused an asset
+    u32 misses;         ///< Loads that have read the file
+    u32 bytes_saved;    ///< Bytes that haven't been loaded thanks to the cache
+    u32 resident;       ///< Number of assets currently loaded
+    u32 resident_bytes; ///< Size of the assets currently loaded
+} NE_AssetCacheStats;
+
+/// Enables or disables the asset cache.
+///
+/// Assets that are already in the cache aren't affected by this. When the cache
+/// is disabled, every load reads the file, and the new assets aren't shared.
+/// It's disabled by default.
+///
+/// @param enabled True to enable the cache, false to disable it.
+void NE_AssetCacheSetEnabled(bool enabled);
+
+/// Gets the statistics of one type of asset.
+///
+/// @param type Type of asset.
+/// @param stats Pointer to a struct to store the statistics.
+void NE_AssetCacheGetStats(NE_AssetType type, NE_AssetCacheStats *stats);
+
+/// Resets the hit, miss and bytes saved counters of all types of assets.
+void NE_AssetCacheResetStats(void);
+
+/// @}
+
+#endif // NE_ASSET_H__
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2024 Antonio Niño Díaz
+//
+// This file is part of Nitro Engine
+
+#ifndef NE_ATLAS_H__
+#define NE_ATLAS_H__
+
+#include <nds.h>
+
+#include "NETexture.h"
+
+/// @file   NEAtlas.h
+/// @brief  Texture atlas functions.
+
+/// @defgroup atlas_system Texture atlas system
+///
+/// Functions to pack many small images of the same format into one texture at
+/// runtime.
+///
+/// Each material uses a texture slot, and the width of each texture is rounded
+/// up to a power of two, so loading small images as individual textures wastes
+/// VRAM. It also means that the texture has to be changed for every sprite or
+/// GUI element that is drawn. An atlas keeps all the images in one texture, and
+/// each image is described by the rectangle of the texture that it uses.
+///
+/// Images are packed with a skyline bottom-left algorithm. Images can't be
+/// removed from an atlas, the whole atlas has to be deleted.
+///
+/// @{
+
+/// Image packed in a texture atlas.
+///
+/// The coordinates can be used with NE_SpriteSetMaterialCanvas() or
+/// NE_2DDrawTexturedQuadColorCanvas(), or NE_SpriteSetAtlasImage() can be used
+/// to assign it to a sprite directly.
+typedef struct {
+    NE_Material *mat; ///< Material of the atlas
+    s16 tl;           ///< Left coordinate of the image in the atlas
+    s16 tt;           ///< Top coordinate of the image in the atlas
+    s16 tr;           ///< Right coordinate of the image in the atlas
+    s16 tb;           ///< Bottom coordinate of the image in the atlas
+} NE_AtlasImage;
+
+/// Holds information of a texture atlas.
+typedef struct {
+    NE_Material *mat;     ///< Material with the texture of the atlas
+    NE_TextureFormat fmt; ///< Format of all the images of the atlas
+    int width;            ///< Width of the texture of the atlas
+    int height;           ///< Height of the texture of the atlas
+    int num_images;       ///< Number of images added to the atlas
+    int used_area;        ///< Number of pixels used by images
+    int align;            ///< Horizontal alignment of images in pixels
+    int num_nodes;        ///< Number of segments of the skyline (internal)
+    void *nodes;          ///< Segments of the skyline (internal)
+} NE_Atlas;
+
+/// Creates a texture atlas.
+///
+/// It creates a material with an empty texture of the specified size. All
+/// images added to the atlas must have the same format as the atlas. Compressed
+/// textures (NE_TEX4X4) aren't supported.
+///
+/// Paletted atlases don't have a palette. Use NE_MaterialSetPalette() with the
+/// material of the atlas to assign one to it.
+///
+/// @param fmt Format of the texture.
+/// @param width Width of the texture. It must be a power of two.
+/// @param height Height of the texture. It must be a power of two.
+/// @param flags Parameters of the texture.
+/// @return Returns a pointer to the atlas, or NULL on error.
+NE_Atlas *NE_AtlasCreate(NE_TextureFormat fmt, int width, int height,
+                         NE_TextureFlags flags);
+
+/// Adds an image to a texture atlas.
+///
+/// The image must have the same format as the atlas. VRAM can only be written
+/// in 16-bit units, so the horizontal position of images is aligned to 16 bits
+/// (8 pixels in NE_PAL4 images, 4 pixels in NE_PAL16 images, 2 pixels in 8-bit
+/// formats). The rows of the image in RAM must be padded to the same size.
+///
+/// @param atlas Atlas.
+/// @param data Pointer to the image data.
+/// @param width Width of the image in pixels.
+/// @param height Height of the image in pixels.
+/// @param image Pointer to a struct to store the position of the image.
+/// @return It returns 1 on success, 0 on error (if the image doesn't fit).
+int NE_AtlasAdd(NE_Atlas *atlas, const void *data, int width, int height,
+                NE_AtlasImage *image);
+
+/// Returns the percentage of the texture of the atlas used by images.
+///
+/// @param atlas Atlas.
+/// @return Percentage of used pixels (0 - 100).
+int NE_AtlasUsedPercent(const NE_Atlas *atlas);
+
+/// Deletes a texture atlas and its material.
+///
+/// All NE_AtlasImage structs of this atlas become invalid.
+///
+/// @param atlas Atlas.
+void NE_AtlasDelete(NE_Atlas *atlas);
+
+/// @}
+
+#endif // NE_ATLAS_H__
@@ -29,6 +29,11 @@ typedef struct {
     int32_t to[3];   ///< Where the camera is looking at
     int32_t up[3];   ///< Vector that points "up"
     bool matrix_is_updated; ///< Set to false when the matrix isn't up-to-date
+    /// Planes of the view volume: normal vector and distance to 'from' (f32).
+    /// They are calculated at the same time as the matrix.
+    int32_t frustum[6][4];
+    /// Field of view, aspect ratio and clipping planes used for the planes.
+    int32_t frustum_projection[4];
 } NE_Camera;
 
 #define NE_DEFAULT_CAMERAS 16 ///< Default max number of cameras.
@@ -77,6 +82,34 @@ void NE_CameraSetI(NE_Camera *cam, int xfrom, int yfrom, int zfrom,
 /// @param cam Camera to be used.
 void NE_CameraUse(NE_Camera *cam);
 
+/// Checks if a sphere is inside the view volume of a camera.
+///
+/// The view volume is calculated from the camera and from the projection set
+/// with NE_Viewport(), NE_SetFov() and NE_ClippingPlanesSetI(). The test is
+/// done on the CPU, so it doesn't need to wait for the GPU. It's conservative:
+/// spheres that are very close to the view volume may be considered visible.
+///
+/// @param cam Camera.
+/// @param x (x, y, z) Center of the sphere in world coordinates (f32).
+/// @param y (x, y, z) Center of the sphere in world coordinates (f32).
+/// @param z (x, y, z) Center of the sphere in world coordinates (f32).
+/// @param radius Radius of the sphere (f32).
+/// @return Returns true if the sphere may be visible, false if it isn't.
+bool NE_CameraSphereIsVisibleI(NE_Camera *cam, int x, int y, int z,
+                               int radius);
+
+/// Checks if a sphere is inside the view volume of a camera.
+///
+/// @param c Camera.
+/// @param x (x, y, z) Center of the sphere in world coordinates (float).
+/// @param y (x, y, z) Center of the sphere in world coordinates (float).
+/// @param z (x, y, z) Center of the sphere in world coordinates (float).
+/// @param r Radius of the sphere (float).
+/// @return Returns true if the sphere may be visible, false if it isn't.
+#define NE_CameraSphereIsVisible(c, x, y, z, r) \
+    NE_CameraSphereIsVisibleI(c, floattof32(x), floattof32(y), floattof32(z), \
+                              floattof32(r))
+
 /// Moves a camera on the global x, y and z axes.
 ///
 /// @param cam Camera to be moved.
@@ -20,9 +20,27 @@
 typedef enum {
     NE_DL_CPU,          ///< Send all data to the GPU with CPU copy loop.
     NE_DL_DMA_GFX_FIFO, ///< Default. DMA in GFX FIFO mode (incompatible with safe dual 3D)
+    NE_DL_DMA_GFX_FIFO_ASYNC, ///< DMA in GFX FIFO mode without waiting for the end (same restrictions)
     // TODO: Support DMA without GFX FIFO DMA mode, using GFX FIFO IRQ instead.
 } NE_DisplayListDrawFunction;
 
+/// Max number of display lists waiting to be sent to the GPU asynchronously.
+#define NE_DL_ASYNC_QUEUE_SIZE 8
+
+/// Options of display lists sent asynchronously.
+typedef enum {
+    NE_DL_FLAGS_NONE = 0,      ///< No options
+    /// The display list has already been flushed from the data cache (with
+    /// DC_FlushRange() or DC_FlushAll()) and it hasn't been modified since.
+    NE_DL_PREFLUSHED = 1 << 0,
+} NE_DisplayListFlags;
+
+/// Identifier of a display list sent with NE_DisplayListDrawAsync().
+///
+/// A fence is signaled when its display list and all the display lists sent
+/// before it have been sent to the GPU. Fence 0 is always signaled.
+typedef u32 NE_DisplayListFence;
+
 /// Sends a display list to the GPU by using the DMA in GFX FIFO mode.
 ///
 /// Important note: Don't use this function when using safe dual 3D. Check the
@@ -36,12 +54,70 @@ void NE_DisplayListDrawDMA_GFX_FIFO(const void *list);
 /// @param list Pointer to the display list
 void NE_DisplayListDrawCPU(const void *list);
 
+/// Sends a display list to the GPU by using the DMA in GFX FIFO mode without
+/// waiting for the transfer to end.
+///
+/// The display list is added to a queue. Lists are sent in order one after the
+/// other, the next one is started from the DMA interrupt handler when the
+/// previous one ends. The function only waits if the queue is full. This lets
+/// the CPU run animations, physics or game logic while the GPU receives the
+/// display lists.
+///
+/// The display list must stay in RAM, unmodified, until its fence is
+/// signaled.
+///
+/// Nothing else can be sent to the GPU while the queue isn't empty, or the
+/// commands would be mixed with the commands of the display list. All the
+/// functions of Nitro Engine that send commands to the GPU (materials, models,
+/// cameras, lights, 2D and text functions, etc) wait until the queue is empty
+/// before sending them. The exceptions are the inline functions of NEPolygon.h
+/// that send individual commands, like NE_PolyBegin() or NE_PolyVertex(), to
+/// keep them fast. Call NE_DisplayListWait() before using them, or before
+/// using any function of libnds that sends commands to the GPU.
+///
+/// When this is the default function, NE_ModelDraw() adds the command that
+/// restores the matrix of the GPU to the queue after the mesh of the model,
+/// so it returns without waiting for the mesh to be sent. Any code that runs
+/// after it, until the next function that sends commands to the GPU, runs
+/// while the GPU receives the mesh.
+///
+/// Important note: Don't use this function when using safe dual 3D. Check the
+/// documentation of NE_DisplayListSetDefaultFunction() for more information.
+///
+/// @param list Pointer to the display list.
+/// @param flags Options of the display list. Use NE_DL_PREFLUSHED for static
+///              display lists that have already been flushed from the data
+///              cache to skip the call to DC_FlushRange().
+/// @return Fence of the display list.
+NE_DisplayListFence NE_DisplayListDrawAsync(const void *list,
+                                            NE_DisplayListFlags flags);
+
+/// Checks if a fence has been signaled.
+///
+/// @param fence Fence returned by NE_DisplayListDrawAsync().
+/// @return Returns true if the display list has been sent to the GPU.
+bool NE_DisplayListFenceDone(NE_DisplayListFence fence);
+
+/// Waits until a fence has been signaled.
+///
+/// @param fence Fence returned by NE_DisplayListDrawAsync().
+void NE_DisplayListFenceWait(NE_DisplayListFence fence);
+
+/// Waits until all display lists sent asynchronously have been sent to the
+/// GPU.
+void NE_DisplayListWait(void);
+
 /// Set the default way to send display lists to the GPU.
 ///
-/// Important note: NE_DL_DMA_GFX_FIFO isn't compatible with safe dual 3D mode
-/// because it uses DMA in horizontal blanking start mode. There is a hardware
-/// bug that makes it unreliable to have both DMA channels active at the same
-/// time in HBL start and GFX FIFO mode.
+/// Important note: NE_DL_DMA_GFX_FIFO and NE_DL_DMA_GFX_FIFO_ASYNC aren't
+/// compatible with safe dual 3D mode because they use DMA in horizontal
+/// blanking start mode. There is a hardware bug that makes it unreliable to
+/// have both DMA channels active at the same time in HBL start and GFX FIFO
+/// mode.
+///
+/// When NE_DL_DMA_GFX_FIFO_ASYNC is used, check the documentation of
+/// NE_DisplayListDrawAsync() to see when NE_DisplayListWait() has to be
+/// called.
 ///
 /// @param type Copy type to use.
 void NE_DisplayListSetDefaultFunction(NE_DisplayListDrawFunction type);
@@ -53,6 +129,160 @@ void NE_DisplayListSetDefaultFunction(NE_DisplayListDrawFunction type);
 /// @param list Pointer to the display list
 void NE_DisplayListDrawDefault(const void *list);
 
+/// Display list recorded at runtime with a display list builder.
+typedef struct {
+    u32 *list;       ///< Display list. The first word is its size in words.
+    size_t capacity; ///< Number of words allocated for the display list.
+    size_t used;     ///< Number of words used by the display list.
+    bool error;      ///< True if there was an error while recording.
+} NE_DisplayListBuilder;
+
+/// Creates a display list builder.
+///
+/// The buffer of the display list grows automatically if a recording needs
+/// more space than the initial size.
+///
+/// @param words Initial size of the display list in words.
+/// @return Returns a pointer to the builder, or NULL on error.
+NE_DisplayListBuilder *NE_DisplayListBuilderCreate(size_t words);
+
+/// Deletes a display list builder and its display list.
+///
+/// @param builder Builder.
+void NE_DisplayListBuilderDelete(NE_DisplayListBuilder *builder);
+
+/// Starts recording a display list.
+///
+/// The previous display list of the builder is discarded. From now on, all
+/// the commands sent to the GPU by the following functions are saved to the
+/// display list instead of being sent to the GPU:
+///
+/// - 2D functions: NE_2DViewInit() and similar, NE_2DDrawQuad() and similar,
+///   NE_SpriteDraw() and NE_SpriteDrawAll().
+/// - Text functions: NE_TextPrint() and similar.
+/// - NE_GUIDraw().
+/// - NE_MaterialUse(), NE_PolyFormat() and the NE_View*() functions.
+///
+/// Commands are saved in packed format, with four commands per header word,
+/// like the display lists generated by the tools of Nitro Engine.
+///
+/// Anything else sent to the GPU while recording (like models, the inline
+/// functions of NEPolygon.h or the gl*() functions of libnds) is sent to the
+/// GPU right away, so it shouldn't be used while recording. Only one display
+/// list can be recorded at a time.
+///
+/// The display list records the state of the objects at the time they are
+/// recorded: the positions of sprites, the strings of text, the VRAM addresses
+/// of textures... Record it again when something changes.
+///
+/// @param builder Builder.
+void NE_DisplayListBuilderBegin(NE_DisplayListBuilder *builder);
+
+/// Stops recording a display list.
+///
+/// The display list is flushed from the data cache, so it can be sent with
+/// NE_DisplayListDrawAsync() with NE_DL_PREFLUSHED.
+///
+/// @param builder Builder.
+/// @return Returns 1 on success, 0 on error (not enough memory, or a command
+///         that can't be used in display lists has been recorded). The display
+///         list is empty on error.
+int NE_DisplayListBuilderEnd(NE_DisplayListBuilder *builder);
+
+/// Draws the display list of a builder with the default draw function.
+///
+/// Nothing is drawn if the display list is empty.
+///
+/// @param builder Builder.
+void NE_DisplayListBuilderDraw(const NE_DisplayListBuilder *builder);
+
+/// Number of possible command IDs of the geometry engine.
+#define NE_DL_NUM_COMMAND_IDS 0x80
+
+/// Results of the validation of a display list.
+typedef enum {
+    NE_DL_VALID = 0,             ///< The display list is valid
+    NE_DL_ERROR_TRUNCATED,       ///< The list ends in the middle of a command
+    NE_DL_ERROR_INVALID_COMMAND, ///< Unknown command, or not valid in lists
+    NE_DL_ERROR_INVALID_RESTORE, ///< MTX_RESTORE of a matrix that isn't a joint
+} NE_DisplayListError;
+
+/// Information about a display list obtained with NE_DisplayListAnalyze().
+typedef struct {
+    NE_DisplayListError error; ///< Result of the validation
+    u32 error_offset;     ///< Offset in words of the command with the error
+    u32 words;            ///< Size of the display list in words
+    u32 commands;         ///< Number of commands (NOPs aren't included)
+    u32 command_count[NE_DL_NUM_COMMAND_IDS]; ///< Number of commands of each ID
+    u32 vertices;         ///< Number of vertices
+    u32 triangles;        ///< Number of triangles (including triangle strips)
+    u32 quads;            ///< Number of quads (including quad strips)
+    u32 cycles;           ///< Estimated geometry engine cycles
+} NE_DisplayListInfo;
+
+/// Callback used by NE_DisplayListDecode() for each command.
+///
+/// @param offset Offset in words of the parameters of the command from the
+///               start of the display list (after the size word).
+/// @param cmd Command ID.
+/// @param params Parameters of the command.
+/// @param num_params Number of parameters.
+/// @param arg Argument passed to NE_DisplayListDecode().
+typedef void (*NE_DisplayListDecodeFn)(u32 offset, u32 cmd, const u32 *params,
+                                       int num_params, void *arg);
+
+/// Returns the number of parameters of a geometry engine command.
+///
+/// @param cmd Command ID.
+/// @return Number of parameters, or -1 if the command doesn't exist or it can't
+///         be used in display lists.
+int NE_DisplayListCommandParams(u32 cmd);
+
+/// Returns the name of a geometry engine command, as it appears in GBATEK.
+///
+/// @param cmd Command ID.
+/// @return Name of the command, or NULL if the command doesn't exist or it
+///         can't be used in display lists.
+const char *NE_DisplayListCommandName(u32 cmd);
+
+/// Decodes a packed display list and calls a function for each command.
+///
+/// NOPs are skipped. The display list must start with its size in words, like
+/// the display lists generated by the tools of Nitro Engine.
+///
+/// @param list Pointer to the display list.
+/// @param size Size of the buffer that contains the display list in bytes. If
+///             it's 0, the size word of the display list is trusted.
+/// @param fn Function called for each command. It can be NULL.
+/// @param arg Argument passed to the function.
+/// @param offset If it isn't NULL, the offset of the command that caused an
+///               error is stored here.
+/// @return NE_DL_VALID, NE_DL_ERROR_TRUNCATED or NE_DL_ERROR_INVALID_COMMAND.
+NE_DisplayListError NE_DisplayListDecode(const void *list, size_t size,
+                                         NE_DisplayListDecodeFn fn, void *arg,
+                                         u32 *offset);
+
+/// Validates a display list and gets statistics about it.
+///
+/// The cycle estimation uses the timings of GBATEK for each command. It
+/// doesn't include the time needed to set up polygons, or the time that the
+/// GPU waits for the CPU or the DMA to fill the FIFO.
+///
+/// Display lists of models exported with md5_to_dsma use MTX_RESTORE to select
+/// the matrix of each joint, which is stored at the end of the matrix stack.
+/// If the number of joints is provided, the indices of all MTX_RESTORE commands
+/// are checked against the matrices used by joints.
+///
+/// @param list Pointer to the display list.
+/// @param size Size of the buffer that contains the display list in bytes. If
+///             it's 0, the size word of the display list is trusted.
+/// @param num_joints Number of joints of the animated model, or 0 for static
+///                   models.
+/// @param info Pointer to a struct to store the results.
+/// @return Returns 1 if the display list is valid, 0 if not.
+int NE_DisplayListAnalyze(const void *list, size_t size, int num_joints,
+                          NE_DisplayListInfo *info);
+
 /// @}
 
 #endif // NE_DISPLAYLIST_H__
@@ -7,6 +7,8 @@
 #ifndef NE_FAT_H__
 #define NE_FAT_H__
 
+#include <stdio.h>
+
 #include <nds.h>
 
 /// @file   NEFAT.h
@@ -20,13 +22,133 @@
 
 /// Loads a file to RAM from a filesystem.
 ///
+/// If the file has been compressed with the "--compress" option of the tools of
+/// Nitro Engine, it is decompressed while it's loaded.
+///
 /// @param filename Path to the file.
 /// @return Returns a pointer to the location of the file that will have to be
 ///         freed with free().
 char *NE_FATLoadData(const char *filename);
 
+/// Default size of the buffer used by NE_FATStreamOpen().
+#define NE_FAT_STREAM_CHUNK_SIZE (4 * 1024)
+
+/// Magic string at the start of compressed files.
+///
+/// It's followed by a header and data in the LZ77 format of the BIOS
+/// (compression type 0x10), so the decompressed size is stored in bits 8-31 of
+/// the word that follows the magic string.
+#define NE_FAT_LZ77_MAGIC "NELZ"
+
+/// Reads a file in chunks with a buffer of fixed size.
+typedef struct {
+    FILE *file;         ///< File being read
+    size_t size;        ///< Size of the data (decompressed size if compressed)
+    size_t offset;      ///< Number of bytes of data read
+    void *buffer;       ///< Buffer where the chunks are read to
+    size_t buffer_size; ///< Size of the buffer
+    bool free_buffer;   ///< True if the buffer has been allocated by the stream
+    bool compressed;    ///< True if the file is compressed
+    void *lz;           ///< State of the decompressor (internal)
+    void *archive;      ///< Archive that contains the file (internal)
+    long position;      ///< Position of the next read in the archive (internal)
+    long end;           ///< End of the file in the archive (internal)
+} NE_FATStream;
+
+/// Opens a file to read it in chunks.
+///
+/// Unlike NE_FATLoadData(), this doesn't need a buffer as big as the file. The
+/// buffer can be provided by the caller, so that it can be reused to read
+/// several files, or it can be allocated by this function. It's freed by
+/// NE_FATStreamClose() in that case.
+///
+/// Files compressed with the "--compress" option of the tools of Nitro Engine
+/// are detected and decompressed while they are read. The data is decompressed
+/// to an internal buffer of NE_FAT_STREAM_CHUNK_SIZE bytes plus 4 KB for the
+/// LZ77 window, so the provided buffer isn't used.
+///
+/// @param stream Stream struct to initialize.
+/// @param filename Path to the file.
+/// @param buffer Buffer used to read the file, or NULL to allocate one.
+/// @param buffer_size Size of the buffer. If "buffer" is NULL and this is 0,
+///                    the size is NE_FAT_STREAM_CHUNK_SIZE.
+/// @return Returns 1 on success, 0 on error.
+int NE_FATStreamOpen(NE_FATStream *stream, const char *filename,
+                     void *buffer, size_t buffer_size);
+
+/// Reads the next chunk of a file.
+///
+/// The data is read to the buffer of the stream, so it's only valid until the
+/// next call to this function. It can return fewer bytes than requested even
+/// if the end of the file hasn't been reached.
+///
+/// @param stream Stream.
+/// @param max_size Max number of bytes to read.
+/// @param data Returns a pointer to the data that has been read.
+/// @return Returns the number of bytes read, 0 at the end of the file, or -1 on
+///         error.
+int NE_FATStreamRead(NE_FATStream *stream, size_t max_size, const void **data);
+
+/// Closes a file stream.
+///
+/// @param stream Stream.
+void NE_FATStreamClose(NE_FATStream *stream);
+
+/// Max number of archives that can be open at the same time.
+#define NE_FAT_MAX_ARCHIVES 4
+
+/// Magic string at the start of archives.
+#define NE_FAT_ARCHIVE_MAGIC "NEPK"
+
+/// Version of the archive format.
+#define NE_FAT_ARCHIVE_VERSION 1
+
+/// Type of an archive entry that contains uncompressed data.
+#define NE_FAT_ARCHIVE_RAW 0
+/// Type of an archive entry that has been compressed with "--compress".
+#define NE_FAT_ARCHIVE_LZ77 1
+
+/// Header of an archive file.
+///
+/// It's followed by a hash table with "num_buckets" entries, a table of
+/// "names_size" bytes with the names of all files, and the data of the files.
+/// Archives are created with tools/pack_files/pack_files.py.
+typedef struct {
+    char magic[4];   ///< NE_FAT_ARCHIVE_MAGIC
+    u32 version;     ///< NE_FAT_ARCHIVE_VERSION
+    u32 num_buckets; ///< Number of entries of the hash table (power of two)
+    u32 names_size;  ///< Size of the table of names
+} NE_FATArchiveHeader;
+
+/// Opens an archive that contains many files.
+///
+/// The index of the archive is loaded to RAM and the file of the archive is
+/// kept open until it's closed with NE_FATArchiveClose(). After this, the files
+/// inside the archive can be loaded by any function of Nitro Engine that loads
+/// files from the filesystem with paths like "name:path/to/file.bin". Finding
+/// a file in the archive doesn't need to access the filesystem, and reading it
+/// needs at most one seek.
+///
+/// Paths with a prefix that doesn't match the name of an open archive, like
+/// "nitro:/file.bin", are opened from the filesystem as usual.
+///
+/// @param name Name used to refer to the archive in paths.
+/// @param path Path to the archive in the filesystem.
+/// @return Returns 1 on success, 0 on error.
+int NE_FATArchiveOpen(const char *name, const char *path);
+
+/// Closes an archive opened with NE_FATArchiveOpen().
+///
+/// There must not be any file of the archive open with NE_FATStreamOpen().
+///
+/// @param name Name of the archive.
+void NE_FATArchiveClose(const char *name);
+
 /// Returns size of a file.
 ///
+/// Files inside archives opened with NE_FATArchiveOpen() are supported. In that
+/// case the size is the size of the data stored in the archive.
+///
 /// @param filename File to check.
 /// @return Returns the file of the size, or -1 on error.
 size_t NE_FATFileSize(const char *filename);
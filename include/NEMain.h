@@ -33,6 +33,8 @@ extern "C" {
 
 #include "NE2D.h"
 #include "NEAnimation.h"
+#include "NEAsset.h"
+#include "NEAtlas.h"
 #include "NECamera.h"
 #include "NEDisplayList.h"
 #include "NEFAT.h"
@@ -43,6 +45,7 @@ extern "C" {
 #include "NEPalette.h"
 #include "NEPhysics.h"
 #include "NEPolygon.h"
+#include "NERenderQueue.h"
 #include "NERichText.h"
 #include "NEText.h"
 #include "NETexture.h"
@@ -21,6 +21,8 @@
 
 #define NE_DEFAULT_MODELS   512 ///< Default max number of models
 
+#define NE_MODEL_MAX_LODS   4 ///< Max number of levels of detail of a model
+
 /// Possible animation types.
 typedef enum {
     NE_ANIM_LOOP,    ///< When the end is reached it jumps to the start.
@@ -43,24 +45,72 @@ typedef enum {
 } NE_ModelType;
 
 /// Holds information of a model.
+///
+/// The position, rotation and scale of a model must be modified with functions
+/// like NE_ModelSetCoordI(), NE_ModelSetRot() or NE_ModelScaleI(). They keep
+/// track of the changes so that NE_ModelDraw() only needs to calculate the
+/// transformation matrix of the model when it has changed.
+///
+/// @warning The fields x, y, z, rx, ry, rz, sx, sy and sz are read-only. If
+///          they are modified directly NE_ModelDraw() keeps using the old
+///          transformation matrix. Use NE_ModelSetCoord(), NE_ModelSetCoordI(),
+///          NE_ModelTranslate(), NE_ModelTranslateI(), NE_ModelSetRot(),
+///          NE_ModelRotate(), NE_ModelScale() or NE_ModelScaleI() instead.
 typedef struct {
     NE_ModelType modeltype;   ///< Model type (static or animated)
     int meshindex;            ///< Index of mesh (static or DSM)
     NE_AnimInfo *animinfo[2]; ///< Animation information (two can be blended)
     int32_t anim_blend;       ///< Animation blend factor
     NE_Material *texture;     ///< Material used by this model
-    int x;                    ///< X position of the model (f32)
-    int y;                    ///< Y position of the model (f32)
-    int z;                    ///< Z position of the model (f32)
-    int rx;                   ///< Rotation of the model by X axis
-    int ry;                   ///< Rotation of the model by Y axis
-    int rz;                   ///< Rotation of the model by Z axis
-    int sx;                   ///< X scale of the model (f32)
-    int sy;                   ///< Y scale of the model (f32)
-    int sz;                   ///< Z scale of the model (f32)
+    int x;                    ///< X position (f32). Read-only, see above.
+    int y;                    ///< Y position (f32). Read-only, see above.
+    int z;                    ///< Z position (f32). Read-only, see above.
+    int rx;                   ///< Rotation by X axis. Read-only, see above.
+    int ry;                   ///< Rotation by Y axis. Read-only, see above.
+    int rz;                   ///< Rotation by Z axis. Read-only, see above.
+    int sx;                   ///< X scale (f32). Read-only, see above.
+    int sy;                   ///< Y scale (f32). Read-only, see above.
+    int sz;                   ///< Z scale (f32). Read-only, see above.
     m4x3 *mat;                ///< Transformation matrix assigned by the user.
+    m4x3 transform;           ///< Matrix of the position, rotation and scale
+    bool transform_dirty;     ///< True if the position, rotation or scale
+                              ///< have changed since 'transform' was updated
+    bool has_box;             ///< True if the bounding box is known
+    int32_t box[6];           ///< Bounding box (x, y, z, width, height, depth)
+    int32_t sphere[4];        ///< Sphere that contains the box (x, y, z, radius)
+    int num_lods;             ///< Number of levels of detail
+    int lod_meshindex[NE_MODEL_MAX_LODS]; ///< Meshes of the levels of detail
+    int32_t lod_distance[NE_MODEL_MAX_LODS]; ///< Depth of each level (f32)
 } NE_Model;
 
+/// Culling modes used by NE_ModelDraw().
+typedef enum {
+    NE_MODEL_CULLING_NONE,     ///< Draw all models (default)
+    NE_MODEL_CULLING_BOX_TEST, ///< Skip models that fail the GPU box test
+    NE_MODEL_CULLING_CPU       ///< Skip models outside of the camera view
+} NE_ModelCullingMode;
+
+/// Number of models handled by NE_ModelDraw() during a frame.
+typedef struct {
+    u32 tested; ///< Models whose bounding box has been tested
+    u32 culled; ///< Models that haven't been drawn because they weren't visible
+    u32 drawn;  ///< Models that have been drawn
+} NE_ModelCullingStats;
+
+/// Transformation of an instance drawn with NE_ModelDrawInstances().
+typedef struct {
+    int x;         ///< X position of the instance (f32)
+    int y;         ///< Y position of the instance (f32)
+    int z;         ///< Z position of the instance (f32)
+    int rx;        ///< Rotation of the instance by X axis (0 - 511)
+    int ry;        ///< Rotation of the instance by Y axis (0 - 511)
+    int rz;        ///< Rotation of the instance by Z axis (0 - 511)
+    int sx;        ///< X scale of the instance (f32)
+    int sy;        ///< Y scale of the instance (f32)
+    int sz;        ///< Z scale of the instance (f32)
+    int32_t frame; ///< Frame of the animation (f32). Animated models only.
+} NE_ModelInstance;
+
 /// Creates a new model object.
 ///
 /// @param type Model type (static or animated).
@@ -102,11 +152,82 @@ int NE_ModelLoadStaticMesh(NE_Model *model, const void *pointer);
 
 /// Loads a display list from a filesystem and assigns it to a static model.
 ///
+/// If the asset cache is enabled and the same file is already loaded, the data
+/// in RAM is shared instead of loading the file again. See
+/// NE_AssetCacheSetEnabled().
+///
 /// @param model Pointer to the model.
 /// @param path Path to the display list.
 /// @return It returns 1 on success, 0 on error.
 int NE_ModelLoadStaticMeshFAT(NE_Model *model, const char *path);
 
+/// Adds a level of detail to a model from a mesh stored in RAM.
+///
+/// Levels of detail are meshes that replace the main mesh of the model when
+/// the model is far from the camera. They are usually simplified versions of
+/// the main mesh. The mesh must be of the same type as the main mesh (a
+/// display list for static models, a DSM file for animated models). Animated
+/// meshes must use the same skeleton as the main mesh.
+///
+/// NE_ModelDraw() calculates the depth of the origin of the model in view
+/// space. It uses the last camera used with NE_CameraUse() in the current
+/// frame or, if there isn't one, the position test of the GPU (which has to
+/// wait for the GPU). The mesh used is the one with the biggest distance that
+/// is smaller or equal than the depth. If the depth is smaller than the
+/// distance of all levels, the main mesh is used.
+///
+/// The levels must be added in increasing order of distance. The bounding box
+/// of the model used for culling is calculated from the main mesh only.
+///
+/// @param model Pointer to the model.
+/// @param pointer Pointer to the mesh.
+/// @param distance Depth from which this level is used (f32).
+/// @return It returns 1 on success, 0 on error.
+int NE_ModelLodAdd(NE_Model *model, const void *pointer, int32_t distance);
+
+/// Adds a level of detail to a model from a mesh stored in a filesystem.
+///
+/// See NE_ModelLodAdd().
+///
+/// @param model Pointer to the model.
+/// @param path Path to the mesh.
+/// @param distance Depth from which this level is used (f32).
+/// @return It returns 1 on success, 0 on error.
+int NE_ModelLodAddFAT(NE_Model *model, const char *path, int32_t distance);
+
+/// Removes all levels of detail of a model.
+///
+/// The main mesh of the model isn't removed.
+///
+/// @param model Pointer to the model.
+void NE_ModelLodClear(NE_Model *model);
+
+/// Sets the polygon and vertex budget used to select levels of detail.
+///
+/// At the end of every frame, Nitro Engine checks the number of polygons and
+/// vertices drawn by the GPU. If they are over the budget, the depth of all
+/// models is multiplied by a bias so that levels of detail with fewer polygons
+/// are used. When the frame uses less than 7/8 of the budget the bias goes back
+/// to 1.0 slowly. The bias is increased faster than it's decreased so that the
+/// levels of detail don't change every frame.
+///
+/// The GPU can store up to 2048 polygons and 6144 vertices per frame. Setting
+/// a budget a bit lower than that, like 1800 polygons and 5400 vertices, makes
+/// it possible to react before polygons start to disappear.
+///
+/// Note that checking the number of polygons and vertices requires waiting for
+/// the GPU at the end of the frame.
+///
+/// @param polygons Max number of polygons (0 - 2048). 0 to ignore polygons.
+/// @param vertices Max number of vertices (0 - 6144). 0 to ignore vertices.
+///                 If both values are 0 the budget is disabled.
+void NE_ModelLodSetBudget(int polygons, int vertices);
+
+/// Returns the bias that the budget applies to the depth of models.
+///
+/// @return Bias (f32). It's 1.0 when the budget isn't exceeded.
+int32_t NE_ModelLodGetBias(void);
+
 /// Assign a material to a model.
 ///
 /// @param model Pointer to the model.
@@ -141,9 +262,115 @@ void NE_ModelSetAnimationSecondary(NE_Model *model, NE_Animation *anim);
 
 /// Draw a model.
 ///
+/// The transformation matrix of the model is sent to the GPU as a single 4x3
+/// matrix. It is only calculated again by the CPU if the position, rotation or
+/// scale of the model have changed since the last time it was drawn.
+///
+/// If culling is enabled with NE_ModelCullingSetMode(), models that are
+/// outside of the view aren't drawn.
+///
 /// @param model Pointer to the model.
 void NE_ModelDraw(const NE_Model *model);
 
+/// Draws a model several times with different transformations.
+///
+/// This is faster than drawing the same number of models with NE_ModelDraw().
+/// The material of the model is only set once, and the transformation of each
+/// instance is calculated by the CPU and sent to the GPU as a single matrix
+/// followed by the mesh of the model.
+///
+/// The mesh, material, levels of detail and bounding box of the model are
+/// used, but its position, rotation, scale and matrix are ignored. Animated
+/// models are drawn with the main animation at the frame of each instance. The
+/// secondary animation is ignored. The frame must be between 0 and the number
+/// of frames of the animation.
+///
+/// The culling mode set with NE_ModelCullingSetMode() is applied to each
+/// instance, and each instance is counted in the statistics of
+/// NE_ModelCullingGetStats() like a model.
+///
+/// @param model Pointer to the model.
+/// @param instances List of transformations.
+/// @param count Number of instances.
+void NE_ModelDrawInstances(const NE_Model *model,
+                           const NE_ModelInstance *instances, int count);
+
+/// Draws a model several times with different transformation matrices.
+///
+/// This works like NE_ModelDrawInstances(), but the transformation of each
+/// instance is a 4x3 matrix, like the one set with NE_ModelSetMatrix().
+///
+/// @param model Pointer to the model.
+/// @param matrices List of transformation matrices.
+/// @param frames List of frames of the animation of each instance (f32). If it
+///               is NULL, all instances use the current frame of the model.
+///               It's ignored for static models.
+/// @param count Number of instances.
+void NE_ModelDrawInstancesMatrix(const NE_Model *model, const m4x3 *matrices,
+                                 const int32_t *frames, int count);
+
+/// Sets the culling mode used by NE_ModelDraw().
+///
+/// The bounding box of a model is calculated when its mesh is loaded. For
+/// animated models it also depends on the animations assigned to the model: it
+/// contains all the positions that the model can reach in all frames of the
+/// animations. Models without a valid bounding box are always drawn. This
+/// happens if the display list changes the current matrix, for example.
+///
+/// With NE_MODEL_CULLING_BOX_TEST, NE_ModelDraw() sets the transformation of
+/// the model and uses the box test of the GPU to check if the bounding box is
+/// inside the view volume. If it isn't, the display list of the model isn't
+/// sent to the GPU. The box test has to wait until the GPU has executed all
+/// previous commands, so it's only worth it for models with a lot of polygons.
+///
+/// The result of the box test depends on the polygon attributes, so
+/// NE_ModelDraw() enables the rendering of polygons that cross the far plane
+/// and 1-dot polygons for the test. The attributes set with NE_PolyFormat()
+/// are restored afterwards, so they must be set with that function rather
+/// than writing to GFX_POLY_FORMAT directly.
+///
+/// With NE_MODEL_CULLING_CPU, NE_ModelDraw() checks the bounding sphere of the
+/// model against the view volume of the last camera used with NE_CameraUse()
+/// in the current frame before sending any command to the GPU. This is a lot
+/// faster than the box test, but it's only correct if the modelview matrix
+/// hasn't been modified after calling NE_CameraUse(). If no camera has been
+/// used in the current frame, models aren't culled.
+///
+/// @param mode Culling mode.
+void NE_ModelCullingSetMode(NE_ModelCullingMode mode);
+
+/// Returns the culling mode used by NE_ModelDraw().
+///
+/// @return Culling mode.
+NE_ModelCullingMode NE_ModelCullingGetMode(void);
+
+/// Culls a list of models against the view volume of a camera.
+///
+/// This function checks the bounding spheres of the models on the CPU, like
+/// NE_MODEL_CULLING_CPU, and it doesn't send any command to the GPU. It's
+/// meant to be used to cull all the objects of a scene at once before drawing
+/// them. Models without a bounding box are considered visible. The models are
+/// counted as tested and culled in the statistics of the current frame.
+///
+/// @param cam Camera.
+/// @param models List of models to check.
+/// @param count Number of models in the list.
+/// @param visible List where the visible models are stored. It must have space
+///                for 'count' models. It can be the same list as 'models'.
+/// @return Number of visible models.
+int NE_ModelCullBatch(NE_Camera *cam, NE_Model *const *models, int count,
+                      NE_Model **visible);
+
+/// Gets the number of models tested, culled and drawn during the last frame.
+///
+/// The counters are updated by NE_ModelDraw() and NE_ModelCullBatch(), and
+/// they are reset at the start of every frame by NE_Process() and the other
+/// processing functions. Models that aren't tested because culling is disabled
+/// or because they don't have a bounding box are counted as drawn.
+///
+/// @param stats Pointer to a struct to store the statistics.
+void NE_ModelCullingGetStats(NE_ModelCullingStats *stats);
+
 /// Clone model.
 ///
 /// This clones the mesh, including the animation, the material it uses. It
@@ -340,6 +567,10 @@ int NE_ModelLoadDSM(NE_Model *model, const void *pointer);
 
 /// Loads a DSM file stored in a filesystem to a model.
 ///
+/// If the asset cache is enabled and the same file is already loaded, the data
+/// in RAM is shared instead of loading the file again. See
+/// NE_AssetCacheSetEnabled().
+///
 /// @param model Pointer to the model.
 /// @param path Path to the file.
 /// @return It returns 1 on success, 0 on error.
@@ -94,10 +94,64 @@ int NE_PaletteFreeMem(void);
 /// @return Returns the percentage of available memory (0-100).
 int NE_PaletteFreeMemPercent(void);
 
+/// Returns the size of the biggest free block of memory for palettes.
+///
+/// @return Returns the size of the biggest free block in bytes.
+int NE_PaletteLargestFreeMem(void);
+
 /// Defragment memory used for palettes.
 ///
-/// WARNING: This function is currently not working.
-void NE_PaletteDefragMem(void);
+/// Palettes are moved to the start of the palette memory, keeping the
+/// alignment required by their format. All palette objects that use a palette
+/// that has been moved are updated.
+///
+/// This function is meant to be called during level loads, not while a palette
+/// is being modified with NE_PaletteModificationStart().
+///
+/// @return Returns the number of bytes that the biggest free block has grown.
+int NE_PaletteDefragMem(void);
+
+/// Calculate the result of defragmenting the memory used for palettes.
+///
+/// This calculates the new layout of the palettes like NE_PaletteDefragMem(),
+/// but it doesn't move any palette. The layout is calculated with a temporary
+/// copy of the palette allocator, so the state of the real allocator isn't
+/// modified and no operations are recorded in its trace.
+///
+/// @return Returns the number of bytes that the biggest free block would grow.
+int NE_PaletteDefragMemDryRun(void);
+
+/// Starts saving all allocations and frees of palette memory.
+///
+/// Operations are saved to a ring buffer. When it is full, the oldest entries
+/// are overwritten. The buffer can be saved to a file with
+/// NE_PaletteTraceDump(), and the file can be replayed on a PC with the tool
+/// tools/alloc_replay to analyze fragmentation.
+///
+/// The trace is discarded when the palette system is reset or ended.
+///
+/// @param num_entries Number of entries of the ring buffer.
+/// @return Returns 0 on success, a negative number on error.
+int NE_PaletteTraceStart(size_t num_entries);
+
+/// Stops saving operations and discards the trace.
+///
+/// @return Returns 0 on success, a negative number on error.
+int NE_PaletteTraceStop(void);
+
+/// Sets the tag saved in all new entries of the trace.
+///
+/// This can be used to tell which part of the game has done each allocation.
+///
+/// @param tag Tag to use.
+/// @return Returns 0 on success, a negative number on error.
+int NE_PaletteTraceSetTag(u16 tag);
+
+/// Saves the current trace to a file.
+///
+/// @param path Path to the destination file.
+/// @return Returns 0 on success, a negative number on error.
+int NE_PaletteTraceDump(const char *path);
 
 /// End palette system and free all memory used by it.
 void NE_PaletteSystemEnd(void);
@@ -101,6 +101,11 @@ void NE_ShininessTableGenerate(NE_ShininessFunction function);
 
 /// Begins a polygon.
 ///
+/// This function and the other functions to send individual commands, like
+/// NE_PolyColor() or NE_PolyVertexI(), don't wait for display lists sent with
+/// NE_DisplayListDrawAsync(). Call NE_DisplayListWait() before using them if
+/// display lists are sent asynchronously.
+///
 /// @param mode Type of polygon to draw (GL_TRIANGLE, GL_QUAD...).
 static inline void NE_PolyBegin(int mode)
 {
@@ -217,7 +222,7 @@ typedef enum {
     NE_RENDER_FAR_CLIPPED = (1 << 12), ///< Draw far-plane intersecting polys
 
     NE_HIDE_ONE_DOT_POLYS   = (0 << 13), ///< Hide 1-dot polygons behind DISP_1DOT_DEPTH
-    NE_RENDER_ONE_DOT_POLYS = (0 << 13), ///< Draw 1-dot polygons behind DISP_1DOT_DEPTH
+    NE_RENDER_ONE_DOT_POLYS = (1 << 13), ///< Draw 1-dot polygons behind DISP_1DOT_DEPTH
 
     NE_DEPTH_TEST_LESS  = (0 << 14), ///< Depth Test: draw pixels with less depth
     NE_DEPTH_TEST_EQUAL = (0 << 14), ///< Depth Test: draw pixels with equal depth
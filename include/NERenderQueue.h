@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2024 Antonio Niño Díaz
+//
+// This file is part of Nitro Engine
+
+#ifndef NE_RENDERQUEUE_H__
+#define NE_RENDERQUEUE_H__
+
+#include <nds.h>
+
+#include "NE2D.h"
+#include "NEModel.h"
+
+/// @file   NERenderQueue.h
+/// @brief  Queue that sorts objects to reduce changes of the GPU state.
+
+/// @defgroup render_queue Render queue
+///
+/// Functions to draw models, sprites and 2D quads sorted by their state.
+///
+/// Objects added to the queue aren't drawn until NE_RenderQueueFlush() is
+/// called. Then, they are drawn sorted by material, palette, polygon format and
+/// depth, so that objects with the same state are drawn one after the other.
+///
+/// Translucent objects (with an alpha value between 1 and 30) are drawn after
+/// the opaque ones, from back to front, because they are drawn in the order in
+/// which they are sent to the GPU. Models are drawn before sprites and quads.
+///
+/// Nitro Engine keeps a copy of the last value written to the registers of the
+/// polygon format, texture format, palette, diffuse/ambient and
+/// specular/emission. Writes to them are skipped if the register already has
+/// the same value. This works even if the render queue isn't used.
+///
+/// @{
+
+#define NE_DEFAULT_RENDER_QUEUE_SIZE 128 ///< Default max number of objects.
+
+/// Number of objects and state changes during a frame.
+typedef struct {
+    u32 drawn;         ///< Objects drawn by NE_RenderQueueFlush()
+    u32 state_changes; ///< Writes to registers of the state cache
+    u32 state_skipped; ///< Writes skipped because the value didn't change
+} NE_RenderQueueStats;
+
+/// Resets the render queue and sets the max number of objects.
+///
+/// If it has already been initialized, it deletes all the objects of the queue.
+///
+/// @param max_objects Max number of objects. If it is lower than 1, it will
+///                    create space for NE_DEFAULT_RENDER_QUEUE_SIZE.
+/// @return Returns 0 on success.
+int NE_RenderQueueReset(int max_objects);
+
+/// Ends the render queue and frees all memory used by it.
+void NE_RenderQueueEnd(void);
+
+/// Adds a model to the render queue.
+///
+/// The polygon format set with NE_PolyFormat() when this function is called is
+/// used to draw the model. The model isn't copied, so any change done to it
+/// before NE_RenderQueueFlush() will be visible.
+///
+/// If the render queue isn't initialized or it's full, the model is drawn right
+/// away.
+///
+/// @param model Model.
+void NE_RenderQueueAddModel(const NE_Model *model);
+
+/// Adds a sprite to the render queue.
+///
+/// If the render queue isn't initialized or it's full, the sprite is drawn
+/// right away.
+///
+/// @param sprite Sprite.
+void NE_RenderQueueAddSprite(const NE_Sprite *sprite);
+
+/// Adds a 2D quad to the render queue.
+///
+/// The polygon format set with NE_PolyFormat() when this function is called is
+/// used to draw the quad.
+///
+/// If the render queue isn't initialized or it's full, the quad is drawn right
+/// away.
+///
+/// @param x1 (x1, y1) Upper - left vertex.
+/// @param y1 (x1, y1) Upper - left vertex.
+/// @param x2 (x2, y2) Lower - right vertex.
+/// @param y2 (x2, y2) Lower - right vertex.
+/// @param z Priority.
+/// @param mat Material. If it is NULL, the quad isn't textured.
+/// @param color Color.
+void NE_RenderQueueAddQuad(s16 x1, s16 y1, s16 x2, s16 y2, s16 z,
+                           const NE_Material *mat, u32 color);
+
+/// Draws all objects of the render queue and empties it.
+///
+/// Models are drawn with the current projection and camera. If there are
+/// sprites or quads in the queue, NE_2DViewInit() is called after drawing the
+/// models, so it's a good idea to flush the queue at the end of the frame.
+///
+/// Objects that haven't been drawn at the start of the next frame are
+/// discarded.
+void NE_RenderQueueFlush(void);
+
+/// Gets the number of objects drawn and state changes of the last frame.
+///
+/// The counters are reset at the start of every frame by NE_Process() and the
+/// other processing functions. The state changes include all the writes done
+/// by Nitro Engine during the frame, not only the ones done by the queue.
+///
+/// @param stats Pointer to a struct to store the statistics.
+void NE_RenderQueueGetStats(NE_RenderQueueStats *stats);
+
+/// Forgets the values saved in the state cache.
+///
+/// This must be called after modifying the polygon format, texture format,
+/// palette, diffuse/ambient or specular/emission registers without Nitro
+/// Engine, for example with libnds functions or with display lists that aren't
+/// recorded with NE_DisplayListBuilderBegin(). The cache is also reset at the
+/// start of every frame.
+void NE_StateCacheInvalidate(void);
+
+/// @}
+
+#endif // NE_RENDERQUEUE_H__
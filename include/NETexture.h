@@ -27,6 +27,9 @@
 
 #define NE_NO_PALETTE       -1 ///< Value that represents not having a palette
 
+/// Default number of bytes copied by NE_TextureUploadUpdate() in each VBlank.
+#define NE_DEFAULT_UPLOAD_BUDGET (16 * 1024)
+
 /// Holds information of one material.
 typedef struct {
     int texindex;            ///< Index to internal texture object
@@ -89,6 +92,16 @@ void NE_MaterialColorDelete(NE_Material *tex);
 /// into texture slot 1. This function expects the two parts to be concatenated
 /// (with the slot 1 part after the other part).
 ///
+/// The file is copied to VRAM in chunks of NE_FAT_STREAM_CHUNK_SIZE bytes, so
+/// it doesn't need to fit in RAM. Files compressed with the "--compress" option
+/// of the tools are decompressed while they are copied.
+///
+/// If the asset cache is enabled and the same file has already been loaded with
+/// the same format, size and flags, the texture in VRAM is shared instead of
+/// loading the file again, like with NE_MaterialClone(). Modifying the texture
+/// with NE_TextureDrawingStart() modifies all the materials that share it. See
+/// NE_AssetCacheSetEnabled().
+///
 /// @param tex Material.
 /// @param fmt Texture format.
 /// @param sizeX (sizeX, sizeY) Texture size.
@@ -103,7 +116,8 @@ int NE_MaterialTexLoadFAT(NE_Material *tex, NE_TextureFormat fmt,
 /// Loads a texture in Texel 4x4 format from the filesystem and assigns it to a
 /// material object.
 ///
-/// Width and height need to be powers of two.
+/// Width and height need to be powers of two. The files are copied to VRAM in
+/// chunks of NE_FAT_STREAM_CHUNK_SIZE bytes, like in NE_MaterialTexLoadFAT().
 ///
 /// @param tex Material.
 /// @param sizeX (sizeX, sizeY) Texture size.
@@ -171,6 +185,140 @@ int NE_MaterialTex4x4Load(NE_Material *tex, int sizeX, int sizeY,
                           NE_TextureFlags flags, const void *texture02,
                           const void *texture1);
 
+/// Loads a managed texture from RAM and assigns it to a material object.
+///
+/// Managed textures work like textures loaded with NE_MaterialTexLoad(), but
+/// they can be removed from VRAM when there isn't enough space for other
+/// textures. VRAM works as a cache: when a texture needs space, the managed
+/// textures that have been used least recently are evicted. When an evicted
+/// texture is used again with NE_MaterialUse() it's uploaded to VRAM again.
+/// The GPU is using VRAM at that point, so the data is copied during the next
+/// VBlank periods, like with NE_MaterialTexLoadAsync(), and polygons are drawn
+/// without texture until then.
+///
+/// Managed textures used in the current frame or in the previous one are never
+/// evicted, as the GPU may still need them. Textures can also be locked in VRAM
+/// with NE_MaterialTexLock().
+///
+/// The texture data isn't copied. It must remain available in RAM until the
+/// material is deleted.
+///
+/// If there isn't enough VRAM to upload the texture right now, it will be
+/// uploaded the first time it is used.
+///
+/// Textures that are uploaded again lose all changes done with
+/// NE_TextureDrawingStart(), and palettes aren't managed.
+///
+/// @param tex Material.
+/// @param fmt Texture format.
+/// @param sizeX (sizeX, sizeY) Texture size.
+/// @param sizeY (sizeX, sizeY) Texture size.
+/// @param flags Parameters of the texture.
+/// @param texture Pointer to the texture data.
+/// @return It returns 1 on success, 0 on error.
+int NE_MaterialTexLoadManaged(NE_Material *tex, NE_TextureFormat fmt,
+                              int sizeX, int sizeY, NE_TextureFlags flags,
+                              const void *texture);
+
+/// Loads a managed texture from the filesystem and assigns it to a material.
+///
+/// This works like NE_MaterialTexLoadManaged(), but the texture isn't kept in
+/// RAM. The file is loaded again every time that the texture needs to be
+/// uploaded to VRAM. Tex4x4 textures need to be stored in one file like in
+/// NE_MaterialTexLoadFAT().
+///
+/// The file is copied to VRAM as soon as NE_MaterialUse() needs it, not during
+/// VBlank. Only the VRAM banks that are written are mapped to the CPU during
+/// the copy, but the textures in those banks may look corrupted for a frame.
+///
+/// @param tex Material.
+/// @param fmt Texture format.
+/// @param sizeX (sizeX, sizeY) Texture size.
+/// @param sizeY (sizeX, sizeY) Texture size.
+/// @param flags Parameters of the texture.
+/// @param path Path of the texture file.
+/// @return It returns 1 on success, 0 on error.
+int NE_MaterialTexLoadManagedFAT(NE_Material *tex, NE_TextureFormat fmt,
+                                 int sizeX, int sizeY, NE_TextureFlags flags,
+                                 const char *path);
+
+/// Prevents the managed texture of a material from being evicted from VRAM.
+///
+/// If the texture isn't in VRAM, it stays there after the next time it's used.
+/// Textures that aren't managed are never evicted.
+///
+/// @param tex Material.
+void NE_MaterialTexLock(NE_Material *tex);
+
+/// Allows the managed texture of a material to be evicted from VRAM again.
+///
+/// @param tex Material.
+void NE_MaterialTexUnlock(NE_Material *tex);
+
+/// Checks if the texture of a material is currently in VRAM.
+///
+/// @param tex Material.
+/// @return Returns false if it is a managed texture that has been evicted.
+bool NE_MaterialTexIsResident(const NE_Material *tex);
+
+/// Loads a texture from RAM in the background and assigns it to a material.
+///
+/// VRAM for the texture is allocated right away, but the data is copied later,
+/// with DMA, during the VBlank period. NE_TextureUploadUpdate() (which is
+/// called from NE_VBLFunc()) copies up to the number of bytes set with
+/// NE_TextureUploadSetBudget() every VBlank, so big textures are copied over
+/// several frames. Only the VRAM banks that are being written are unmapped
+/// from the GPU during the copy, and only while the GPU isn't drawing.
+///
+/// Until the texture has been copied the material is pending, and
+/// NE_MaterialUse() draws polygons without texture.
+///
+/// The texture data must remain available in RAM and it can't be modified
+/// until NE_MaterialTexIsPending() returns false. Tex4x4 textures need to be
+/// stored like in NE_MaterialTexLoad().
+///
+/// @param tex Material.
+/// @param fmt Texture format.
+/// @param sizeX (sizeX, sizeY) Texture size.
+/// @param sizeY (sizeX, sizeY) Texture size.
+/// @param flags Parameters of the texture.
+/// @param texture Pointer to the texture data.
+/// @return It returns 1 on success, 0 on error.
+int NE_MaterialTexLoadAsync(NE_Material *tex, NE_TextureFormat fmt,
+                            int sizeX, int sizeY, NE_TextureFlags flags,
+                            const void *texture);
+
+/// Checks if the texture of a material is waiting to be copied to VRAM.
+///
+/// @param tex Material.
+/// @return Returns true if the texture has been loaded with
+///         NE_MaterialTexLoadAsync() and the copy hasn't finished.
+bool NE_MaterialTexIsPending(const NE_Material *tex);
+
+/// Sets the max number of bytes copied to VRAM in each VBlank.
+///
+/// Copies are also stopped when the GPU starts drawing the next frame, so a
+/// big budget only helps if the CPU is fast enough to copy everything during
+/// the VBlank period.
+///
+/// @param max_bytes Number of bytes (NE_DEFAULT_UPLOAD_BUDGET by default).
+void NE_TextureUploadSetBudget(size_t max_bytes);
+
+/// Copies part of the textures loaded with NE_MaterialTexLoadAsync() to VRAM.
+///
+/// This is called from NE_VBLFunc(), it only needs to be called manually if
+/// NE_VBLFunc() isn't used as VBlank interrupt handler. It must be called
+/// during the VBlank period.
+///
+/// @return Number of pending copies left.
+int NE_TextureUploadUpdate(void);
+
+/// Copies all textures loaded with NE_MaterialTexLoadAsync() to VRAM.
+///
+/// This doesn't wait for the VBlank period and it copies everything right away.
+/// It's useful in loading screens.
+void NE_TextureUploadFlush(void);
+
 /// Tell a material that it has to delete its palette on deletion.
 ///
 /// Normally, when a material is deleted, the palette isn't deleted with it.
@@ -216,9 +364,37 @@ void NE_MaterialSetPalette(NE_Material *tex, NE_Palette *pal);
 /// polygons won't be affected by them until this function is called again with
 /// a valid material.
 ///
+/// If the material uses a managed texture that has been evicted from VRAM, it
+/// is uploaded again. Polygons are drawn without texture until the upload ends
+/// (see NE_MaterialTexLoadManaged()) or if there isn't enough VRAM for it.
+///
 /// @param tex Material to be used.
 void NE_MaterialUse(const NE_Material *tex);
 
+/// Statistics of the cache of managed textures.
+typedef struct {
+    u32 hits;       ///< Uses of managed textures that were in VRAM
+    u32 misses;     ///< Uses of managed textures that had to be uploaded
+    u32 evictions;  ///< Managed textures removed from VRAM to make space
+    u32 failed;     ///< Uploads that failed because there wasn't enough VRAM
+    u32 managed;    ///< Number of managed textures
+    u32 resident;   ///< Number of managed textures in VRAM
+    u32 resident_bytes; ///< VRAM used by managed textures
+} NE_TextureCacheStats;
+
+/// Gets the statistics of the cache of managed textures.
+///
+/// The counters of hits, misses, evictions and failed uploads are accumulated
+/// since the texture system was reset or NE_TextureCacheResetStats() was
+/// called. A miss happens when NE_MaterialUse() has to upload a texture, which
+/// is slow, so the number of misses per frame should normally be close to zero.
+///
+/// @param stats Pointer to a struct to store the statistics.
+void NE_TextureCacheGetStats(NE_TextureCacheStats *stats);
+
+/// Resets the counters of hits, misses, evictions and failed uploads.
+void NE_TextureCacheResetStats(void);
+
 /// Flags to choose which VRAM banks Nitro Engine can use to allocate textures.
 typedef enum {
     NE_VRAM_A = (1 << 0), ///< Bank A
@@ -239,8 +415,24 @@ typedef enum {
     NE_VRAM_BCD = NE_VRAM_B | NE_VRAM_C | NE_VRAM_D, ///< Banks B, C and D
 
     NE_VRAM_ABCD = NE_VRAM_A | NE_VRAM_B | NE_VRAM_C | NE_VRAM_D, ///< All main banks
+
+    /// Place textures at the end of VRAM (default).
+    NE_TEXTURE_ALLOC_FROM_END = (0 << 4),
+    /// Place textures in the free gap with the lowest address where they fit.
+    NE_TEXTURE_ALLOC_FIRST_FIT = (1 << 4),
+    /// Place textures in the smallest free gap where they fit.
+    NE_TEXTURE_ALLOC_BEST_FIT = (2 << 4),
+    /// Place textures in VRAM_D first, then in the halves of VRAM_B that
+    /// match a bank that isn't used for textures, then in VRAM_C and VRAM_A,
+    /// and VRAM_B last. Compressed textures need space in VRAM_A or VRAM_C and
+    /// half of that space in VRAM_B, so every byte of VRAM_B used by another
+    /// texture can block two bytes of VRAM_A or VRAM_C.
+    NE_TEXTURE_ALLOC_BANK_PARTITIONED = (3 << 4),
 } NE_VRAMBankFlags;
 
+/// Mask of the placement policy bits of NE_VRAMBankFlags.
+#define NE_TEXTURE_ALLOC_POLICY_MASK (3 << 4)
+
 /// Resets the material system and sets the new max number of objects.
 ///
 /// In Dual 3D mode, only VRAM A and B are available for textures.
@@ -248,11 +440,21 @@ typedef enum {
 /// If no VRAM banks are specified in this function, all VRAM banks A to D will
 /// be used for textures (or just A and B in dual 3D mode).
 ///
+/// The placement policy of textures can be selected by adding one of the
+/// NE_TEXTURE_ALLOC_* values to the VRAM bank flags. It only affects textures
+/// that aren't compressed. Compressed textures (NE_TEX4X4) always need to be
+/// placed in slot 0 or 2 with the matching space in slot 1. For example:
+///
+/// ```
+/// NE_TextureSystemReset(0, 0, NE_VRAM_ABCD | NE_TEXTURE_ALLOC_BEST_FIT);
+/// ```
+///
 /// @param max_textures Max number of textures. If lower than 1, it will
 ///                     create space for NE_DEFAULT_TEXTURES.
 /// @param max_palettes Max number of palettes. If lower than 1, it will
 ///                     create space for NE_DEFAULT_PALETTES.
-/// @param bank_flags VRAM banks where Nitro Engine can allocate textures.
+/// @param bank_flags VRAM banks where Nitro Engine can allocate textures, and
+///                   placement policy.
 /// @return Returns 0 on success.
 int NE_TextureSystemReset(int max_textures, int max_palettes,
                           NE_VRAMBankFlags bank_flags);
@@ -276,11 +478,86 @@ int NE_TextureFreeMem(void);
 /// @return Returns the percentage of available memory (0-100).
 int NE_TextureFreeMemPercent(void);
 
+/// Returns the size of the biggest free block of memory for textures.
+///
+/// This is the size of the biggest texture that can be loaded right now. If it
+/// is a lot smaller than NE_TextureFreeMem(), it may be a good idea to call
+/// NE_TextureDefragMem().
+///
+/// @return Returns the size of the biggest free block in bytes.
+int NE_TextureLargestFreeMem(void);
+
 /// Defragment memory used for textures.
 ///
-/// WARNING: This function is currently not working.
+/// Regular textures are moved to the best free location according to the
+/// placement policy selected in NE_TextureSystemReset(), and tex4x4 textures
+/// are moved to the start of slot 0 or 2 (and the matching part of slot 1), so
+/// that free space is merged into bigger blocks. All materials that use a
+/// texture that has been moved are updated.
+///
+/// This function moves all textures that can be moved, so it can take a long
+/// time. Use NE_TextureDefragMemStep() to spread the work over several frames.
+///
+/// Don't call this function between NE_TextureDrawingStart() and
+/// NE_TextureDrawingEnd().
 void NE_TextureDefragMem(void);
 
+/// Defragment memory used for textures, copying a limited amount of data.
+///
+/// This does the same thing as NE_TextureDefragMem(), but it stops after
+/// copying "max_bytes" bytes. It is meant to be called once per frame, right
+/// after NE_WaitForVBL(), until it returns 0.
+///
+/// Textures bigger than the remaining budget are copied over several calls.
+/// They are only moved to locations that don't overlap their current location,
+/// and they keep using the old one until all their data has been copied, so
+/// they can be drawn normally in the meantime. Because of this, some textures
+/// that NE_TextureDefragMem() would move may not be moved by this function.
+///
+/// Only the VRAM banks that contain the textures being moved are mapped to the
+/// CPU while they are copied. The textures of other banks aren't affected.
+///
+/// If NE_TextureDrawingStart() is called with a texture that is being moved,
+/// the move is cancelled.
+///
+/// @param max_bytes Maximum number of bytes to copy. 0 means no limit. The
+///                  minimum is 4 bytes.
+/// @return Returns the number of bytes copied, 0 if memory is defragmented, or
+///         a negative number on error.
+int NE_TextureDefragMemStep(size_t max_bytes);
+
+/// Starts saving all allocations and frees of texture memory.
+///
+/// Operations are saved to a ring buffer. When it is full, the oldest entries
+/// are overwritten. The buffer can be saved to a file with
+/// NE_TextureTraceDump(), and the file can be replayed on a PC with the tool
+/// tools/alloc_replay to analyze fragmentation.
+///
+/// The trace is discarded when the texture system is reset or ended.
+///
+/// @param num_entries Number of entries of the ring buffer.
+/// @return Returns 0 on success, a negative number on error.
+int NE_TextureTraceStart(size_t num_entries);
+
+/// Stops saving operations and discards the trace.
+///
+/// @return Returns 0 on success, a negative number on error.
+int NE_TextureTraceStop(void);
+
+/// Sets the tag saved in all new entries of the trace.
+///
+/// This can be used to tell which part of the game has done each allocation.
+///
+/// @param tag Tag to use.
+/// @return Returns 0 on success, a negative number on error.
+int NE_TextureTraceSetTag(u16 tag);
+
+/// Saves the current trace to a file.
+///
+/// @param path Path to the destination file.
+/// @return Returns 0 on success, a negative number on error.
+int NE_TextureTraceDump(const char *path);
+
 /// End texture system and free all memory used by it.
 void NE_TextureSystemEnd(void);
 
@@ -5,6 +5,7 @@
 // This file is part of Nitro Engine
 
 #include "NEMain.h"
+#include "NEGFX.h"
 
 /// @file NE2D.c
 
@@ -118,6 +119,22 @@ void NE_SpriteSetMaterialCanvas(NE_Sprite *sprite, int tl, int tt, int tr, int t
     sprite->tb = tb;
 }
 
+void NE_SpriteSetAtlasImage(NE_Sprite *sprite, const NE_AtlasImage *image)
+{
+    NE_AssertPointer(sprite, "NULL sprite pointer");
+    NE_AssertPointer(image, "NULL image pointer");
+
+    sprite->mat = image->mat;
+
+    sprite->w = image->tr - image->tl;
+    sprite->h = image->tb - image->tt;
+
+    sprite->tl = image->tl;
+    sprite->tr = image->tr;
+    sprite->tt = image->tt;
+    sprite->tb = image->tb;
+}
+
 void NE_SpriteSetPriority(NE_Sprite *sprite, int priority)
 {
     NE_AssertPointer(sprite, "NULL pointer");
@@ -217,7 +234,7 @@ void NE_SpriteDraw(const NE_Sprite *sprite)
 
     if (sprite->rot_angle)
     {
-        MATRIX_PUSH = 0;
+        NE_GFX(MATRIX_PUSH) = 0;
 
         NE_2DViewRotateScaleByPositionXYI(sprite->x + (sprite->w >> 1),
                                         sprite->y + (sprite->h >> 1),
@@ -231,8 +248,9 @@ void NE_SpriteDraw(const NE_Sprite *sprite)
                                   sprite->xscale, sprite->yscale);
     }
 
-    GFX_POLY_FORMAT = POLY_ALPHA(sprite->alpha) | POLY_ID(sprite->id) |
-                      NE_CULL_NONE;
+    NE_GFX_STATE(NE_STATE_POLY_FORMAT, GFX_POLY_FORMAT,
+                 POLY_ALPHA(sprite->alpha) | POLY_ID(sprite->id) |
+                 NE_CULL_NONE);
 
     NE_2DDrawTexturedQuadColorCanvas(sprite->x, sprite->y,
                                      sprite->x + sprite->w,
@@ -243,7 +261,7 @@ void NE_SpriteDraw(const NE_Sprite *sprite)
                                      sprite->mat, sprite->color);
 
     if (sprite->rot_angle)
-        MATRIX_POP = 1;
+        NE_GFX(MATRIX_POP) = 1;
 }
 
 void NE_SpriteDrawAll(void)
@@ -263,7 +281,7 @@ void NE_SpriteDrawAll(void)
 
         if (sprite->rot_angle)
         {
-            MATRIX_PUSH = 0;
+            NE_GFX(MATRIX_PUSH) = 0;
 
             NE_2DViewRotateScaleByPositionXYI(sprite->x + (sprite->w >> 1),
                                             sprite->y + (sprite->h >> 1),
@@ -277,8 +295,9 @@ void NE_SpriteDrawAll(void)
                                       sprite->xscale, sprite->yscale);
         }
 
-        GFX_POLY_FORMAT = POLY_ALPHA(sprite->alpha) |
-                          POLY_ID(sprite->id) | NE_CULL_NONE;
+        NE_GFX_STATE(NE_STATE_POLY_FORMAT, GFX_POLY_FORMAT,
+                     POLY_ALPHA(sprite->alpha) |
+                     POLY_ID(sprite->id) | NE_CULL_NONE);
 
         NE_2DDrawTexturedQuadColorCanvas(sprite->x, sprite->y,
                                          sprite->x + sprite->w,
@@ -289,7 +308,7 @@ void NE_SpriteDrawAll(void)
                                          sprite->mat, sprite->color);
 
         if (sprite->rot_angle)
-            MATRIX_POP = 1;
+            NE_GFX(MATRIX_POP) = 1;
     }
 }
 
@@ -306,9 +325,34 @@ int __NE_TextureGetRawY(const NE_Material *tex);
 
 //--------------------------------------------
 
+// Version of glOrthof32() of libnds that can be recorded in display lists
+static void ne_2d_ortho(int left, int right, int bottom, int top, int znear,
+                        int zfar)
+{
+    NE_GFX(MATRIX_MULT4x4) = divf32(inttof32(2), right - left);
+    NE_GFX(MATRIX_MULT4x4) = 0;
+    NE_GFX(MATRIX_MULT4x4) = 0;
+    NE_GFX(MATRIX_MULT4x4) = 0;
+
+    NE_GFX(MATRIX_MULT4x4) = 0;
+    NE_GFX(MATRIX_MULT4x4) = divf32(inttof32(2), top - bottom);
+    NE_GFX(MATRIX_MULT4x4) = 0;
+    NE_GFX(MATRIX_MULT4x4) = 0;
+
+    NE_GFX(MATRIX_MULT4x4) = 0;
+    NE_GFX(MATRIX_MULT4x4) = 0;
+    NE_GFX(MATRIX_MULT4x4) = divf32(inttof32(-2), zfar - znear);
+    NE_GFX(MATRIX_MULT4x4) = 0;
+
+    NE_GFX(MATRIX_MULT4x4) = -divf32(right + left, right - left);
+    NE_GFX(MATRIX_MULT4x4) = -divf32(top + bottom, top - bottom);
+    NE_GFX(MATRIX_MULT4x4) = -divf32(zfar + znear, zfar - znear);
+    NE_GFX(MATRIX_MULT4x4) = inttof32(1);
+}
+
 void NE_2DViewInit(void)
 {
-    GFX_VIEWPORT = 0 | (0 << 8) | (255 << 16) | (191 << 24);
+    NE_GFX(GFX_VIEWPORT) = 0 | (0 << 8) | (255 << 16) | (191 << 24);
 
     // The projection matrix actually thinks that the size of the DS is
     // (256 << factor) x (192 << factor). After this, we scale the MODELVIEW
@@ -337,19 +381,19 @@ void NE_2DViewInit(void)
     // In my tests, Y axis distortion starts to happen with a factor of 4, so a
     // factor of 2 should be safe and reduce enough flickering.
 
-    MATRIX_CONTROL = GL_PROJECTION;
-    MATRIX_IDENTITY = 0;
+    NE_GFX(MATRIX_CONTROL) = GL_PROJECTION;
+    NE_GFX(MATRIX_IDENTITY) = 0;
 
     int factor = 2;
 
-    glOrthof32(0, 256 << factor, 192 << factor, 0, inttof32(1), inttof32(-1));
+    ne_2d_ortho(0, 256 << factor, 192 << factor, 0, inttof32(1), inttof32(-1));
 
-    MATRIX_CONTROL = GL_MODELVIEW;
-    MATRIX_IDENTITY = 0;
+    NE_GFX(MATRIX_CONTROL) = GL_MODELVIEW;
+    NE_GFX(MATRIX_IDENTITY) = 0;
 
-    MATRIX_SCALE = inttof32(1 << factor);
-    MATRIX_SCALE = inttof32(1 << factor);
-    MATRIX_SCALE = inttof32(1);
+    NE_GFX(MATRIX_SCALE) = inttof32(1 << factor);
+    NE_GFX(MATRIX_SCALE) = inttof32(1 << factor);
+    NE_GFX(MATRIX_SCALE) = inttof32(1);
 
     NE_PolyFormat(31, 0, 0, NE_CULL_NONE, 0);
 }
@@ -358,11 +402,11 @@ void NE_2DViewRotateScaleByPositionXYI(int x, int y, int rotz, int xscale, int y
 {
     NE_ViewMoveI(x, y, 0);
 
-    MATRIX_SCALE = xscale;
-    MATRIX_SCALE = yscale;
-    MATRIX_SCALE = inttof32(1);
+    NE_GFX(MATRIX_SCALE) = xscale;
+    NE_GFX(MATRIX_SCALE) = yscale;
+    NE_GFX(MATRIX_SCALE) = inttof32(1);
 
-    glRotateZi(rotz << 6);
+    ne_gfx_rotate_z(rotz << 6);
 
     NE_ViewMoveI(-x, -y, 0);
 }
@@ -375,7 +419,7 @@ void NE_2DViewRotateByPosition(int x, int y, int rotz)
 {
     NE_ViewMoveI(x, y, 0);
 
-    glRotateZi(rotz << 6);
+    ne_gfx_rotate_z(rotz << 6);
 
     NE_ViewMoveI(-x, -y, 0);
 }
@@ -384,9 +428,9 @@ void NE_2DViewScaleByPositionXYI(int x, int y, int xscale, int yscale)
 {
     NE_ViewMoveI(x, y, 0);
 
-    MATRIX_SCALE = xscale;
-    MATRIX_SCALE = yscale;
-    MATRIX_SCALE = inttof32(1);
+    NE_GFX(MATRIX_SCALE) = xscale;
+    NE_GFX(MATRIX_SCALE) = yscale;
+    NE_GFX(MATRIX_SCALE) = inttof32(1);
 
     NE_ViewMoveI(-x, -y, 0);
 }
@@ -397,41 +441,41 @@ void NE_2DViewRotateScaleByPositionI(int x, int y, int rotz, int scale) {
 
 void NE_2DDrawQuad(s16 x1, s16 y1, s16 x2, s16 y2, s16 z, u32 color)
 {
-    GFX_BEGIN = GL_QUADS;
+    NE_GFX(GFX_BEGIN) = GL_QUADS;
 
-    GFX_TEX_FORMAT = 0;
+    NE_GFX_STATE(NE_STATE_TEX_FORMAT, GFX_TEX_FORMAT, 0);
 
-    GFX_COLOR = color;
+    NE_GFX(GFX_COLOR) = color;
 
-    GFX_VERTEX16 = (y1 << 16) | (x1 & 0xFFFF); // Up-left
-    GFX_VERTEX16 = z;
+    NE_GFX(GFX_VERTEX16) = (y1 << 16) | (x1 & 0xFFFF); // Up-left
+    NE_GFX(GFX_VERTEX16) = z;
 
-    GFX_VERTEX_XY = (y2 << 16) | (x1 & 0xFFFF); // Down-left
+    NE_GFX(GFX_VERTEX_XY) = (y2 << 16) | (x1 & 0xFFFF); // Down-left
 
-    GFX_VERTEX_XY = (y2 << 16) | (x2 & 0xFFFF); // Down-right
+    NE_GFX(GFX_VERTEX_XY) = (y2 << 16) | (x2 & 0xFFFF); // Down-right
 
-    GFX_VERTEX_XY = (y1 << 16) | (x2 & 0xFFFF); // Up-right
+    NE_GFX(GFX_VERTEX_XY) = (y1 << 16) | (x2 & 0xFFFF); // Up-right
 }
 
 void NE_2DDrawQuadGradient(s16 x1, s16 y1, s16 x2, s16 y2, s16 z, u32 color1,
                            u32 color2, u32 color3, u32 color4)
 {
-    GFX_BEGIN = GL_QUADS;
+    NE_GFX(GFX_BEGIN) = GL_QUADS;
 
-    GFX_TEX_FORMAT = 0;
+    NE_GFX_STATE(NE_STATE_TEX_FORMAT, GFX_TEX_FORMAT, 0);
 
-    GFX_COLOR = color1;
-    GFX_VERTEX16 = (y1 << 16) | (x1 & 0xFFFF); // Up-left
-    GFX_VERTEX16 = z;
+    NE_GFX(GFX_COLOR) = color1;
+    NE_GFX(GFX_VERTEX16) = (y1 << 16) | (x1 & 0xFFFF); // Up-left
+    NE_GFX(GFX_VERTEX16) = z;
 
-    GFX_COLOR = color4;
-    GFX_VERTEX_XY = (y2 << 16) | (x1 & 0xFFFF); // Down-left
+    NE_GFX(GFX_COLOR) = color4;
+    NE_GFX(GFX_VERTEX_XY) = (y2 << 16) | (x1 & 0xFFFF); // Down-left
 
-    GFX_COLOR = color3;
-    GFX_VERTEX_XY = (y2 << 16) | (x2 & 0xFFFF); // Down-right
+    NE_GFX(GFX_COLOR) = color3;
+    NE_GFX(GFX_VERTEX_XY) = (y2 << 16) | (x2 & 0xFFFF); // Down-right
 
-    GFX_COLOR = color2;
-    GFX_VERTEX_XY = (y1 << 16) | (x2 & 0xFFFF); // Up-right
+    NE_GFX(GFX_COLOR) = color2;
+    NE_GFX(GFX_VERTEX_XY) = (y1 << 16) | (x2 & 0xFFFF); // Up-right
 }
 
 void NE_2DDrawTexturedQuad(s16 x1, s16 y1, s16 x2, s16 y2, s16 z,
@@ -444,20 +488,20 @@ void NE_2DDrawTexturedQuad(s16 x1, s16 y1, s16 x2, s16 y2, s16 z,
 
     NE_MaterialUse(mat);
 
-    GFX_BEGIN = GL_QUADS;
+    NE_GFX(GFX_BEGIN) = GL_QUADS;
 
-    GFX_TEX_COORD = TEXTURE_PACK(0, 0);
-    GFX_VERTEX16 = (y1 << 16) | (x1 & 0xFFFF); // Up-left
-    GFX_VERTEX16 = z;
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(0, 0);
+    NE_GFX(GFX_VERTEX16) = (y1 << 16) | (x1 & 0xFFFF); // Up-left
+    NE_GFX(GFX_VERTEX16) = z;
 
-    GFX_TEX_COORD = TEXTURE_PACK(0, inttot16(y));
-    GFX_VERTEX_XY = (y2 << 16) | (x1 & 0xFFFF); // Down-left
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(0, inttot16(y));
+    NE_GFX(GFX_VERTEX_XY) = (y2 << 16) | (x1 & 0xFFFF); // Down-left
 
-    GFX_TEX_COORD = TEXTURE_PACK(inttot16(x), inttot16(y));
-    GFX_VERTEX_XY = (y2 << 16) | (x2 & 0xFFFF); // Down-right
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(inttot16(x), inttot16(y));
+    NE_GFX(GFX_VERTEX_XY) = (y2 << 16) | (x2 & 0xFFFF); // Down-right
 
-    GFX_TEX_COORD = TEXTURE_PACK(inttot16(x), 0);
-    GFX_VERTEX_XY = (y1 << 16) | (x2 & 0xFFFF); // Up-right
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(inttot16(x), 0);
+    NE_GFX(GFX_VERTEX_XY) = (y1 << 16) | (x2 & 0xFFFF); // Up-right
 }
 
 void NE_2DDrawTexturedQuadColor(s16 x1, s16 y1, s16 x2, s16 y2, s16 z,
@@ -470,22 +514,22 @@ void NE_2DDrawTexturedQuadColor(s16 x1, s16 y1, s16 x2, s16 y2, s16 z,
 
     NE_MaterialUse(mat);
 
-    GFX_COLOR = color;
+    NE_GFX(GFX_COLOR) = color;
 
-    GFX_BEGIN = GL_QUADS;
+    NE_GFX(GFX_BEGIN) = GL_QUADS;
 
-    GFX_TEX_COORD = TEXTURE_PACK(0, 0);
-    GFX_VERTEX16 = (y1 << 16) | (x1 & 0xFFFF); // Up-left
-    GFX_VERTEX16 = z;
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(0, 0);
+    NE_GFX(GFX_VERTEX16) = (y1 << 16) | (x1 & 0xFFFF); // Up-left
+    NE_GFX(GFX_VERTEX16) = z;
 
-    GFX_TEX_COORD = TEXTURE_PACK(0, inttot16(y));
-    GFX_VERTEX_XY = (y2 << 16) | (x1 & 0xFFFF); // Down-left
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(0, inttot16(y));
+    NE_GFX(GFX_VERTEX_XY) = (y2 << 16) | (x1 & 0xFFFF); // Down-left
 
-    GFX_TEX_COORD = TEXTURE_PACK(inttot16(x), inttot16(y));
-    GFX_VERTEX_XY = (y2 << 16) | (x2 & 0xFFFF); // Down-right
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(inttot16(x), inttot16(y));
+    NE_GFX(GFX_VERTEX_XY) = (y2 << 16) | (x2 & 0xFFFF); // Down-right
 
-    GFX_TEX_COORD = TEXTURE_PACK(inttot16(x), 0);
-    GFX_VERTEX_XY = (y1 << 16) | (x2 & 0xFFFF); // Up-right
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(inttot16(x), 0);
+    NE_GFX(GFX_VERTEX_XY) = (y1 << 16) | (x2 & 0xFFFF); // Up-right
 }
 
 void NE_2DDrawTexturedQuadGradient(s16 x1, s16 y1, s16 x2, s16 y2, s16 z,
@@ -499,24 +543,24 @@ void NE_2DDrawTexturedQuadGradient(s16 x1, s16 y1, s16 x2, s16 y2, s16 z,
 
     NE_MaterialUse(mat);
 
-    GFX_BEGIN = GL_QUADS;
+    NE_GFX(GFX_BEGIN) = GL_QUADS;
 
-    GFX_COLOR = color1;
-    GFX_TEX_COORD = TEXTURE_PACK(0, 0);
-    GFX_VERTEX16 = (y1 << 16) | (x1 & 0xFFFF); // Up-left
-    GFX_VERTEX16 = z;
+    NE_GFX(GFX_COLOR) = color1;
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(0, 0);
+    NE_GFX(GFX_VERTEX16) = (y1 << 16) | (x1 & 0xFFFF); // Up-left
+    NE_GFX(GFX_VERTEX16) = z;
 
-    GFX_COLOR = color4;
-    GFX_TEX_COORD = TEXTURE_PACK(0, inttot16(y));
-    GFX_VERTEX_XY = (y2 << 16) | (x1 & 0xFFFF); // Down-left
+    NE_GFX(GFX_COLOR) = color4;
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(0, inttot16(y));
+    NE_GFX(GFX_VERTEX_XY) = (y2 << 16) | (x1 & 0xFFFF); // Down-left
 
-    GFX_COLOR = color3;
-    GFX_TEX_COORD = TEXTURE_PACK(inttot16(x), inttot16(y));
-    GFX_VERTEX_XY = (y2 << 16) | (x2 & 0xFFFF); // Down-right
+    NE_GFX(GFX_COLOR) = color3;
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(inttot16(x), inttot16(y));
+    NE_GFX(GFX_VERTEX_XY) = (y2 << 16) | (x2 & 0xFFFF); // Down-right
 
-    GFX_COLOR = color2;
-    GFX_TEX_COORD = TEXTURE_PACK(inttot16(x), 0);
-    GFX_VERTEX_XY = (y1 << 16) | (x2 & 0xFFFF); // Up-right
+    NE_GFX(GFX_COLOR) = color2;
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(inttot16(x), 0);
+    NE_GFX(GFX_VERTEX_XY) = (y1 << 16) | (x2 & 0xFFFF); // Up-right
 }
 
 void NE_2DDrawTexturedQuadColorCanvas(s16 x1, s16 y1, s16 x2, s16 y2, s16 z,
@@ -528,20 +572,20 @@ void NE_2DDrawTexturedQuadColorCanvas(s16 x1, s16 y1, s16 x2, s16 y2, s16 z,
 
     NE_MaterialUse(mat);
 
-    GFX_COLOR = color;
+    NE_GFX(GFX_COLOR) = color;
 
-    GFX_BEGIN = GL_QUADS;
+    NE_GFX(GFX_BEGIN) = GL_QUADS;
 
-    GFX_TEX_COORD = TEXTURE_PACK(inttot16(tl), inttot16(tt));
-    GFX_VERTEX16 = (y1 << 16) | (x1 & 0xFFFF); // Up-left
-    GFX_VERTEX16 = z;
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(inttot16(tl), inttot16(tt));
+    NE_GFX(GFX_VERTEX16) = (y1 << 16) | (x1 & 0xFFFF); // Up-left
+    NE_GFX(GFX_VERTEX16) = z;
 
-    GFX_TEX_COORD = TEXTURE_PACK(inttot16(tl), inttot16(tb));
-    GFX_VERTEX_XY = (y2 << 16) | (x1 & 0xFFFF); // Down-left
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(inttot16(tl), inttot16(tb));
+    NE_GFX(GFX_VERTEX_XY) = (y2 << 16) | (x1 & 0xFFFF); // Down-left
 
-    GFX_TEX_COORD = TEXTURE_PACK(inttot16(tr), inttot16(tb));
-    GFX_VERTEX_XY = (y2 << 16) | (x2 & 0xFFFF); // Down-right
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(inttot16(tr), inttot16(tb));
+    NE_GFX(GFX_VERTEX_XY) = (y2 << 16) | (x2 & 0xFFFF); // Down-right
 
-    GFX_TEX_COORD = TEXTURE_PACK(inttot16(tr), inttot16(tt));
-    GFX_VERTEX_XY = (y1 << 16) | (x2 & 0xFFFF); // Up-right
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(inttot16(tr), inttot16(tt));
+    NE_GFX(GFX_VERTEX_XY) = (y1 << 16) | (x2 & 0xFFFF); // Up-right
 }
@@ -9,6 +9,387 @@
 #include "NEMain.h"
 #include "NEAlloc.h"
 
+// The chunks of the linked list aren't allocated individually with malloc().
+// They are taken from a pool of nodes owned by the allocator, which is grown in
+// blocks of NE_ALLOC_NODES_PER_BLOCK nodes whenever it runs out of nodes. Nodes
+// that are no longer used (because two chunks have been merged) are returned to
+// the pool, so that allocating and freeing memory doesn't use the heap unless
+// the number of chunks grows over the maximum reached so far.
+
+typedef struct ne_chunk_block {
+    struct ne_chunk_block *next; // Next block of nodes allocated with malloc()
+    NEChunk nodes[NE_ALLOC_NODES_PER_BLOCK];
+} ne_chunk_block_t;
+
+typedef struct {
+    // This must be the first element of the struct. The pointer to the first
+    // chunk is the handle that the user passes to all functions of the
+    // allocator, and the first chunk is never removed from the list.
+    NEChunk first_chunk;
+
+    NEChunk *free_nodes;      // Unused nodes, linked with their "next" field
+    ne_chunk_block_t *blocks; // All blocks of nodes owned by this allocator
+
+    NEChunk *root;            // Root of the tree of chunks sorted by address
+
+    NETraceEntry *trace;      // Ring buffer of operations (NULL if disabled)
+    uint32_t trace_size;      // Number of entries of the ring buffer
+    uint32_t trace_count;     // Number of entries saved since tracing started
+    uint16_t trace_tag;       // Tag saved in all new entries
+
+    NETraceEntry *snapshot;   // State of the pool when tracing started
+    uint32_t snapshot_size;   // Number of entries of the snapshot
+} ne_allocator_t;
+
+static inline ne_allocator_t *ne_allocator_get(NEChunk *first_chunk)
+{
+    return (ne_allocator_t *)first_chunk;
+}
+
+static int ne_node_pool_grow(ne_allocator_t *alloc)
+{
+    ne_chunk_block_t *block = malloc(sizeof(ne_chunk_block_t));
+    if (block == NULL)
+        return -1;
+
+    block->next = alloc->blocks;
+    alloc->blocks = block;
+
+    for (int i = 0; i < NE_ALLOC_NODES_PER_BLOCK; i++)
+    {
+        block->nodes[i].next = alloc->free_nodes;
+        alloc->free_nodes = &block->nodes[i];
+    }
+
+    return 0;
+}
+
+static NEChunk *ne_node_get(ne_allocator_t *alloc)
+{
+    if (alloc->free_nodes == NULL)
+    {
+        if (ne_node_pool_grow(alloc) != 0)
+            return NULL;
+    }
+
+    NEChunk *node = alloc->free_nodes;
+    alloc->free_nodes = node->next;
+    return node;
+}
+
+static void ne_node_release(ne_allocator_t *alloc, NEChunk *node)
+{
+    node->next = alloc->free_nodes;
+    alloc->free_nodes = node;
+}
+
+// Apart from the linked list, all chunks are stored in an AVL tree sorted by
+// their start address. Each node of the tree also holds the size of the biggest
+// free chunk in its subtree. This makes it possible to look for the chunk that
+// contains an address, and to look for the first or last free chunk with enough
+// space, in logarithmic time, while keeping the same placement of allocations
+// as a linear search of the list.
+
+static inline size_t ne_chunk_size(const NEChunk *chunk)
+{
+    return (uintptr_t)chunk->end - (uintptr_t)chunk->start;
+}
+
+static inline int ne_tree_height(const NEChunk *node)
+{
+    return node == NULL ? 0 : node->height;
+}
+
+static inline size_t ne_tree_max_free(const NEChunk *node)
+{
+    return node == NULL ? 0 : node->max_free;
+}
+
+// Recalculate the height and biggest free size of a node from its children.
+static void ne_tree_fix(NEChunk *node)
+{
+    int height_left = ne_tree_height(node->left);
+    int height_right = ne_tree_height(node->right);
+
+    if (height_left > height_right)
+        node->height = height_left + 1;
+    else
+        node->height = height_right + 1;
+
+    size_t max_free = 0;
+    if (node->state == NE_STATE_FREE)
+        max_free = ne_chunk_size(node);
+
+    size_t max_free_left = ne_tree_max_free(node->left);
+    size_t max_free_right = ne_tree_max_free(node->right);
+
+    if (max_free < max_free_left)
+        max_free = max_free_left;
+    if (max_free < max_free_right)
+        max_free = max_free_right;
+
+    node->max_free = max_free;
+}
+
+static NEChunk *ne_tree_rotate_right(NEChunk *node)
+{
+    NEChunk *left = node->left;
+    node->left = left->right;
+    left->right = node;
+    ne_tree_fix(node);
+    ne_tree_fix(left);
+    return left;
+}
+
+static NEChunk *ne_tree_rotate_left(NEChunk *node)
+{
+    NEChunk *right = node->right;
+    node->right = right->left;
+    right->left = node;
+    ne_tree_fix(node);
+    ne_tree_fix(right);
+    return right;
+}
+
+// Returns the new root of the subtree after balancing it.
+static NEChunk *ne_tree_balance(NEChunk *node)
+{
+    ne_tree_fix(node);
+
+    int balance = ne_tree_height(node->left) - ne_tree_height(node->right);
+
+    if (balance > 1)
+    {
+        NEChunk *left = node->left;
+        if (ne_tree_height(left->left) < ne_tree_height(left->right))
+            node->left = ne_tree_rotate_left(left);
+        return ne_tree_rotate_right(node);
+    }
+
+    if (balance < -1)
+    {
+        NEChunk *right = node->right;
+        if (ne_tree_height(right->right) < ne_tree_height(right->left))
+            node->right = ne_tree_rotate_right(right);
+        return ne_tree_rotate_left(node);
+    }
+
+    return node;
+}
+
+static NEChunk *ne_tree_insert(NEChunk *node, NEChunk *new)
+{
+    if (node == NULL)
+    {
+        new->left = NULL;
+        new->right = NULL;
+        ne_tree_fix(new);
+        return new;
+    }
+
+    if (new->start < node->start)
+        node->left = ne_tree_insert(node->left, new);
+    else
+        node->right = ne_tree_insert(node->right, new);
+
+    return ne_tree_balance(node);
+}
+
+// Removes the leftmost node of the subtree and returns it in "min".
+static NEChunk *ne_tree_remove_min(NEChunk *node, NEChunk **min)
+{
+    if (node->left == NULL)
+    {
+        *min = node;
+        return node->right;
+    }
+
+    node->left = ne_tree_remove_min(node->left, min);
+    return ne_tree_balance(node);
+}
+
+static NEChunk *ne_tree_remove(NEChunk *node, void *start)
+{
+    NE_AssertPointer(node, "Chunk not found in tree");
+
+    if (start < node->start)
+    {
+        node->left = ne_tree_remove(node->left, start);
+    }
+    else if (start > node->start)
+    {
+        node->right = ne_tree_remove(node->right, start);
+    }
+    else
+    {
+        NEChunk *left = node->left;
+        NEChunk *right = node->right;
+
+        if (right == NULL)
+            return left;
+
+        // Replace this node by the leftmost node of the right subtree
+        NEChunk *min;
+        right = ne_tree_remove_min(right, &min);
+        min->left = left;
+        min->right = right;
+        return ne_tree_balance(min);
+    }
+
+    return ne_tree_balance(node);
+}
+
+// This needs to be called after the size or state of a chunk changes so that
+// the biggest free size of all the nodes above it is updated.
+static void ne_tree_refresh(NEChunk *node, void *start)
+{
+    if (node == NULL)
+        return;
+
+    if (start < node->start)
+        ne_tree_refresh(node->left, start);
+    else if (start > node->start)
+        ne_tree_refresh(node->right, start);
+
+    ne_tree_fix(node);
+}
+
+static void ne_chunk_set_state(ne_allocator_t *alloc, NEChunk *chunk,
+                               ne_chunk_state state)
+{
+    chunk->state = state;
+    ne_tree_refresh(alloc->root, chunk->start);
+}
+
+// Returns the chunk that starts at the provided address, or NULL.
+static NEChunk *ne_tree_find(NEChunk *node, void *start)
+{
+    while (node != NULL)
+    {
+        if (start < node->start)
+            node = node->left;
+        else if (start > node->start)
+            node = node->right;
+        else
+            return node;
+    }
+
+    return NULL;
+}
+
+// Returns the chunk with the highest address of the subtree.
+static NEChunk *ne_tree_last(NEChunk *node)
+{
+    while (node->right != NULL)
+        node = node->right;
+
+    return node;
+}
+
+// Returns the free chunk with the lowest address that has at least "size"
+// bytes, or NULL.
+static NEChunk *ne_tree_first_fit(NEChunk *node, size_t size)
+{
+    while (node != NULL)
+    {
+        if (ne_tree_max_free(node->left) >= size)
+            node = node->left;
+        else if ((node->state == NE_STATE_FREE) && (ne_chunk_size(node) >= size))
+            return node;
+        else if (ne_tree_max_free(node->right) >= size)
+            node = node->right;
+        else
+            return NULL;
+    }
+
+    return NULL;
+}
+
+// Returns the free chunk with the highest address that has at least "size"
+// bytes, or NULL.
+static NEChunk *ne_tree_last_fit(NEChunk *node, size_t size)
+{
+    while (node != NULL)
+    {
+        if (ne_tree_max_free(node->right) >= size)
+            node = node->right;
+        else if ((node->state == NE_STATE_FREE) && (ne_chunk_size(node) >= size))
+            return node;
+        else if (ne_tree_max_free(node->left) >= size)
+            node = node->left;
+        else
+            return NULL;
+    }
+
+    return NULL;
+}
+
+// Returns the free chunk with the lowest address that starts after "address"
+// and has at least "size" bytes, or NULL.
+static NEChunk *ne_tree_first_fit_after(NEChunk *node, void *address,
+                                        size_t size)
+{
+    if (ne_tree_max_free(node) < size)
+        return NULL;
+
+    if (node->start <= address)
+        return ne_tree_first_fit_after(node->right, address, size);
+
+    NEChunk *found = ne_tree_first_fit_after(node->left, address, size);
+    if (found != NULL)
+        return found;
+
+    if ((node->state == NE_STATE_FREE) && (ne_chunk_size(node) >= size))
+        return node;
+
+    return ne_tree_first_fit(node->right, size);
+}
+
+// Returns the free chunk with the highest address that starts before "address"
+// and has at least "size" bytes, or NULL.
+static NEChunk *ne_tree_last_fit_before(NEChunk *node, void *address,
+                                        size_t size)
+{
+    if (ne_tree_max_free(node) < size)
+        return NULL;
+
+    if (node->start >= address)
+        return ne_tree_last_fit_before(node->left, address, size);
+
+    NEChunk *found = ne_tree_last_fit_before(node->right, address, size);
+    if (found != NULL)
+        return found;
+
+    if ((node->state == NE_STATE_FREE) && (ne_chunk_size(node) >= size))
+        return node;
+
+    return ne_tree_last_fit(node->left, size);
+}
+
+// Looks for the smallest free chunk with at least "size" bytes. If there are
+// several of them, it returns the one with the highest address. Subtrees
+// without any free chunk big enough are skipped, so this only visits the free
+// chunks that can hold the allocation.
+static void ne_tree_best_fit(NEChunk *node, size_t size, NEChunk **best)
+{
+    if (ne_tree_max_free(node) < size)
+        return;
+
+    ne_tree_best_fit(node->left, size, best);
+
+    if (node->state == NE_STATE_FREE)
+    {
+        size_t node_size = ne_chunk_size(node);
+        if ((node_size >= size) &&
+            ((*best == NULL) || (node_size <= ne_chunk_size(*best))))
+        {
+            *best = node;
+        }
+    }
+
+    ne_tree_best_fit(node->right, size, best);
+}
+
 int NE_AllocInit(NEChunk **first_chunk, void *start, void *end)
 {
     if (first_chunk == NULL)
@@ -23,19 +404,43 @@ int NE_AllocInit(NEChunk **first_chunk, void *start, void *end)
         return -2;
     }
 
-    *first_chunk = malloc(sizeof(NEChunk));
-    if (*first_chunk == NULL)
+    ne_allocator_t *alloc = malloc(sizeof(ne_allocator_t));
+    if (alloc == NULL)
     {
         NE_DebugPrint("Not enough memory");
         return -3;
     }
 
+    alloc->free_nodes = NULL;
+    alloc->blocks = NULL;
+
+    alloc->trace = NULL;
+    alloc->trace_size = 0;
+    alloc->trace_count = 0;
+    alloc->trace_tag = 0;
+
+    alloc->snapshot = NULL;
+    alloc->snapshot_size = 0;
+
+    // Allocate the first block of nodes now so that the first allocations
+    // don't need to use the heap.
+    if (ne_node_pool_grow(alloc) != 0)
+    {
+        NE_DebugPrint("Not enough memory");
+        free(alloc);
+        return -3;
+    }
+
+    *first_chunk = &alloc->first_chunk;
+
     (*first_chunk)->previous = NULL;
     (*first_chunk)->state = NE_STATE_FREE;
     (*first_chunk)->start = start;
     (*first_chunk)->end = end;
     (*first_chunk)->next = NULL;
 
+    alloc->root = ne_tree_insert(NULL, *first_chunk);
+
     return 0;
 }
 
@@ -47,15 +452,26 @@ int NE_AllocEnd(NEChunk **first_chunk)
         return -1;
     }
 
-    NEChunk *this = *first_chunk;
+    if (*first_chunk == NULL)
+        return 0;
+
+    ne_allocator_t *alloc = ne_allocator_get(*first_chunk);
 
-    while (this != NULL)
+    // All chunks other than the first one are stored in the blocks of nodes,
+    // so it is enough to free the blocks.
+    ne_chunk_block_t *block = alloc->blocks;
+
+    while (block != NULL)
     {
-        NEChunk *next = this->next;
-        free(this);
-        this = next;
+        ne_chunk_block_t *next = block->next;
+        free(block);
+        block = next;
     }
 
+    free(alloc->trace);
+    free(alloc->snapshot);
+    free(alloc);
+
     *first_chunk = NULL;
     return 0;
 }
@@ -72,7 +488,8 @@ int NE_AllocEnd(NEChunk **first_chunk)
 // +------+----------+------+
 //
 // It returns a pointer to the new chunk.
-static NEChunk *ne_split_chunk(NEChunk *this, size_t this_size)
+static NEChunk *ne_split_chunk(ne_allocator_t *alloc, NEChunk *this,
+                               size_t this_size)
 {
     NE_AssertPointer(this, "NULL pointer");
 
@@ -80,7 +497,7 @@ static NEChunk *ne_split_chunk(NEChunk *this, size_t this_size)
 
     NEChunk *next = this->next;
 
-    NEChunk *new = malloc(sizeof(NEChunk));
+    NEChunk *new = ne_node_get(alloc);
     if (new == NULL)
     {
         NE_DebugPrint("Not enough memory");
@@ -114,35 +531,52 @@ static NEChunk *ne_split_chunk(NEChunk *this, size_t this_size)
     this->end = (void *)((uintptr_t)this->start + this_size);
     new->start = this->end;
 
+    // The new chunk has the same state as the original chunk until the caller
+    // changes it.
+    new->state = this->state;
+
+    // Update the tree of chunks
+    // -------------------------
+
+    alloc->root = ne_tree_insert(alloc->root, new);
+    ne_tree_refresh(alloc->root, this->start);
+
     return new;
 }
 
 // This returns a pointer to the chunk that contains the provided address.
 // The start address of the chunk is considered to be part of that chunk, but
 // the end address isn't considered part of that chunk.
-static NEChunk *ne_search_address(NEChunk *first_chunk, void *address)
+static NEChunk *ne_search_address(ne_allocator_t *alloc, void *address)
 {
-    NE_AssertPointer(first_chunk, "NULL pointer");
-
-    NEChunk *this = first_chunk;
+    NE_AssertPointer(alloc, "NULL pointer");
 
-    uintptr_t addr = (uintptr_t)address;
+    // Look for the last chunk that starts before or at the address
+    NEChunk *node = alloc->root;
+    NEChunk *found = NULL;
 
-    for ( ; this != NULL; this = this->next)
+    while (node != NULL)
     {
-        uintptr_t start = (uintptr_t)this->start;
-        uintptr_t end = (uintptr_t)this->end;
+        if (address < node->start)
+        {
+            node = node->left;
+        }
+        else
+        {
+            found = node;
+            node = node->right;
+        }
+    }
 
-        // We've gone too far. This pointer was likely before the allocated
-        // memory pool.
-        if (addr < start)
-            return NULL;
+    // This pointer was likely before the allocated memory pool.
+    if (found == NULL)
+        return NULL;
 
-        if (addr < end)
-            return this;
-    }
+    // This pointer was likely after the allocated memory pool.
+    if (address >= found->end)
+        return NULL;
 
-    return NULL;
+    return found;
 }
 
 void *NE_AllocFindInRange(NEChunk *first_chunk, void *start, void *end, size_t size)
@@ -153,63 +587,121 @@ void *NE_AllocFindInRange(NEChunk *first_chunk, void *start, void *end, size_t s
         return NULL;
     }
 
+    ne_allocator_t *alloc = ne_allocator_get(first_chunk);
+
     // Get the chunk that contains the first address. If the start address of
     // the first chunk is after the provided start, get the first chunk.
     NEChunk *this;
     if (start < first_chunk->start)
         this = first_chunk;
     else
-        this = ne_search_address(first_chunk, start);
+        this = ne_search_address(alloc, start);
+
+    if (this == NULL)
+        return NULL;
+
+    // "start" is inside "this", but "this->start" may be before "start". In
+    // that case, we need to calculate the size actually inside the range
+    // provided by the user.
+    uintptr_t real_start;
+    if (this->start < start)
+        real_start = (uintptr_t)start;
+    else
+        real_start = (uintptr_t)this->start;
+
+    // If the requested chunk doesn't fit in the first chunk, look for the first
+    // free chunk after it that has enough space. All of them start inside the
+    // range provided by the user.
+    if ((this->state != NE_STATE_FREE) ||
+        (((uintptr_t)this->end - real_start) < size))
+    {
+        this = ne_tree_first_fit_after(alloc->root, this->start, size);
+        if (this == NULL)
+            return NULL;
+
+        real_start = (uintptr_t)this->start;
+    }
 
+    // Check if the expected end of the allocated chunk is within the limits
+    // provided by the user. If not, there is no space in the range.
     uintptr_t range_end = (uintptr_t)end;
+    uintptr_t expected_end = real_start + size;
+    if (expected_end > range_end)
+        return NULL;
 
-    for ( ; this != NULL; this = this->next)
+    return (void *)real_start;
+}
+
+void *NE_AllocFindInRangeFromEnd(NEChunk *first_chunk, void *start, void *end,
+                                 size_t size)
+{
+    if ((first_chunk == NULL) || (start == NULL) || (end == NULL) || (size == 0))
     {
-        // Is this free?
-        if (this->state != NE_STATE_FREE)
-            continue;
+        NE_DebugPrint("Invalid arguments");
+        return NULL;
+    }
 
-        // "start" is inside "this", but "this->start" may be before "start". In
-        // that case, we need to calculate the size actually inside the range
-        // provided by the user.
-        uintptr_t real_start;
-        if (this->start < start)
-            real_start = (uintptr_t)start;
-        else
-            real_start = (uintptr_t)this->start;
+    // The returned address is calculated from the end of the chunk, so the
+    // size and the end of the range need to be aligned like any other chunk.
+    const size_t mask = NE_ALLOC_MIN_SIZE - 1;
+    if ((size & mask) != 0)
+        size += NE_ALLOC_MIN_SIZE - (size & mask);
 
-        uintptr_t this_end = (uintptr_t)this->end;
-        size_t this_size = this_end - real_start;
+    uintptr_t range_start = (uintptr_t)start;
+    uintptr_t range_end = (uintptr_t)end & ~mask;
 
-        // Check if the requested chunk would fit here
-        if (this_size < size)
-            continue;
+    ne_allocator_t *alloc = ne_allocator_get(first_chunk);
 
-        // Check if the expected end of the allocated chunk is within the limits
-        // provided by the user. If so, we've gone over the limit, there is no
-        // need to keep searching.
-        uintptr_t expected_end = real_start + size;
-        if (expected_end > range_end)
+    // Get the chunk that contains the last address of the range. If the range
+    // ends after the end of the pool, get the last chunk.
+    NEChunk *this = ne_search_address(alloc, (void *)(range_end - 1));
+    if (this == NULL)
+    {
+        this = ne_tree_last(alloc->root);
+        if ((uintptr_t)this->end > range_end)
             return NULL;
+    }
 
-        return (void *)real_start;
+    // "this->end" may be after the end of the range. In that case, we need to
+    // calculate the size actually inside the range provided by the user.
+    uintptr_t real_end = (uintptr_t)this->end;
+    if (real_end > range_end)
+        real_end = range_end;
+
+    // If the requested chunk doesn't fit in the last chunk, look for the last
+    // free chunk before it that has enough space. All of them end inside the
+    // range provided by the user.
+    if ((this->state != NE_STATE_FREE) ||
+        ((real_end - (uintptr_t)this->start) < size))
+    {
+        this = ne_tree_last_fit_before(alloc->root, this->start, size);
+        if (this == NULL)
+            return NULL;
+
+        real_end = (uintptr_t)this->end;
     }
 
-    return NULL;
+    // Check if the expected start of the allocated chunk is within the limits
+    // provided by the user. If not, there is no space in the range.
+    uintptr_t expected_start = real_end - size;
+    if (expected_start < range_start)
+        return NULL;
+
+    return (void *)expected_start;
 }
 
 // This function searches the list and returns a chunk that contains the
 // specified range of memory (address, address + size) if it is free.
-static NEChunk *ne_search_free_range_chunk(NEChunk *first_chunk,
+static NEChunk *ne_search_free_range_chunk(ne_allocator_t *alloc,
                                            void *address, size_t size)
 {
-    NE_AssertPointer(first_chunk, "NULL pointer");
+    NE_AssertPointer(alloc, "NULL pointer");
 
     // If that range of memory is free, it should be in one single chunk. Look
     // for the chunk that contains the base address, and check if the end
     // address is also part of that chunk.
 
-    NEChunk *chunk = ne_search_address(first_chunk, address);
+    NEChunk *chunk = ne_search_address(alloc, address);
     if (chunk == NULL)
         return NULL;
 
@@ -225,7 +717,53 @@ static NEChunk *ne_search_free_range_chunk(NEChunk *first_chunk,
     return chunk;
 }
 
-int NE_AllocAddress(NEChunk *first_chunk, void *address, size_t size)
+// Allocation tracing
+// ------------------
+
+static void ne_trace_entry_set(NEChunk *first_chunk, NETraceEntry *entry,
+                               ne_trace_op op, void *address, size_t size,
+                               bool failed, uint16_t tag)
+{
+    entry->op = op;
+    entry->failed = failed;
+    entry->tag = tag;
+    entry->offset = failed && (address == NULL) ? 0 :
+                    (uintptr_t)address - (uintptr_t)first_chunk->start;
+    entry->size = size;
+}
+
+static void ne_trace(NEChunk *first_chunk, ne_trace_op op, void *address,
+                     size_t size, bool failed)
+{
+    if (first_chunk == NULL)
+        return;
+
+    ne_allocator_t *alloc = ne_allocator_get(first_chunk);
+    if (alloc->trace == NULL)
+        return;
+
+    NETraceEntry *entry = &alloc->trace[alloc->trace_count % alloc->trace_size];
+    alloc->trace_count++;
+
+    ne_trace_entry_set(first_chunk, entry, op, address, size, failed,
+                       alloc->trace_tag);
+}
+
+static void ne_trace_free(ne_allocator_t *alloc)
+{
+    free(alloc->trace);
+    alloc->trace = NULL;
+    alloc->trace_size = 0;
+    alloc->trace_count = 0;
+
+    free(alloc->snapshot);
+    alloc->snapshot = NULL;
+    alloc->snapshot_size = 0;
+}
+
+static int ne_free(NEChunk *first_chunk, void *pointer);
+
+static int ne_alloc_address(NEChunk *first_chunk, void *address, size_t size)
 {
     if ((first_chunk == NULL) || (address == NULL) || (size == 0))
     {
@@ -233,6 +771,8 @@ int NE_AllocAddress(NEChunk *first_chunk, void *address, size_t size)
         return -1;
     }
 
+    ne_allocator_t *alloc = ne_allocator_get(first_chunk);
+
     // Force sizes multiple of NE_ALLOC_MIN_SIZE
     const size_t mask = NE_ALLOC_MIN_SIZE - 1;
     if ((size & mask) != 0)
@@ -241,7 +781,7 @@ int NE_AllocAddress(NEChunk *first_chunk, void *address, size_t size)
     // Get a free chunk that contains this range of memory. This function
     // returns NULL if there is no chunk that contains this range entirely.
     // It also returns NULL if it isn't free.
-    NEChunk *this = ne_search_free_range_chunk(first_chunk, address, size);
+    NEChunk *this = ne_search_free_range_chunk(alloc, address, size);
     if (this == NULL)
         return -2;
 
@@ -267,7 +807,7 @@ int NE_AllocAddress(NEChunk *first_chunk, void *address, size_t size)
     {
         // Split this chunk into two, ignore the first one and get the second
         // one (which contains the start address)
-        this = ne_split_chunk(this, alloc_start - this_start);
+        this = ne_split_chunk(alloc, this, alloc_start - this_start);
         if (this == NULL)
             return -3;
 
@@ -279,22 +819,22 @@ int NE_AllocAddress(NEChunk *first_chunk, void *address, size_t size)
         NE_Assert(this_end == (uintptr_t)this->end, "Unexpected error");
     }
 
-    this->state = NE_STATE_USED;
+    ne_chunk_set_state(alloc, this, NE_STATE_USED);
 
     if (alloc_end < this_end)
     {
         // Split this chunk into two as well. The first one is the final desired
         // chunk, the second one is more free space.
-        NEChunk *next = ne_split_chunk(this, size);
+        NEChunk *next = ne_split_chunk(alloc, this, size);
         if (next == NULL)
         {
             if (this_is_modified)
-                NE_Free(first_chunk, this);
+                ne_free(first_chunk, this->start);
 
             return -4;
         }
 
-        next->state = NE_STATE_FREE;
+        ne_chunk_set_state(alloc, next, NE_STATE_FREE);
 
         // Only the end has changed
         this_end = (uintptr_t)this->end;
@@ -308,7 +848,14 @@ int NE_AllocAddress(NEChunk *first_chunk, void *address, size_t size)
     return 0;
 }
 
-void *NE_Alloc(NEChunk *first_chunk, size_t size)
+int NE_AllocAddress(NEChunk *first_chunk, void *address, size_t size)
+{
+    int ret = ne_alloc_address(first_chunk, address, size);
+    ne_trace(first_chunk, NE_TRACE_ALLOC_ADDRESS, address, size, ret != 0);
+    return ret;
+}
+
+static void *ne_alloc(NEChunk *first_chunk, size_t size)
 {
     if ((first_chunk == NULL) || (size == 0))
     {
@@ -321,53 +868,86 @@ void *NE_Alloc(NEChunk *first_chunk, size_t size)
     if ((size & mask) != 0)
         size += NE_ALLOC_MIN_SIZE - (size & mask);
 
-    NEChunk *this = first_chunk;
+    ne_allocator_t *alloc = ne_allocator_get(first_chunk);
 
-    for ( ; this != NULL; this = this->next)
+    // Get the first free chunk with enough space
+    NEChunk *this = ne_tree_first_fit(alloc->root, size);
+    if (this == NULL)
+        return NULL; // Not enough free space.
+
+    size_t this_size = ne_chunk_size(this);
+
+    // If we have exactly the space requested, we're done.
+    if (this_size == size)
     {
-        // Skip non-free chunks
-        if (this->state != NE_STATE_FREE)
-            continue;
+        ne_chunk_set_state(alloc, this, NE_STATE_USED);
+        return this->start;
+    }
 
-        size_t this_size = (size_t)this->end - (size_t)this->start;
+    // If we have more space than requested, split this chunk:
+    //
+    // |      THIS       | NEXT |
+    // +-----------------+------+  Before
+    // |    NOT USED     | USED |
+    //
+    // | THIS |   NEW    | NEXT |
+    // +------+----------+------+  After
+    // | USED | NOT USED | USED |
 
-        // If this chunk doesn't have enough space, simply skip it.
-        if (this_size < size)
-            continue;
+    NEChunk *new = ne_split_chunk(alloc, this, size);
+    if (new == NULL)
+        return NULL;
 
-        // If we have exactly the space requested, we're done.
-        if (this_size == size)
-        {
-            this->state = NE_STATE_USED;
-            return this->start;
-        }
+    // Flag this chunk as used (the new one is free)
+    ne_chunk_set_state(alloc, this, NE_STATE_USED);
 
-        // If we have more space than requested, split this chunk:
-        //
-        // |      THIS       | NEXT |
-        // +-----------------+------+  Before
-        // |    NOT USED     | USED |
-        //
-        // | THIS |   NEW    | NEXT |
-        // +------+----------+------+  After
-        // | USED | NOT USED | USED |
+    return this->start;
+}
 
-        NEChunk *new = ne_split_chunk(this, size);
-        if (new == NULL)
-            return NULL;
+void *NE_Alloc(NEChunk *first_chunk, size_t size)
+{
+    void *ptr = ne_alloc(first_chunk, size);
+    ne_trace(first_chunk, NE_TRACE_ALLOC, ptr, size, ptr == NULL);
+    return ptr;
+}
 
-        // Flag this chunk as used and the new one as free
-        this->state = NE_STATE_USED;
-        new->state = NE_STATE_FREE;
+// Allocates "size" bytes at the end of the provided free chunk. The size must
+// already be a multiple of NE_ALLOC_MIN_SIZE.
+static void *ne_chunk_alloc_end(ne_allocator_t *alloc, NEChunk *this,
+                                size_t size)
+{
+    size_t this_size = ne_chunk_size(this);
 
+    // If we have exactly the space requested, we're done.
+    if (this_size == size)
+    {
+        ne_chunk_set_state(alloc, this, NE_STATE_USED);
         return this->start;
     }
 
-    // No more chunks... Not enough free space.
-    return NULL;
+    // If we have more space than requested, split this chunk:
+    //
+    // |        THIS      | NEXT |
+    // +------------------+------+  Before
+    // |      NOT USED    | USED |
+    //
+    // |    THIS   | NEW  | NEXT |
+    // +-----------+------+------+  After
+    // |  NOT USED | USED | USED |
+
+    // The size of this chunk has to be the current one minus the requested
+    // size for the new chunk.
+    NEChunk *new = ne_split_chunk(alloc, this, this_size - size);
+    if (new == NULL)
+        return NULL;
+
+    // Flag the new chunk as used
+    ne_chunk_set_state(alloc, new, NE_STATE_USED);
+
+    return new->start;
 }
 
-void *NE_AllocFromEnd(NEChunk *first_chunk, size_t size)
+static void *ne_alloc_from_end(NEChunk *first_chunk, size_t size)
 {
     if ((first_chunk == NULL) || (size == 0))
     {
@@ -380,58 +960,55 @@ void *NE_AllocFromEnd(NEChunk *first_chunk, size_t size)
     if ((size & mask) != 0)
         size += NE_ALLOC_MIN_SIZE - (size & mask);
 
-    // Find last chunk
-    NEChunk *this = first_chunk;
-    while (this->next != NULL)
-        this = this->next;
+    ne_allocator_t *alloc = ne_allocator_get(first_chunk);
 
-    // Traverse list from end to beginning
-    for ( ; this != NULL; this = this->previous)
-    {
-        // Skip non-free chunks
-        if (this->state != NE_STATE_FREE)
-            continue;
+    // Get the last free chunk with enough space
+    NEChunk *this = ne_tree_last_fit(alloc->root, size);
+    if (this == NULL)
+        return NULL; // Not enough free space.
 
-        size_t this_size = (size_t)this->end - (size_t)this->start;
+    return ne_chunk_alloc_end(alloc, this, size);
+}
 
-        // If this chunk doesn't have enough space, simply skip it.
-        if (this_size < size)
-            continue;
+void *NE_AllocFromEnd(NEChunk *first_chunk, size_t size)
+{
+    void *ptr = ne_alloc_from_end(first_chunk, size);
+    ne_trace(first_chunk, NE_TRACE_ALLOC_FROM_END, ptr, size, ptr == NULL);
+    return ptr;
+}
 
-        // If we have exactly the space requested, we're done.
-        if (this_size == size)
-        {
-            this->state = NE_STATE_USED;
-            return this->start;
-        }
+static void *ne_alloc_best_fit(NEChunk *first_chunk, size_t size)
+{
+    if ((first_chunk == NULL) || (size == 0))
+    {
+        NE_DebugPrint("Invalid arguments");
+        return NULL;
+    }
 
-        // If we have more space than requested, split this chunk:
-        //
-        // |        THIS      | NEXT |
-        // +------------------+------+  Before
-        // |      NOT USED    | USED |
-        //
-        // |    THIS   | NEW  | NEXT |
-        // +-----------+------+------+  After
-        // |  NOT USED | USED | USED |
-
-        // The size of this chunk has to be the current one minus the requested
-        // size for the new chunk.
-        NEChunk *new = ne_split_chunk(this, this_size - size);
-        if (new == NULL)
-            return NULL;
+    // Force sizes multiple of NE_ALLOC_MIN_SIZE
+    const size_t mask = NE_ALLOC_MIN_SIZE - 1;
+    if ((size & mask) != 0)
+        size += NE_ALLOC_MIN_SIZE - (size & mask);
 
-        // Flag the new chunk as used
-        new->state = NE_STATE_USED;
+    ne_allocator_t *alloc = ne_allocator_get(first_chunk);
 
-        return new->start;
-    }
+    // Get the smallest free chunk with enough space
+    NEChunk *this = NULL;
+    ne_tree_best_fit(alloc->root, size, &this);
+    if (this == NULL)
+        return NULL; // Not enough free space.
 
-    // No more chunks... Not enough free space.
-    return NULL;
+    return ne_chunk_alloc_end(alloc, this, size);
 }
 
-int NE_Free(NEChunk *first_chunk, void *pointer)
+void *NE_AllocBestFit(NEChunk *first_chunk, size_t size)
+{
+    void *ptr = ne_alloc_best_fit(first_chunk, size);
+    ne_trace(first_chunk, NE_TRACE_ALLOC_BEST_FIT, ptr, size, ptr == NULL);
+    return ptr;
+}
+
+static int ne_free(NEChunk *first_chunk, void *pointer)
 {
     if (first_chunk == NULL)
     {
@@ -439,21 +1016,12 @@ int NE_Free(NEChunk *first_chunk, void *pointer)
         return -1;
     }
 
-    NEChunk *this = first_chunk;
+    ne_allocator_t *alloc = ne_allocator_get(first_chunk);
 
     // Look for the chunk that corresponds to the given pointer
-    while (1)
-    {
-        // Check if we have reached the end without finding the chunk
-        if (this == NULL)
-            return -2;
-
-        // If this is the chunk we're looking for, exit loop
-        if (this->start == pointer)
-            break;
-
-        this = this->next;
-    }
+    NEChunk *this = ne_tree_find(alloc->root, pointer);
+    if (this == NULL)
+        return -2;
 
     // If the specified chunk is free or locked, it can't be freed.
     if (this->state != NE_STATE_USED)
@@ -492,10 +1060,11 @@ int NE_Free(NEChunk *first_chunk, void *pointer)
         }
 
         // Expand the previous one
+        alloc->root = ne_tree_remove(alloc->root, this->start);
         previous->end = this->end;
 
-        // Delete current chunk
-        free(this);
+        // Return the current chunk to the pool of nodes
+        ne_node_release(alloc, this);
 
         // Change the active chunk to try to join it with the next one.
         this = previous;
@@ -533,16 +1102,27 @@ int NE_Free(NEChunk *first_chunk, void *pointer)
         }
 
         // Expand this node one
+        alloc->root = ne_tree_remove(alloc->root, next->start);
         this->end = next->end;
 
-        // Delete next chunk
-        free(next);
+        // Return the next chunk to the pool of nodes
+        ne_node_release(alloc, next);
     }
 
+    // Update the size of the biggest free chunk in the tree
+    ne_tree_refresh(alloc->root, this->start);
+
     return 0;
 }
 
-int NE_Lock(NEChunk *first_chunk, void *pointer)
+int NE_Free(NEChunk *first_chunk, void *pointer)
+{
+    int ret = ne_free(first_chunk, pointer);
+    ne_trace(first_chunk, NE_TRACE_FREE, pointer, 0, ret != 0);
+    return ret;
+}
+
+static int ne_lock(NEChunk *first_chunk, void *pointer)
 {
     if (first_chunk == NULL)
     {
@@ -550,29 +1130,30 @@ int NE_Lock(NEChunk *first_chunk, void *pointer)
         return -1;
     }
 
-    NEChunk *this = first_chunk;
+    NEChunk *this = ne_tree_find(ne_allocator_get(first_chunk)->root, pointer);
 
-    while (1)
-    {
-        if (this->start == pointer)
-        {
-            // Check if we are trying to lock a chunk that isn't in use
-            if (this->state != NE_STATE_USED)
-                return -2;
+    // Couldn't find a chunk at the specified address
+    if (this == NULL)
+        return -3;
 
-            this->state = NE_STATE_LOCKED;
-            return 0;
-        }
+    // Check if we are trying to lock a chunk that isn't in use
+    if (this->state != NE_STATE_USED)
+        return -2;
 
-        // Couldn't find a chunk at the specified address
-        if (this->next == NULL)
-            return -3;
+    // The amount of free memory doesn't change, it isn't needed to update the
+    // tree of chunks.
+    this->state = NE_STATE_LOCKED;
+    return 0;
+}
 
-        this = this->next;
-    }
+int NE_Lock(NEChunk *first_chunk, void *pointer)
+{
+    int ret = ne_lock(first_chunk, pointer);
+    ne_trace(first_chunk, NE_TRACE_LOCK, pointer, 0, ret != 0);
+    return ret;
 }
 
-int NE_Unlock(NEChunk *first_chunk, void *pointer)
+static int ne_unlock(NEChunk *first_chunk, void *pointer)
 {
     if (first_chunk == NULL)
     {
@@ -580,26 +1161,27 @@ int NE_Unlock(NEChunk *first_chunk, void *pointer)
         return -1;
     }
 
-    NEChunk *this = first_chunk;
+    NEChunk *this = ne_tree_find(ne_allocator_get(first_chunk)->root, pointer);
 
-    while (1)
-    {
-        if (this->start == pointer)
-        {
-            // Check if we are trying to unlock a chunk that isn't locked
-            if (this->state != NE_STATE_LOCKED)
-                return -2;
+    // Couldn't find a chunk at the specified address
+    if (this == NULL)
+        return -3;
 
-            this->state = NE_STATE_USED;
-            return 0;
-        }
+    // Check if we are trying to unlock a chunk that isn't locked
+    if (this->state != NE_STATE_LOCKED)
+        return -2;
 
-        // Couldn't find a chunk at the specified address
-        if (this->next == NULL)
-            return -3;
+    // The amount of free memory doesn't change, it isn't needed to update the
+    // tree of chunks.
+    this->state = NE_STATE_USED;
+    return 0;
+}
 
-        this = this->next;
-    }
+int NE_Unlock(NEChunk *first_chunk, void *pointer)
+{
+    int ret = ne_unlock(first_chunk, pointer);
+    ne_trace(first_chunk, NE_TRACE_UNLOCK, pointer, 0, ret != 0);
+    return ret;
 }
 
 int NE_MemGetInformation(NEChunk *first_chunk, NEMemInfo *info)
@@ -614,6 +1196,7 @@ int NE_MemGetInformation(NEChunk *first_chunk, NEMemInfo *info)
     info->used = 0;
     info->total = 0;
     info->locked = 0;
+    info->free_fragments = 0;
 
     NEChunk *this = first_chunk;
 
@@ -626,6 +1209,7 @@ int NE_MemGetInformation(NEChunk *first_chunk, NEMemInfo *info)
             case NE_STATE_FREE:
                 info->free += size;
                 info->total += size;
+                info->free_fragments++;
                 break;
             case NE_STATE_USED:
                 info->used += size;
@@ -642,5 +1226,177 @@ int NE_MemGetInformation(NEChunk *first_chunk, NEMemInfo *info)
     }
 
     info->free_percent = (info->free * 100) / info->total;
+
+    // The root of the tree knows the size of the biggest free chunk
+    info->largest_free = ne_tree_max_free(ne_allocator_get(first_chunk)->root);
+
+    // Percentage of free memory that isn't part of the biggest free chunk
+    if (info->free > 0)
+        info->fragmentation = 100 - (info->largest_free * 100) / info->free;
+    else
+        info->fragmentation = 0;
+
     return 0;
 }
+
+int NE_AllocTraceStart(NEChunk *first_chunk, size_t num_entries)
+{
+    if ((first_chunk == NULL) || (num_entries == 0))
+    {
+        NE_DebugPrint("Invalid arguments");
+        return -1;
+    }
+
+    ne_allocator_t *alloc = ne_allocator_get(first_chunk);
+
+    // The current state of the pool is saved outside of the ring buffer so
+    // that it isn't overwritten when the ring buffer wraps around.
+    uint32_t snapshot_size = 0;
+
+    for (NEChunk *this = first_chunk; this != NULL; this = this->next)
+    {
+        if (this->state == NE_STATE_USED)
+            snapshot_size++;
+        else if (this->state == NE_STATE_LOCKED)
+            snapshot_size += 2;
+    }
+
+    NETraceEntry *trace = malloc(num_entries * sizeof(NETraceEntry));
+    NETraceEntry *snapshot = NULL;
+    if (snapshot_size > 0)
+        snapshot = malloc(snapshot_size * sizeof(NETraceEntry));
+
+    if ((trace == NULL) || ((snapshot_size > 0) && (snapshot == NULL)))
+    {
+        free(trace);
+        free(snapshot);
+        NE_DebugPrint("Not enough memory");
+        return -2;
+    }
+
+    ne_trace_free(alloc);
+
+    alloc->trace = trace;
+    alloc->trace_size = num_entries;
+    alloc->trace_count = 0;
+
+    alloc->snapshot = snapshot;
+    alloc->snapshot_size = snapshot_size;
+
+    // Save the current state of the pool so that the trace can be replayed
+    // from an empty pool.
+    NETraceEntry *entry = snapshot;
+
+    for (NEChunk *this = first_chunk; this != NULL; this = this->next)
+    {
+        if (this->state == NE_STATE_FREE)
+            continue;
+
+        ne_trace_entry_set(first_chunk, entry++, NE_TRACE_ALLOC_ADDRESS,
+                           this->start, ne_chunk_size(this), false,
+                           NE_TRACE_TAG_SNAPSHOT);
+
+        if (this->state == NE_STATE_LOCKED)
+        {
+            ne_trace_entry_set(first_chunk, entry++, NE_TRACE_LOCK,
+                               this->start, 0, false, NE_TRACE_TAG_SNAPSHOT);
+        }
+    }
+
+    return 0;
+}
+
+int NE_AllocTraceStop(NEChunk *first_chunk)
+{
+    if (first_chunk == NULL)
+    {
+        NE_DebugPrint("Invalid arguments");
+        return -1;
+    }
+
+    ne_trace_free(ne_allocator_get(first_chunk));
+
+    return 0;
+}
+
+int NE_AllocTraceSetTag(NEChunk *first_chunk, uint16_t tag)
+{
+    if (first_chunk == NULL)
+    {
+        NE_DebugPrint("Invalid arguments");
+        return -1;
+    }
+
+    ne_allocator_get(first_chunk)->trace_tag = tag;
+
+    return 0;
+}
+
+int NE_AllocTraceDump(NEChunk *first_chunk, const char *path)
+{
+    if ((first_chunk == NULL) || (path == NULL))
+    {
+        NE_DebugPrint("Invalid arguments");
+        return -1;
+    }
+
+    ne_allocator_t *alloc = ne_allocator_get(first_chunk);
+    if (alloc->trace == NULL)
+    {
+        NE_DebugPrint("Tracing not enabled");
+        return -2;
+    }
+
+    // If the ring buffer has wrapped around, the oldest entries are lost
+    uint32_t num_entries = alloc->trace_count;
+    uint32_t first = 0;
+    if (num_entries > alloc->trace_size)
+    {
+        num_entries = alloc->trace_size;
+        first = alloc->trace_count % alloc->trace_size;
+    }
+
+    NETraceHeader header = {
+        .magic = NE_TRACE_MAGIC,
+        .version = NE_TRACE_VERSION,
+        .pool_size = (uintptr_t)ne_tree_last(alloc->root)->end -
+                     (uintptr_t)first_chunk->start,
+        .num_entries = alloc->snapshot_size + num_entries,
+        .dropped = alloc->trace_count - num_entries,
+    };
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+    {
+        NE_DebugPrint("Can't open file %s", path);
+        return -3;
+    }
+
+    int ret = 0;
+
+    if (fwrite(&header, sizeof(header), 1, f) != 1)
+        ret = -4;
+
+    // The snapshot goes first, followed by the entries of the ring buffer in
+    // the order they were saved.
+    for (uint32_t i = 0; (i < alloc->snapshot_size) && (ret == 0); i++)
+    {
+        if (fwrite(&alloc->snapshot[i], sizeof(NETraceEntry), 1, f) != 1)
+            ret = -4;
+    }
+
+    for (uint32_t i = 0; (i < num_entries) && (ret == 0); i++)
+    {
+        NETraceEntry *entry = &alloc->trace[(first + i) % alloc->trace_size];
+        if (fwrite(entry, sizeof(NETraceEntry), 1, f) != 1)
+            ret = -4;
+    }
+
+    if (fclose(f) != 0)
+        ret = -4;
+
+    if (ret != 0)
+        NE_DebugPrint("Can't write file %s", path);
+
+    return ret;
+}
@@ -10,6 +10,10 @@
 
 /// @file NEAnimation.c
 
+// Internal use. See NEAsset.c
+void *__NE_AssetCacheLoad(NE_AssetType type, const char *path);
+void __NE_AssetCacheFree(void *data);
+
 static NE_Animation **NE_AnimationPointers;
 static int NE_MAX_ANIMATIONS;
 static bool ne_animation_system_inited = false;
@@ -73,7 +77,7 @@ void NE_AnimationDelete(NE_Animation *animation)
     }
 
     if (animation->loadedfromfat)
-        free((void *)animation->data);
+        __NE_AssetCacheFree((void *)animation->data);
 
     free(animation);
 }
@@ -87,11 +91,12 @@ int NE_AnimationLoadFAT(NE_Animation *animation, const char *dsa_path)
     NE_AssertPointer(dsa_path, "NULL path pointer");
 
     if (animation->loadedfromfat)
-        free((void *)animation->data);
+        __NE_AssetCacheFree((void *)animation->data);
 
-    animation->loadedfromfat = true;
+    animation->loadedfromfat = false;
+    animation->data = NULL;
 
-    uint32_t *pointer = (uint32_t *)NE_FATLoadData(dsa_path);
+    uint32_t *pointer = __NE_AssetCacheLoad(NE_ASSET_ANIMATION, dsa_path);
     if (pointer == NULL)
     {
         NE_DebugPrint("Couldn't load file from FAT");
@@ -103,10 +108,11 @@ int NE_AnimationLoadFAT(NE_Animation *animation, const char *dsa_path)
     if (version != 1)
     {
         NE_DebugPrint("file version is %ld, it should be 1", version);
-        free(pointer);
+        __NE_AssetCacheFree(pointer);
         return 0;
     }
 
+    animation->loadedfromfat = true;
     animation->data = (void *)pointer;
     return 1;
 }
@@ -120,7 +126,7 @@ int NE_AnimationLoad(NE_Animation *animation, const void *dsa_pointer)
     NE_AssertPointer(dsa_pointer, "NULL data pointer");
 
     if (animation->loadedfromfat)
-        free((void *)animation->data);
+        __NE_AssetCacheFree((void *)animation->data);
 
     animation->loadedfromfat = false;
 
@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2024 Antonio Niño Díaz
+//
+// This file is part of Nitro Engine
+
+#include "NEMain.h"
+
+/// @file NEAsset.c
+
+// Internal use. See NEFAT.c
+char *__NE_FATLoadDataSize(const char *filename, size_t *size);
+
+// Files loaded to RAM that may be shared by several users
+typedef struct ne_asset_entry {
+    struct ne_asset_entry *next;
+    NE_AssetType type;
+    char *path;
+    void *data;
+    size_t size;
+    int uses;
+} ne_asset_entry_t;
+
+static ne_asset_entry_t *ne_asset_list = NULL;
+
+static bool ne_asset_cache_enabled = false;
+
+static NE_AssetCacheStats ne_asset_stats[NE_ASSET_TYPES];
+
+void NE_AssetCacheSetEnabled(bool enabled)
+{
+    ne_asset_cache_enabled = enabled;
+}
+
+bool __NE_AssetCacheIsEnabled(void)
+{
+    return ne_asset_cache_enabled;
+}
+
+void NE_AssetCacheGetStats(NE_AssetType type, NE_AssetCacheStats *stats)
+{
+    NE_AssertPointer(stats, "NULL stats pointer");
+    NE_AssertMinMax(0, type, NE_ASSET_TYPES - 1, "Invalid asset type %d", type);
+
+    *stats = ne_asset_stats[type];
+}
+
+void NE_AssetCacheResetStats(void)
+{
+    for (int i = 0; i < NE_ASSET_TYPES; i++)
+    {
+        ne_asset_stats[i].hits = 0;
+        ne_asset_stats[i].misses = 0;
+        ne_asset_stats[i].bytes_saved = 0;
+    }
+}
+
+// Used by assets that aren't in the list, like textures.
+void __NE_AssetCacheCountLoad(NE_AssetType type, bool hit, size_t size)
+{
+    NE_AssetCacheStats *stats = &ne_asset_stats[type];
+
+    if (hit)
+    {
+        stats->hits++;
+        stats->bytes_saved += size;
+    }
+    else
+    {
+        stats->misses++;
+        stats->resident++;
+        stats->resident_bytes += size;
+    }
+}
+
+void __NE_AssetCacheCountFree(NE_AssetType type, size_t size)
+{
+    NE_AssetCacheStats *stats = &ne_asset_stats[type];
+
+    stats->resident--;
+    stats->resident_bytes -= size;
+}
+
+// Loads a file to RAM, or returns the copy that has already been loaded. The
+// returned pointer must be freed with __NE_AssetCacheFree().
+void *__NE_AssetCacheLoad(NE_AssetType type, const char *path)
+{
+    if (ne_asset_cache_enabled)
+    {
+        for (ne_asset_entry_t *e = ne_asset_list; e != NULL; e = e->next)
+        {
+            // Files loaded while the cache was disabled don't have a path
+            if ((e->type != type) || (e->path == NULL))
+                continue;
+
+            if (strcmp(e->path, path) == 0)
+            {
+                e->uses++;
+                __NE_AssetCacheCountLoad(type, true, e->size);
+                return e->data;
+            }
+        }
+    }
+
+    ne_asset_entry_t *e = calloc(1, sizeof(ne_asset_entry_t));
+    if (e == NULL)
+    {
+        NE_DebugPrint("Not enough memory");
+        return NULL;
+    }
+
+    // The path isn't needed if the file can't be shared
+    if (ne_asset_cache_enabled)
+    {
+        e->path = strdup(path);
+        if (e->path == NULL)
+        {
+            NE_DebugPrint("Not enough memory");
+            free(e);
+            return NULL;
+        }
+    }
+
+    e->data = __NE_FATLoadDataSize(path, &e->size);
+    if (e->data == NULL)
+    {
+        free(e->path);
+        free(e);
+        return NULL;
+    }
+
+    e->type = type;
+    e->uses = 1;
+
+    e->next = ne_asset_list;
+    ne_asset_list = e;
+
+    __NE_AssetCacheCountLoad(type, false, e->size);
+
+    return e->data;
+}
+
+// Releases data returned by __NE_AssetCacheLoad(). Data that didn't come from
+// the cache is freed with free().
+void __NE_AssetCacheFree(void *data)
+{
+    ne_asset_entry_t **prev = &ne_asset_list;
+
+    for (ne_asset_entry_t *e = ne_asset_list; e != NULL; e = e->next)
+    {
+        if (e->data == data)
+        {
+            e->uses--;
+            if (e->uses > 0)
+                return;
+
+            __NE_AssetCacheCountFree(e->type, e->size);
+
+            *prev = e->next;
+            free(e->data);
+            free(e->path);
+            free(e);
+            return;
+        }
+
+        prev = &e->next;
+    }
+
+    free(data);
+}
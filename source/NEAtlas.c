@@ -0,0 +1,306 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2024 Antonio Niño Díaz
+//
+// This file is part of Nitro Engine
+
+#include <limits.h>
+
+#include "NEMain.h"
+
+/// @file NEAtlas.c
+
+// The skyline is a list of horizontal segments that cover the whole width of
+// the atlas, sorted by X coordinate. Each segment is the lowest Y coordinate
+// where new images can be placed between x and x + width.
+typedef struct {
+    u16 x;
+    u16 y;
+    u16 width;
+} ne_atlas_node_t;
+
+// Bits per pixel of each texture format
+static const int ne_atlas_bpp[] = {
+    0,  // Nothing
+    8,  // NE_A3PAL32
+    2,  // NE_PAL4
+    4,  // NE_PAL16
+    8,  // NE_PAL256
+    0,  // NE_TEX4X4 (Not supported)
+    8,  // NE_A5PAL8
+    16, // NE_A1RGB5
+    16, // NE_RGB5
+};
+
+static bool ne_atlas_is_valid_size(int size)
+{
+    return (size >= 8) && (size <= 1024) && ((size & (size - 1)) == 0);
+}
+
+NE_Atlas *NE_AtlasCreate(NE_TextureFormat fmt, int width, int height,
+                         NE_TextureFlags flags)
+{
+    if ((fmt < NE_A3PAL32) || (fmt > NE_RGB5) || (fmt == NE_TEX4X4))
+    {
+        NE_DebugPrint("Unsupported texture format");
+        return NULL;
+    }
+
+    if (!ne_atlas_is_valid_size(width) || !ne_atlas_is_valid_size(height))
+    {
+        NE_DebugPrint("Width and height must be powers of 2");
+        return NULL;
+    }
+
+    NE_Atlas *atlas = calloc(1, sizeof(NE_Atlas));
+    if (atlas == NULL)
+    {
+        NE_DebugPrint("Not enough memory");
+        return NULL;
+    }
+
+    atlas->fmt = fmt;
+    atlas->width = width;
+    atlas->height = height;
+    atlas->align = 16 / ne_atlas_bpp[fmt];
+
+    // There can't be more segments than aligned positions in the atlas. One
+    // more is needed while a segment is being added.
+    ne_atlas_node_t *nodes = calloc((width / atlas->align) + 1,
+                                    sizeof(ne_atlas_node_t));
+    if (nodes == NULL)
+    {
+        NE_DebugPrint("Not enough memory");
+        goto cleanup;
+    }
+
+    nodes[0].x = 0;
+    nodes[0].y = 0;
+    nodes[0].width = width;
+    atlas->nodes = nodes;
+    atlas->num_nodes = 1;
+
+    atlas->mat = NE_MaterialCreate();
+    if (atlas->mat == NULL)
+    {
+        NE_DebugPrint("Can't create material");
+        goto cleanup;
+    }
+
+    // Start with an empty texture
+    void *empty = calloc(1, (width * height * ne_atlas_bpp[fmt]) >> 3);
+    if (empty == NULL)
+    {
+        NE_DebugPrint("Not enough memory");
+        goto cleanup;
+    }
+
+    int ret = NE_MaterialTexLoad(atlas->mat, fmt, width, height, flags, empty);
+    free(empty);
+    if (ret == 0)
+    {
+        NE_DebugPrint("Can't load atlas texture");
+        goto cleanup;
+    }
+
+    return atlas;
+
+cleanup:
+    if (atlas->mat != NULL)
+        NE_MaterialDelete(atlas->mat);
+    free(atlas->nodes);
+    free(atlas);
+    return NULL;
+}
+
+// Returns the lowest Y coordinate where an image of the provided size can be
+// placed with its left side at the start of the segment "index", or -1 if it
+// doesn't fit there.
+static int ne_atlas_fit(const NE_Atlas *atlas, int index, int width, int height)
+{
+    const ne_atlas_node_t *nodes = atlas->nodes;
+
+    if (nodes[index].x + width > atlas->width)
+        return -1;
+
+    int y = 0;
+    int remaining = width;
+
+    // The segments cover the whole width of the atlas, so this loop can't go
+    // past the last segment.
+    while (remaining > 0)
+    {
+        if (nodes[index].y > y)
+            y = nodes[index].y;
+
+        if (y + height > atlas->height)
+            return -1;
+
+        remaining -= nodes[index].width;
+        index++;
+    }
+
+    return y;
+}
+
+// Adds a segment for a new image at the position of segment "index", and
+// shrinks or removes the segments that are now under the new one.
+static void ne_atlas_add_node(NE_Atlas *atlas, int index, int x, int y,
+                              int width)
+{
+    ne_atlas_node_t *nodes = atlas->nodes;
+
+    memmove(&nodes[index + 1], &nodes[index],
+            (atlas->num_nodes - index) * sizeof(ne_atlas_node_t));
+    atlas->num_nodes++;
+
+    nodes[index].x = x;
+    nodes[index].y = y;
+    nodes[index].width = width;
+
+    int i = index + 1;
+    while (i < atlas->num_nodes)
+    {
+        int end = nodes[i - 1].x + nodes[i - 1].width;
+
+        if (nodes[i].x >= end)
+            break;
+
+        int shrink = end - nodes[i].x;
+        if (shrink < nodes[i].width)
+        {
+            nodes[i].x += shrink;
+            nodes[i].width -= shrink;
+            break;
+        }
+
+        memmove(&nodes[i], &nodes[i + 1],
+                (atlas->num_nodes - i - 1) * sizeof(ne_atlas_node_t));
+        atlas->num_nodes--;
+    }
+
+    // Merge segments at the same height
+    i = 0;
+    while (i < atlas->num_nodes - 1)
+    {
+        if (nodes[i].y == nodes[i + 1].y)
+        {
+            nodes[i].width += nodes[i + 1].width;
+            memmove(&nodes[i + 1], &nodes[i + 2],
+                    (atlas->num_nodes - i - 2) * sizeof(ne_atlas_node_t));
+            atlas->num_nodes--;
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+int NE_AtlasAdd(NE_Atlas *atlas, const void *data, int width, int height,
+                NE_AtlasImage *image)
+{
+    NE_AssertPointer(atlas, "NULL atlas pointer");
+    NE_AssertPointer(data, "NULL data pointer");
+    NE_AssertPointer(image, "NULL image pointer");
+
+    if ((width <= 0) || (height <= 0))
+    {
+        NE_DebugPrint("Size must be positive");
+        return 0;
+    }
+
+    ne_atlas_node_t *nodes = atlas->nodes;
+
+    int aligned_width = (width + atlas->align - 1) & ~(atlas->align - 1);
+
+    // Look for the position that leaves the top of the image as low as
+    // possible. In case of a tie, use the narrowest segment.
+    int best_index = -1;
+    int best_bottom = INT_MAX;
+    int best_width = INT_MAX;
+
+    for (int i = 0; i < atlas->num_nodes; i++)
+    {
+        int y = ne_atlas_fit(atlas, i, aligned_width, height);
+        if (y < 0)
+            continue;
+
+        int bottom = y + height;
+        if ((bottom < best_bottom) ||
+            ((bottom == best_bottom) && (nodes[i].width < best_width)))
+        {
+            best_index = i;
+            best_bottom = bottom;
+            best_width = nodes[i].width;
+        }
+    }
+
+    if (best_index == -1)
+    {
+        NE_DebugPrint("Not enough space in atlas");
+        return 0;
+    }
+
+    int x = nodes[best_index].x;
+    int y = best_bottom - height;
+
+    // Only reserve the space if the image can be copied to VRAM
+    u16 *dst = NE_TextureDrawingStart(atlas->mat);
+    if (dst == NULL)
+    {
+        NE_DebugPrint("Can't access atlas texture");
+        return 0;
+    }
+
+    ne_atlas_add_node(atlas, best_index, x, best_bottom, aligned_width);
+
+    // Copy the image to VRAM 16 bits at a time
+
+    int bpp = ne_atlas_bpp[atlas->fmt];
+    size_t src_stride = (aligned_width * bpp) >> 4;
+    size_t dst_stride = (atlas->width * bpp) >> 4;
+
+    dst += (y * dst_stride) + ((x * bpp) >> 4);
+
+    const u16 *src = data;
+    u16 alpha = (atlas->fmt == NE_RGB5) ? (1 << 15) : 0;
+
+    for (int j = 0; j < height; j++)
+    {
+        for (size_t i = 0; i < src_stride; i++)
+            dst[i] = src[i] | alpha;
+
+        src += src_stride;
+        dst += dst_stride;
+    }
+
+    NE_TextureDrawingEnd();
+
+    atlas->num_images++;
+    atlas->used_area += width * height;
+
+    image->mat = atlas->mat;
+    image->tl = x;
+    image->tt = y;
+    image->tr = x + width;
+    image->tb = y + height;
+
+    return 1;
+}
+
+int NE_AtlasUsedPercent(const NE_Atlas *atlas)
+{
+    NE_AssertPointer(atlas, "NULL atlas pointer");
+
+    return (atlas->used_area * 100) / (atlas->width * atlas->height);
+}
+
+void NE_AtlasDelete(NE_Atlas *atlas)
+{
+    NE_AssertPointer(atlas, "NULL atlas pointer");
+
+    NE_MaterialDelete(atlas->mat);
+    free(atlas->nodes);
+    free(atlas);
+}
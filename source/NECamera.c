@@ -5,6 +5,7 @@
 // This file is part of Nitro Engine
 
 #include "NEMain.h"
+#include "NEGFX.h"
 
 /// @file NECamera.c
 
@@ -12,6 +13,63 @@ static NE_Camera **NE_UserCamera;
 static int NE_MAX_CAMERAS;
 static bool ne_camera_system_inited = false;
 
+// Last camera used with NE_CameraUse() during this frame
+static NE_Camera *ne_camera_active = NULL;
+
+// Internal use. See NEGeneral.c
+void __NE_ProjectionGet(int32_t *projection);
+
+// Calculates the sine and cosine of an angle from its tangent
+static void ne_tan_to_sin_cos(int32_t tan, int32_t *sin, int32_t *cos)
+{
+    int32_t hyp = sqrtf32(inttof32(1) + mulf32(tan, tan));
+    *sin = divf32(tan, hyp);
+    *cos = divf32(inttof32(1), hyp);
+}
+
+// Sets a plane with normal a * fa + b * fb and distance d
+static void ne_set_plane(int32_t *plane, const int32_t *a, int32_t fa,
+                         const int32_t *b, int32_t fb, int32_t d)
+{
+    for (int i = 0; i < 3; i++)
+        plane[i] = mulf32(a[i], fa) + mulf32(b[i], fb);
+    plane[3] = d;
+}
+
+// The camera looks at -forward. The normals of the planes point to the inside
+// of the view volume, and the distances are relative to the position of the
+// camera so that they don't depend on the size of the world.
+static void ne_camera_update_frustum(NE_Camera *cam,
+                                     const int32_t *projection)
+{
+    const int32_t *m = cam->matrix.m;
+    int32_t side[3] = { m[0], m[4], m[8] };
+    int32_t up[3] = { m[1], m[5], m[9] };
+    int32_t forward[3] = { m[2], m[6], m[10] };
+
+    // Half angles of the view volume, like in gluPerspectivef32()
+    int32_t tan_y = tanLerp(projection[0] >> 1);
+    int32_t tan_x = mulf32(tan_y, projection[1]);
+
+    int32_t sin_x, cos_x, sin_y, cos_y;
+    ne_tan_to_sin_cos(tan_x, &sin_x, &cos_x);
+    ne_tan_to_sin_cos(tan_y, &sin_y, &cos_y);
+
+    int32_t (*planes)[4] = cam->frustum;
+
+    ne_set_plane(planes[0], side, cos_x, forward, -sin_x, 0); // Left
+    ne_set_plane(planes[1], side, -cos_x, forward, -sin_x, 0); // Right
+    ne_set_plane(planes[2], up, cos_y, forward, -sin_y, 0); // Bottom
+    ne_set_plane(planes[3], up, -cos_y, forward, -sin_y, 0); // Top
+    ne_set_plane(planes[4], side, 0, forward, -inttof32(1),
+                 -projection[2]); // Near
+    ne_set_plane(planes[5], side, 0, forward, inttof32(1),
+                 projection[3]); // Far
+
+    for (int i = 0; i < 4; i++)
+        cam->frustum_projection[i] = projection[i];
+}
+
 // Internal use only
 ARM_CODE static void __NE_CameraUpdateMatrix(NE_Camera * cam)
 {
@@ -49,6 +107,10 @@ ARM_CODE static void __NE_CameraUpdateMatrix(NE_Camera * cam)
     cam->matrix.m[13] = -dotf32(cam->from, up);
     cam->matrix.m[14] = -dotf32(cam->from, forward);
     cam->matrix.m[15] = inttof32(1);
+
+    int32_t projection[4];
+    __NE_ProjectionGet(projection);
+    ne_camera_update_frustum(cam, projection);
 }
 
 NE_Camera *NE_CameraCreate(void)
@@ -115,7 +177,66 @@ void NE_CameraUse(NE_Camera *cam)
         cam->matrix_is_updated = true;
     }
 
+    // Display lists sent asynchronously may still be using the GPU FIFO
+    NE_DisplayListWait();
+
     glLoadMatrix4x4(&cam->matrix);
+
+    ne_camera_active = cam;
+}
+
+ARM_CODE bool NE_CameraSphereIsVisibleI(NE_Camera *cam, int x, int y, int z,
+                                        int radius)
+{
+    NE_AssertPointer(cam, "NULL pointer");
+
+    if (!cam->matrix_is_updated)
+    {
+        __NE_CameraUpdateMatrix(cam);
+        cam->matrix_is_updated = true;
+    }
+    else
+    {
+        int32_t projection[4];
+        __NE_ProjectionGet(projection);
+        if (memcmp(projection, cam->frustum_projection, sizeof(projection)))
+            ne_camera_update_frustum(cam, projection);
+    }
+
+    int32_t dx = x - cam->from[0];
+    int32_t dy = y - cam->from[1];
+    int32_t dz = z - cam->from[2];
+
+    // The planes aren't very precise. Make the sphere a bit bigger so that
+    // objects close to the edges aren't culled by mistake.
+    int32_t margin = radius + ((abs(dx) + abs(dy) + abs(dz)) >> 10);
+
+    for (int i = 0; i < 6; i++)
+    {
+        const int32_t *plane = cam->frustum[i];
+
+        int64_t dot = (int64_t)plane[0] * dx + (int64_t)plane[1] * dy
+                    + (int64_t)plane[2] * dz;
+        int32_t distance = (int32_t)(dot >> 12) + plane[3];
+
+        if (distance < -margin)
+            return false;
+    }
+
+    return true;
+}
+
+// Internal use. See NEModel.c
+NE_Camera *__NE_CameraGetActive(void)
+{
+    return ne_camera_active;
+}
+
+// Internal use. See NEGeneral.c
+void __NE_CameraNewFrame(void)
+{
+    // NE_Process() resets the modelview matrix
+    ne_camera_active = NULL;
 }
 
 ARM_CODE void NE_CameraMoveFreeI(NE_Camera *cam, int front, int right, int up)
@@ -364,6 +485,9 @@ void NE_CameraDelete(NE_Camera *cam)
         if (NE_UserCamera[i] != cam)
             continue;
 
+        if (ne_camera_active == cam)
+            ne_camera_active = NULL;
+
         NE_UserCamera[i] = NULL;
         free(cam);
         return;
@@ -411,34 +535,34 @@ void NE_CameraSystemEnd(void)
 
 void NE_ViewPush(void)
 {
-    MATRIX_PUSH = 0;
+    NE_GFX(MATRIX_PUSH) = 0;
 }
 
 void NE_ViewPop(void)
 {
-    MATRIX_POP = 1;
+    NE_GFX(MATRIX_POP) = 1;
 }
 
 void NE_ViewMoveI(int x, int y, int z)
 {
-    MATRIX_TRANSLATE = x;
-    MATRIX_TRANSLATE = y;
-    MATRIX_TRANSLATE = z;
+    NE_GFX(MATRIX_TRANSLATE) = x;
+    NE_GFX(MATRIX_TRANSLATE) = y;
+    NE_GFX(MATRIX_TRANSLATE) = z;
 }
 
 void NE_ViewRotate(int rx, int ry, int rz)
 {
     if (rx != 0)
-        glRotateXi(rx << 6);
+        ne_gfx_rotate_x(rx << 6);
     if (ry != 0)
-        glRotateYi(ry << 6);
+        ne_gfx_rotate_y(ry << 6);
     if (rz != 0)
-        glRotateZi(rz << 6);
+        ne_gfx_rotate_z(rz << 6);
 }
 
 void NE_ViewScaleI(int x, int y, int z)
 {
-    MATRIX_SCALE = x;
-    MATRIX_SCALE = y;
-    MATRIX_SCALE = z;
+    NE_GFX(MATRIX_SCALE) = x;
+    NE_GFX(MATRIX_SCALE) = y;
+    NE_GFX(MATRIX_SCALE) = z;
 }
@@ -7,31 +7,187 @@
 #include <nds.h>
 
 #include "NEMain.h"
+#include "NEGFX.h"
 
-void NE_DisplayListDrawDMA_GFX_FIFO(const void *list)
-{
-    const uint32_t *p = list;
+// Display list waiting to be sent to the GPU
+typedef struct {
+    const uint32_t *list;
+    uint32_t words;
+} ne_dl_queue_entry_t;
 
-    NE_AssertPointer(p, "NULL display list pointer");
+static ne_dl_queue_entry_t ne_dl_queue[NE_DL_ASYNC_QUEUE_SIZE];
+static volatile int ne_dl_queue_head;
+static volatile int ne_dl_queue_count; // Including the list being transferred
+static volatile bool ne_dl_queue_busy; // The DMA is sending the first list
 
-    uint32_t words = *p++;
+// Fences of the last list added to the queue and the last list that has been
+// sent to the GPU.
+static volatile NE_DisplayListFence ne_dl_fence_submitted;
+static volatile NE_DisplayListFence ne_dl_fence_completed;
 
-    NE_Assert(words > 0, "Empty display list");
+static bool ne_dl_irq_enabled = false;
 
-    DC_FlushRange(p, words * 4);
+// Writes with NE_GFX() check this before writing to the GPU. See NEGFX.h
+volatile u32 __NE_GFXRedirect = 0;
+
+// Display list that restores the matrix saved by NE_ModelDraw(), so that it can
+// be added to the queue after the mesh of the model.
+static const uint32_t ne_dl_matrix_pop[] = {
+    2,
+    FIFO_COMMAND_PACK(FIFO_POP, FIFO_NOP, FIFO_NOP, FIFO_NOP),
+    1
+};
 
+static void ne_dl_dma_start(const uint32_t *p, uint32_t words, uint32_t flags)
+{
     // There is a hardware bug that affects DMA when there are multiple channels
     // active, under certain conditions. Instead of checking for said
     // conditions, simply ensure that there are no DMA channels active.
     while (dmaBusy(0) || dmaBusy(1) || dmaBusy(2) || dmaBusy(3));
 
 #ifdef NE_BLOCKSDS
-    dmaSetParams(0, p, (void *)&GFX_FIFO, DMA_FIFO | words);
+    dmaSetParams(0, p, (void *)&GFX_FIFO, DMA_FIFO | flags | words);
 #else
     DMA_SRC(0) = (uint32_t)p;
     DMA_DEST(0) = (uint32_t)&GFX_FIFO;
-    DMA_CR(0) = DMA_FIFO | words;
+    DMA_CR(0) = DMA_FIFO | flags | words;
 #endif
+}
+
+// Removes the list that has been sent from the queue and starts the next one.
+// It's called from the DMA interrupt handler and when polling the state of the
+// queue, so that waiting doesn't depend on interrupts being enabled. It must be
+// called with interrupts disabled.
+static void ne_dl_queue_update(void)
+{
+    if (ne_dl_queue_busy)
+    {
+        if (dmaBusy(0))
+            return;
+
+        ne_dl_queue_busy = false;
+        ne_dl_queue_head = (ne_dl_queue_head + 1) % NE_DL_ASYNC_QUEUE_SIZE;
+        ne_dl_queue_count--;
+        ne_dl_fence_completed++;
+    }
+
+    if (ne_dl_queue_count == 0)
+    {
+        // Commands can be sent to the GPU directly again
+        __NE_GFXRedirect &= ~NE_GFX_REDIRECT_ASYNC;
+        return;
+    }
+
+    ne_dl_queue_entry_t *e = &ne_dl_queue[ne_dl_queue_head];
+    ne_dl_dma_start(e->list, e->words, DMA_IRQ_REQ);
+    ne_dl_queue_busy = true;
+}
+
+static void ne_dl_dma_handler(void)
+{
+    ne_dl_queue_update();
+}
+
+NE_DisplayListFence NE_DisplayListDrawAsync(const void *list,
+                                            NE_DisplayListFlags flags)
+{
+    const uint32_t *p = list;
+
+    NE_AssertPointer(p, "NULL display list pointer");
+
+    uint32_t words = *p++;
+
+    NE_Assert(words > 0, "Empty display list");
+
+    if (!(flags & NE_DL_PREFLUSHED))
+        DC_FlushRange(p, words * 4);
+
+    if (!ne_dl_irq_enabled)
+    {
+        irqSet(IRQ_DMA0, ne_dl_dma_handler);
+        irqEnable(IRQ_DMA0);
+        ne_dl_irq_enabled = true;
+    }
+
+    // Wait until there is space in the queue
+    int oldIME;
+    while (1)
+    {
+        oldIME = enterCriticalSection();
+        ne_dl_queue_update();
+        if (ne_dl_queue_count < NE_DL_ASYNC_QUEUE_SIZE)
+            break;
+        leaveCriticalSection(oldIME);
+    }
+
+    int index = ne_dl_queue_head + ne_dl_queue_count;
+    index %= NE_DL_ASYNC_QUEUE_SIZE;
+    ne_dl_queue[index].list = p;
+    ne_dl_queue[index].words = words;
+    ne_dl_queue_count++;
+
+    __NE_GFXRedirect |= NE_GFX_REDIRECT_ASYNC;
+
+    NE_DisplayListFence fence = ++ne_dl_fence_submitted;
+
+    // Start the transfer if the DMA is idle
+    ne_dl_queue_update();
+
+    leaveCriticalSection(oldIME);
+
+    return fence;
+}
+
+bool NE_DisplayListFenceDone(NE_DisplayListFence fence)
+{
+    int oldIME = enterCriticalSection();
+    ne_dl_queue_update();
+    // This works even if the counter has overflowed
+    bool done = (int32_t)(ne_dl_fence_completed - fence) >= 0;
+    leaveCriticalSection(oldIME);
+
+    return done;
+}
+
+void NE_DisplayListFenceWait(NE_DisplayListFence fence)
+{
+    while (!NE_DisplayListFenceDone(fence));
+}
+
+void NE_DisplayListWait(void)
+{
+    if (ne_dl_queue_count == 0)
+        return;
+
+    NE_DisplayListFenceWait(ne_dl_fence_submitted);
+}
+
+// Internal use. See NEModel.c
+void __NE_DisplayListMatrixPop(void)
+{
+    // If a display list is being sent asynchronously, add the command after
+    // it instead of waiting for it to end.
+    if (__NE_GFXRedirect & NE_GFX_REDIRECT_ASYNC)
+        NE_DisplayListDrawAsync(ne_dl_matrix_pop, NE_DL_FLAGS_NONE);
+    else
+        MATRIX_POP = 1;
+}
+
+void NE_DisplayListDrawDMA_GFX_FIFO(const void *list)
+{
+    const uint32_t *p = list;
+
+    NE_AssertPointer(p, "NULL display list pointer");
+
+    uint32_t words = *p++;
+
+    NE_Assert(words > 0, "Empty display list");
+
+    DC_FlushRange(p, words * 4);
+
+    NE_DisplayListWait();
+
+    ne_dl_dma_start(p, words, 0);
 
     while (dmaBusy(0));
 }
@@ -46,10 +202,17 @@ void NE_DisplayListDrawCPU(const void *list)
 
     NE_Assert(words > 0, "Empty display list");
 
+    NE_DisplayListWait();
+
     while (words--)
         GFX_FIFO = *p++;
 }
 
+static void ne_display_list_draw_async(const void *list)
+{
+    NE_DisplayListDrawAsync(list, NE_DL_FLAGS_NONE);
+}
+
 typedef void (*ne_display_list_draw_fn)(const void *);
 
 static ne_display_list_draw_fn ne_display_list_draw = NE_DisplayListDrawDMA_GFX_FIFO;
@@ -64,6 +227,10 @@ void NE_DisplayListSetDefaultFunction(NE_DisplayListDrawFunction type)
     {
         ne_display_list_draw = NE_DisplayListDrawDMA_GFX_FIFO;
     }
+    else if (type == NE_DL_DMA_GFX_FIFO_ASYNC)
+    {
+        ne_display_list_draw = ne_display_list_draw_async;
+    }
     else
     {
         NE_Assert(0, "Invalid display list function type");
@@ -75,3 +242,228 @@ void NE_DisplayListDrawDefault(const void *list)
 {
     ne_display_list_draw(list);
 }
+
+// Display list builder
+// ====================
+
+bool __NE_DisplayListRecording = false;
+
+static NE_DisplayListBuilder *ne_dl_builder;
+
+static size_t ne_dl_builder_header;    // Index of the current header word
+static int ne_dl_builder_commands;     // Commands in the current header
+static uint32_t ne_dl_builder_cmd;     // Last command that has been recorded
+static int ne_dl_builder_params_left;  // Parameters the command still needs
+
+// Writes to commands without parameters, and writes after an error, go here.
+static u32 ne_dl_builder_dummy;
+
+// Returns a pointer to the next free word of the display list, or NULL if
+// there isn't enough memory.
+static u32 *ne_dl_builder_alloc_word(NE_DisplayListBuilder *builder)
+{
+    if (builder->used == builder->capacity)
+    {
+        size_t capacity = builder->capacity * 2;
+        u32 *list = realloc(builder->list, capacity * sizeof(u32));
+        if (list == NULL)
+            return NULL;
+
+        builder->list = list;
+        builder->capacity = capacity;
+    }
+
+    return &builder->list[builder->used++];
+}
+
+// Called by NE_GFX() and NE_GFX_STATE() when the commands can't be written to
+// the GPU directly. It returns the address where the value has to be written.
+vu32 *__NE_DisplayListRedirect(vu32 *reg)
+{
+    if (__NE_DisplayListRecording)
+        return __NE_DisplayListBuilderPort(reg);
+
+    // A display list is being sent asynchronously
+    NE_DisplayListWait();
+
+    return reg;
+}
+
+// Called instead of writing to a command register of the GPU while a display
+// list is being recorded. It returns the address where the value written to
+// the register has to be saved.
+vu32 *__NE_DisplayListBuilderPort(vu32 *reg)
+{
+    NE_DisplayListBuilder *builder = ne_dl_builder;
+
+    if (builder->error)
+        return &ne_dl_builder_dummy;
+
+    uint32_t cmd = ((uintptr_t)reg - (uintptr_t)&GFX_FIFO) >> 2;
+
+    // Commands with several parameters are sent by writing to the same
+    // register several times.
+    if ((cmd != ne_dl_builder_cmd) || (ne_dl_builder_params_left == 0))
+    {
+        // Writes to GFX_FIFO (command 0) are already packed, they can't be
+        // recorded.
+        int params = NE_DisplayListCommandParams(cmd);
+        if ((cmd == 0) || (params < 0))
+        {
+            NE_DebugPrint("Command 0x%lX can't be recorded", cmd);
+            builder->error = true;
+            return &ne_dl_builder_dummy;
+        }
+
+        // Start a new header word when the current one is full
+        if (ne_dl_builder_commands == 4)
+        {
+            u32 *header = ne_dl_builder_alloc_word(builder);
+            if (header == NULL)
+                goto error;
+
+            *header = 0;
+            ne_dl_builder_header = builder->used - 1;
+            ne_dl_builder_commands = 0;
+        }
+
+        int shift = ne_dl_builder_commands * 8;
+        builder->list[ne_dl_builder_header] |= cmd << shift;
+        ne_dl_builder_commands++;
+
+        ne_dl_builder_cmd = cmd;
+        ne_dl_builder_params_left = params;
+
+        if (ne_dl_builder_params_left == 0)
+            return &ne_dl_builder_dummy;
+    }
+
+    u32 *param = ne_dl_builder_alloc_word(builder);
+    if (param == NULL)
+        goto error;
+
+    ne_dl_builder_params_left--;
+
+    return param;
+
+error:
+    NE_DebugPrint("Not enough memory");
+    builder->error = true;
+    return &ne_dl_builder_dummy;
+}
+
+NE_DisplayListBuilder *NE_DisplayListBuilderCreate(size_t words)
+{
+    NE_DisplayListBuilder *builder = calloc(1, sizeof(NE_DisplayListBuilder));
+    if (builder == NULL)
+    {
+        NE_DebugPrint("Not enough memory");
+        return NULL;
+    }
+
+    // The size word and the first header are always needed
+    if (words < 2)
+        words = 2;
+
+    builder->list = malloc(words * sizeof(u32));
+    if (builder->list == NULL)
+    {
+        NE_DebugPrint("Not enough memory");
+        free(builder);
+        return NULL;
+    }
+
+    builder->capacity = words;
+
+    return builder;
+}
+
+void NE_DisplayListBuilderDelete(NE_DisplayListBuilder *builder)
+{
+    NE_AssertPointer(builder, "NULL builder pointer");
+    NE_Assert(ne_dl_builder != builder, "Builder is recording");
+
+    // The display list may still be in the queue of asynchronous lists
+    NE_DisplayListWait();
+
+    free(builder->list);
+    free(builder);
+}
+
+void NE_DisplayListBuilderBegin(NE_DisplayListBuilder *builder)
+{
+    NE_AssertPointer(builder, "NULL builder pointer");
+    NE_Assert(ne_dl_builder == NULL, "Another builder is recording");
+
+    // The previous display list may still be in the queue of asynchronous
+    // lists, and it's about to be overwritten.
+    NE_DisplayListWait();
+
+    // Size word and first header
+    builder->list[0] = 0;
+    builder->list[1] = 0;
+    builder->used = 2;
+    builder->error = false;
+
+    ne_dl_builder = builder;
+    ne_dl_builder_header = 1;
+    ne_dl_builder_commands = 0;
+    ne_dl_builder_cmd = 0;
+    ne_dl_builder_params_left = 0;
+
+    __NE_DisplayListRecording = true;
+
+    // The DMA interrupt handler modifies the same variable
+    int oldIME = enterCriticalSection();
+    __NE_GFXRedirect |= NE_GFX_REDIRECT_RECORDING;
+    leaveCriticalSection(oldIME);
+}
+
+int NE_DisplayListBuilderEnd(NE_DisplayListBuilder *builder)
+{
+    NE_AssertPointer(builder, "NULL builder pointer");
+    NE_Assert(ne_dl_builder == builder, "Builder isn't recording");
+
+    __NE_DisplayListRecording = false;
+    ne_dl_builder = NULL;
+
+    int oldIME = enterCriticalSection();
+    __NE_GFXRedirect &= ~NE_GFX_REDIRECT_RECORDING;
+    leaveCriticalSection(oldIME);
+
+    if (builder->error)
+    {
+        builder->used = 0;
+        return 0;
+    }
+
+    // Nothing has been recorded
+    if (ne_dl_builder_commands == 0)
+    {
+        builder->used = 0;
+        return 1;
+    }
+
+    NE_Assert(ne_dl_builder_params_left == 0,
+              "Missing parameters of command 0x%lX", ne_dl_builder_cmd);
+
+    // The unused commands of the last header are left as NOPs
+    builder->list[0] = builder->used - 1;
+
+    DC_FlushRange(builder->list, builder->used * sizeof(u32));
+
+    return 1;
+}
+
+void NE_DisplayListBuilderDraw(const NE_DisplayListBuilder *builder)
+{
+    NE_AssertPointer(builder, "NULL builder pointer");
+
+    if (builder->used == 0)
+        return;
+
+    NE_DisplayListDrawDefault(builder->list);
+
+    // Recorded display lists can contain any state change, like materials
+    ne_gfx_state_invalidate(NE_STATE_ALL);
+}
@@ -0,0 +1,267 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2024 Antonio Niño Díaz
+//
+// This file is part of Nitro Engine
+
+#include "NEMain.h"
+
+/// @file NEDisplayListInfo.c
+
+// This file doesn't access the hardware so that it can be built for the PC by
+// the tools that inspect display lists.
+
+typedef struct {
+    const char *name;
+    s8 params;
+    u8 cycles;
+} ne_dl_command_t;
+
+// Commands that can be used in display lists. The number of cycles is taken
+// from GBATEK. Commands without a name don't exist, or can't be used in display
+// lists (like SWAP_BUFFERS).
+static const ne_dl_command_t ne_dl_commands[NE_DL_NUM_COMMAND_IDS] = {
+    [0x00] = { "NOP", 0, 0 },
+    [0x10] = { "MTX_MODE", 1, 1 },
+    [0x11] = { "MTX_PUSH", 0, 17 },
+    [0x12] = { "MTX_POP", 1, 36 },
+    [0x13] = { "MTX_STORE", 1, 17 },
+    [0x14] = { "MTX_RESTORE", 1, 36 },
+    [0x15] = { "MTX_IDENTITY", 0, 19 },
+    [0x16] = { "MTX_LOAD_4x4", 16, 34 },
+    [0x17] = { "MTX_LOAD_4x3", 12, 30 },
+    [0x18] = { "MTX_MULT_4x4", 16, 35 },
+    [0x19] = { "MTX_MULT_4x3", 12, 31 },
+    [0x1A] = { "MTX_MULT_3x3", 9, 28 },
+    [0x1B] = { "MTX_SCALE", 3, 22 },
+    [0x1C] = { "MTX_TRANS", 3, 22 },
+    [0x20] = { "COLOR", 1, 1 },
+    [0x21] = { "NORMAL", 1, 9 },
+    [0x22] = { "TEXCOORD", 1, 1 },
+    [0x23] = { "VTX_16", 2, 9 },
+    [0x24] = { "VTX_10", 1, 8 },
+    [0x25] = { "VTX_XY", 1, 8 },
+    [0x26] = { "VTX_XZ", 1, 8 },
+    [0x27] = { "VTX_YZ", 1, 8 },
+    [0x28] = { "VTX_DIFF", 1, 8 },
+    [0x29] = { "POLYGON_ATTR", 1, 1 },
+    [0x2A] = { "TEXIMAGE_PARAM", 1, 1 },
+    [0x2B] = { "PLTT_BASE", 1, 1 },
+    [0x30] = { "DIF_AMB", 1, 4 },
+    [0x31] = { "SPE_EMI", 1, 4 },
+    [0x32] = { "LIGHT_VECTOR", 1, 6 },
+    [0x33] = { "LIGHT_COLOR", 1, 1 },
+    [0x34] = { "SHININESS", 32, 32 },
+    [0x40] = { "BEGIN_VTXS", 1, 1 },
+    [0x41] = { "END_VTXS", 0, 1 },
+    [0x60] = { "VIEWPORT", 1, 1 },
+    [0x70] = { "BOX_TEST", 3, 103 },
+    [0x71] = { "POS_TEST", 2, 9 },
+    [0x72] = { "VEC_TEST", 1, 5 },
+};
+
+// Matrix multiplications and translations also update the vector matrix in
+// MTX_MODE 2, which takes extra cycles.
+#define NE_DL_MTX_MODE_2_CYCLES 30
+
+// The last entry of the position matrix stack. DSMA stores the matrices of the
+// joints at the end of the stack.
+#define NE_DL_MATRIX_STACK_LAST 30
+
+int NE_DisplayListCommandParams(u32 cmd)
+{
+    if ((cmd >= NE_DL_NUM_COMMAND_IDS) || (ne_dl_commands[cmd].name == NULL))
+        return -1;
+
+    return ne_dl_commands[cmd].params;
+}
+
+const char *NE_DisplayListCommandName(u32 cmd)
+{
+    if (cmd >= NE_DL_NUM_COMMAND_IDS)
+        return NULL;
+
+    return ne_dl_commands[cmd].name;
+}
+
+NE_DisplayListError NE_DisplayListDecode(const void *list, size_t size,
+                                         NE_DisplayListDecodeFn fn, void *arg,
+                                         u32 *offset)
+{
+    NE_AssertPointer(list, "NULL display list pointer");
+
+    const u32 *p = list;
+
+    u32 words = p[0];
+    p++;
+
+    u32 dummy;
+    if (offset == NULL)
+        offset = &dummy;
+
+    *offset = 0;
+
+    if ((size != 0) && ((size < 4) || ((size / 4) - 1 < words)))
+        return NE_DL_ERROR_TRUNCATED;
+
+    u32 i = 0;
+    while (i < words)
+    {
+        u32 header = p[i];
+        u32 header_offset = i;
+        i++;
+
+        for (int j = 0; j < 4; j++)
+        {
+            u32 cmd = (header >> (j * 8)) & 0xFF;
+
+            int params = NE_DisplayListCommandParams(cmd);
+            if (params < 0)
+            {
+                *offset = header_offset;
+                return NE_DL_ERROR_INVALID_COMMAND;
+            }
+
+            if (i + params > words)
+            {
+                *offset = header_offset;
+                return NE_DL_ERROR_TRUNCATED;
+            }
+
+            if ((cmd != 0) && (fn != NULL))
+                fn(i, cmd, &p[i], params, arg);
+
+            i += params;
+        }
+    }
+
+    return NE_DL_VALID;
+}
+
+typedef struct {
+    NE_DisplayListInfo *info;
+    int num_joints;
+    u32 mtx_mode;
+    u32 poly_type;
+    u32 poly_vertices; // Vertices since the last BEGIN_VTXS
+} ne_dl_analyze_state_t;
+
+// Adds the polygons formed by the vertices since the last BEGIN_VTXS
+static void ne_dl_analyze_end_polygons(ne_dl_analyze_state_t *state)
+{
+    NE_DisplayListInfo *info = state->info;
+    u32 n = state->poly_vertices;
+
+    if (state->poly_type == GL_TRIANGLES)
+        info->triangles += n / 3;
+    else if (state->poly_type == GL_QUADS)
+        info->quads += n / 4;
+    else if ((state->poly_type == GL_TRIANGLE_STRIP) && (n >= 3))
+        info->triangles += n - 2;
+    else if ((state->poly_type == GL_QUAD_STRIP) && (n >= 4))
+        info->quads += (n - 2) / 2;
+
+    state->poly_vertices = 0;
+}
+
+static void ne_dl_analyze_command(u32 offset, u32 cmd, const u32 *params,
+                                  int num_params, void *arg)
+{
+    (void)num_params;
+
+    ne_dl_analyze_state_t *state = arg;
+    NE_DisplayListInfo *info = state->info;
+
+    info->commands++;
+    info->command_count[cmd]++;
+    info->cycles += ne_dl_commands[cmd].cycles;
+
+    switch (cmd)
+    {
+        case 0x10: // MTX_MODE
+            state->mtx_mode = params[0] & 3;
+            break;
+
+        case 0x18: // MTX_MULT_4x4
+        case 0x19: // MTX_MULT_4x3
+        case 0x1A: // MTX_MULT_3x3
+        case 0x1C: // MTX_TRANS
+            if (state->mtx_mode == 2)
+                info->cycles += NE_DL_MTX_MODE_2_CYCLES;
+            break;
+
+        case 0x14: // MTX_RESTORE
+        {
+            u32 index = params[0] & 0x1F;
+            u32 first = 0;
+            if (state->num_joints > 0)
+                first = NE_DL_MATRIX_STACK_LAST + 1 - state->num_joints;
+
+            if ((index < first) || (index > NE_DL_MATRIX_STACK_LAST))
+            {
+                if (info->error == NE_DL_VALID)
+                {
+                    info->error = NE_DL_ERROR_INVALID_RESTORE;
+                    info->error_offset = offset;
+                }
+            }
+            break;
+        }
+
+        case 0x23: // VTX_16
+        case 0x24: // VTX_10
+        case 0x25: // VTX_XY
+        case 0x26: // VTX_XZ
+        case 0x27: // VTX_YZ
+        case 0x28: // VTX_DIFF
+            info->vertices++;
+            state->poly_vertices++;
+            break;
+
+        case 0x40: // BEGIN_VTXS
+            ne_dl_analyze_end_polygons(state);
+            state->poly_type = params[0] & 3;
+            break;
+
+        case 0x41: // END_VTXS
+            ne_dl_analyze_end_polygons(state);
+            break;
+
+        default:
+            break;
+    }
+}
+
+int NE_DisplayListAnalyze(const void *list, size_t size, int num_joints,
+                          NE_DisplayListInfo *info)
+{
+    NE_AssertPointer(list, "NULL display list pointer");
+    NE_AssertPointer(info, "NULL info pointer");
+
+    memset(info, 0, sizeof(NE_DisplayListInfo));
+    info->words = *(const u32 *)list;
+
+    ne_dl_analyze_state_t state = {
+        .info = info,
+        .num_joints = num_joints,
+        .mtx_mode = 0,
+        .poly_type = GL_TRIANGLES,
+        .poly_vertices = 0,
+    };
+
+    u32 offset;
+    NE_DisplayListError ret = NE_DisplayListDecode(list, size,
+                                                   ne_dl_analyze_command,
+                                                   &state, &offset);
+
+    ne_dl_analyze_end_polygons(&state);
+
+    // Errors found while decoding stop the analysis, so they take priority
+    if (ret != NE_DL_VALID)
+    {
+        info->error = ret;
+        info->error_offset = offset;
+    }
+
+    return info->error == NE_DL_VALID;
+}
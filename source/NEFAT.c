@@ -8,46 +8,434 @@
 
 /// @file NEFAT.c
 
-char *NE_FATLoadData(const char *filename)
+// Size of the sliding window of the LZ77 format
+#define NE_LZ77_WINDOW_SIZE     4096
+// Size of the buffer used to read compressed data from the file
+#define NE_LZ77_INPUT_SIZE      512
+
+// State of the decompressor of a compressed file stream. The decompressed data
+// is written to the window buffer, right after the previous NE_LZ77_WINDOW_SIZE
+// bytes, which are needed to decompress the following data.
+typedef struct {
+    u8 window[NE_LZ77_WINDOW_SIZE + NE_FAT_STREAM_CHUNK_SIZE] __attribute__((aligned(4)));
+    size_t pos;         // Write position in the window buffer
+    u8 input[NE_LZ77_INPUT_SIZE];
+    size_t input_pos;
+    size_t input_size;
+    u8 flags;           // Flags of the current group of 8 blocks
+    int blocks;         // Blocks left in the current group
+    int match_len;      // Bytes left to copy of the current match
+    int match_disp;     // Distance to the bytes to copy
+} ne_lz77_state_t;
+
+// Entry of the hash table of an archive. The name is stored in the table of
+// names of the archive. Empty entries have a name offset of 0xFFFFFFFF.
+typedef struct {
+    u32 hash;
+    u32 name_offset;
+    u32 offset;
+    u32 size;
+    u32 type;
+} ne_archive_entry_t;
+
+typedef struct {
+    char *name;
+    FILE *file;
+    long position;  // Current position of the file
+    u32 num_buckets;
+    ne_archive_entry_t *entries;
+    char *names;
+    u32 names_size;
+} ne_archive_t;
+
+static ne_archive_t *ne_archives[NE_FAT_MAX_ARCHIVES];
+
+// FNV-1a hash. The packer of archives uses the same function.
+static u32 ne_archive_hash(const char *name)
 {
-    FILE *f = fopen(filename, "rb");
-    if (f == NULL)
+    u32 hash = 2166136261u;
+
+    while (*name != '\0')
     {
-        NE_DebugPrint("%s could't be opened", filename);
-        return NULL;
+        hash ^= (u8)*name++;
+        hash *= 16777619u;
     }
 
-    if (fseek(f, 0, SEEK_END) != 0)
+    return hash;
+}
+
+// Looks for a file with the format "archive:name" in the open archives. It
+// returns NULL if the path doesn't refer to an open archive, or if the file
+// isn't in the archive.
+static ne_archive_entry_t *ne_archive_find(const char *path,
+                                           ne_archive_t **archive)
+{
+    const char *colon = strchr(path, ':');
+    if (colon == NULL)
+        return NULL;
+
+    size_t len = colon - path;
+    const char *name = colon + 1;
+
+    for (int i = 0; i < NE_FAT_MAX_ARCHIVES; i++)
     {
-        NE_DebugPrint("Failed to fseek: %s", filename);
-        fclose(f);
+        ne_archive_t *a = ne_archives[i];
+        if (a == NULL)
+            continue;
+
+        if ((strncmp(a->name, path, len) != 0) || (a->name[len] != '\0'))
+            continue;
+
+        u32 hash = ne_archive_hash(name);
+        u32 mask = a->num_buckets - 1;
+
+        for (u32 j = 0; j < a->num_buckets; j++)
+        {
+            ne_archive_entry_t *e = &a->entries[(hash + j) & mask];
+
+            if (e->name_offset == 0xFFFFFFFF)
+                break;
+
+            if ((e->hash == hash) && (strcmp(&a->names[e->name_offset], name) == 0))
+            {
+                *archive = a;
+                return e;
+            }
+        }
+
+        NE_DebugPrint("%s not found in archive", name);
         return NULL;
     }
 
-    size_t size = ftell(f);
-    rewind(f);
+    return NULL;
+}
+
+// Returns true if the path has the format "archive:name" and the archive is
+// open.
+static bool ne_archive_is_path(const char *path)
+{
+    const char *colon = strchr(path, ':');
+    if (colon == NULL)
+        return false;
+
+    size_t len = colon - path;
+
+    for (int i = 0; i < NE_FAT_MAX_ARCHIVES; i++)
+    {
+        ne_archive_t *a = ne_archives[i];
+        if (a == NULL)
+            continue;
+
+        if ((strncmp(a->name, path, len) == 0) && (a->name[len] == '\0'))
+            return true;
+    }
+
+    return false;
+}
+
+// Reads data from the file of a stream. Files inside archives share the FILE of
+// the archive, so it's only needed to seek if another file of the archive has
+// been read since the last read of this stream.
+static size_t ne_fat_stream_fread(NE_FATStream *stream, void *dst, size_t size)
+{
+    ne_archive_t *archive = stream->archive;
+
+    if (archive == NULL)
+        return fread(dst, 1, size, stream->file);
+
+    if ((long)size > stream->end - stream->position)
+        size = stream->end - stream->position;
+
+    if (archive->position != stream->position)
+    {
+        if (fseek(stream->file, stream->position, SEEK_SET) != 0)
+        {
+            archive->position = -1;
+            return 0;
+        }
+    }
+
+    size_t ret = fread(dst, 1, size, stream->file);
+
+    stream->position += ret;
+    archive->position = stream->position;
+
+    return ret;
+}
+
+static void ne_fat_stream_close_file(NE_FATStream *stream)
+{
+    if (stream->archive == NULL)
+        fclose(stream->file);
+
+    free(stream->lz);
+
+    stream->file = NULL;
+    stream->lz = NULL;
+}
+
+// Opens a file and reads the header of compressed files. The buffer of the
+// stream isn't set up.
+static int ne_fat_stream_open_file(NE_FATStream *stream, const char *filename)
+{
+    stream->offset = 0;
+    stream->buffer = NULL;
+    stream->buffer_size = 0;
+    stream->free_buffer = false;
+    stream->compressed = false;
+    stream->lz = NULL;
+    stream->archive = NULL;
+
+    ne_archive_t *archive;
+    ne_archive_entry_t *entry = ne_archive_find(filename, &archive);
+    if (entry != NULL)
+    {
+        stream->file = archive->file;
+        stream->archive = archive;
+        stream->size = entry->size;
+        stream->position = entry->offset;
+        stream->end = entry->offset + entry->size;
+
+        if (entry->type != NE_FAT_ARCHIVE_LZ77)
+            return 1;
+    }
+    else
+    {
+        if (ne_archive_is_path(filename))
+            return 0;
+
+        stream->file = fopen(filename, "rb");
+        if (stream->file == NULL)
+        {
+            NE_DebugPrint("%s couldn't be opened", filename);
+            return 0;
+        }
+
+        if (fseek(stream->file, 0, SEEK_END) != 0)
+        {
+            NE_DebugPrint("Failed to fseek: %s", filename);
+            fclose(stream->file);
+            return 0;
+        }
+
+        stream->size = ftell(stream->file);
+        rewind(stream->file);
+    }
+
+    u32 header[2];
+    if (stream->size < sizeof(header))
+        return 1;
+
+    if (ne_fat_stream_fread(stream, header, sizeof(header)) != sizeof(header))
+    {
+        NE_DebugPrint("Failed to read data of %s", filename);
+        ne_fat_stream_close_file(stream);
+        return 0;
+    }
+
+    if ((memcmp(header, NE_FAT_LZ77_MAGIC, 4) != 0) ||
+        ((header[1] & 0xFF) != 0x10))
+    {
+        // This isn't a compressed file
+        if (stream->archive != NULL)
+            stream->position -= sizeof(header);
+        else
+            rewind(stream->file);
+        return 1;
+    }
+
+    ne_lz77_state_t *lz = malloc(sizeof(ne_lz77_state_t));
+    if (lz == NULL)
+    {
+        NE_DebugPrint("Not enough memory to load %s", filename);
+        ne_fat_stream_close_file(stream);
+        return 0;
+    }
+
+    lz->pos = 0;
+    lz->input_pos = 0;
+    lz->input_size = 0;
+    lz->blocks = 0;
+    lz->match_len = 0;
+
+    stream->compressed = true;
+    stream->size = header[1] >> 8;
+    stream->lz = lz;
+
+    return 1;
+}
+
+// Returns the next byte of compressed data, or -1 on error.
+static int ne_lz77_get_byte(NE_FATStream *stream)
+{
+    ne_lz77_state_t *lz = stream->lz;
+
+    if (lz->input_pos == lz->input_size)
+    {
+        lz->input_size = ne_fat_stream_fread(stream, lz->input,
+                                             NE_LZ77_INPUT_SIZE);
+        lz->input_pos = 0;
+        if (lz->input_size == 0)
+            return -1;
+    }
+
+    return lz->input[lz->input_pos++];
+}
+
+// Decompresses up to "size" bytes. It returns the number of bytes written to
+// "data", or -1 on error.
+static int ne_lz77_read(NE_FATStream *stream, size_t size, const void **data)
+{
+    ne_lz77_state_t *lz = stream->lz;
+
+    // If the buffer is full, keep the last NE_LZ77_WINDOW_SIZE bytes and
+    // discard the rest.
+    if (lz->pos == sizeof(lz->window))
+    {
+        memmove(lz->window, lz->window + lz->pos - NE_LZ77_WINDOW_SIZE,
+                NE_LZ77_WINDOW_SIZE);
+        lz->pos = NE_LZ77_WINDOW_SIZE;
+    }
+
+    if (size > sizeof(lz->window) - lz->pos)
+        size = sizeof(lz->window) - lz->pos;
+
+    u8 *window = lz->window;
+    size_t start = lz->pos;
+    size_t end = start + size;
+    size_t pos = start;
+
+    while (pos < end)
+    {
+        if (lz->match_len > 0)
+        {
+            window[pos] = window[pos - lz->match_disp];
+            pos++;
+            lz->match_len--;
+            continue;
+        }
+
+        if (lz->blocks == 0)
+        {
+            int flags = ne_lz77_get_byte(stream);
+            if (flags < 0)
+                goto error;
+
+            lz->flags = flags;
+            lz->blocks = 8;
+        }
+
+        bool compressed = lz->flags & 0x80;
+        lz->flags <<= 1;
+        lz->blocks--;
+
+        if (compressed)
+        {
+            int b0 = ne_lz77_get_byte(stream);
+            int b1 = ne_lz77_get_byte(stream);
+            if ((b0 < 0) || (b1 < 0))
+                goto error;
+
+            lz->match_len = (b0 >> 4) + 3;
+            lz->match_disp = (((b0 & 0xF) << 8) | b1) + 1;
+
+            if ((size_t)lz->match_disp > pos)
+            {
+                NE_DebugPrint("Invalid compressed data");
+                return -1;
+            }
+        }
+        else
+        {
+            int b = ne_lz77_get_byte(stream);
+            if (b < 0)
+                goto error;
+
+            window[pos++] = b;
+        }
+    }
+
+    lz->pos = pos;
+    *data = window + start;
+
+    return size;
+
+error:
+    NE_DebugPrint("Failed to read data");
+    return -1;
+}
+
+// Like NE_FATLoadData(), but it also returns the size of the data, which is
+// the decompressed size for compressed files. "size" can be NULL.
+char *__NE_FATLoadDataSize(const char *filename, size_t *size_out)
+{
+    NE_FATStream stream;
+    if (ne_fat_stream_open_file(&stream, filename) == 0)
+        return NULL;
+
+    size_t size = stream.size;
 
     char *buffer = malloc(size);
     if (buffer == NULL)
     {
         NE_DebugPrint("Not enought memory to load %s", filename);
-        fclose(f);
+        NE_FATStreamClose(&stream);
         return NULL;
     }
 
-    if (fread(buffer, 1, size, f) != size)
+    if (stream.compressed)
+    {
+        char *dst = buffer;
+        while (1)
+        {
+            const void *data;
+            int read = NE_FATStreamRead(&stream, size, &data);
+            if (read <= 0)
+                break;
+
+            memcpy(dst, data, read);
+            dst += read;
+        }
+
+        if (stream.offset != size)
+        {
+            NE_DebugPrint("Failed to decompress %s", filename);
+            free(buffer);
+            NE_FATStreamClose(&stream);
+            return NULL;
+        }
+    }
+    else if (ne_fat_stream_fread(&stream, buffer, size) != size)
     {
         NE_DebugPrint("Failed to read data of %s", filename);
-        fclose(f);
+        free(buffer);
+        NE_FATStreamClose(&stream);
         return NULL;
     }
 
-    fclose(f);
+    NE_FATStreamClose(&stream);
+
+    if (size_out != NULL)
+        *size_out = size;
+
     return buffer;
 }
 
+char *NE_FATLoadData(const char *filename)
+{
+    return __NE_FATLoadDataSize(filename, NULL);
+}
+
 size_t NE_FATFileSize(const char *filename)
 {
+    ne_archive_t *archive;
+    ne_archive_entry_t *entry = ne_archive_find(filename, &archive);
+    if (entry != NULL)
+        return entry->size;
+
+    if (ne_archive_is_path(filename))
+        return -1;
+
     FILE *f = fopen(filename, "rb");
     if (f == NULL)
     {
@@ -67,6 +455,233 @@ size_t NE_FATFileSize(const char *filename)
     return size;
 }
 
+int NE_FATStreamOpen(NE_FATStream *stream, const char *filename,
+                     void *buffer, size_t buffer_size)
+{
+    NE_AssertPointer(stream, "NULL stream pointer");
+    NE_AssertPointer(filename, "NULL filename pointer");
+
+    if (ne_fat_stream_open_file(stream, filename) == 0)
+        return 0;
+
+    // Compressed files are decompressed to the buffer of the decompressor
+    if (stream->compressed)
+        return 1;
+
+    if (buffer == NULL)
+    {
+        if (buffer_size == 0)
+            buffer_size = NE_FAT_STREAM_CHUNK_SIZE;
+
+        buffer = malloc(buffer_size);
+        if (buffer == NULL)
+        {
+            NE_DebugPrint("Not enough memory to load %s", filename);
+            ne_fat_stream_close_file(stream);
+            return 0;
+        }
+
+        stream->free_buffer = true;
+    }
+
+    stream->buffer = buffer;
+    stream->buffer_size = buffer_size;
+
+    return 1;
+}
+
+int NE_FATStreamRead(NE_FATStream *stream, size_t max_size, const void **data)
+{
+    NE_AssertPointer(stream, "NULL stream pointer");
+    NE_AssertPointer(data, "NULL data pointer");
+
+    size_t size = stream->size - stream->offset;
+    if (size > max_size)
+        size = max_size;
+
+    if (size == 0)
+        return 0;
+
+    if (stream->compressed)
+    {
+        int ret = ne_lz77_read(stream, size, data);
+        if (ret > 0)
+            stream->offset += ret;
+        return ret;
+    }
+
+    if (size > stream->buffer_size)
+        size = stream->buffer_size;
+
+    if (ne_fat_stream_fread(stream, stream->buffer, size) != size)
+    {
+        NE_DebugPrint("Failed to read data");
+        return -1;
+    }
+
+    stream->offset += size;
+    *data = stream->buffer;
+
+    return size;
+}
+
+void NE_FATStreamClose(NE_FATStream *stream)
+{
+    NE_AssertPointer(stream, "NULL stream pointer");
+
+    ne_fat_stream_close_file(stream);
+
+    if (stream->free_buffer)
+        free(stream->buffer);
+
+    stream->buffer = NULL;
+}
+
+int NE_FATArchiveOpen(const char *name, const char *path)
+{
+    NE_AssertPointer(name, "NULL name pointer");
+    NE_AssertPointer(path, "NULL path pointer");
+
+    int slot = -1;
+    for (int i = 0; i < NE_FAT_MAX_ARCHIVES; i++)
+    {
+        if (ne_archives[i] == NULL)
+        {
+            if (slot == -1)
+                slot = i;
+            continue;
+        }
+
+        if (strcmp(ne_archives[i]->name, name) == 0)
+        {
+            NE_DebugPrint("Archive %s is already open", name);
+            return 0;
+        }
+    }
+
+    if (slot == -1)
+    {
+        NE_DebugPrint("No free slots");
+        return 0;
+    }
+
+    ne_archive_t *archive = calloc(1, sizeof(ne_archive_t));
+    if (archive == NULL)
+    {
+        NE_DebugPrint("Not enough memory");
+        return 0;
+    }
+
+    archive->name = strdup(name);
+    if (archive->name == NULL)
+    {
+        NE_DebugPrint("Not enough memory");
+        goto cleanup;
+    }
+
+    archive->file = fopen(path, "rb");
+    if (archive->file == NULL)
+    {
+        NE_DebugPrint("%s couldn't be opened", path);
+        goto cleanup;
+    }
+
+    NE_FATArchiveHeader header;
+    if (fread(&header, sizeof(header), 1, archive->file) != 1)
+    {
+        NE_DebugPrint("Failed to read header of %s", path);
+        goto cleanup;
+    }
+
+    if ((memcmp(header.magic, NE_FAT_ARCHIVE_MAGIC, 4) != 0) ||
+        (header.version != NE_FAT_ARCHIVE_VERSION))
+    {
+        NE_DebugPrint("%s isn't a valid archive", path);
+        goto cleanup;
+    }
+
+    // The number of buckets must be a power of two
+    if ((header.num_buckets == 0) ||
+        ((header.num_buckets & (header.num_buckets - 1)) != 0))
+    {
+        NE_DebugPrint("Invalid number of buckets in %s", path);
+        goto cleanup;
+    }
+
+    archive->num_buckets = header.num_buckets;
+    archive->names_size = header.names_size;
+
+    archive->entries = malloc(header.num_buckets * sizeof(ne_archive_entry_t));
+    archive->names = malloc(header.names_size + 1);
+    if ((archive->entries == NULL) || (archive->names == NULL))
+    {
+        NE_DebugPrint("Not enough memory");
+        goto cleanup;
+    }
+
+    if ((fread(archive->entries, sizeof(ne_archive_entry_t),
+               header.num_buckets, archive->file) != header.num_buckets) ||
+        (fread(archive->names, 1, header.names_size, archive->file) !=
+               header.names_size))
+    {
+        NE_DebugPrint("Failed to read index of %s", path);
+        goto cleanup;
+    }
+
+    // Make sure that a corrupted archive can't make lookups read out of bounds
+    archive->names[header.names_size] = '\0';
+    for (u32 i = 0; i < header.num_buckets; i++)
+    {
+        u32 offset = archive->entries[i].name_offset;
+        if ((offset != 0xFFFFFFFF) && (offset >= header.names_size))
+        {
+            NE_DebugPrint("Invalid entry in %s", path);
+            goto cleanup;
+        }
+    }
+
+    archive->position = ftell(archive->file);
+
+    ne_archives[slot] = archive;
+
+    return 1;
+
+cleanup:
+    if (archive->file != NULL)
+        fclose(archive->file);
+    free(archive->entries);
+    free(archive->names);
+    free(archive->name);
+    free(archive);
+    return 0;
+}
+
+void NE_FATArchiveClose(const char *name)
+{
+    NE_AssertPointer(name, "NULL name pointer");
+
+    for (int i = 0; i < NE_FAT_MAX_ARCHIVES; i++)
+    {
+        ne_archive_t *archive = ne_archives[i];
+        if (archive == NULL)
+            continue;
+
+        if (strcmp(archive->name, name) != 0)
+            continue;
+
+        fclose(archive->file);
+        free(archive->entries);
+        free(archive->names);
+        free(archive->name);
+        free(archive);
+
+        ne_archives[i] = NULL;
+        return;
+    }
+
+    NE_DebugPrint("Archive %s isn't open", name);
+}
+
 static void NE_write16(u16 *address, u16 value)
 {
     u8 *first = (u8 *)address;
@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2024 Antonio Niño Díaz
+//
+// This file is part of Nitro Engine
+
+#ifndef NE_GFX_H__
+#define NE_GFX_H__
+
+#include <nds.h>
+
+// Internal helpers to send commands to the GPU. Commands written with NE_GFX()
+// are saved to the active display list builder instead of being sent to the GPU
+// while a display list is being recorded. If a display list is being sent to
+// the GPU asynchronously, NE_GFX() waits until it has been sent so that the
+// commands aren't mixed with the commands of the display list. See
+// NEDisplayList.c
+
+extern bool __NE_DisplayListRecording;
+
+// Bits of __NE_GFXRedirect. Both cases are checked with a single flag so that
+// the common case (no recording and no asynchronous transfers) is fast.
+#define NE_GFX_REDIRECT_RECORDING   BIT(0)
+#define NE_GFX_REDIRECT_ASYNC       BIT(1)
+
+extern volatile u32 __NE_GFXRedirect;
+
+vu32 *__NE_DisplayListBuilderPort(vu32 *reg);
+vu32 *__NE_DisplayListRedirect(vu32 *reg);
+
+#define NE_GFX(reg) \
+    (*(__NE_GFXRedirect ? __NE_DisplayListRedirect(&(reg)) : &(reg)))
+
+// Registers with a copy in the state cache. Writes with NE_GFX_STATE() are
+// skipped if the register already has the same value. GFX_COLOR isn't cached
+// because it's also modified by NORMAL commands, display lists, etc. See
+// NERenderQueue.c
+
+typedef enum {
+    NE_STATE_POLY_FORMAT,
+    NE_STATE_TEX_FORMAT,
+    NE_STATE_PAL_FORMAT,
+    NE_STATE_DIFFUSE_AMBIENT,
+    NE_STATE_SPECULAR_EMISSION,
+
+    NE_STATE_NUM
+} ne_gfx_state_t;
+
+#define NE_STATE_ALL    ((1 << NE_STATE_NUM) - 1)
+
+extern u32 __NE_GFXState[NE_STATE_NUM];
+extern u32 __NE_GFXStateValid;
+extern u32 __NE_GFXStateWrites;
+extern u32 __NE_GFXStateSkipped;
+
+static inline void ne_gfx_state_write(ne_gfx_state_t state, vu32 *reg,
+                                      u32 value)
+{
+    if (__NE_GFXRedirect)
+    {
+        // Display lists have to include all commands because the state of the
+        // GPU when they are drawn isn't known. Recording them doesn't change
+        // the state. If nothing is being recorded, this waits for asynchronous
+        // transfers to end.
+        vu32 *port = __NE_DisplayListRedirect(reg);
+        if (__NE_DisplayListRecording)
+        {
+            *port = value;
+            return;
+        }
+    }
+
+    if ((__NE_GFXStateValid & BIT(state)) && (__NE_GFXState[state] == value))
+    {
+        __NE_GFXStateSkipped++;
+        return;
+    }
+
+    *reg = value;
+
+    __NE_GFXState[state] = value;
+    __NE_GFXStateValid |= BIT(state);
+    __NE_GFXStateWrites++;
+}
+
+#define NE_GFX_STATE(state, reg, value) \
+    ne_gfx_state_write(state, &(reg), value)
+
+// Forget the values of some registers of the state cache. This has to be done
+// after they are modified without NE_GFX_STATE().
+static inline void ne_gfx_state_invalidate(u32 mask)
+{
+    __NE_GFXStateValid &= ~mask;
+}
+
+// Versions of glRotateXi(), glRotateYi() and glRotateZi() of libnds that can be
+// recorded.
+
+static inline void ne_gfx_rotate_x(int angle)
+{
+    int32_t sine = sinLerp(angle);
+    int32_t cosine = cosLerp(angle);
+
+    NE_GFX(MATRIX_MULT3x3) = inttof32(1);
+    NE_GFX(MATRIX_MULT3x3) = 0;
+    NE_GFX(MATRIX_MULT3x3) = 0;
+
+    NE_GFX(MATRIX_MULT3x3) = 0;
+    NE_GFX(MATRIX_MULT3x3) = cosine;
+    NE_GFX(MATRIX_MULT3x3) = sine;
+
+    NE_GFX(MATRIX_MULT3x3) = 0;
+    NE_GFX(MATRIX_MULT3x3) = -sine;
+    NE_GFX(MATRIX_MULT3x3) = cosine;
+}
+
+static inline void ne_gfx_rotate_y(int angle)
+{
+    int32_t sine = sinLerp(angle);
+    int32_t cosine = cosLerp(angle);
+
+    NE_GFX(MATRIX_MULT3x3) = cosine;
+    NE_GFX(MATRIX_MULT3x3) = 0;
+    NE_GFX(MATRIX_MULT3x3) = -sine;
+
+    NE_GFX(MATRIX_MULT3x3) = 0;
+    NE_GFX(MATRIX_MULT3x3) = inttof32(1);
+    NE_GFX(MATRIX_MULT3x3) = 0;
+
+    NE_GFX(MATRIX_MULT3x3) = sine;
+    NE_GFX(MATRIX_MULT3x3) = 0;
+    NE_GFX(MATRIX_MULT3x3) = cosine;
+}
+
+static inline void ne_gfx_rotate_z(int angle)
+{
+    int32_t sine = sinLerp(angle);
+    int32_t cosine = cosLerp(angle);
+
+    NE_GFX(MATRIX_MULT3x3) = cosine;
+    NE_GFX(MATRIX_MULT3x3) = sine;
+    NE_GFX(MATRIX_MULT3x3) = 0;
+
+    NE_GFX(MATRIX_MULT3x3) = -sine;
+    NE_GFX(MATRIX_MULT3x3) = cosine;
+    NE_GFX(MATRIX_MULT3x3) = 0;
+
+    NE_GFX(MATRIX_MULT3x3) = 0;
+    NE_GFX(MATRIX_MULT3x3) = 0;
+    NE_GFX(MATRIX_MULT3x3) = inttof32(1);
+}
+
+#endif // NE_GFX_H__
@@ -5,6 +5,7 @@
 // This file is part of Nitro Engine
 
 #include "NEMain.h"
+#include "NEGFX.h"
 
 /// @file NEGUI.c
 
@@ -350,16 +351,18 @@ static void NE_GUIDrawButton(NE_GUIObj *obj, int priority)
     if (button->event > 0)
     {
         // Pressed
-        GFX_POLY_FORMAT = POLY_ALPHA(button->alpha2)
-                        | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE;
+        NE_GFX_STATE(NE_STATE_POLY_FORMAT, GFX_POLY_FORMAT,
+                     POLY_ALPHA(button->alpha2)
+                     | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE);
         tex = button->tex_2;
         color = button->color2;
     }
     else
     {
         // Not-pressed
-        GFX_POLY_FORMAT = POLY_ALPHA(button->alpha1)
-                        | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE;
+        NE_GFX_STATE(NE_STATE_POLY_FORMAT, GFX_POLY_FORMAT,
+                     POLY_ALPHA(button->alpha1)
+                     | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE);
         tex = button->tex_1;
         color = button->color1;
     }
@@ -383,14 +386,16 @@ static void NE_GUIDrawCheckBox(NE_GUIObj *obj, int priority)
 
     if (chbox->event > 0)
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(chbox->alpha2)
-                        | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE;
+        NE_GFX_STATE(NE_STATE_POLY_FORMAT, GFX_POLY_FORMAT,
+                     POLY_ALPHA(chbox->alpha2)
+                     | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE);
         color = chbox->color2;
     }
     else
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(chbox->alpha1)
-                        | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE;
+        NE_GFX_STATE(NE_STATE_POLY_FORMAT, GFX_POLY_FORMAT,
+                     POLY_ALPHA(chbox->alpha1)
+                     | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE);
         color = chbox->color1;
     }
 
@@ -415,14 +420,16 @@ static void NE_GUIDrawRadioButton(NE_GUIObj *obj, int priority)
 
     if (rabtn->event > 0)
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(rabtn->alpha2)
-                        | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE;
+        NE_GFX_STATE(NE_STATE_POLY_FORMAT, GFX_POLY_FORMAT,
+                     POLY_ALPHA(rabtn->alpha2)
+                     | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE);
         color = rabtn->color2;
     }
     else
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(rabtn->alpha1)
-                        | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE;
+        NE_GFX_STATE(NE_STATE_POLY_FORMAT, GFX_POLY_FORMAT,
+                     POLY_ALPHA(rabtn->alpha1)
+                     | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE);
         color = rabtn->color1;
     }
 
@@ -469,14 +476,16 @@ static void NE_GUIDrawSlideBar(NE_GUIObj *obj, int priority)
 
     if (sldbar->event_plus > 0)
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(sldbar->alpha2)
-                        | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE;
+        NE_GFX_STATE(NE_STATE_POLY_FORMAT, GFX_POLY_FORMAT,
+                     POLY_ALPHA(sldbar->alpha2)
+                     | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE);
         color = sldbar->color2;
     }
     else
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(sldbar->alpha1)
-                        | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE;
+        NE_GFX_STATE(NE_STATE_POLY_FORMAT, GFX_POLY_FORMAT,
+                     POLY_ALPHA(sldbar->alpha1)
+                     | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE);
         color = sldbar->color1;
     }
 
@@ -500,14 +509,16 @@ static void NE_GUIDrawSlideBar(NE_GUIObj *obj, int priority)
 
     if (sldbar->event_minus > 0)
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(sldbar->alpha2)
-                        | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE;
+        NE_GFX_STATE(NE_STATE_POLY_FORMAT, GFX_POLY_FORMAT,
+                     POLY_ALPHA(sldbar->alpha2)
+                     | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE);
         color = sldbar->color2;
     }
     else
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(sldbar->alpha1)
-                        | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE;
+        NE_GFX_STATE(NE_STATE_POLY_FORMAT, GFX_POLY_FORMAT,
+                     POLY_ALPHA(sldbar->alpha1)
+                     | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE);
         color = sldbar->color1;
     }
 
@@ -534,14 +545,16 @@ static void NE_GUIDrawSlideBar(NE_GUIObj *obj, int priority)
 
     if (sldbar->event_bar > 0)
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(sldbar->alpha2)
-                        | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE;
+        NE_GFX_STATE(NE_STATE_POLY_FORMAT, GFX_POLY_FORMAT,
+                     POLY_ALPHA(sldbar->alpha2)
+                     | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE);
         color = sldbar->color2;
     }
     else
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(sldbar->alpha1)
-                        | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE;
+        NE_GFX_STATE(NE_STATE_POLY_FORMAT, GFX_POLY_FORMAT,
+                     POLY_ALPHA(sldbar->alpha1)
+                     | POLY_ID(NE_GUI_POLY_ID) | NE_CULL_NONE);
         color = sldbar->color1;
     }
 
@@ -582,8 +595,9 @@ static void NE_GUIDrawSlideBar(NE_GUIObj *obj, int priority)
     // Load texture and color of the slide bar background
     tex = sldbar->texlong;
     color = sldbar->barcolor;
-    GFX_POLY_FORMAT = POLY_ALPHA(sldbar->baralpha)
-                    | POLY_ID(NE_GUI_POLY_ID_ALT) | NE_CULL_NONE;
+    NE_GFX_STATE(NE_STATE_POLY_FORMAT, GFX_POLY_FORMAT,
+                 POLY_ALPHA(sldbar->baralpha)
+                 | POLY_ID(NE_GUI_POLY_ID_ALT) | NE_CULL_NONE);
 
     // Now we need to use `priority + 1` as priority. The bar button must
     // be in front of bar. `priority + 1` is less priority than `priority`.
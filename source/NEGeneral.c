@@ -121,6 +121,7 @@ void NE_End(void)
     vramSetBankE(VRAM_E_LCD); // Palettes
 
     NE_GUISystemEnd();
+    NE_RenderQueueEnd();
     NE_SpriteSystemEnd();
     NE_PhysicsSystemEnd();
     NE_ModelSystemEnd();
@@ -143,6 +144,9 @@ void NE_Viewport(int x1, int y1, int x2, int y2)
     // Start calculating screen ratio in f32 format
     ne_div_start((x2 - x1 + 1) << 12, (y2 - y1 + 1));
 
+    // Display lists sent asynchronously may still be using the GPU FIFO
+    NE_DisplayListWait();
+
     // Save viewport
     NE_viewport = x1 | (y1 << 8) | (x2 << 16) | (y2 << 24);
     GFX_VIEWPORT = NE_viewport;
@@ -185,6 +189,7 @@ void NE_SetFov(int fovValue)
 static void ne_systems_end_all(void)
 {
     NE_GUISystemEnd();
+    NE_RenderQueueEnd();
     NE_SpriteSystemEnd();
     NE_PhysicsSystemEnd();
     NE_ModelSystemEnd();
@@ -222,6 +227,9 @@ cleanup:
     return -1;
 }
 
+// Internal use. See NEPolygon.c
+void __NE_PolyFormatSet(u32 format);
+
 static void ne_init_registers(void)
 {
     // This function is usually called when the program boots. We don't know
@@ -282,7 +290,7 @@ static void ne_init_registers(void)
         NE_LightOff(i);
 
     GFX_COLOR = 0;
-    GFX_POLY_FORMAT = 0;
+    __NE_PolyFormatSet(0);
 
     for (int i = 0; i < 8; i++)
         NE_OutliningSetColor(i, 0);
@@ -607,9 +615,35 @@ void NE_SetConsoleColor(u32 color)
     BG_PALETTE[255] = color;
 }
 
+// Internal use. See NETexture.c
+void __NE_TextureCacheNewFrame(void);
+
+// Internal use. See NEModel.c
+void __NE_ModelCullingNewFrame(void);
+void __NE_ModelLodEndFrame(void);
+
+// Internal use. See NECamera.c
+void __NE_CameraNewFrame(void);
+
+// Internal use. See NERenderQueue.c
+void __NE_RenderQueueNewFrame(void);
+
+// Internal use. See NECamera.c
+void __NE_ProjectionGet(int32_t *projection)
+{
+    projection[0] = fov * DEGREES_IN_CIRCLE / 360;
+    projection[1] = NE_screenratio;
+    projection[2] = ne_znear;
+    projection[3] = ne_zfar;
+}
+
 static void ne_process_common(void)
 {
     NE_UpdateInput();
+    __NE_TextureCacheNewFrame();
+    __NE_ModelCullingNewFrame();
+    __NE_CameraNewFrame();
+    __NE_RenderQueueNewFrame();
 
     if (ne_main_screen == 1)
         lcdMainOnTop();
@@ -636,6 +670,11 @@ void NE_Process(NE_Voidfunc drawscene)
     NE_AssertPointer(drawscene, "NULL function pointer");
     drawscene();
 
+    // Display lists sent asynchronously must reach the GPU before the flush
+    NE_DisplayListWait();
+
+    __NE_ModelLodEndFrame();
+
     GFX_FLUSH = GL_TRANS_MANUALSORT | ne_depth_buffering_mode;
 }
 
@@ -646,12 +685,21 @@ void NE_ProcessArg(NE_VoidArgfunc drawscene, void *arg)
     NE_AssertPointer(drawscene, "NULL function pointer");
     drawscene(arg);
 
+    // Display lists sent asynchronously must reach the GPU before the flush
+    NE_DisplayListWait();
+
+    __NE_ModelLodEndFrame();
+
     GFX_FLUSH = GL_TRANS_MANUALSORT | ne_depth_buffering_mode;
 }
 
 static void ne_process_dual_3d_common_start(void)
 {
     NE_UpdateInput();
+    __NE_TextureCacheNewFrame();
+    __NE_ModelCullingNewFrame();
+    __NE_CameraNewFrame();
+    __NE_RenderQueueNewFrame();
 
     if (NE_Screen == ne_main_screen)
         lcdMainOnTop();
@@ -702,6 +750,11 @@ static void ne_process_dual_3d_common_start(void)
 
 static void ne_process_dual_3d_common_end(void)
 {
+    // Display lists sent asynchronously must reach the GPU before the flush
+    NE_DisplayListWait();
+
+    __NE_ModelLodEndFrame();
+
     GFX_FLUSH = GL_TRANS_MANUALSORT | ne_depth_buffering_mode;
 
     NE_Screen ^= 1;
@@ -738,6 +791,10 @@ static void ne_process_dual_3d_arg(NE_VoidArgfunc mainscreen,
 static void ne_process_dual_3d_fb_common_start(void)
 {
     NE_UpdateInput();
+    __NE_TextureCacheNewFrame();
+    __NE_ModelCullingNewFrame();
+    __NE_CameraNewFrame();
+    __NE_RenderQueueNewFrame();
 
     if (NE_Screen == ne_main_screen)
         lcdMainOnTop();
@@ -782,6 +839,11 @@ static void ne_process_dual_3d_fb_common_start(void)
 
 static void ne_process_dual_3d_fb_common_end(void)
 {
+    // Display lists sent asynchronously must reach the GPU before the flush
+    NE_DisplayListWait();
+
+    __NE_ModelLodEndFrame();
+
     GFX_FLUSH = GL_TRANS_MANUALSORT | ne_depth_buffering_mode;
 
     NE_Screen ^= 1;
@@ -833,6 +895,11 @@ static void ne_do_dma(void)
 
 static void ne_process_dual_3d_dma_common_start(void)
 {
+    __NE_TextureCacheNewFrame();
+    __NE_ModelCullingNewFrame();
+    __NE_CameraNewFrame();
+    __NE_RenderQueueNewFrame();
+
     if (NE_Screen == ne_main_screen)
         lcdMainOnBottom();
     else
@@ -951,6 +1018,11 @@ static void ne_process_dual_3d_dma_common_start(void)
 
 static void ne_process_dual_3d_dma_common_end(void)
 {
+    // Display lists sent asynchronously must reach the GPU before the flush
+    NE_DisplayListWait();
+
+    __NE_ModelLodEndFrame();
+
     GFX_FLUSH = GL_TRANS_MANUALSORT | ne_depth_buffering_mode;
 
     NE_Screen ^= 1;
@@ -1111,6 +1183,8 @@ void NE_VBLFunc(void)
         if (!NE_effectpause)
             NE_lastvbladd = (NE_lastvbladd + 1) & (NE_NOISEPAUSE_SIZE - 1);
     }
+
+    NE_TextureUploadUpdate();
 }
 
 void NE_SpecialEffectPause(bool pause)
@@ -1273,6 +1347,9 @@ static int ne_vertexcount;
 
 void NE_TouchTestStart(void)
 {
+    // Display lists sent asynchronously may still be using the GPU FIFO
+    NE_DisplayListWait();
+
     // Hide what we are going to draw
     GFX_VIEWPORT = 255 | (255 << 8) | (255 << 16) | (255 << 24);
 
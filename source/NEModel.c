@@ -4,25 +4,394 @@
 //
 // This file is part of Nitro Engine
 
+#include <nds/arm9/boxtest.h>
 #include <nds/arm9/postest.h>
 
 #include "dsma/dsma.h"
 
 #include "NEMain.h"
+#include "NEGFX.h"
 
 /// @file NEModel.c
 
+// Internal use. See NEAsset.c
+void *__NE_AssetCacheLoad(NE_AssetType type, const char *path);
+void __NE_AssetCacheFree(void *data);
+
+// Internal use. See NEPolygon.c
+u32 __NE_PolyFormatGet(void);
+
+// Internal use. See NECamera.c
+NE_Camera *__NE_CameraGetActive(void);
+
+// Internal use. See NEDisplayList.c
+void __NE_DisplayListMatrixPop(void);
+
+// Number of matrices of the matrix stack that can be used with MTX_RESTORE
+#define NE_MESH_MATRICES 31
+
 typedef struct {
     void *address;
     int uses; // Number of models that use this mesh
     bool has_to_free;
+    // Bounding box of the vertices drawn with the matrix of the model
+    bool has_box;
+    int32_t box[6];
+    // Animated meshes only. Radius of the sphere centered at the origin that
+    // contains all the vertices drawn with each matrix of the stack. It's
+    // negative for matrices that aren't used. It's NULL if the bounds of the
+    // mesh couldn't be calculated.
+    int32_t *joint_radius;
 } ne_mesh_info_t;
 
+// Format of the header of DSA files. See dsma.c
+typedef struct {
+    uint32_t version;
+    uint32_t num_frames;
+    uint32_t num_joints;
+    struct {
+        int32_t pos[3];
+        int32_t orient[4];
+    } joints[];
+} ne_dsa_t;
+
 static ne_mesh_info_t *NE_Mesh = NULL;
 static NE_Model **NE_ModelPointers;
 static int NE_MAX_MODELS;
 static bool ne_model_system_inited = false;
 
+// The LOD budget is disabled if both values are 0
+static int ne_model_lod_budget_polygons = 0;
+static int ne_model_lod_budget_vertices = 0;
+static int32_t ne_model_lod_bias = inttof32(1);
+
+#define NE_MODEL_LOD_MAX_BIAS inttof32(16)
+
+static NE_ModelCullingMode ne_model_culling_mode = NE_MODEL_CULLING_NONE;
+static NE_ModelCullingStats ne_model_culling_stats;
+static NE_ModelCullingStats ne_model_culling_stats_last;
+
+typedef struct {
+    bool valid;
+    bool animated;
+    int matrix; // Matrix selected with MTX_RESTORE, or -1 for the model matrix
+    int32_t vtx[3]; // Coordinates of the last vertex
+    bool has_vertices;
+    int32_t min[3];
+    int32_t max[3];
+    int64_t radius2[NE_MESH_MATRICES];
+} ne_mesh_bounds_t;
+
+static void ne_mesh_bounds_command(u32 offset, u32 cmd, const u32 *params,
+                                   int num_params, void *arg)
+{
+    (void)offset;
+    (void)num_params;
+
+    ne_mesh_bounds_t *bounds = arg;
+    int32_t *v = bounds->vtx;
+    u32 p = params[0];
+
+    switch (cmd)
+    {
+        case 0x14: // MTX_RESTORE
+            // Animated meshes use it to select the matrix of each joint. In
+            // static meshes it loads a matrix that can't be known in advance.
+            if (bounds->animated)
+                bounds->matrix = p & 0x1F;
+            else
+                bounds->valid = false;
+            return;
+
+        case 0x10: // MTX_MODE
+        case 0x12: // MTX_POP
+        case 0x15: // MTX_IDENTITY
+        case 0x16: // MTX_LOAD_4x4
+        case 0x17: // MTX_LOAD_4x3
+        case 0x18: // MTX_MULT_4x4
+        case 0x19: // MTX_MULT_4x3
+        case 0x1A: // MTX_MULT_3x3
+        case 0x1B: // MTX_SCALE
+        case 0x1C: // MTX_TRANS
+            bounds->valid = false;
+            return;
+
+        case 0x23: // VTX_16
+            v[0] = (int16_t)(p & 0xFFFF);
+            v[1] = (int16_t)(p >> 16);
+            v[2] = (int16_t)(params[1] & 0xFFFF);
+            break;
+        case 0x24: // VTX_10
+            v[0] = (int32_t)(p << 22) >> 16;
+            v[1] = (int32_t)(p << 12) >> 16;
+            v[2] = (int32_t)(p << 2) >> 16;
+            break;
+        case 0x25: // VTX_XY
+            v[0] = (int16_t)(p & 0xFFFF);
+            v[1] = (int16_t)(p >> 16);
+            break;
+        case 0x26: // VTX_XZ
+            v[0] = (int16_t)(p & 0xFFFF);
+            v[2] = (int16_t)(p >> 16);
+            break;
+        case 0x27: // VTX_YZ
+            v[1] = (int16_t)(p & 0xFFFF);
+            v[2] = (int16_t)(p >> 16);
+            break;
+        case 0x28: // VTX_DIFF
+            // The differences are multiplied by 8 by the GPU
+            v[0] += (int32_t)(p << 22) >> 19;
+            v[1] += (int32_t)(p << 12) >> 19;
+            v[2] += (int32_t)(p << 2) >> 19;
+            break;
+
+        default:
+            return;
+    }
+
+    if (bounds->matrix >= 0)
+    {
+        int64_t r2 = (int64_t)v[0] * v[0] + (int64_t)v[1] * v[1]
+                   + (int64_t)v[2] * v[2];
+        if (r2 > bounds->radius2[bounds->matrix])
+            bounds->radius2[bounds->matrix] = r2;
+        return;
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (!bounds->has_vertices || v[i] < bounds->min[i])
+            bounds->min[i] = v[i];
+        if (!bounds->has_vertices || v[i] > bounds->max[i])
+            bounds->max[i] = v[i];
+    }
+    bounds->has_vertices = true;
+}
+
+static void ne_mesh_calculate_bounds(ne_mesh_info_t *mesh, bool animated)
+{
+    mesh->has_box = false;
+    mesh->joint_radius = NULL;
+
+    ne_mesh_bounds_t bounds = { 0 };
+    bounds.valid = true;
+    bounds.animated = animated;
+    bounds.matrix = -1;
+    for (int i = 0; i < NE_MESH_MATRICES; i++)
+        bounds.radius2[i] = -1;
+
+    NE_DisplayListError ret = NE_DisplayListDecode(mesh->address, 0,
+                                                   ne_mesh_bounds_command,
+                                                   &bounds, NULL);
+    if ((ret != NE_DL_VALID) || !bounds.valid)
+    {
+        NE_DebugPrint("Can't calculate the bounds of the mesh");
+        return;
+    }
+
+    if (bounds.has_vertices)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            mesh->box[i] = bounds.min[i];
+            mesh->box[i + 3] = bounds.max[i] - bounds.min[i];
+        }
+        mesh->has_box = true;
+    }
+
+    if (!animated)
+        return;
+
+    mesh->joint_radius = malloc(NE_MESH_MATRICES * sizeof(int32_t));
+    if (mesh->joint_radius == NULL)
+    {
+        NE_DebugPrint("Not enough memory");
+        return;
+    }
+
+    for (int i = 0; i < NE_MESH_MATRICES; i++)
+    {
+        if (bounds.radius2[i] < 0)
+            mesh->joint_radius[i] = -1;
+        else // Round up to make sure that the sphere contains all vertices
+            mesh->joint_radius[i] = sqrt64(bounds.radius2[i]) + 1;
+    }
+}
+
+// The bounding box of animated models contains the bounding spheres of all
+// joints in all frames of the animations of the model. The matrices built by
+// DSMA never make a vector longer, so the spheres contain the vertices in any
+// orientation of the joints.
+static void ne_model_update_box(NE_Model *model)
+{
+    model->has_box = false;
+
+    if (model->meshindex == NE_NO_MESH)
+        return;
+
+    const ne_mesh_info_t *mesh = &NE_Mesh[model->meshindex];
+
+    int32_t min[3], max[3];
+    bool has_box = mesh->has_box;
+
+    if (has_box)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            min[i] = mesh->box[i];
+            max[i] = mesh->box[i] + mesh->box[i + 3];
+        }
+    }
+
+    if (model->modeltype == NE_Animated)
+    {
+        if (mesh->joint_radius == NULL)
+            return;
+
+        for (int a = 0; a < 2; a++)
+        {
+            const NE_Animation *anim = model->animinfo[a]->animation;
+            if (anim == NULL)
+                continue;
+
+            const ne_dsa_t *dsa = anim->data;
+            if ((dsa->version != 1) || (dsa->num_joints > NE_MESH_MATRICES))
+                return;
+
+            // Vertices drawn with matrices that aren't joints of this
+            // animation can be anywhere.
+            int base = NE_MESH_MATRICES - dsa->num_joints;
+            for (int m = 0; m < base; m++)
+            {
+                if (mesh->joint_radius[m] >= 0)
+                    return;
+            }
+
+            for (uint32_t f = 0; f < dsa->num_frames; f++)
+            {
+                for (uint32_t j = 0; j < dsa->num_joints; j++)
+                {
+                    int32_t r = mesh->joint_radius[base + j];
+                    if (r < 0)
+                        continue;
+
+                    const int32_t *pos =
+                            dsa->joints[f * dsa->num_joints + j].pos;
+
+                    for (int i = 0; i < 3; i++)
+                    {
+                        if (!has_box || pos[i] - r < min[i])
+                            min[i] = pos[i] - r;
+                        if (!has_box || pos[i] + r > max[i])
+                            max[i] = pos[i] + r;
+                    }
+                    has_box = true;
+                }
+            }
+        }
+    }
+
+    if (!has_box)
+        return;
+
+    int64_t diagonal2 = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        int32_t size = max[i] - min[i];
+
+        model->box[i] = min[i];
+        model->box[i + 3] = size;
+
+        model->sphere[i] = min[i] + (size >> 1);
+        diagonal2 += (int64_t)size * size;
+    }
+
+    model->sphere[3] = (sqrt64(diagonal2) >> 1) + 1;
+    model->has_box = true;
+}
+
+// Transforms a bounding sphere by a 4x3 matrix
+ARM_CODE static void ne_matrix_transform_sphere(const m4x3 *mat,
+                                                const int32_t *local,
+                                                int32_t *sphere)
+{
+    const int32_t *m = mat->m;
+
+    for (int i = 0; i < 3; i++)
+    {
+        sphere[i] = m[9 + i] + mulf32(local[0], m[i])
+                  + mulf32(local[1], m[3 + i])
+                  + mulf32(local[2], m[6 + i]);
+    }
+
+    // The biggest scale that the matrix can apply to a vector is smaller or
+    // equal than sqrt(max_row_sum * max_column_sum), using the sums of the
+    // absolute values of the elements.
+    int32_t max_row = 0, max_column = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        int32_t row = abs(m[i * 3]) + abs(m[i * 3 + 1]) + abs(m[i * 3 + 2]);
+        int32_t column = abs(m[i]) + abs(m[i + 3]) + abs(m[i + 6]);
+        if (row > max_row)
+            max_row = row;
+        if (column > max_column)
+            max_column = column;
+    }
+    int32_t norm = sqrt64((int64_t)max_row * max_column) + 1;
+
+    sphere[3] = mulf32(local[3], norm) + 1;
+}
+
+// Calculates the bounding sphere of a model in world coordinates
+ARM_CODE static void ne_model_world_sphere(const NE_Model *model,
+                                           int32_t *sphere)
+{
+    const int32_t *local = model->sphere;
+
+    if (model->mat != NULL)
+    {
+        ne_matrix_transform_sphere(model->mat, local, sphere);
+        return;
+    }
+
+    int32_t scale = abs(model->sx);
+    if (abs(model->sy) > scale)
+        scale = abs(model->sy);
+    if (abs(model->sz) > scale)
+        scale = abs(model->sz);
+
+    if ((model->rx | model->ry | model->rz) == 0)
+    {
+        sphere[0] = model->x + mulf32(local[0], model->sx);
+        sphere[1] = model->y + mulf32(local[1], model->sy);
+        sphere[2] = model->z + mulf32(local[2], model->sz);
+        sphere[3] = mulf32(local[3], scale) + 1;
+        return;
+    }
+
+    // Rotations move the center of the sphere around the origin of the model.
+    // Use a sphere centered at the origin that contains all possible spheres.
+    int64_t center2 = (int64_t)local[0] * local[0]
+                    + (int64_t)local[1] * local[1]
+                    + (int64_t)local[2] * local[2];
+
+    sphere[0] = model->x;
+    sphere[1] = model->y;
+    sphere[2] = model->z;
+    sphere[3] = mulf32(local[3] + sqrt64(center2) + 1, scale) + 1;
+}
+
+// Returns true if the model may be visible from the camera
+static bool ne_model_sphere_test(const NE_Model *model, NE_Camera *cam)
+{
+    int32_t sphere[4];
+    ne_model_world_sphere(model, sphere);
+
+    return NE_CameraSphereIsVisibleI(cam, sphere[0], sphere[1], sphere[2],
+                                     sphere[3]);
+}
+
 static void ne_mesh_delete(int mesh_index)
 {
     int slot = mesh_index;
@@ -33,8 +402,13 @@ static void ne_mesh_delete(int mesh_index)
     // If the number of users is zero, delete it.
     if (NE_Mesh[slot].uses == 0)
     {
+        // Meshes loaded from the filesystem may be shared with other mesh
+        // slots by the asset cache.
         if (NE_Mesh[slot].has_to_free)
-            free(NE_Mesh[slot].address);
+            __NE_AssetCacheFree(NE_Mesh[slot].address);
+
+        free(NE_Mesh[slot].joint_radius);
+        NE_Mesh[slot].joint_radius = NULL;
 
         NE_Mesh[slot].address = NULL;
     }
@@ -53,6 +427,46 @@ static int ne_model_get_free_mesh_slot(void)
     return NE_NO_MESH;
 }
 
+// Returns the new mesh slot, or NE_NO_MESH on error
+static int ne_mesh_load_ram(const void *pointer)
+{
+    int slot = ne_model_get_free_mesh_slot();
+    if (slot == NE_NO_MESH)
+        return NE_NO_MESH;
+
+    ne_mesh_info_t *mesh = &NE_Mesh[slot];
+
+    mesh->address = (void *)pointer;
+    mesh->has_to_free = false;
+    mesh->uses = 1;
+    mesh->has_box = false;
+    mesh->joint_radius = NULL;
+
+    return slot;
+}
+
+// Returns the new mesh slot, or NE_NO_MESH on error
+static int ne_mesh_load_filesystem(const char *path)
+{
+    int slot = ne_model_get_free_mesh_slot();
+    if (slot == NE_NO_MESH)
+        return NE_NO_MESH;
+
+    void *pointer = __NE_AssetCacheLoad(NE_ASSET_MESH, path);
+    if (pointer == NULL)
+        return NE_NO_MESH;
+
+    ne_mesh_info_t *mesh = &NE_Mesh[slot];
+
+    mesh->address = pointer;
+    mesh->has_to_free = true;
+    mesh->uses = 1;
+    mesh->has_box = false;
+    mesh->joint_radius = NULL;
+
+    return slot;
+}
+
 static int ne_model_load_ram_common(NE_Model *model, const void *pointer)
 {
     NE_AssertPointer(model, "NULL model pointer");
@@ -62,17 +476,14 @@ static int ne_model_load_ram_common(NE_Model *model, const void *pointer)
     if (model->meshindex != NE_NO_MESH)
         ne_mesh_delete(model->meshindex);
 
-    int slot = ne_model_get_free_mesh_slot();
+    int slot = ne_mesh_load_ram(pointer);
     if (slot == NE_NO_MESH)
         return 0;
 
     model->meshindex = slot;
 
-    ne_mesh_info_t *mesh = &NE_Mesh[slot];
-
-    mesh->address = (void *)pointer;
-    mesh->has_to_free = false;
-    mesh->uses = 1;
+    ne_mesh_calculate_bounds(&NE_Mesh[slot], model->modeltype == NE_Animated);
+    ne_model_update_box(model);
 
     return 1;
 }
@@ -86,25 +497,50 @@ static int ne_model_load_filesystem_common(NE_Model *model, const char *path)
     if (model->meshindex != NE_NO_MESH)
         ne_mesh_delete(model->meshindex);
 
-    int slot = ne_model_get_free_mesh_slot();
+    int slot = ne_mesh_load_filesystem(path);
     if (slot == NE_NO_MESH)
         return 0;
 
-    void *pointer = NE_FATLoadData(path);
-    if (pointer == NULL)
-        return 0;
-
     model->meshindex = slot;
 
-    ne_mesh_info_t *mesh = &NE_Mesh[slot];
+    ne_mesh_calculate_bounds(&NE_Mesh[slot], model->modeltype == NE_Animated);
+    ne_model_update_box(model);
 
-    mesh->address = pointer;
-    mesh->has_to_free = true;
-    mesh->uses = 1;
+    return 1;
+}
+
+// Levels of detail are meshes that are used instead of the main mesh of the
+// model when the model is far from the camera. They don't affect the bounds.
+static int ne_model_lod_add_common(NE_Model *model, int slot, int32_t distance)
+{
+    if (slot == NE_NO_MESH)
+        return 0;
+
+    model->lod_meshindex[model->num_lods] = slot;
+    model->lod_distance[model->num_lods] = distance;
+    model->num_lods++;
 
     return 1;
 }
 
+static bool ne_model_lod_can_add(NE_Model *model, int32_t distance)
+{
+    if (model->num_lods == NE_MODEL_MAX_LODS)
+    {
+        NE_DebugPrint("Too many levels of detail");
+        return false;
+    }
+
+    if ((model->num_lods > 0) &&
+        (distance <= model->lod_distance[model->num_lods - 1]))
+    {
+        NE_DebugPrint("Distances must be added in increasing order");
+        return false;
+    }
+
+    return true;
+}
+
 //--------------------------------------------------------------------------
 
 NE_Model *NE_ModelCreate(NE_ModelType type)
@@ -140,6 +576,7 @@ NE_Model *NE_ModelCreate(NE_ModelType type)
     }
 
     model->sx = model->sy = model->sz = inttof32(1);
+    model->transform_dirty = true;
 
     model->mat = NULL;
 
@@ -195,6 +632,8 @@ void NE_ModelDelete(NE_Model *model)
     if (model->meshindex != NE_NO_MESH)
         ne_mesh_delete(model->meshindex);
 
+    NE_ModelLodClear(model);
+
     free(model);
 }
 
@@ -218,6 +657,39 @@ int NE_ModelLoadStaticMesh(NE_Model *model, const void *pointer)
     return ne_model_load_ram_common(model, pointer);
 }
 
+int NE_ModelLodAdd(NE_Model *model, const void *pointer, int32_t distance)
+{
+    NE_AssertPointer(model, "NULL model pointer");
+    NE_AssertPointer(pointer, "NULL data pointer");
+
+    if (!ne_model_lod_can_add(model, distance))
+        return 0;
+
+    return ne_model_lod_add_common(model, ne_mesh_load_ram(pointer), distance);
+}
+
+int NE_ModelLodAddFAT(NE_Model *model, const char *path, int32_t distance)
+{
+    NE_AssertPointer(model, "NULL model pointer");
+    NE_AssertPointer(path, "NULL path pointer");
+
+    if (!ne_model_lod_can_add(model, distance))
+        return 0;
+
+    return ne_model_lod_add_common(model, ne_mesh_load_filesystem(path),
+                                   distance);
+}
+
+void NE_ModelLodClear(NE_Model *model)
+{
+    NE_AssertPointer(model, "NULL model pointer");
+
+    for (int i = 0; i < model->num_lods; i++)
+        ne_mesh_delete(model->lod_meshindex[i]);
+
+    model->num_lods = 0;
+}
+
 void NE_ModelFreeMeshWhenDeleted(NE_Model *model)
 {
     NE_AssertPointer(model, "NULL model pointer");
@@ -243,6 +715,7 @@ void NE_ModelSetAnimation(NE_Model *model, NE_Animation *anim)
     model->animinfo[0]->animation = anim;
     uint32_t frames = DSMA_GetNumFrames(anim->data);
     model->animinfo[0]->numframes = frames;
+    ne_model_update_box(model);
 }
 
 void NE_ModelSetAnimationSecondary(NE_Model *model, NE_Animation *anim)
@@ -253,6 +726,7 @@ void NE_ModelSetAnimationSecondary(NE_Model *model, NE_Animation *anim)
     model->animinfo[1]->animation = anim;
     uint32_t frames = DSMA_GetNumFrames(anim->data);
     model->animinfo[1]->numframes = frames;
+    ne_model_update_box(model);
 }
 
 //---------------------------------------------------------
@@ -260,6 +734,191 @@ void NE_ModelSetAnimationSecondary(NE_Model *model, NE_Animation *anim)
 // Internal use... see below
 extern bool NE_TestTouch;
 
+// The matrix of the model must be the current matrix. This function can only
+// be called if there aren't any display lists being sent to the GPU.
+static bool ne_model_box_test(const int32_t *box)
+{
+    // The box test only accepts 16-bit values. Scale down big boxes and scale
+    // up the matrix so that the result is the same. The scaled box is rounded
+    // so that it contains the original box.
+    int shift = 0;
+    int32_t b[6];
+    while (1)
+    {
+        bool fits = true;
+        for (int i = 0; i < 3; i++)
+        {
+            int32_t round = (1 << shift) - 1;
+            int32_t end = (box[i] + box[i + 3] + round) >> shift;
+            b[i] = box[i] >> shift;
+            b[i + 3] = end - b[i];
+            if ((b[i] < INT16_MIN) || (end > INT16_MAX) ||
+                (b[i + 3] > INT16_MAX))
+                fits = false;
+        }
+        if (fits)
+            break;
+        shift++;
+    }
+
+    if (shift > 0)
+    {
+        MATRIX_PUSH = 0;
+        MATRIX_SCALE = inttof32(1) << shift;
+        MATRIX_SCALE = inttof32(1) << shift;
+        MATRIX_SCALE = inttof32(1) << shift;
+    }
+
+    // The box test considers that boxes that cross the far plane or that are
+    // too small aren't visible unless polygons like that are rendered. The
+    // polygon attributes are applied by BEGIN_VTXS. The original attributes
+    // will be applied by the BEGIN_VTXS of the display list of the model.
+    u32 format = __NE_PolyFormatGet();
+    GFX_POLY_FORMAT = format | NE_RENDER_FAR_CLIPPED | NE_RENDER_ONE_DOT_POLYS;
+    GFX_BEGIN = GL_TRIANGLES;
+    GFX_END = 0;
+
+    int visible = BoxTest(b[0], b[1], b[2], b[3], b[4], b[5]);
+
+    GFX_POLY_FORMAT = format;
+    ne_gfx_state_invalidate(BIT(NE_STATE_POLY_FORMAT));
+
+    if (shift > 0)
+        MATRIX_POP = 1;
+
+    return visible != 0;
+}
+
+// Calculates the depth of a point in view space with the matrix of the active
+// camera. It returns false if there is no active camera.
+static bool ne_view_depth(int32_t x, int32_t y, int32_t z, int32_t *depth)
+{
+    NE_Camera *cam = __NE_CameraGetActive();
+    if (cam == NULL)
+        return false;
+
+    // The camera looks at -Z in view space
+    const int32_t *m = cam->matrix.m;
+    *depth = -(mulf32(m[2], x) + mulf32(m[6], y) + mulf32(m[10], z) + m[14]);
+
+    return true;
+}
+
+// Internal use. See NERenderQueue.c
+//
+// Calculates the depth of the origin of a model in view space with the matrix of
+// the active camera. It returns false if there is no active camera.
+bool __NE_ModelGetViewDepth(const NE_Model *model, int32_t *depth)
+{
+    if (model->mat != NULL)
+    {
+        return ne_view_depth(model->mat->m[9], model->mat->m[10],
+                             model->mat->m[11], depth);
+    }
+
+    return ne_view_depth(model->x, model->y, model->z, depth);
+}
+
+// Returns the mesh of the level of detail to be used to draw the model with its
+// origin at the provided position. The matrix of the model must be the current
+// matrix.
+static int ne_model_lod_select(const NE_Model *model, const int32_t *pos)
+{
+    if (model->num_lods == 0)
+        return model->meshindex;
+
+    int32_t depth;
+
+    if (!ne_view_depth(pos[0], pos[1], pos[2], &depth))
+    {
+        // The W coordinate of the origin of the model in clip space is the
+        // depth in view space. This needs to wait for the GPU.
+        PosTest(0, 0, 0);
+        depth = PosTestWresult();
+    }
+
+    depth = mulf32(depth, ne_model_lod_bias);
+
+    int meshindex = model->meshindex;
+
+    for (int i = 0; i < model->num_lods; i++)
+    {
+        if (depth < model->lod_distance[i])
+            break;
+
+        meshindex = model->lod_meshindex[i];
+    }
+
+    return meshindex;
+}
+
+// Calculates the transformation matrix of an instance or a model: translation,
+// rotation by X, Y and Z axes, and scale, in that order. It gives the same
+// result as sending the individual transformations to the GPU.
+ARM_CODE static void ne_model_instance_matrix(const NE_ModelInstance *instance,
+                                              m4x3 *mat)
+{
+    int32_t sin_x = sinLerp(instance->rx << 6);
+    int32_t cos_x = cosLerp(instance->rx << 6);
+    int32_t sin_y = sinLerp(instance->ry << 6);
+    int32_t cos_y = cosLerp(instance->ry << 6);
+    int32_t sin_z = sinLerp(instance->rz << 6);
+    int32_t cos_z = cosLerp(instance->rz << 6);
+
+    int32_t sin_y_sin_x = mulf32(sin_y, sin_x);
+    int32_t sin_y_cos_x = mulf32(sin_y, cos_x);
+
+    int32_t *m = mat->m;
+
+    // Scale * RotZ * RotY * RotX
+    m[0] = mulf32(instance->sx, mulf32(cos_z, cos_y));
+    m[1] = mulf32(instance->sx, mulf32(sin_z, cos_x)
+                                + mulf32(cos_z, sin_y_sin_x));
+    m[2] = mulf32(instance->sx, mulf32(sin_z, sin_x)
+                                - mulf32(cos_z, sin_y_cos_x));
+
+    m[3] = mulf32(instance->sy, -mulf32(sin_z, cos_y));
+    m[4] = mulf32(instance->sy, mulf32(cos_z, cos_x)
+                                - mulf32(sin_z, sin_y_sin_x));
+    m[5] = mulf32(instance->sy, mulf32(cos_z, sin_x)
+                                + mulf32(sin_z, sin_y_cos_x));
+
+    m[6] = mulf32(instance->sz, sin_y);
+    m[7] = mulf32(instance->sz, -mulf32(cos_y, sin_x));
+    m[8] = mulf32(instance->sz, mulf32(cos_y, cos_x));
+
+    m[9] = instance->x;
+    m[10] = instance->y;
+    m[11] = instance->z;
+}
+
+// Returns the transformation matrix of a model. If the user hasn't assigned a
+// matrix to the model, it's calculated from the position, rotation and scale
+// of the model, but only if they have changed since the last time.
+static const m4x3 *ne_model_get_matrix(const NE_Model *model)
+{
+    if (model->mat != NULL)
+        return model->mat;
+
+    if (model->transform_dirty)
+    {
+        // The matrix is only a cache of the position, rotation and scale, so
+        // it's fine to update it even if the model is const.
+        NE_Model *m = (NE_Model *)model;
+
+        NE_ModelInstance instance = {
+            .x = m->x, .y = m->y, .z = m->z,
+            .rx = m->rx, .ry = m->ry, .rz = m->rz,
+            .sx = m->sx, .sy = m->sy, .sz = m->sz,
+        };
+        ne_model_instance_matrix(&instance, &m->transform);
+
+        m->transform_dirty = false;
+    }
+
+    return &model->transform;
+}
+
 void NE_ModelDraw(const NE_Model *model)
 {
     NE_AssertPointer(model, "NULL pointer");
@@ -274,29 +933,48 @@ void NE_ModelDraw(const NE_Model *model)
             return;
     }
 
+    if ((ne_model_culling_mode == NE_MODEL_CULLING_CPU) && model->has_box)
+    {
+        NE_Camera *cam = __NE_CameraGetActive();
+        if (cam != NULL)
+        {
+            ne_model_culling_stats.tested++;
+
+            if (!ne_model_sphere_test(model, cam))
+            {
+                ne_model_culling_stats.culled++;
+                return;
+            }
+        }
+    }
+
+    const m4x3 *mat = ne_model_get_matrix(model);
+
+    // Display lists sent asynchronously may still be using the GPU FIFO. The
+    // matrix is calculated before waiting so that it's done while the GPU
+    // receives the previous display lists.
+    NE_DisplayListWait();
+
     MATRIX_PUSH = 0;
 
-    if (model->mat != NULL)
+    glMultMatrix4x3(mat);
+
+    if ((ne_model_culling_mode == NE_MODEL_CULLING_BOX_TEST) && model->has_box)
     {
-        glMultMatrix4x3(model->mat);
+        ne_model_culling_stats.tested++;
+
+        if (!ne_model_box_test(model->box))
+        {
+            ne_model_culling_stats.culled++;
+            MATRIX_POP = 1;
+            return;
+        }
     }
-    else
-    {
-        MATRIX_TRANSLATE = model->x;
-        MATRIX_TRANSLATE = model->y;
-        MATRIX_TRANSLATE = model->z;
 
-        if (model->rx != 0)
-            glRotateXi(model->rx << 6);
-        if (model->ry != 0)
-            glRotateYi(model->ry << 6);
-        if (model->rz != 0)
-            glRotateZi(model->rz << 6);
+    ne_model_culling_stats.drawn++;
 
-        MATRIX_SCALE = model->sx;
-        MATRIX_SCALE = model->sy;
-        MATRIX_SCALE = model->sz;
-    }
+    ne_mesh_info_t *mesh = &NE_Mesh[ne_model_lod_select(model, &mat->m[9])];
+    const void *meshdata = mesh->address;
 
     if (NE_TestTouch)
     {
@@ -309,9 +987,6 @@ void NE_ModelDraw(const NE_Model *model)
         NE_MaterialUse(model->texture);
     }
 
-    ne_mesh_info_t *mesh = &NE_Mesh[model->meshindex];
-    const void *meshdata = mesh->address;
-
     if (model->modeltype == NE_Static)
     {
         NE_DisplayListDrawDefault(meshdata);
@@ -337,7 +1012,250 @@ void NE_ModelDraw(const NE_Model *model)
         }
     }
 
-    MATRIX_POP = 1;
+    // If the default function sends display lists asynchronously, the matrix
+    // can't be restored until the GPU has received the whole mesh. The command
+    // is added to the queue after the mesh so that this function can return
+    // without waiting.
+    __NE_DisplayListMatrixPop();
+}
+
+// Checks that a model can be drawn and sets up the GPU to draw instances of it.
+// Returns false if the model can't be drawn.
+static bool ne_model_instances_begin(const NE_Model *model)
+{
+    if (model->meshindex == NE_NO_MESH)
+        return false;
+
+    if (model->modeltype == NE_Animated)
+    {
+        if (model->animinfo[0]->animation == NULL)
+            return false;
+    }
+
+    // Display lists sent asynchronously may still be using the GPU FIFO
+    NE_DisplayListWait();
+
+    // The material is the same for all instances. If the texture pointer is
+    // NULL, this will set GFX_TEX_FORMAT to 0 and GFX_COLOR to white.
+    if (!NE_TestTouch)
+        NE_MaterialUse(model->texture);
+
+    return true;
+}
+
+// Draws one instance of a model with the provided matrix. The material of the
+// model must have been set up by ne_model_instances_begin().
+static void ne_model_instance_draw(const NE_Model *model, NE_Camera *cam,
+                                   const m4x3 *mat, int32_t frame)
+{
+    if ((ne_model_culling_mode == NE_MODEL_CULLING_CPU) && model->has_box &&
+        (cam != NULL))
+    {
+        ne_model_culling_stats.tested++;
+
+        int32_t sphere[4];
+        ne_matrix_transform_sphere(mat, model->sphere, sphere);
+
+        if (!NE_CameraSphereIsVisibleI(cam, sphere[0], sphere[1], sphere[2],
+                                       sphere[3]))
+        {
+            ne_model_culling_stats.culled++;
+            return;
+        }
+    }
+
+    // The mesh of the previous instance may still be being sent
+    NE_DisplayListWait();
+
+    MATRIX_PUSH = 0;
+
+    glMultMatrix4x3(mat);
+
+    if ((ne_model_culling_mode == NE_MODEL_CULLING_BOX_TEST) && model->has_box)
+    {
+        ne_model_culling_stats.tested++;
+
+        if (!ne_model_box_test(model->box))
+        {
+            ne_model_culling_stats.culled++;
+            MATRIX_POP = 1;
+            return;
+        }
+    }
+
+    ne_model_culling_stats.drawn++;
+
+    ne_mesh_info_t *mesh = &NE_Mesh[ne_model_lod_select(model, &mat->m[9])];
+
+    if (model->modeltype == NE_Static)
+    {
+        NE_DisplayListDrawDefault(mesh->address);
+    }
+    else // if (model->modeltype == NE_Animated)
+    {
+        int ret = DSMA_DrawModel(mesh->address,
+                                 model->animinfo[0]->animation->data, frame);
+        NE_Assert(ret == DSMA_SUCCESS, "Failed to draw animated model");
+    }
+
+    // The matrix of the next instance is calculated while the GPU receives the
+    // mesh of this one. See NE_ModelDraw().
+    __NE_DisplayListMatrixPop();
+}
+
+void NE_ModelDrawInstances(const NE_Model *model,
+                           const NE_ModelInstance *instances, int count)
+{
+    NE_AssertPointer(model, "NULL model pointer");
+    NE_AssertPointer(instances, "NULL instances pointer");
+
+    if (!ne_model_instances_begin(model))
+        return;
+
+    NE_Camera *cam = __NE_CameraGetActive();
+
+    for (int i = 0; i < count; i++)
+    {
+        m4x3 mat;
+        ne_model_instance_matrix(&instances[i], &mat);
+        ne_model_instance_draw(model, cam, &mat, instances[i].frame);
+    }
+}
+
+void NE_ModelDrawInstancesMatrix(const NE_Model *model, const m4x3 *matrices,
+                                 const int32_t *frames, int count)
+{
+    NE_AssertPointer(model, "NULL model pointer");
+    NE_AssertPointer(matrices, "NULL matrices pointer");
+
+    if (!ne_model_instances_begin(model))
+        return;
+
+    NE_Camera *cam = __NE_CameraGetActive();
+
+    int32_t frame = 0;
+    if (model->modeltype == NE_Animated)
+        frame = model->animinfo[0]->currframe;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (frames != NULL)
+            frame = frames[i];
+
+        ne_model_instance_draw(model, cam, &matrices[i], frame);
+    }
+}
+
+void NE_ModelLodSetBudget(int polygons, int vertices)
+{
+    NE_AssertMinMax(0, polygons, 2048, "Invalid polygon budget %d", polygons);
+    NE_AssertMinMax(0, vertices, 6144, "Invalid vertex budget %d", vertices);
+
+    ne_model_lod_budget_polygons = polygons;
+    ne_model_lod_budget_vertices = vertices;
+
+    if ((polygons == 0) && (vertices == 0))
+        ne_model_lod_bias = inttof32(1);
+}
+
+int32_t NE_ModelLodGetBias(void)
+{
+    return ne_model_lod_bias;
+}
+
+// Internal use. See NEGeneral.c
+void __NE_ModelLodEndFrame(void)
+{
+    if ((ne_model_lod_budget_polygons == 0) &&
+        (ne_model_lod_budget_vertices == 0))
+        return;
+
+    // Fraction of the budget used in this frame (f32). This waits until the
+    // GPU has processed all commands of the frame.
+    int32_t usage = 0;
+
+    if (ne_model_lod_budget_polygons > 0)
+    {
+        int32_t polygons = inttof32(NE_GetPolygonCount());
+        usage = polygons / ne_model_lod_budget_polygons;
+    }
+
+    if (ne_model_lod_budget_vertices > 0)
+    {
+        int32_t vertices = inttof32(NE_GetVertexCount());
+        int32_t vertex_usage = vertices / ne_model_lod_budget_vertices;
+        if (vertex_usage > usage)
+            usage = vertex_usage;
+    }
+
+    // Use simpler meshes quickly if the budget is exceeded, and go back to
+    // detailed meshes slowly when there is plenty of room so that the levels
+    // of detail don't change every frame.
+    if (usage > inttof32(1))
+    {
+        ne_model_lod_bias += ne_model_lod_bias >> 3;
+        if (ne_model_lod_bias > NE_MODEL_LOD_MAX_BIAS)
+            ne_model_lod_bias = NE_MODEL_LOD_MAX_BIAS;
+    }
+    else if (usage < floattof32(0.875))
+    {
+        ne_model_lod_bias -= ne_model_lod_bias >> 4;
+        if (ne_model_lod_bias < inttof32(1))
+            ne_model_lod_bias = inttof32(1);
+    }
+}
+
+void NE_ModelCullingSetMode(NE_ModelCullingMode mode)
+{
+    ne_model_culling_mode = mode;
+}
+
+NE_ModelCullingMode NE_ModelCullingGetMode(void)
+{
+    return ne_model_culling_mode;
+}
+
+ARM_CODE int NE_ModelCullBatch(NE_Camera *cam, NE_Model *const *models,
+                               int count, NE_Model **visible)
+{
+    NE_AssertPointer(cam, "NULL camera pointer");
+    NE_AssertPointer(models, "NULL models pointer");
+    NE_AssertPointer(visible, "NULL visible pointer");
+
+    int num_visible = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        NE_Model *model = models[i];
+
+        if (model->has_box)
+        {
+            ne_model_culling_stats.tested++;
+
+            if (!ne_model_sphere_test(model, cam))
+            {
+                ne_model_culling_stats.culled++;
+                continue;
+            }
+        }
+
+        visible[num_visible++] = model;
+    }
+
+    return num_visible;
+}
+
+void NE_ModelCullingGetStats(NE_ModelCullingStats *stats)
+{
+    NE_AssertPointer(stats, "NULL pointer");
+    *stats = ne_model_culling_stats_last;
+}
+
+// Internal use. See NEGeneral.c
+void __NE_ModelCullingNewFrame(void)
+{
+    ne_model_culling_stats_last = ne_model_culling_stats;
+    memset(&ne_model_culling_stats, 0, sizeof(ne_model_culling_stats));
 }
 
 void NE_ModelClone(NE_Model *dest, NE_Model *source)
@@ -363,10 +1281,15 @@ void NE_ModelClone(NE_Model *dest, NE_Model *source)
     dest->sx = source->sx;
     dest->sy = source->sy;
     dest->sz = source->sz;
+    dest->transform_dirty = true;
 
     dest->texture = source->texture;
     dest->meshindex = source->meshindex;
 
+    dest->has_box = source->has_box;
+    memcpy(dest->box, source->box, sizeof(dest->box));
+    memcpy(dest->sphere, source->sphere, sizeof(dest->sphere));
+
     // If the model has a mesh (which is the normal situation), increase the
     // count of users of that mesh.
     if (dest->meshindex != NE_NO_MESH)
@@ -374,6 +1297,16 @@ void NE_ModelClone(NE_Model *dest, NE_Model *source)
         ne_mesh_info_t *mesh = &NE_Mesh[dest->meshindex];
         mesh->uses++;
     }
+
+    NE_ModelLodClear(dest);
+
+    for (int i = 0; i < source->num_lods; i++)
+    {
+        dest->lod_meshindex[i] = source->lod_meshindex[i];
+        dest->lod_distance[i] = source->lod_distance[i];
+        NE_Mesh[dest->lod_meshindex[i]].uses++;
+    }
+    dest->num_lods = source->num_lods;
 }
 
 void NE_ModelScaleI(NE_Model *model, int x, int y, int z)
@@ -382,6 +1315,7 @@ void NE_ModelScaleI(NE_Model *model, int x, int y, int z)
     model->sx = x;
     model->sy = y;
     model->sz = z;
+    model->transform_dirty = true;
 }
 
 void NE_ModelTranslateI(NE_Model *model, int x, int y, int z)
@@ -390,6 +1324,7 @@ void NE_ModelTranslateI(NE_Model *model, int x, int y, int z)
     model->x += x;
     model->y += y;
     model->z += z;
+    model->transform_dirty = true;
 }
 
 void NE_ModelSetCoordI(NE_Model *model, int x, int y, int z)
@@ -398,6 +1333,7 @@ void NE_ModelSetCoordI(NE_Model *model, int x, int y, int z)
     model->x = x;
     model->y = y;
     model->z = z;
+    model->transform_dirty = true;
 }
 
 void NE_ModelRotate(NE_Model *model, int rx, int ry, int rz)
@@ -406,6 +1342,7 @@ void NE_ModelRotate(NE_Model *model, int rx, int ry, int rz)
     model->rx = (model->rx + rx + 512) & 0x1FF;
     model->ry = (model->ry + ry + 512) & 0x1FF;
     model->rz = (model->rz + rz + 512) & 0x1FF;
+    model->transform_dirty = true;
 }
 
 void NE_ModelSetRot(NE_Model *model, int rx, int ry, int rz)
@@ -414,6 +1351,7 @@ void NE_ModelSetRot(NE_Model *model, int rx, int ry, int rz)
     model->rx = rx;
     model->ry = ry;
     model->rz = rz;
+    model->transform_dirty = true;
 }
 
 int NE_ModelSetMatrix(NE_Model *model, m4x3 *mat)
@@ -441,6 +1379,7 @@ void NE_ModelClearMatrix(NE_Model *model)
         return;
 
     free(model->mat);
+    model->mat = NULL;
 }
 
 void NE_ModelAnimateAll(void)
@@ -576,6 +1515,7 @@ void NE_ModelAnimSecondaryClear(NE_Model *model, bool replace_base_anim)
         memcpy(model->animinfo[0], model->animinfo[1], sizeof(NE_AnimInfo));
 
     memset(model->animinfo[1], 0, sizeof(NE_AnimInfo));
+    ne_model_update_box(model);
 }
 
 int NE_ModelLoadDSMFAT(NE_Model *model, const char *path)
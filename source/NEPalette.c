@@ -5,6 +5,7 @@
 // This file is part of Nitro Engine
 
 #include "NEMain.h"
+#include "NEGFX.h"
 #include "NEAlloc.h"
 
 /// @file NEPalette.c
@@ -54,37 +55,11 @@ NE_Palette *NE_PaletteCreate(void)
     return NULL;
 }
 
-int NE_PaletteLoadFAT(NE_Palette *pal, const char *path, NE_TextureFormat format)
-{
-    if (!ne_palette_system_inited)
-        return 0;
-
-    NE_AssertPointer(pal, "NULL palette pointer");
-    NE_AssertPointer(path, "NULL path pointer");
-
-    u32 size = NE_FATFileSize(path);
-    if (size < 1)
-    {
-        NE_DebugPrint("Couldn't obtain file size");
-        return 0;
-    }
-
-    void *ptr = NE_FATLoadData(path);
-    NE_AssertPointer(ptr, "Couldn't load file from FAT");
-    int ret = NE_PaletteLoadSize(pal, ptr, size, format);
-    free(ptr);
-
-    return ret;
-}
-
-int NE_PaletteLoad(NE_Palette *pal, const void *pointer, u16 numcolor,
-                   NE_TextureFormat format)
+// Assigns a palette slot and VRAM to a palette. It returns the address in VRAM
+// where the colors have to be copied, or NULL on error.
+static u16 *ne_palette_alloc(NE_Palette *pal, u16 numcolor,
+                             NE_TextureFormat format)
 {
-    if (!ne_palette_system_inited)
-        return 0;
-
-    NE_AssertPointer(pal, "NULL pointer");
-
     if (pal->index != NE_NO_PALETTE)
     {
         NE_DebugPrint("Palette already loaded");
@@ -105,7 +80,7 @@ int NE_PaletteLoad(NE_Palette *pal, const void *pointer, u16 numcolor,
     if (slot == NE_NO_PALETTE)
     {
         NE_DebugPrint("No free lots");
-        return 0;
+        return NULL;
     }
 
     NE_PalInfo[slot].pointer = NE_Alloc(NE_PalAllocList, numcolor << 1);
@@ -113,7 +88,7 @@ int NE_PaletteLoad(NE_Palette *pal, const void *pointer, u16 numcolor,
     if (NE_PalInfo[slot].pointer == NULL)
     {
         NE_DebugPrint("Not enough memory");
-        return 0;
+        return NULL;
     }
 
     NE_PalInfo[slot].format = format;
@@ -121,9 +96,95 @@ int NE_PaletteLoad(NE_Palette *pal, const void *pointer, u16 numcolor,
     pal->index = slot;
     NE_PalInfo[slot].numcolors = numcolor;
 
+    return NE_PalInfo[slot].pointer;
+}
+
+int NE_PaletteLoadFAT(NE_Palette *pal, const char *path, NE_TextureFormat format)
+{
+    if (!ne_palette_system_inited)
+        return 0;
+
+    NE_AssertPointer(pal, "NULL palette pointer");
+    NE_AssertPointer(path, "NULL path pointer");
+
+    // Palettes are small, so a buffer in the stack is enough to copy them to
+    // VRAM in a few chunks without allocating memory in the heap.
+    u32 buffer[128];
+
+    NE_FATStream stream;
+    if (NE_FATStreamOpen(&stream, path, buffer, sizeof(buffer)) == 0)
+    {
+        NE_DebugPrint("Couldn't open file");
+        return 0;
+    }
+
+    size_t size = stream.size;
+    if (size < 1)
+    {
+        NE_DebugPrint("Couldn't obtain file size");
+        NE_FATStreamClose(&stream);
+        return 0;
+    }
+
+    u16 *dst = ne_palette_alloc(pal, size >> 1, format);
+    if (dst == NULL)
+    {
+        NE_FATStreamClose(&stream);
+        return 0;
+    }
+
+    int ret = 1;
+
+    while (1)
+    {
+        const void *data;
+        int read = NE_FATStreamRead(&stream, sizeof(buffer), &data);
+        if (read <= 0)
+        {
+            if (read < 0)
+                ret = 0;
+            break;
+        }
+
+        // Allow CPU writes to VRAM_E
+        vramSetBankE(VRAM_E_LCD);
+        swiCopy(data, dst, (read >> 2) | COPY_MODE_WORD);
+        vramSetBankE(VRAM_E_TEX_PALETTE);
+
+        dst += read >> 1;
+    }
+
+    NE_FATStreamClose(&stream);
+
+    if (ret == 0)
+    {
+        NE_DebugPrint("Couldn't load file from FAT");
+
+        // Only free the space allocated by this function. The palette object
+        // belongs to the caller.
+        NE_Free(NE_PalAllocList, (void *)NE_PalInfo[pal->index].pointer);
+        NE_PalInfo[pal->index].pointer = NULL;
+        pal->index = NE_NO_PALETTE;
+    }
+
+    return ret;
+}
+
+int NE_PaletteLoad(NE_Palette *pal, const void *pointer, u16 numcolor,
+                   NE_TextureFormat format)
+{
+    if (!ne_palette_system_inited)
+        return 0;
+
+    NE_AssertPointer(pal, "NULL pointer");
+
+    u16 *dst = ne_palette_alloc(pal, numcolor, format);
+    if (dst == NULL)
+        return 0;
+
     // Allow CPU writes to VRAM_E
     vramSetBankE(VRAM_E_LCD);
-    swiCopy(pointer, NE_PalInfo[slot].pointer, (numcolor / 2) | COPY_MODE_WORD);
+    swiCopy(pointer, dst, (numcolor / 2) | COPY_MODE_WORD);
     vramSetBankE(VRAM_E_TEX_PALETTE);
 
     return 1;
@@ -167,7 +228,8 @@ void NE_PaletteUse(const NE_Palette *pal)
     NE_AssertPointer(pal, "NULL pointer");
     NE_Assert(pal->index != NE_NO_PALETTE, "No asigned palette");
     unsigned int shift = 4 - (NE_PalInfo[pal->index].format == NE_PAL4);
-    GFX_PAL_FORMAT = (uintptr_t)NE_PalInfo[pal->index].pointer >> shift;
+    NE_GFX_STATE(NE_STATE_PAL_FORMAT, GFX_PAL_FORMAT,
+                 (uintptr_t)NE_PalInfo[pal->index].pointer >> shift);
 }
 
 int NE_PaletteSystemReset(int max_palettes)
@@ -189,6 +251,7 @@ int NE_PaletteSystemReset(int max_palettes)
         goto cleanup;
 
     GFX_PAL_FORMAT = 0;
+    ne_gfx_state_invalidate(BIT(NE_STATE_PAL_FORMAT));
 
     ne_palette_system_inited = true;
     return 0;
@@ -222,43 +285,171 @@ int NE_PaletteFreeMemPercent(void)
     return info.free_percent;
 }
 
-void NE_PaletteDefragMem(void)
+static int ne_palette_largest_free(NEChunk *alloc)
 {
-    NE_Assert(0, "This function doesn't work");
-    return;
+    NEMemInfo info;
+    NE_MemGetInformation(alloc, &info);
 
-    // TODO: Fix
+    return info.largest_free;
+}
 
-    /*
+int NE_PaletteLargestFreeMem(void)
+{
     if (!ne_palette_system_inited)
-        return;
+        return 0;
 
-    vramSetBankE(VRAM_E_LCD);
-    bool ok = false;
-    while (!ok)
+    return ne_palette_largest_free(NE_PalAllocList);
+}
+
+// Palettes are allocated from the start of VRAM_E, so they are compacted by
+// moving them to the lowest free address where they fit. The allocator always
+// returns addresses aligned to NE_ALLOC_MIN_SIZE (16 bytes), which is enough
+// for all formats (NE_PAL4 palettes need 8 bytes, the others need 16 bytes).
+//
+// If "dry_run" is true, the new layout is calculated with a copy of the
+// allocator, so the real allocator (and its trace) isn't modified, and palettes
+// aren't copied.
+//
+// It returns the number of bytes that the biggest free block has grown.
+static int ne_palette_defrag(bool dry_run)
+{
+    if (!ne_palette_system_inited)
+        return 0;
+
+    NEChunk *alloc = NE_PalAllocList;
+
+    // Location of each palette in the copy of the allocator
+    u16 **dry_pointer = NULL;
+
+    if (dry_run)
     {
-        ok = true;
+        dry_pointer = malloc(NE_MAX_PALETTES * sizeof(u16 *));
+        if (dry_pointer == NULL)
+        {
+            NE_DebugPrint("Not enough memory");
+            return 0;
+        }
+
+        if (NE_AllocInit(&alloc, (void *)VRAM_E, (void *)VRAM_F) != 0)
+        {
+            NE_DebugPrint("Not enough memory");
+            free(dry_pointer);
+            return 0;
+        }
+
         for (int i = 0; i < NE_MAX_PALETTES; i++)
         {
-            int size = NE_GetSize(NE_PalAllocList, (void*)NE_PalInfo[i].pointer);
+            dry_pointer[i] = NE_PalInfo[i].pointer;
+            if (dry_pointer[i] != NULL)
+            {
+                NE_AllocAddress(alloc, dry_pointer[i],
+                                NE_PalInfo[i].numcolors << 1);
+            }
+        }
+    }
 
-            NE_Free(NE_PalAllocList, (void*)NE_PalInfo[i].pointer);
-            void *pointer = NE_Alloc(NE_PalAllocList, size);
-            // Aligned to 16 bytes (except 8 bytes for NE_PAL4).
+    int largest_free = ne_palette_largest_free(alloc);
 
-            NE_AssertPointer(pointer, "Couldn't reallocate palette");
+    // Allow CPU writes to VRAM_E
+    if (!dry_run)
+        vramSetBankE(VRAM_E_LCD);
 
-            if ((int)pointer != (int)NE_PalInfo[i].pointer)
-            {
-                dmaCopy((void *)NE_PalInfo[i].pointer, pointer, size);
+    // Every palette that is moved ends at a lower address than before, so this
+    // loop always ends.
+    bool moved = true;
+    while (moved)
+    {
+        moved = false;
+
+        for (int i = 0; i < NE_MAX_PALETTES; i++)
+        {
+            u16 **pointer = dry_run ? &dry_pointer[i] : &NE_PalInfo[i].pointer;
+
+            u16 *old = *pointer;
+            if (old == NULL)
+                continue;
+
+            size_t size = NE_PalInfo[i].numcolors << 1;
 
-                NE_PalInfo[i].pointer = (void*)pointer;
-                ok = false;
+            // The old location is free after this, so NE_Alloc() can't fail,
+            // and it can't return an address higher than the old one.
+            NE_Free(alloc, old);
+            u16 *new = NE_Alloc(alloc, size);
+            NE_AssertPointer(new, "Couldn't reallocate palette");
+
+            if (new == old)
+                continue;
+
+            // The destination is always before the source, so it is safe to
+            // copy forwards even if they overlap. VRAM can't be written in
+            // 8-bit units.
+            if (!dry_run)
+            {
+                for (int c = 0; c < NE_PalInfo[i].numcolors; c++)
+                    new[c] = old[c];
             }
+
+            *pointer = new;
+            moved = true;
         }
     }
-    vramSetBankE(VRAM_E_TEX_PALETTE);
-    */
+
+    if (!dry_run)
+        vramSetBankE(VRAM_E_TEX_PALETTE);
+
+    int recovered = ne_palette_largest_free(alloc) - largest_free;
+
+    if (dry_run)
+    {
+        NE_AllocEnd(&alloc);
+        free(dry_pointer);
+    }
+
+    return recovered;
+}
+
+int NE_PaletteDefragMemDryRun(void)
+{
+    return ne_palette_defrag(true);
+}
+
+int NE_PaletteDefragMem(void)
+{
+    return ne_palette_defrag(false);
+}
+
+int NE_PaletteTraceStart(size_t num_entries)
+{
+    if (!ne_palette_system_inited)
+        return -1;
+
+    return NE_AllocTraceStart(NE_PalAllocList, num_entries);
+}
+
+int NE_PaletteTraceStop(void)
+{
+    if (!ne_palette_system_inited)
+        return -1;
+
+    return NE_AllocTraceStop(NE_PalAllocList);
+}
+
+int NE_PaletteTraceSetTag(u16 tag)
+{
+    if (!ne_palette_system_inited)
+        return -1;
+
+    return NE_AllocTraceSetTag(NE_PalAllocList, tag);
+}
+
+int NE_PaletteTraceDump(const char *path)
+{
+    if (!ne_palette_system_inited)
+        return -1;
+
+    NE_AssertPointer(path, "NULL path pointer");
+
+    return NE_AllocTraceDump(NE_PalAllocList, path);
 }
 
 void NE_PaletteSystemEnd(void)
@@ -255,6 +255,9 @@ ARM_CODE void NE_PhysicsUpdate(NE_Physics *pointer)
     posy = model->y = model->y + pointer->yspeed;
     posz = model->z = model->z + pointer->zspeed;
 
+    // The position may also be modified below if there is a collision
+    model->transform_dirty = true;
+
     // Gravity and movement have been applied, time to check collisions...
     bool xenabled = true, yenabled = true, zenabled = true;
     if (bposx == posx)
@@ -5,13 +5,20 @@
 // This file is part of Nitro Engine
 
 #include "NEMain.h"
+#include "NEGFX.h"
 
 /// @file NEPolygon.c
 
+// Last value written to GFX_POLY_FORMAT with NE_PolyFormat()
+static u32 ne_poly_format;
+
 void NE_LightOff(int index)
 {
     NE_AssertMinMax(0, index, 3, "Invalid light index %d", index);
 
+    // Display lists sent asynchronously may still be using the GPU FIFO
+    NE_DisplayListWait();
+
     GFX_LIGHT_VECTOR = (index & 3) << 30;
     GFX_LIGHT_COLOR = (index & 3) << 30;
 }
@@ -20,6 +27,8 @@ void NE_LightSetColor(int index, u32 color)
 {
     NE_AssertMinMax(0, index, 3, "Invalid light number %d", index);
 
+    NE_DisplayListWait();
+
     GFX_LIGHT_COLOR = ((index & 3) << 30) | color;
 }
 
@@ -27,6 +36,8 @@ void NE_LightSetI(int index, u32 color, int x, int y, int z)
 {
     NE_AssertMinMax(0, index, 3, "Invalid light number %d", index);
 
+    NE_DisplayListWait();
+
     GFX_LIGHT_VECTOR = ((index & 3) << 30)
                      | ((z & 0x3FF) << 20) | ((y & 0x3FF) << 10) | (x & 0x3FF);
     GFX_LIGHT_COLOR = ((index & 3) << 30) | color;
@@ -37,6 +48,9 @@ void NE_ShininessTableGenerate(NE_ShininessFunction function)
     uint32_t table[128 / 4];
     uint8_t *bytes = (uint8_t *)table;
 
+    // Display lists sent asynchronously may still be using the GPU FIFO
+    NE_DisplayListWait();
+
     if (function == NE_SHININESS_LINEAR)
     {
         for (int i = 0; i < 128; i++)
@@ -82,14 +96,31 @@ void NE_ShininessTableGenerate(NE_ShininessFunction function)
         GFX_SHININESS = table[i];
 }
 
+// Internal use. See NERenderQueue.c
+void __NE_PolyFormatSet(u32 format)
+{
+    // Formats saved to a display list don't affect the current state
+    if (!__NE_DisplayListRecording)
+        ne_poly_format = format;
+
+    NE_GFX_STATE(NE_STATE_POLY_FORMAT, GFX_POLY_FORMAT, format);
+}
+
 void NE_PolyFormat(u32 alpha, u32 id, NE_LightEnum lights,
                    NE_CullingEnum culling, NE_OtherFormatEnum other)
 {
     NE_AssertMinMax(0, alpha, 31, "Invalid alpha value %lu", alpha);
     NE_AssertMinMax(0, id, 63, "Invalid polygon ID %lu", id);
 
-    GFX_POLY_FORMAT = POLY_ALPHA(alpha) | POLY_ID(id)
-                    | lights | culling | other;
+    u32 format = POLY_ALPHA(alpha) | POLY_ID(id) | lights | culling | other;
+
+    __NE_PolyFormatSet(format);
+}
+
+// Internal use. See NEModel.c
+u32 __NE_PolyFormatGet(void)
+{
+    return ne_poly_format;
 }
 
 void NE_OutliningSetColor(u32 index, u32 color)
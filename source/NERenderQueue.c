@@ -0,0 +1,331 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2024 Antonio Niño Díaz
+//
+// This file is part of Nitro Engine
+
+#include "NEMain.h"
+#include "NEGFX.h"
+
+/// @file NERenderQueue.c
+
+// Internal use. See NEPolygon.c
+u32 __NE_PolyFormatGet(void);
+void __NE_PolyFormatSet(u32 format);
+
+// Internal use. See NEModel.c
+bool __NE_ModelGetViewDepth(const NE_Model *model, int32_t *depth);
+
+// State cache
+// ===========
+
+// Last value written to each register of the state cache, and a bit for each
+// register that is set if the value is known. See NEGFX.h
+u32 __NE_GFXState[NE_STATE_NUM];
+u32 __NE_GFXStateValid;
+
+// Writes done and skipped during the current frame
+u32 __NE_GFXStateWrites;
+u32 __NE_GFXStateSkipped;
+
+void NE_StateCacheInvalidate(void)
+{
+    ne_gfx_state_invalidate(NE_STATE_ALL);
+}
+
+// Render queue
+// ============
+
+typedef enum {
+    NE_RQ_MODEL,
+    NE_RQ_SPRITE,
+    NE_RQ_QUAD
+} ne_rq_type_t;
+
+typedef struct {
+    ne_rq_type_t type;
+    const NE_Material *mat;
+    u32 poly_format;
+    int32_t depth; // The higher the value, the further away the object is
+    int order;     // Position in the queue, used to keep the sort stable
+    union {
+        const NE_Model *model;
+        const NE_Sprite *sprite;
+        struct {
+            s16 x1, y1, x2, y2, z;
+            u32 color;
+        } quad;
+    } u;
+} ne_rq_item_t;
+
+static ne_rq_item_t *ne_rq_items = NULL;
+static int ne_rq_size;
+static int ne_rq_count;
+
+static bool ne_rq_inited = false;
+
+static u32 ne_rq_drawn;
+static NE_RenderQueueStats ne_rq_stats_last;
+
+int NE_RenderQueueReset(int max_objects)
+{
+    if (ne_rq_inited)
+        NE_RenderQueueEnd();
+
+    if (max_objects < 1)
+        ne_rq_size = NE_DEFAULT_RENDER_QUEUE_SIZE;
+    else
+        ne_rq_size = max_objects;
+
+    ne_rq_items = malloc(ne_rq_size * sizeof(ne_rq_item_t));
+    if (ne_rq_items == NULL)
+    {
+        NE_DebugPrint("Not enough memory");
+        return -1;
+    }
+
+    ne_rq_count = 0;
+
+    ne_rq_inited = true;
+    return 0;
+}
+
+void NE_RenderQueueEnd(void)
+{
+    if (!ne_rq_inited)
+        return;
+
+    free(ne_rq_items);
+    ne_rq_items = NULL;
+
+    ne_rq_inited = false;
+}
+
+// Returns a new entry of the queue, or NULL if the object has to be drawn right
+// away. Objects drawn while a display list is being recorded are never queued.
+static ne_rq_item_t *ne_rq_new_item(ne_rq_type_t type)
+{
+    if (!ne_rq_inited || __NE_DisplayListRecording)
+        return NULL;
+
+    if (ne_rq_count == ne_rq_size)
+    {
+        NE_DebugPrint("Render queue full");
+        return NULL;
+    }
+
+    ne_rq_item_t *item = &ne_rq_items[ne_rq_count];
+    item->type = type;
+    item->order = ne_rq_count;
+
+    ne_rq_count++;
+
+    return item;
+}
+
+void NE_RenderQueueAddModel(const NE_Model *model)
+{
+    NE_AssertPointer(model, "NULL pointer");
+
+    ne_rq_item_t *item = ne_rq_new_item(NE_RQ_MODEL);
+    if (item == NULL)
+    {
+        NE_ModelDraw(model);
+        return;
+    }
+
+    item->mat = model->texture;
+    item->poly_format = __NE_PolyFormatGet();
+    item->u.model = model;
+
+    if (!__NE_ModelGetViewDepth(model, &item->depth))
+        item->depth = 0;
+}
+
+void NE_RenderQueueAddSprite(const NE_Sprite *sprite)
+{
+    NE_AssertPointer(sprite, "NULL pointer");
+
+    if (!sprite->visible)
+        return;
+
+    ne_rq_item_t *item = ne_rq_new_item(NE_RQ_SPRITE);
+    if (item == NULL)
+    {
+        NE_SpriteDraw(sprite);
+        return;
+    }
+
+    // This is the polygon format set by NE_SpriteDraw()
+    item->mat = sprite->mat;
+    item->poly_format = POLY_ALPHA(sprite->alpha) | POLY_ID(sprite->id) |
+                        NE_CULL_NONE;
+    item->depth = sprite->priority;
+    item->u.sprite = sprite;
+}
+
+static void ne_rq_draw_quad(s16 x1, s16 y1, s16 x2, s16 y2, s16 z,
+                            const NE_Material *mat, u32 color)
+{
+    if (mat == NULL)
+        NE_2DDrawQuad(x1, y1, x2, y2, z, color);
+    else
+        NE_2DDrawTexturedQuadColor(x1, y1, x2, y2, z, mat, color);
+}
+
+void NE_RenderQueueAddQuad(s16 x1, s16 y1, s16 x2, s16 y2, s16 z,
+                           const NE_Material *mat, u32 color)
+{
+    ne_rq_item_t *item = ne_rq_new_item(NE_RQ_QUAD);
+    if (item == NULL)
+    {
+        ne_rq_draw_quad(x1, y1, x2, y2, z, mat, color);
+        return;
+    }
+
+    item->mat = mat;
+    item->poly_format = __NE_PolyFormatGet();
+    item->depth = z;
+    item->u.quad.x1 = x1;
+    item->u.quad.y1 = y1;
+    item->u.quad.x2 = x2;
+    item->u.quad.y2 = y2;
+    item->u.quad.z = z;
+    item->u.quad.color = color;
+}
+
+static bool ne_rq_is_translucent(const ne_rq_item_t *item)
+{
+    u32 alpha = (item->poly_format >> 16) & 31;
+
+    // Alpha 0 is used for wireframe polygons, which are opaque
+    return (alpha > 0) && (alpha < 31);
+}
+
+static int ne_rq_compare_values(uintptr_t a, uintptr_t b)
+{
+    return (a > b) - (a < b);
+}
+
+static int ne_rq_compare(const void *a, const void *b)
+{
+    const ne_rq_item_t *ia = a;
+    const ne_rq_item_t *ib = b;
+    int ret;
+
+    // Models are drawn with the 3D projection, before sprites and quads
+    ret = ((ia->type != NE_RQ_MODEL) - (ib->type != NE_RQ_MODEL));
+    if (ret != 0)
+        return ret;
+
+    bool translucent = ne_rq_is_translucent(ia);
+
+    ret = translucent - ne_rq_is_translucent(ib);
+    if (ret != 0)
+        return ret;
+
+    if (translucent)
+    {
+        // Back to front. The state of the GPU isn't important here.
+        ret = (ia->depth < ib->depth) - (ia->depth > ib->depth);
+        if (ret != 0)
+            return ret;
+    }
+
+    // Textures are the most expensive state to change. Many materials can use
+    // the same texture and palette (for example, clones of materials).
+    int tex_a = ia->mat ? ia->mat->texindex : -1;
+    int tex_b = ib->mat ? ib->mat->texindex : -1;
+    ret = (tex_a > tex_b) - (tex_a < tex_b);
+    if (ret != 0)
+        return ret;
+
+    ret = ne_rq_compare_values((uintptr_t)(ia->mat ? ia->mat->palette : NULL),
+                               (uintptr_t)(ib->mat ? ib->mat->palette : NULL));
+    if (ret != 0)
+        return ret;
+
+    ret = ne_rq_compare_values((uintptr_t)ia->mat, (uintptr_t)ib->mat);
+    if (ret != 0)
+        return ret;
+
+    ret = ne_rq_compare_values(ia->poly_format, ib->poly_format);
+    if (ret != 0)
+        return ret;
+
+    // Front to back
+    ret = (ia->depth > ib->depth) - (ia->depth < ib->depth);
+    if (ret != 0)
+        return ret;
+
+    return ia->order - ib->order;
+}
+
+void NE_RenderQueueFlush(void)
+{
+    if (!ne_rq_inited || (ne_rq_count == 0))
+        return;
+
+    qsort(ne_rq_items, ne_rq_count, sizeof(ne_rq_item_t), ne_rq_compare);
+
+    u32 format = __NE_PolyFormatGet();
+    bool view_2d = false;
+
+    for (int i = 0; i < ne_rq_count; i++)
+    {
+        ne_rq_item_t *item = &ne_rq_items[i];
+
+        if ((item->type != NE_RQ_MODEL) && !view_2d)
+        {
+            NE_2DViewInit();
+            view_2d = true;
+        }
+
+        if (item->type == NE_RQ_MODEL)
+        {
+            __NE_PolyFormatSet(item->poly_format);
+            NE_ModelDraw(item->u.model);
+        }
+        else if (item->type == NE_RQ_SPRITE)
+        {
+            NE_SpriteDraw(item->u.sprite);
+        }
+        else // if (item->type == NE_RQ_QUAD)
+        {
+            __NE_PolyFormatSet(item->poly_format);
+            ne_rq_draw_quad(item->u.quad.x1, item->u.quad.y1,
+                            item->u.quad.x2, item->u.quad.y2, item->u.quad.z,
+                            item->mat, item->u.quad.color);
+        }
+    }
+
+    ne_rq_drawn += ne_rq_count;
+    ne_rq_count = 0;
+
+    __NE_PolyFormatSet(format);
+}
+
+void NE_RenderQueueGetStats(NE_RenderQueueStats *stats)
+{
+    NE_AssertPointer(stats, "NULL pointer");
+
+    *stats = ne_rq_stats_last;
+}
+
+// Internal use. See NEGeneral.c
+void __NE_RenderQueueNewFrame(void)
+{
+    ne_rq_stats_last.drawn = ne_rq_drawn;
+    ne_rq_stats_last.state_changes = __NE_GFXStateWrites;
+    ne_rq_stats_last.state_skipped = __NE_GFXStateSkipped;
+
+    ne_rq_drawn = 0;
+    __NE_GFXStateWrites = 0;
+    __NE_GFXStateSkipped = 0;
+
+    // Objects that haven't been drawn are discarded
+    ne_rq_count = 0;
+
+    // The registers may have been modified outside of Nitro Engine
+    ne_gfx_state_invalidate(NE_STATE_ALL);
+}
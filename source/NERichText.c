@@ -5,6 +5,7 @@
 // This file is part of Nitro Engine
 
 #include "NEMain.h"
+#include "NEGFX.h"
 
 #include "libdsf/dsf.h"
 
@@ -404,6 +405,10 @@ int NE_RichTextRender3DWithIndent(u32 slot, const char *str, s32 x, s32 y,
     if (!info->active)
         return 0;
 
+    // libdsf writes to the GPU directly. Display lists sent asynchronously
+    // may still be using the GPU FIFO.
+    NE_DisplayListWait();
+
     NE_MaterialUse(info->material);
 
     dsf_error err = DSF_StringRender3DWithIndent(info->handle, str, x, y,
@@ -432,11 +437,19 @@ int NE_RichTextRender3DAlphaWithIndent(u32 slot, const char *str, s32 x, s32 y,
     if (!info->active)
         return 0;
 
+    // libdsf writes to the GPU directly. Display lists sent asynchronously
+    // may still be using the GPU FIFO.
+    NE_DisplayListWait();
+
     NE_MaterialUse(info->material);
 
     dsf_error err = DSF_StringRender3DAlphaWithIndent(info->handle, str, x, y,
                                                       NE_RICH_TEXT_PRIORITY,
                                                       poly_fmt, poly_id_base, xIndent);
+
+    // libdsf sets the polygon format of each character with glPolyFmt()
+    ne_gfx_state_invalidate(BIT(NE_STATE_POLY_FORMAT));
+
     if (err != DSF_NO_ERROR)
         return 0;
 
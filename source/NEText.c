@@ -5,6 +5,7 @@
 // This file is part of Nitro Engine
 
 #include "NEMain.h"
+#include "NEGFX.h"
 
 /// @file NEText.c
 
@@ -59,18 +60,18 @@ void NE_TextResetSystem(void)
 static void _ne_texturecuadprint(int xcrd1, int ycrd1, int xcrd2, int ycrd2,
                                  int xtx1, int ytx1, int xtx2, int ytx2)
 {
-    GFX_TEX_COORD = TEXTURE_PACK(inttot16(xtx1), inttot16(ytx1));
-    GFX_VERTEX16 = (ycrd1 << 16) | (xcrd1 & 0xFFFF);
-    GFX_VERTEX16 = NE_TEXT_PRIORITY;
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(inttot16(xtx1), inttot16(ytx1));
+    NE_GFX(GFX_VERTEX16) = (ycrd1 << 16) | (xcrd1 & 0xFFFF);
+    NE_GFX(GFX_VERTEX16) = NE_TEXT_PRIORITY;
 
-    GFX_TEX_COORD = TEXTURE_PACK(inttot16(xtx1), inttot16(ytx2));
-    GFX_VERTEX_XY = (ycrd2 << 16) | (xcrd1 & 0xFFFF);
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(inttot16(xtx1), inttot16(ytx2));
+    NE_GFX(GFX_VERTEX_XY) = (ycrd2 << 16) | (xcrd1 & 0xFFFF);
 
-    GFX_TEX_COORD = TEXTURE_PACK(inttot16(xtx2), inttot16(ytx2));
-    GFX_VERTEX_XY = (ycrd2 << 16) | (xcrd2 & 0xFFFF);
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(inttot16(xtx2), inttot16(ytx2));
+    NE_GFX(GFX_VERTEX_XY) = (ycrd2 << 16) | (xcrd2 & 0xFFFF);
 
-    GFX_TEX_COORD = TEXTURE_PACK(inttot16(xtx2), inttot16(ytx1));
-    GFX_VERTEX_XY = (ycrd1 << 16) | (xcrd2 & 0xFFFF);
+    NE_GFX(GFX_TEX_COORD) = TEXTURE_PACK(inttot16(xtx2), inttot16(ytx1));
+    NE_GFX(GFX_VERTEX_XY) = (ycrd1 << 16) | (xcrd2 & 0xFFFF);
 }
 
 static void _ne_charprint(const ne_textinfo_t * textinfo, int xcrd1, int ycrd1,
@@ -98,12 +99,12 @@ int NE_TextPrint(int slot, int x, int y, u32 color, const char *text)
         return -1;
 
     NE_MaterialUse(textinfo->material);
-    GFX_COLOR = color;
+    NE_GFX(GFX_COLOR) = color;
 
     int count = 0;
     int x_ = x * textinfo->sizex, y_ = y * textinfo->sizey;
 
-    GFX_BEGIN = GL_QUADS;
+    NE_GFX(GFX_BEGIN) = GL_QUADS;
 
     while (1)
     {
@@ -148,7 +149,7 @@ int NE_TextPrintBox(int slot, int x, int y, int endx, int endy, u32 color,
         return -1;
 
     NE_MaterialUse(textinfo->material);
-    GFX_COLOR = color;
+    NE_GFX(GFX_COLOR) = color;
 
     int count = 0;
     int x_ = x * textinfo->sizex, y_ = y * textinfo->sizey;
@@ -158,7 +159,7 @@ int NE_TextPrintBox(int slot, int x, int y, int endx, int endy, u32 color,
     if (charnum < 0)
         charnum = 0x0FFFFFFF;
 
-    GFX_BEGIN = GL_QUADS;
+    NE_GFX(GFX_BEGIN) = GL_QUADS;
 
     while (1) {
         if (charnum <= count)
@@ -205,12 +206,12 @@ int NE_TextPrintFree(int slot, int x, int y, u32 color, const char *text)
         return -1;
 
     NE_MaterialUse(textinfo->material);
-    GFX_COLOR = color;
+    NE_GFX(GFX_COLOR) = color;
 
     int count = 0;
     int x_ = x, y_ = y;
 
-    GFX_BEGIN = GL_QUADS;
+    NE_GFX(GFX_BEGIN) = GL_QUADS;
 
     while (1) {
         if (text[count] == '\0')
@@ -243,7 +244,7 @@ int NE_TextPrintBoxFree(int slot, int x, int y, int endx, int endy, u32 color,
         return -1;
 
     NE_MaterialUse(textinfo->material);
-    GFX_COLOR = color;
+    NE_GFX(GFX_COLOR) = color;
 
     int count = 0;
     int x_ = x, y_ = y;
@@ -253,7 +254,7 @@ int NE_TextPrintBoxFree(int slot, int x, int y, int endx, int endy, u32 color,
     if (charnum < 0)
         charnum = 0x0FFFFFFF;
 
-    GFX_BEGIN = GL_QUADS;
+    NE_GFX(GFX_BEGIN) = GL_QUADS;
 
     while (1) {
         if (charnum <= count)
@@ -5,10 +5,16 @@
 // This file is part of Nitro Engine
 
 #include "NEMain.h"
+#include "NEGFX.h"
 #include "NEAlloc.h"
 
 /// @file NETexture.c
 
+// Internal use. See NEAsset.c
+bool __NE_AssetCacheIsEnabled(void);
+void __NE_AssetCacheCountLoad(NE_AssetType type, bool hit, size_t size);
+void __NE_AssetCacheCountFree(NE_AssetType type, size_t size);
+
 typedef struct {
     u32 param;
     // For regular textures, this is the base address in VRAM of the texture.
@@ -17,6 +23,22 @@ typedef struct {
     char *address;
     int uses; // Number of materials that use this texture
     int sizex, sizey;
+
+    // Managed textures can be evicted from VRAM when there isn't enough space
+    // for other textures. When they are used again they are uploaded from
+    // "source" or, if it's NULL, from the file in "path". Regular textures
+    // loaded from the filesystem save the path too, so that the asset cache
+    // can share them.
+    bool managed;
+    bool locked; // Locked textures are never evicted
+    u8 fmt; // Format of the source data (NE_RGB5 is saved as NE_A1RGB5 in param)
+    u32 last_used; // Value of ne_texture_frame when it was last used
+    const void *source;
+    char *path;
+
+    // The texture has been loaded with NE_MaterialTexLoadAsync() and it hasn't
+    // been copied to VRAM yet.
+    bool pending;
 } ne_textureinfo_t;
 
 static ne_textureinfo_t *NE_Texture = NULL;
@@ -28,10 +50,74 @@ static bool ne_texture_system_inited = false;
 
 static int NE_MAX_TEXTURES;
 
+// Placement policy of textures that aren't compressed
+static NE_VRAMBankFlags ne_texture_alloc_policy;
+
+// VRAM banks used for textures
+static NE_VRAMBankFlags ne_texture_banks;
+
+// Number of frames drawn since the texture system was reset. It's used to find
+// the least recently used managed textures.
+static u32 ne_texture_frame;
+
+static NE_TextureCacheStats ne_texture_cache_stats;
+
+// Uploads are split in chunks so that NE_TextureUploadUpdate() can check if it
+// has reached the end of the VBlank period between them.
+#define NE_TEXTURE_UPLOAD_CHUNK_SIZE 1024
+
+// Channel 0 is used for display lists, 2 for dual 3D DMA mode and 3 is the
+// default channel of libnds.
+#define NE_TEXTURE_UPLOAD_DMA_CHANNEL 1
+
+// Part of a texture waiting to be copied to VRAM
+typedef struct {
+    int slot; // Texture slot
+    const u8 *src;
+    u8 *dst;
+    size_t size; // Bytes left to copy
+    bool set_alpha; // NE_RGB5 textures need the alpha bit set in all pixels
+} ne_upload_job_t;
+
+// Ring buffer of pending uploads. Each texture needs at most two entries, and
+// the entries of deleted textures are removed right away.
+static ne_upload_job_t *ne_upload_queue;
+static int ne_upload_queue_size;
+static int ne_upload_queue_head;
+static int ne_upload_queue_count;
+static size_t ne_upload_budget = NE_DEFAULT_UPLOAD_BUDGET;
+
+// Texture that NE_TextureDefragMemStep() is moving over several calls. The data
+// is copied to a location that doesn't overlap the old one, and the texture
+// keeps using the old location until all the data has been copied. Tex4x4
+// textures use the second part for the data in slot 1.
+typedef struct {
+    int slot; // NE_NO_TEXTURE if no texture is being moved
+    u8 *old[2];
+    u8 *new[2];
+    size_t size[2]; // Size of each part (0 if not used)
+    size_t done[2]; // Bytes of each part copied so far
+} ne_texture_move_t;
+
+static ne_texture_move_t ne_texture_move = { .slot = NE_NO_TEXTURE };
+
 // Default material properties
 static u32 ne_default_diffuse_ambient;
 static u32 ne_default_specular_emission;
 
+// Used to calculate the size of non-compressed textures from their dimensions
+static const int ne_tex_size_shift[] = {
+    0, // Nothing
+    1, // NE_A3PAL32
+    3, // NE_PAL4
+    2, // NE_PAL16
+    1, // NE_PAL256
+    0, // NE_TEX4X4 (This value isn't used)
+    1, // NE_A5PAL8
+    0, // NE_A1RGB5
+    0, // NE_RGB5
+};
+
 static int ne_is_valid_tex_size(int size)
 {
     for (int i = 0; i < 8; i++)
@@ -81,17 +167,128 @@ static inline void *slot1_to_slot2(void *ptr)
     return (void *)((uintptr_t)VRAM_C + (offset1 * 2));
 }
 
-static inline void ne_set_material_tex_param(NE_Material *tex,
-                            int sizeX, int sizeY, uint32_t *addr,
-                            GL_TEXTURE_TYPE_ENUM mode, u32 param)
+// The address is set with ne_texture_set_address() when the texture is
+// uploaded to VRAM.
+static inline void ne_texture_set_param(int slot, int sizeX, int sizeY,
+                                        GL_TEXTURE_TYPE_ENUM mode, u32 param)
 {
-    NE_AssertPointer(tex, "NULL pointer");
-    NE_Assert(tex->texindex != NE_NO_TEXTURE, "No assigned texture");
-    NE_Texture[tex->texindex].param =
-            (ne_tex_raw_size(sizeX) << 20) |
-            (ne_tex_raw_size(sizeY) << 23) |
-            (((uint32_t)addr >> 3) & 0xFFFF) |
-            (mode << 26) | param;
+    NE_Texture[slot].param = (ne_tex_raw_size(sizeX) << 20) |
+                             (ne_tex_raw_size(sizeY) << 23) |
+                             (mode << 26) | param;
+}
+
+static void ne_texture_set_address(int slot, void *address)
+{
+    NE_Texture[slot].address = address;
+    NE_Texture[slot].param &= ~0xFFFF;
+    NE_Texture[slot].param |= ((uint32_t)address >> 3) & 0xFFFF;
+}
+
+// Size of the data of a texture in VRAM. For tex4x4 textures this is the size
+// of the part in slot 0 or 2. The part in slot 1 is half of this size.
+static size_t ne_texture_vram_size(int slot)
+{
+    uint32_t fmt = (NE_Texture[slot].param >> 26) & 7;
+    size_t size = NE_Texture[slot].sizex * NE_Texture[slot].sizey;
+
+    if (fmt == NE_TEX4X4)
+        return size >> 2;
+
+    return (size << 1) >> ne_tex_size_shift[fmt];
+}
+
+// Size of all the data of a texture in VRAM, including the part of tex4x4
+// textures in slot 1.
+static size_t ne_texture_total_size(int slot)
+{
+    size_t size = ne_texture_vram_size(slot);
+    uint32_t fmt = (NE_Texture[slot].param >> 26) & 7;
+
+    if (fmt == NE_TEX4X4)
+        return size + (size >> 1);
+
+    return size;
+}
+
+// Returns the index of a texture slot that isn't used by any material, or
+// NE_NO_TEXTURE if there are no free slots.
+static int ne_texture_get_free_slot(void)
+{
+    for (int i = 0; i < NE_MAX_TEXTURES; i++)
+    {
+        if (NE_Texture[i].uses == 0)
+            return i;
+    }
+
+    return NE_NO_TEXTURE;
+}
+
+// Stops moving the texture that NE_TextureDefragMemStep() was moving. The
+// texture stays at its old location.
+static void ne_texture_move_cancel(void)
+{
+    if (ne_texture_move.slot == NE_NO_TEXTURE)
+        return;
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (ne_texture_move.size[i] > 0)
+            NE_Free(NE_TexAllocList, ne_texture_move.new[i]);
+    }
+
+    ne_texture_move.slot = NE_NO_TEXTURE;
+}
+
+// Frees the VRAM used by a texture, but keeps the rest of its information.
+static void ne_texture_free_vram(int slot)
+{
+    if (ne_texture_move.slot == slot)
+        ne_texture_move_cancel();
+
+    uint32_t fmt = (NE_Texture[slot].param >> 26) & 7;
+
+    if (fmt == NE_TEX4X4)
+    {
+        // Check if the texture is allocated in VRAM_A or VRAM_C, and
+        // calculate the corresponding address in VRAM_B.
+        void *slot02 = NE_Texture[slot].address;
+        void *slot1 = (slot02 < (void *)VRAM_B) ?
+                      slot0_to_slot1(slot02) : slot2_to_slot1(slot02);
+        NE_Free(NE_TexAllocList, slot02);
+        NE_Free(NE_TexAllocList, slot1);
+    }
+    else
+    {
+        NE_Free(NE_TexAllocList, NE_Texture[slot].address);
+    }
+
+    NE_Texture[slot].address = NULL;
+    NE_Texture[slot].param &= ~0xFFFF;
+}
+
+// Removes all the uploads of a texture slot from the queue. The other uploads
+// are moved so that the queue stays contiguous, and the entries are free for
+// new uploads right away. It must be called with interrupts disabled.
+static void ne_texture_upload_cancel(int slot)
+{
+    int count = 0;
+
+    for (int i = 0; i < ne_upload_queue_count; i++)
+    {
+        int index = (ne_upload_queue_head + i) % ne_upload_queue_size;
+        if (ne_upload_queue[index].slot == slot)
+            continue;
+
+        int dst = (ne_upload_queue_head + count) % ne_upload_queue_size;
+        if (dst != index)
+            ne_upload_queue[dst] = ne_upload_queue[index];
+
+        count++;
+    }
+
+    ne_upload_queue_count = count;
+
+    NE_Texture[slot].pending = false;
 }
 
 static void ne_texture_delete(int texture_index)
@@ -104,24 +301,30 @@ static void ne_texture_delete(int texture_index)
     // If the number of users is zero, delete it.
     if (NE_Texture[slot].uses == 0)
     {
-        uint32_t fmt = (NE_Texture[slot].param >> 26) & 7;
-
-        if (fmt == NE_TEX4X4)
+        if (NE_Texture[slot].pending)
         {
-            // Check if the texture is allocated in VRAM_A or VRAM_C, and
-            // calculate the corresponding address in VRAM_B.
-            void *slot02 = NE_Texture[slot].address;
-            void *slot1 = (slot02 < (void *)VRAM_B) ?
-                          slot0_to_slot1(slot02) : slot2_to_slot1(slot02);
-            NE_Free(NE_TexAllocList, slot02);
-            NE_Free(NE_TexAllocList, slot1);
+            int oldIME = enterCriticalSection();
+            ne_texture_upload_cancel(slot);
+            leaveCriticalSection(oldIME);
         }
-        else
+
+        // Textures in the asset cache
+        if (!NE_Texture[slot].managed && (NE_Texture[slot].path != NULL))
         {
-            NE_Free(NE_TexAllocList, NE_Texture[slot].address);
+            __NE_AssetCacheCountFree(NE_ASSET_TEXTURE,
+                                     ne_texture_total_size(slot));
         }
 
-        NE_Texture[slot].address = NULL;
+        // Managed textures may have been evicted from VRAM
+        if (NE_Texture[slot].address != NULL)
+            ne_texture_free_vram(slot);
+
+        free(NE_Texture[slot].path);
+
+        NE_Texture[slot].path = NULL;
+        NE_Texture[slot].source = NULL;
+        NE_Texture[slot].managed = false;
+        NE_Texture[slot].locked = false;
         NE_Texture[slot].param = 0;
     }
 }
@@ -317,60 +520,6 @@ cleanup:
 #endif // NE_BLOCKSDS
 }
 
-int NE_MaterialTexLoadFAT(NE_Material *tex, NE_TextureFormat fmt,
-                          int sizeX, int sizeY, NE_TextureFlags flags,
-                          const char *path)
-{
-    NE_AssertPointer(tex, "NULL material pointer");
-    NE_AssertPointer(path, "NULL path pointer");
-    NE_Assert(sizeX > 0 && sizeY > 0, "Size must be positive");
-
-    void *ptr = NE_FATLoadData(path);
-    if (ptr == NULL)
-    {
-        NE_DebugPrint("Couldn't load file from FAT");
-        return 0;
-    }
-
-    int ret = NE_MaterialTexLoad(tex, fmt, sizeX, sizeY, flags, ptr);
-    free(ptr);
-
-    return ret;
-}
-
-int NE_MaterialTex4x4LoadFAT(NE_Material *tex, int sizeX, int sizeY,
-                             NE_TextureFlags flags, const char *path02,
-                             const char *path1)
-{
-    NE_AssertPointer(tex, "NULL material pointer");
-    NE_AssertPointer(path02, "NULL path02 pointer");
-    NE_AssertPointer(path1, "NULL path1 pointer");
-    NE_Assert(sizeX > 0 && sizeY > 0, "Size must be positive");
-
-    void *texture02 = NE_FATLoadData(path02);
-    if (texture02 == NULL)
-    {
-        NE_DebugPrint("Couldn't load file from FAT");
-        return 0;
-    }
-
-    void *texture1 = NE_FATLoadData(path1);
-    if (texture1 == NULL)
-    {
-        NE_DebugPrint("Couldn't load file from FAT");
-        free(texture02);
-        return 0;
-    }
-
-    int ret = NE_MaterialTex4x4Load(tex, sizeX, sizeY, flags, texture02,
-                                    texture1);
-
-    free(texture02);
-    free(texture1);
-
-    return ret;
-}
-
 // This function takes as argument the size of the chunk of the compressed
 // texture chunk that goes into slots 0 or 2. The size that goes into slot 1 is
 // always half of this size, so it isn't needed to provide it.
@@ -479,212 +628,979 @@ static int ne_alloc_compressed_tex(size_t size, void **slot02, void **slot1)
     return -1;
 }
 
-int NE_MaterialTex4x4Load(NE_Material *tex, int sizeX, int sizeY,
-                          NE_TextureFlags flags, const void *texture02,
-                          const void *texture1)
+#define NE_TEXTURE_PARTITION_RANGES 6
+
+// Fills the list of VRAM ranges used by NE_TEXTURE_ALLOC_BANK_PARTITIONED, in
+// the order in which they are used, and returns the number of ranges.
+//
+// Compressed textures use slot 0 or 2 and half of that size in the matching
+// half of slot 1. Every byte used in slot 1 by a regular texture can prevent
+// two bytes in slot 0 or 2 from being used by compressed textures, so slot 1
+// is used last. Slot 3 is never used by compressed textures, so it is used
+// first, as well as the halves of slot 1 that match a slot that isn't
+// available.
+static int ne_alloc_tex_partitions(void *ranges[][2])
 {
-    NE_AssertPointer(tex, "NULL material pointer");
+    void *slot1_mid = (void *)((uintptr_t)VRAM_B + (64 * 1024));
+    int num_ranges = 0;
 
-    // For tex4x4 textures, both width and height must be valid
-    if ((ne_is_valid_tex_size(sizeX) != sizeX)
-        || (ne_is_valid_tex_size(sizeY) != sizeY))
+    ranges[num_ranges][0] = VRAM_D;
+    ranges[num_ranges++][1] = VRAM_E;
+
+    if (!(ne_texture_banks & NE_VRAM_C))
     {
-        NE_DebugPrint("Width and height of tex4x4 textures must be a power of 2");
-        return 0;
+        ranges[num_ranges][0] = slot1_mid;
+        ranges[num_ranges++][1] = VRAM_C;
+    }
+    if (!(ne_texture_banks & NE_VRAM_A))
+    {
+        ranges[num_ranges][0] = VRAM_B;
+        ranges[num_ranges++][1] = slot1_mid;
     }
 
-    // Check if a texture exists
-    if (tex->texindex != NE_NO_TEXTURE)
-        ne_texture_delete(tex->texindex);
+    ranges[num_ranges][0] = VRAM_C;
+    ranges[num_ranges++][1] = VRAM_D;
+    ranges[num_ranges][0] = VRAM_A;
+    ranges[num_ranges++][1] = VRAM_B;
+    ranges[num_ranges][0] = VRAM_B;
+    ranges[num_ranges++][1] = VRAM_C;
 
-    // Get free slot
-    tex->texindex = NE_NO_TEXTURE;
-    for (int i = 0; i < NE_MAX_TEXTURES; i++)
+    return num_ranges;
+}
+
+// Allocates space for a texture that isn't compressed using the placement
+// policy selected in NE_TextureSystemReset().
+static void *ne_alloc_tex(size_t size)
+{
+    switch (ne_texture_alloc_policy)
     {
-        if (NE_Texture[i].address == NULL)
+        case NE_TEXTURE_ALLOC_FIRST_FIT:
+            return NE_Alloc(NE_TexAllocList, size);
+
+        case NE_TEXTURE_ALLOC_BEST_FIT:
+            return NE_AllocBestFit(NE_TexAllocList, size);
+
+        case NE_TEXTURE_ALLOC_BANK_PARTITIONED:
         {
-            tex->texindex = i;
-            break;
+            void *ranges[NE_TEXTURE_PARTITION_RANGES][2];
+            int num_ranges = ne_alloc_tex_partitions(ranges);
+
+            for (int i = 0; i < num_ranges; i++)
+            {
+                void *addr = NE_AllocFindInRangeFromEnd(NE_TexAllocList,
+                                                        ranges[i][0],
+                                                        ranges[i][1], size);
+                if (addr == NULL)
+                    continue;
+
+                if (NE_AllocAddress(NE_TexAllocList, addr, size) == 0)
+                    return addr;
+            }
+
+            // The texture may be too big to fit in a single bank
+            return NE_AllocFromEnd(NE_TexAllocList, size);
         }
-    }
 
-    if (tex->texindex == NE_NO_TEXTURE)
-    {
-        NE_DebugPrint("No free slots");
-        return 0;
+        case NE_TEXTURE_ALLOC_FROM_END:
+        default:
+            return NE_AllocFromEnd(NE_TexAllocList, size);
     }
+}
+
+// Managed textures used in the current frame or in the previous one can't be
+// evicted because the GPU may still need them to draw the previous frame.
+#define NE_TEXTURE_CACHE_MIN_AGE 2
+
+// Returns a mask with the texture slots (one bit per slot) used by a texture
+// that is in VRAM.
+static u32 ne_texture_slot_mask(int slot)
+{
+    uintptr_t start = (uintptr_t)NE_Texture[slot].address - (uintptr_t)VRAM_A;
+    size_t size = ne_texture_vram_size(slot);
+    uint32_t fmt = (NE_Texture[slot].param >> 26) & 7;
+
+    u32 mask = 0;
+    for (uintptr_t i = start >> 17; i <= ((start + size - 1) >> 17); i++)
+        mask |= BIT(i);
 
-    size_t size02 = (sizeX * sizeY) >> 2;
+    // The other part of tex4x4 textures is in slot 1
+    if (fmt == NE_TEX4X4)
+        mask |= BIT(1);
+
+    return mask;
+}
+
+// Returns the texture slots where evicting a texture can help finding space
+// for a tex4x4 texture. The part in slot 0 or 2 and the part in slot 1 must be
+// free at the same time, so evicting textures from one of them is useless if
+// there isn't enough space in the other one.
+static u32 ne_texture_tex4x4_evict_mask(size_t size02)
+{
     size_t size1 = size02 >> 1;
+    void *slot1_mid = (void *)((uintptr_t)VRAM_B + (64 * 1024));
+
+    void *slot0 = NE_AllocFindInRange(NE_TexAllocList, VRAM_A, VRAM_B, size02);
+    void *slot2 = NE_AllocFindInRange(NE_TexAllocList, VRAM_C, VRAM_D, size02);
+    if ((slot0 == NULL) && (slot2 == NULL))
+        return BIT(0) | BIT(2);
+
+    void *slot1_0 = NE_AllocFindInRange(NE_TexAllocList, VRAM_B, slot1_mid,
+                                        size1);
+    void *slot1_2 = NE_AllocFindInRange(NE_TexAllocList, slot1_mid, VRAM_C,
+                                        size1);
+    if ((slot1_0 == NULL) && (slot1_2 == NULL))
+        return BIT(1);
+
+    // There is space in both slots, but not at matching addresses
+    return BIT(0) | BIT(1) | BIT(2);
+}
 
-    void *slot02, *slot1;
-    int ret = ne_alloc_compressed_tex(size02, &slot02, &slot1);
-    if (ret != 0)
-    {
-        NE_DebugPrint("Can't find space for compressed texture");
-        return 0;
-    }
+// Frees the VRAM of the managed texture that has been unused for the longest
+// time out of the ones that use any of the texture slots in "slot_mask".
+// Returns false if no texture can be evicted.
+static bool ne_texture_evict_lru(u32 slot_mask)
+{
+    int lru = NE_NO_TEXTURE;
+    u32 lru_age = 0;
 
-    ret = NE_AllocAddress(NE_TexAllocList, slot02, size02);
-    if (ret != 0)
+    for (int i = 0; i < NE_MAX_TEXTURES; i++)
     {
-        NE_DebugPrint("Can't allocate slot 0/2");
-        return 0;
-    }
+        ne_textureinfo_t *t = &NE_Texture[i];
 
-    ret = NE_AllocAddress(NE_TexAllocList, slot1, size1);
-    if (ret != 0)
-    {
-        NE_Free(NE_TexAllocList, slot02);
-        NE_DebugPrint("Can't allocate slot 1");
-        return 0;
-    }
+        // Textures with queued uploads can't be evicted until the data has
+        // been copied.
+        if (!t->managed || t->locked || (t->address == NULL) || t->pending)
+            continue;
 
-    // Save information
-    int slot = tex->texindex;
-    NE_Texture[slot].sizex = sizeX;
-    NE_Texture[slot].sizey = sizeY;
-    NE_Texture[slot].address = slot02;
-    NE_Texture[slot].uses = 1; // Initially only this material uses the texture
+        // Evicting this texture wouldn't free space where it's needed
+        if ((ne_texture_slot_mask(i) & slot_mask) == 0)
+            continue;
 
-    // Unlock texture memory for writing
-    // TODO: Only unlock the banks that Nitro Engine uses.
-    u32 vramTemp = vramSetPrimaryBanks(VRAM_A_LCD, VRAM_B_LCD, VRAM_C_LCD,
-                                        VRAM_D_LCD);
+        u32 age = ne_texture_frame - t->last_used;
+        if (age < NE_TEXTURE_CACHE_MIN_AGE)
+            continue;
 
-    swiCopy(texture02, slot02, (size02 >> 2) | COPY_MODE_WORD);
-    swiCopy(texture1, slot1, (size1 >> 2) | COPY_MODE_WORD);
+        if ((lru == NE_NO_TEXTURE) || (age > lru_age))
+        {
+            lru = i;
+            lru_age = age;
+        }
+    }
 
-    int hardware_size_y = ne_is_valid_tex_size(sizeY);
-    ne_set_material_tex_param(tex, sizeX, hardware_size_y, slot02,
-                              NE_TEX4X4, flags);
+    if (lru == NE_NO_TEXTURE)
+        return false;
 
-    vramRestorePrimaryBanks(vramTemp);
+    ne_texture_free_vram(lru);
+    ne_texture_cache_stats.evictions++;
 
-    return 1;
+    return true;
 }
 
-int NE_MaterialTexLoad(NE_Material *tex, NE_TextureFormat fmt,
-                       int sizeX, int sizeY, NE_TextureFlags flags,
-                       const void *texture)
+// Allocates VRAM for a texture. The size, format and flags of the texture must
+// be set before calling this function. If there isn't enough free VRAM, managed
+// textures that haven't been used recently are evicted. For tex4x4 textures,
+// "addr1" returns the address of the part that goes to slot 1.
+//
+// It returns 0 on success.
+static int ne_texture_alloc_vram(int slot, void **addr, void **addr1)
 {
-    NE_AssertPointer(tex, "NULL material pointer");
-    NE_Assert(fmt != 0, "No texture format provided");
+    size_t size = ne_texture_vram_size(slot);
+    uint32_t fmt = (NE_Texture[slot].param >> 26) & 7;
 
     if (fmt == NE_TEX4X4)
     {
-        // Split tex4x4 texture into its two parts, that have been concatenated
+        size_t size02 = size;
+        size_t size1 = size02 >> 1;
 
-        size_t size02 = (sizeX * sizeY) >> 2;
+        void *slot02, *slot1;
+        while (ne_alloc_compressed_tex(size02, &slot02, &slot1) != 0)
+        {
+            if (!ne_texture_evict_lru(ne_texture_tex4x4_evict_mask(size02)))
+            {
+                NE_DebugPrint("Can't find space for compressed texture");
+                return -1;
+            }
+        }
 
-        const void *texture02 = texture;
-        const void *texture1 = (const void *)((uintptr_t)texture + size02);
+        int ret = NE_AllocAddress(NE_TexAllocList, slot02, size02);
+        if (ret != 0)
+        {
+            NE_DebugPrint("Can't allocate slot 0/2");
+            return -1;
+        }
 
-        return NE_MaterialTex4x4Load(tex, sizeX, sizeY, flags,
-                                     texture02, texture1);
-    }
+        ret = NE_AllocAddress(NE_TexAllocList, slot1, size1);
+        if (ret != 0)
+        {
+            NE_Free(NE_TexAllocList, slot02);
+            NE_DebugPrint("Can't allocate slot 1");
+            return -1;
+        }
+
+        *addr = slot02;
+        *addr1 = slot1;
 
-    // The width of a texture must be a power of 2. The height doesn't need to
-    // be a power of 2, but we will have to cheat later and make the DS believe
-    // it is a power of 2.
-    if (ne_is_valid_tex_size(sizeX) != sizeX)
-    {
-        NE_DebugPrint("Width of textures must be a power of 2");
         return 0;
     }
 
-    // Check if a texture exists
-    if (tex->texindex != NE_NO_TEXTURE)
-        ne_texture_delete(tex->texindex);
+    // All non-compressed texture types are handled here
 
-    // Get free slot
-    tex->texindex = NE_NO_TEXTURE;
-    for (int i = 0; i < NE_MAX_TEXTURES; i++)
+    // This pointer must be aligned to 8 bytes at least
+    void *ptr;
+    while ((ptr = ne_alloc_tex(size)) == NULL)
     {
-        if (NE_Texture[i].address == NULL)
+        if (!ne_texture_evict_lru(BIT(0) | BIT(1) | BIT(2) | BIT(3)))
         {
-            tex->texindex = i;
-            break;
+            NE_DebugPrint("Not enough memory");
+            return -1;
         }
     }
 
-    if (tex->texindex == NE_NO_TEXTURE)
-    {
-        NE_DebugPrint("No free slots");
-        return 0;
-    }
-
-    // All non-compressed texture types are handled here
+    *addr = ptr;
+    *addr1 = NULL;
 
-    const int size_shift[] = {
-        0, // Nothing
-        1, // NE_A3PAL32
-        3, // NE_PAL4
-        2, // NE_PAL16
-        1, // NE_PAL256
-        0, // NE_TEX4X4 (This value isn't used)
-        1, // NE_A5PAL8
-        0, // NE_A1RGB5
-        0, // NE_RGB5
-    };
+    return 0;
+}
 
-    uint32_t size = (sizeX * sizeY << 1) >> size_shift[fmt];
+// Maps the VRAM banks that contain the range [addr, addr + size) to the CPU.
+// The rest of the banks can still be used by the GPU. The previous mapping can
+// be restored with vramRestorePrimaryBanks().
+static void ne_vram_set_lcd(const void *addr, size_t size)
+{
+    uintptr_t first = ((uintptr_t)addr - (uintptr_t)VRAM_A) >> 17;
+    uintptr_t last = ((uintptr_t)addr + size - 1 - (uintptr_t)VRAM_A) >> 17;
 
-    // This pointer must be aligned to 8 bytes at least
-    void *addr = NE_AllocFromEnd(NE_TexAllocList, size);
-    if (!addr)
+    for (uintptr_t bank = first; bank <= last; bank++)
     {
-        tex->texindex = NE_NO_TEXTURE;
-        NE_DebugPrint("Not enough memory");
-        return 0;
+        if (bank == 0)
+            vramSetBankA(VRAM_A_LCD);
+        else if (bank == 1)
+            vramSetBankB(VRAM_B_LCD);
+        else if (bank == 2)
+            vramSetBankC(VRAM_C_LCD);
+        else
+            vramSetBankD(VRAM_D_LCD);
     }
+}
 
-    // Save information
-    int slot = tex->texindex;
-    NE_Texture[slot].sizex = sizeX;
-    NE_Texture[slot].sizey = sizeY;
-    NE_Texture[slot].address = addr;
-    NE_Texture[slot].uses = 1; // Initially only this material uses the texture
+// Copies data from RAM to VRAM during the upload of a texture queued with
+// NE_MaterialTexLoadAsync() or loaded from a file. Only the VRAM banks that are
+// written are mapped to the CPU, so the rest of the textures can still be used
+// by the GPU. It must be called with interrupts disabled.
+static void ne_texture_upload_copy(void *dst, const void *src, size_t size,
+                                   bool set_alpha)
+{
+    u32 vramTemp = VRAM_CR;
 
-    // Unlock texture memory for writing
-    // TODO: Only unlock the banks that Nitro Engine uses.
-    u32 vramTemp = vramSetPrimaryBanks(VRAM_A_LCD, VRAM_B_LCD, VRAM_C_LCD,
-                                       VRAM_D_LCD);
+    ne_vram_set_lcd(dst, size);
 
-    if (fmt == NE_RGB5)
+    if (set_alpha)
     {
-        // NE_RGB5 is NE_A1RGB5 with each alpha bit manually set to 1 during the
-        // copy to VRAM.
-        uint32_t *src = (uint32_t *)texture;
-        uint32_t *dest = addr;
-        size >>= 2; // We are going to process four bytes each iteration
+        // NE_RGB5 textures can't be copied with DMA because the alpha bit of
+        // all pixels needs to be set to 1.
+        const uint32_t *s = src;
+        uint32_t *d = dst;
+        size >>= 2;
         while (size--)
-            *dest++ = *src++ | ((1 << 15) | (1 << 31));
-
-        fmt = NE_A1RGB5;
+            *d++ = *s++ | ((1 << 15) | (1 << 31));
     }
     else
     {
-        swiCopy((u32 *)texture, addr, (size >> 2) | COPY_MODE_WORD);
+        // Using several DMA channels at the same time isn't reliable
+        NE_DisplayListWait();
+        dmaCopyWords(NE_TEXTURE_UPLOAD_DMA_CHANNEL, src, dst, size);
     }
 
-    int hardware_size_y = ne_is_valid_tex_size(sizeY);
-    ne_set_material_tex_param(tex, sizeX, hardware_size_y, addr, fmt, flags);
-
     vramRestorePrimaryBanks(vramTemp);
-
-    return 1;
 }
 
-void NE_MaterialAutodeletePalette(NE_Material *mat)
+// Copies "size" bytes of a file to VRAM one chunk at a time, so that the file
+// never needs to be loaded to RAM in full. It returns 0 on success.
+static int ne_texture_upload_stream(NE_FATStream *stream, void *dst,
+                                    size_t size, bool set_alpha)
 {
-    NE_AssertPointer(mat, "NULL material pointer");
+    u8 *d = dst;
 
-    mat->palette_autodelete = true;
-}
+    while (size > 0)
+    {
+        const void *data;
+        int read = NE_FATStreamRead(stream, size, &data);
+        if (read <= 0)
+        {
+            NE_DebugPrint("File is too small");
+            return -1;
+        }
 
-void NE_MaterialClone(NE_Material *source, NE_Material *dest)
-{
+        // The data is copied with DMA, which doesn't go through the data cache
+        DC_FlushRange(data, read);
+
+        int oldIME = enterCriticalSection();
+        ne_texture_upload_copy(d, data, read, set_alpha);
+        leaveCriticalSection(oldIME);
+
+        d += read;
+        size -= read;
+    }
+
+    return 0;
+}
+
+// Allocates VRAM for a texture and copies its data to it from a file. For
+// tex4x4 textures, "path1" is the file with the part that goes to slot 1. If it
+// is NULL, that part is read from the end of the first file. It returns 0 on
+// success, -1 if there isn't enough VRAM and -2 if a file can't be read.
+static int ne_texture_upload_file(int slot, const char *path, const char *path1)
+{
+    NE_FATStream stream;
+    if (NE_FATStreamOpen(&stream, path, NULL, 0) == 0)
+        return -2;
+
+    void *addr, *addr1;
+    if (ne_texture_alloc_vram(slot, &addr, &addr1) != 0)
+    {
+        NE_FATStreamClose(&stream);
+        return -1;
+    }
+
+    ne_texture_set_address(slot, addr);
+
+    size_t size = ne_texture_vram_size(slot);
+    NE_TextureFormat fmt = NE_Texture[slot].fmt;
+
+    int ret = ne_texture_upload_stream(&stream, addr, size, fmt == NE_RGB5);
+
+    if ((ret == 0) && (fmt == NE_TEX4X4))
+    {
+        if (path1 != NULL)
+        {
+            NE_FATStreamClose(&stream);
+            if (NE_FATStreamOpen(&stream, path1, NULL, 0) == 0)
+            {
+                ne_texture_free_vram(slot);
+                return -2;
+            }
+        }
+
+        ret = ne_texture_upload_stream(&stream, addr1, size >> 1, false);
+    }
+
+    NE_FATStreamClose(&stream);
+
+    if (ret != 0)
+    {
+        ne_texture_free_vram(slot);
+        return -2;
+    }
+
+    return 0;
+}
+
+// Copies data from RAM to VRAM right away. Only the VRAM banks that are written
+// are mapped to the CPU, so the GPU can keep using the rest of the textures.
+// The data is copied in chunks so that interrupts aren't disabled for too long.
+static void ne_texture_upload_chunks(void *dst, const void *src, size_t size,
+                                     bool set_alpha)
+{
+    u8 *d = dst;
+    const u8 *s = src;
+
+    // The data is copied with DMA, which doesn't go through the data cache
+    DC_FlushRange(src, size);
+
+    while (size > 0)
+    {
+        size_t chunk = size;
+        if (chunk > NE_TEXTURE_UPLOAD_CHUNK_SIZE)
+            chunk = NE_TEXTURE_UPLOAD_CHUNK_SIZE;
+
+        int oldIME = enterCriticalSection();
+        ne_texture_upload_copy(d, s, chunk, set_alpha);
+        leaveCriticalSection(oldIME);
+
+        d += chunk;
+        s += chunk;
+        size -= chunk;
+    }
+}
+
+// Allocates VRAM for a texture and copies its data to it. For tex4x4 textures,
+// "texture1" is the part that goes to slot 1. It returns 0 on success.
+static int ne_texture_upload(int slot, NE_TextureFormat fmt,
+                             const void *texture, const void *texture1)
+{
+    void *addr, *addr1;
+    if (ne_texture_alloc_vram(slot, &addr, &addr1) != 0)
+        return -1;
+
+    size_t size = ne_texture_vram_size(slot);
+
+    // NE_RGB5 is NE_A1RGB5 with each alpha bit manually set to 1 during the
+    // copy to VRAM.
+    ne_texture_upload_chunks(addr, texture, size, fmt == NE_RGB5);
+    if (fmt == NE_TEX4X4)
+        ne_texture_upload_chunks(addr1, texture1, size >> 1, false);
+
+    ne_texture_set_address(slot, addr);
+
+    return 0;
+}
+
+// Uploads a managed texture that has been evicted from VRAM. It returns 0 on
+// success, -1 if there isn't enough VRAM and -2 if the file with the texture
+// can't be loaded.
+static int ne_texture_cache_upload(int slot)
+{
+    ne_textureinfo_t *t = &NE_Texture[slot];
+
+    if (t->source == NULL)
+    {
+        int ret = ne_texture_upload_file(slot, t->path, NULL);
+        if (ret == -2)
+            NE_DebugPrint("Couldn't load file from FAT");
+        return ret;
+    }
+
+    const void *data = t->source;
+
+    // Tex4x4 textures are stored with the slot 1 part after the other part
+    const void *data1 = NULL;
+    if (t->fmt == NE_TEX4X4)
+        data1 = (const void *)((uintptr_t)data + ne_texture_vram_size(slot));
+
+    return ne_texture_upload(slot, t->fmt, data, data1);
+}
+
+// Checks the size of a texture and assigns a free texture slot to the material.
+// The previous texture of the material is released. It returns the slot, or
+// NE_NO_TEXTURE on error.
+static int ne_material_tex_prepare(NE_Material *tex, NE_TextureFormat fmt,
+                                   int sizeX, int sizeY, NE_TextureFlags flags)
+{
+    if (fmt == NE_TEX4X4)
+    {
+        // For tex4x4 textures, both width and height must be valid
+        if ((ne_is_valid_tex_size(sizeX) != sizeX)
+            || (ne_is_valid_tex_size(sizeY) != sizeY))
+        {
+            NE_DebugPrint("Width and height of tex4x4 textures must be a power of 2");
+            return NE_NO_TEXTURE;
+        }
+    }
+    else
+    {
+        // The width of a texture must be a power of 2. The height doesn't need
+        // to be a power of 2, but we will have to cheat later and make the DS
+        // believe it is a power of 2.
+        if (ne_is_valid_tex_size(sizeX) != sizeX)
+        {
+            NE_DebugPrint("Width of textures must be a power of 2");
+            return NE_NO_TEXTURE;
+        }
+    }
+
+    // Check if a texture exists
+    if (tex->texindex != NE_NO_TEXTURE)
+        ne_texture_delete(tex->texindex);
+
+    // Get free slot
+    tex->texindex = ne_texture_get_free_slot();
+    if (tex->texindex == NE_NO_TEXTURE)
+    {
+        NE_DebugPrint("No free slots");
+        return NE_NO_TEXTURE;
+    }
+
+    // NE_RGB5 is loaded as NE_A1RGB5 with all alpha bits set
+    GL_TEXTURE_TYPE_ENUM mode = (fmt == NE_RGB5) ? NE_A1RGB5 : fmt;
+
+    // Save information
+    int slot = tex->texindex;
+    NE_Texture[slot].sizex = sizeX;
+    NE_Texture[slot].sizey = sizeY;
+    NE_Texture[slot].fmt = fmt;
+    NE_Texture[slot].managed = false;
+    NE_Texture[slot].locked = false;
+    NE_Texture[slot].source = NULL;
+    NE_Texture[slot].path = NULL;
+
+    int hardware_size_y = ne_is_valid_tex_size(sizeY);
+    ne_texture_set_param(slot, sizeX, hardware_size_y, mode, flags);
+
+    return slot;
+}
+
+int NE_MaterialTex4x4Load(NE_Material *tex, int sizeX, int sizeY,
+                          NE_TextureFlags flags, const void *texture02,
+                          const void *texture1)
+{
+    NE_AssertPointer(tex, "NULL material pointer");
+
+    int slot = ne_material_tex_prepare(tex, NE_TEX4X4, sizeX, sizeY, flags);
+    if (slot == NE_NO_TEXTURE)
+        return 0;
+
+    if (ne_texture_upload(slot, NE_TEX4X4, texture02, texture1) != 0)
+    {
+        NE_Texture[slot].param = 0;
+        tex->texindex = NE_NO_TEXTURE;
+        return 0;
+    }
+
+    NE_Texture[slot].uses = 1; // Initially only this material uses the texture
+
+    return 1;
+}
+
+int NE_MaterialTexLoad(NE_Material *tex, NE_TextureFormat fmt,
+                       int sizeX, int sizeY, NE_TextureFlags flags,
+                       const void *texture)
+{
+    NE_AssertPointer(tex, "NULL material pointer");
+    NE_Assert(fmt != 0, "No texture format provided");
+
+    if (fmt == NE_TEX4X4)
+    {
+        // Split tex4x4 texture into its two parts, that have been concatenated
+
+        size_t size02 = (sizeX * sizeY) >> 2;
+
+        const void *texture02 = texture;
+        const void *texture1 = (const void *)((uintptr_t)texture + size02);
+
+        return NE_MaterialTex4x4Load(tex, sizeX, sizeY, flags,
+                                     texture02, texture1);
+    }
+
+    int slot = ne_material_tex_prepare(tex, fmt, sizeX, sizeY, flags);
+    if (slot == NE_NO_TEXTURE)
+        return 0;
+
+    if (ne_texture_upload(slot, fmt, texture, NULL) != 0)
+    {
+        NE_Texture[slot].param = 0;
+        tex->texindex = NE_NO_TEXTURE;
+        return 0;
+    }
+
+    NE_Texture[slot].uses = 1; // Initially only this material uses the texture
+
+    return 1;
+}
+
+// Bits of the texture parameters that come from NE_TextureFlags
+#define NE_TEXTURE_FLAGS_MASK ((0xFU << 16) | (7U << 29))
+
+// Looks for a texture loaded from the same file with the same parameters. It
+// returns the slot, or NE_NO_TEXTURE if there isn't one.
+static int ne_texture_find_cached(NE_TextureFormat fmt, int sizeX, int sizeY,
+                                  NE_TextureFlags flags, const char *path)
+{
+    for (int i = 0; i < NE_MAX_TEXTURES; i++)
+    {
+        ne_textureinfo_t *t = &NE_Texture[i];
+
+        if ((t->uses == 0) || t->managed || (t->path == NULL))
+            continue;
+
+        if ((t->fmt != fmt) || (t->sizex != sizeX) || (t->sizey != sizeY))
+            continue;
+
+        if ((t->param & NE_TEXTURE_FLAGS_MASK) != flags)
+            continue;
+
+        if (strcmp(t->path, path) == 0)
+            return i;
+    }
+
+    return NE_NO_TEXTURE;
+}
+
+int NE_MaterialTexLoadFAT(NE_Material *tex, NE_TextureFormat fmt,
+                          int sizeX, int sizeY, NE_TextureFlags flags,
+                          const char *path)
+{
+    NE_AssertPointer(tex, "NULL material pointer");
+    NE_AssertPointer(path, "NULL path pointer");
+    NE_Assert(sizeX > 0 && sizeY > 0, "Size must be positive");
+    NE_Assert(fmt != 0, "No texture format provided");
+
+    if (__NE_AssetCacheIsEnabled())
+    {
+        int slot = ne_texture_find_cached(fmt, sizeX, sizeY, flags, path);
+        if (slot != NE_NO_TEXTURE)
+        {
+            // Add the new user before removing the previous texture of the
+            // material, in case it's the same one.
+            NE_Texture[slot].uses++;
+
+            if (tex->texindex != NE_NO_TEXTURE)
+                ne_texture_delete(tex->texindex);
+
+            tex->texindex = slot;
+
+            __NE_AssetCacheCountLoad(NE_ASSET_TEXTURE, true,
+                                     ne_texture_total_size(slot));
+            return 1;
+        }
+    }
+
+    int slot = ne_material_tex_prepare(tex, fmt, sizeX, sizeY, flags);
+    if (slot == NE_NO_TEXTURE)
+        return 0;
+
+    if (ne_texture_upload_file(slot, path, NULL) != 0)
+    {
+        NE_DebugPrint("Couldn't load file from FAT");
+        NE_Texture[slot].param = 0;
+        tex->texindex = NE_NO_TEXTURE;
+        return 0;
+    }
+
+    NE_Texture[slot].uses = 1; // Initially only this material uses the texture
+
+    if (__NE_AssetCacheIsEnabled())
+    {
+        // If there isn't enough memory for the path the texture just won't
+        // be shared.
+        NE_Texture[slot].path = strdup(path);
+        if (NE_Texture[slot].path != NULL)
+        {
+            __NE_AssetCacheCountLoad(NE_ASSET_TEXTURE, false,
+                                     ne_texture_total_size(slot));
+        }
+    }
+
+    return 1;
+}
+
+int NE_MaterialTex4x4LoadFAT(NE_Material *tex, int sizeX, int sizeY,
+                             NE_TextureFlags flags, const char *path02,
+                             const char *path1)
+{
+    NE_AssertPointer(tex, "NULL material pointer");
+    NE_AssertPointer(path02, "NULL path02 pointer");
+    NE_AssertPointer(path1, "NULL path1 pointer");
+    NE_Assert(sizeX > 0 && sizeY > 0, "Size must be positive");
+
+    int slot = ne_material_tex_prepare(tex, NE_TEX4X4, sizeX, sizeY, flags);
+    if (slot == NE_NO_TEXTURE)
+        return 0;
+
+    if (ne_texture_upload_file(slot, path02, path1) != 0)
+    {
+        NE_DebugPrint("Couldn't load file from FAT");
+        NE_Texture[slot].param = 0;
+        tex->texindex = NE_NO_TEXTURE;
+        return 0;
+    }
+
+    NE_Texture[slot].uses = 1; // Initially only this material uses the texture
+
+    return 1;
+}
+
+static int ne_material_tex_load_managed(NE_Material *tex, NE_TextureFormat fmt,
+                                        int sizeX, int sizeY,
+                                        NE_TextureFlags flags,
+                                        const void *texture, const char *path)
+{
+    char *path_copy = NULL;
+    if (path != NULL)
+    {
+        path_copy = strdup(path);
+        if (path_copy == NULL)
+        {
+            NE_DebugPrint("Not enough memory");
+            return 0;
+        }
+    }
+
+    int slot = ne_material_tex_prepare(tex, fmt, sizeX, sizeY, flags);
+    if (slot == NE_NO_TEXTURE)
+    {
+        free(path_copy);
+        return 0;
+    }
+
+    ne_textureinfo_t *t = &NE_Texture[slot];
+    t->managed = true;
+    t->locked = false;
+    t->last_used = ne_texture_frame;
+    t->source = texture;
+    t->path = path_copy;
+
+    // Try to upload it right away. If there isn't enough VRAM, it will be
+    // uploaded the first time it's used.
+    if (ne_texture_cache_upload(slot) == -2)
+    {
+        free(path_copy);
+        t->path = NULL;
+        t->source = NULL;
+        t->managed = false;
+        t->param = 0;
+        tex->texindex = NE_NO_TEXTURE;
+        return 0;
+    }
+
+    t->uses = 1; // Initially only this material uses the texture
+
+    return 1;
+}
+
+int NE_MaterialTexLoadManaged(NE_Material *tex, NE_TextureFormat fmt,
+                              int sizeX, int sizeY, NE_TextureFlags flags,
+                              const void *texture)
+{
+    NE_AssertPointer(tex, "NULL material pointer");
+    NE_AssertPointer(texture, "NULL texture pointer");
+    NE_Assert(fmt != 0, "No texture format provided");
+
+    return ne_material_tex_load_managed(tex, fmt, sizeX, sizeY, flags,
+                                        texture, NULL);
+}
+
+int NE_MaterialTexLoadManagedFAT(NE_Material *tex, NE_TextureFormat fmt,
+                                 int sizeX, int sizeY, NE_TextureFlags flags,
+                                 const char *path)
+{
+    NE_AssertPointer(tex, "NULL material pointer");
+    NE_AssertPointer(path, "NULL path pointer");
+    NE_Assert(fmt != 0, "No texture format provided");
+
+    return ne_material_tex_load_managed(tex, fmt, sizeX, sizeY, flags,
+                                        NULL, path);
+}
+
+void NE_MaterialTexLock(NE_Material *tex)
+{
+    NE_AssertPointer(tex, "NULL material pointer");
+    NE_Assert(tex->texindex != NE_NO_TEXTURE, "No texture asigned to material");
+
+    NE_Texture[tex->texindex].locked = true;
+}
+
+void NE_MaterialTexUnlock(NE_Material *tex)
+{
+    NE_AssertPointer(tex, "NULL material pointer");
+    NE_Assert(tex->texindex != NE_NO_TEXTURE, "No texture asigned to material");
+
+    NE_Texture[tex->texindex].locked = false;
+}
+
+bool NE_MaterialTexIsResident(const NE_Material *tex)
+{
+    NE_AssertPointer(tex, "NULL material pointer");
+    NE_Assert(tex->texindex != NE_NO_TEXTURE, "No texture asigned to material");
+
+    return NE_Texture[tex->texindex].address != NULL;
+}
+
+// Returns true if there are uploads left in the queue for a texture slot.
+static bool ne_texture_upload_is_queued(int slot)
+{
+    for (int i = 0; i < ne_upload_queue_count; i++)
+    {
+        int index = (ne_upload_queue_head + i) % ne_upload_queue_size;
+        if (ne_upload_queue[index].slot == slot)
+            return true;
+    }
+
+    return false;
+}
+
+static void ne_texture_upload_push(int slot, void *dst, const void *src,
+                                   size_t size, bool set_alpha)
+{
+    // Cancelled uploads are removed from the queue, so there is always space
+    // for two entries per texture slot.
+    NE_Assert(ne_upload_queue_count < ne_upload_queue_size,
+              "Texture upload queue full");
+
+    int index = (ne_upload_queue_head + ne_upload_queue_count)
+              % ne_upload_queue_size;
+
+    ne_upload_job_t *job = &ne_upload_queue[index];
+    job->slot = slot;
+    job->dst = dst;
+    job->src = src;
+    job->size = size;
+    job->set_alpha = set_alpha;
+
+    ne_upload_queue_count++;
+}
+
+// Copies up to "max_bytes" bytes of the queued uploads. If "vblank_only" is
+// true, it also stops when the GPU starts drawing the next frame.
+static void ne_texture_upload_process(size_t max_bytes, bool vblank_only)
+{
+    while ((ne_upload_queue_count > 0) && (max_bytes > 0))
+    {
+        if (vblank_only && NE_GPUIsRendering())
+            break;
+
+        ne_upload_job_t *job = &ne_upload_queue[ne_upload_queue_head];
+
+        size_t size = job->size;
+        if (size > NE_TEXTURE_UPLOAD_CHUNK_SIZE)
+            size = NE_TEXTURE_UPLOAD_CHUNK_SIZE;
+        if (size > max_bytes)
+            size = max_bytes & ~3;
+        if (size == 0)
+            break;
+
+        ne_texture_upload_copy(job->dst, job->src, size, job->set_alpha);
+
+        job->dst += size;
+        job->src += size;
+        job->size -= size;
+        max_bytes -= size;
+
+        if (job->size > 0)
+            continue;
+
+        int slot = job->slot;
+
+        ne_upload_queue_head = (ne_upload_queue_head + 1) % ne_upload_queue_size;
+        ne_upload_queue_count--;
+
+        if (!ne_texture_upload_is_queued(slot))
+            NE_Texture[slot].pending = false;
+    }
+}
+
+// Queues the upload of a texture to the VRAM allocated for it. For tex4x4
+// textures, "addr1" is the address in slot 1, and the data that goes there is
+// stored after the rest of the data.
+static void ne_texture_upload_queue(int slot, void *addr, void *addr1,
+                                    const void *texture)
+{
+    NE_TextureFormat fmt = NE_Texture[slot].fmt;
+    size_t size = ne_texture_vram_size(slot);
+
+    // The data is copied with DMA, which doesn't go through the data cache
+    DC_FlushRange(texture, (fmt == NE_TEX4X4) ? size + (size >> 1) : size);
+
+    int oldIME = enterCriticalSection();
+
+    NE_Texture[slot].pending = true;
+
+    if (fmt == NE_TEX4X4)
+    {
+        const void *texture1 = (const void *)((uintptr_t)texture + size);
+
+        ne_texture_upload_push(slot, addr, texture, size, false);
+        ne_texture_upload_push(slot, addr1, texture1, size >> 1, false);
+    }
+    else
+    {
+        ne_texture_upload_push(slot, addr, texture, size, fmt == NE_RGB5);
+    }
+
+    leaveCriticalSection(oldIME);
+}
+
+// Uploads a managed texture that has been evicted from VRAM while the scene is
+// being drawn. The GPU is using VRAM, so textures in RAM are queued and copied
+// during VBlank like the ones loaded with NE_MaterialTexLoadAsync(). Textures
+// loaded from the filesystem are copied right away, but only the VRAM banks
+// that are written are mapped to the CPU. The return value is the same as in
+// ne_texture_cache_upload().
+static int ne_texture_cache_upload_async(int slot)
+{
+    ne_textureinfo_t *t = &NE_Texture[slot];
+
+    if (t->source == NULL)
+        return ne_texture_cache_upload(slot);
+
+    void *addr, *addr1;
+    if (ne_texture_alloc_vram(slot, &addr, &addr1) != 0)
+        return -1;
+
+    ne_texture_set_address(slot, addr);
+
+    ne_texture_upload_queue(slot, addr, addr1, t->source);
+
+    return 0;
+}
+
+int NE_MaterialTexLoadAsync(NE_Material *tex, NE_TextureFormat fmt,
+                            int sizeX, int sizeY, NE_TextureFlags flags,
+                            const void *texture)
+{
+    NE_AssertPointer(tex, "NULL material pointer");
+    NE_AssertPointer(texture, "NULL texture pointer");
+    NE_Assert(fmt != 0, "No texture format provided");
+
+    int slot = ne_material_tex_prepare(tex, fmt, sizeX, sizeY, flags);
+    if (slot == NE_NO_TEXTURE)
+        return 0;
+
+    void *addr, *addr1;
+    if (ne_texture_alloc_vram(slot, &addr, &addr1) != 0)
+    {
+        NE_Texture[slot].param = 0;
+        tex->texindex = NE_NO_TEXTURE;
+        return 0;
+    }
+
+    ne_texture_set_address(slot, addr);
+
+    NE_Texture[slot].uses = 1; // Initially only this material uses the texture
+
+    ne_texture_upload_queue(slot, addr, addr1, texture);
+
+    return 1;
+}
+
+bool NE_MaterialTexIsPending(const NE_Material *tex)
+{
+    NE_AssertPointer(tex, "NULL material pointer");
+    NE_Assert(tex->texindex != NE_NO_TEXTURE, "No texture asigned to material");
+
+    return NE_Texture[tex->texindex].pending;
+}
+
+void NE_TextureUploadSetBudget(size_t max_bytes)
+{
+    ne_upload_budget = max_bytes;
+}
+
+int NE_TextureUploadUpdate(void)
+{
+    if (!ne_texture_system_inited)
+        return 0;
+
+    int oldIME = enterCriticalSection();
+
+    ne_texture_upload_process(ne_upload_budget, true);
+    int count = ne_upload_queue_count;
+
+    leaveCriticalSection(oldIME);
+
+    return count;
+}
+
+void NE_TextureUploadFlush(void)
+{
+    if (!ne_texture_system_inited)
+        return;
+
+    int oldIME = enterCriticalSection();
+
+    ne_texture_upload_process(SIZE_MAX, false);
+
+    leaveCriticalSection(oldIME);
+}
+
+void NE_MaterialAutodeletePalette(NE_Material *mat)
+{
+    NE_AssertPointer(mat, "NULL material pointer");
+
+    mat->palette_autodelete = true;
+}
+
+void NE_MaterialClone(NE_Material *source, NE_Material *dest)
+{
     NE_AssertPointer(source, "NULL source pointer");
     NE_AssertPointer(dest, "NULL dest pointer");
     NE_Assert(source->texindex != NE_NO_TEXTURE,
@@ -702,27 +1618,127 @@ void NE_MaterialSetPalette(NE_Material *tex, NE_Palette *pal)
     tex->palette = pal;
 }
 
+static void ne_material_set_diffuse_ambient(u32 value)
+{
+    // If bit 15 is set, the diffuse color is also set as vertex color, so the
+    // write can't be skipped.
+    if (value & BIT(15))
+        ne_gfx_state_invalidate(BIT(NE_STATE_DIFFUSE_AMBIENT));
+
+    NE_GFX_STATE(NE_STATE_DIFFUSE_AMBIENT, GFX_DIFFUSE_AMBIENT, value);
+}
+
 void NE_MaterialUse(const NE_Material *tex)
 {
     if (tex == NULL)
     {
-        GFX_TEX_FORMAT = 0;
-        GFX_COLOR = NE_White;
-        GFX_DIFFUSE_AMBIENT = ne_default_diffuse_ambient;
-        GFX_SPECULAR_EMISSION = ne_default_specular_emission;
+        NE_GFX_STATE(NE_STATE_TEX_FORMAT, GFX_TEX_FORMAT, 0);
+        NE_GFX(GFX_COLOR) = NE_White;
+        ne_material_set_diffuse_ambient(ne_default_diffuse_ambient);
+        NE_GFX_STATE(NE_STATE_SPECULAR_EMISSION, GFX_SPECULAR_EMISSION,
+                     ne_default_specular_emission);
         return;
     }
 
-    GFX_DIFFUSE_AMBIENT = tex->diffuse_ambient;
-    GFX_SPECULAR_EMISSION = tex->specular_emission;
+    ne_material_set_diffuse_ambient(tex->diffuse_ambient);
+    NE_GFX_STATE(NE_STATE_SPECULAR_EMISSION, GFX_SPECULAR_EMISSION,
+                 tex->specular_emission);
 
     NE_Assert(tex->texindex != NE_NO_TEXTURE, "No texture asigned to material");
 
     if (tex->palette)
         NE_PaletteUse(tex->palette);
 
-    GFX_COLOR = tex->color;
-    GFX_TEX_FORMAT = NE_Texture[tex->texindex].param;
+    NE_GFX(GFX_COLOR) = tex->color;
+
+    ne_textureinfo_t *t = &NE_Texture[tex->texindex];
+
+    if (t->managed)
+        t->last_used = ne_texture_frame;
+
+    // Draw the polygons without texture until the texture is in VRAM
+    if (t->pending)
+    {
+        NE_GFX_STATE(NE_STATE_TEX_FORMAT, GFX_TEX_FORMAT, 0);
+        return;
+    }
+
+    if (t->managed)
+    {
+        if (t->address != NULL)
+        {
+            ne_texture_cache_stats.hits++;
+        }
+        else
+        {
+            ne_texture_cache_stats.misses++;
+
+            if (ne_texture_cache_upload_async(tex->texindex) != 0)
+            {
+                // Draw the polygons without texture
+                ne_texture_cache_stats.failed++;
+                NE_GFX_STATE(NE_STATE_TEX_FORMAT, GFX_TEX_FORMAT, 0);
+                return;
+            }
+
+            // Draw the polygons without texture until it has been copied
+            if (t->pending)
+            {
+                NE_GFX_STATE(NE_STATE_TEX_FORMAT, GFX_TEX_FORMAT, 0);
+                return;
+            }
+        }
+    }
+
+    NE_GFX_STATE(NE_STATE_TEX_FORMAT, GFX_TEX_FORMAT, t->param);
+}
+
+void NE_TextureCacheGetStats(NE_TextureCacheStats *stats)
+{
+    NE_AssertPointer(stats, "NULL pointer");
+
+    *stats = ne_texture_cache_stats;
+
+    stats->managed = 0;
+    stats->resident = 0;
+    stats->resident_bytes = 0;
+
+    if (!ne_texture_system_inited)
+        return;
+
+    for (int i = 0; i < NE_MAX_TEXTURES; i++)
+    {
+        ne_textureinfo_t *t = &NE_Texture[i];
+
+        if (!t->managed)
+            continue;
+
+        stats->managed++;
+
+        if (t->address == NULL)
+            continue;
+
+        size_t size = ne_texture_vram_size(i);
+        if (t->fmt == NE_TEX4X4)
+            size += size >> 1;
+
+        stats->resident++;
+        stats->resident_bytes += size;
+    }
+}
+
+void NE_TextureCacheResetStats(void)
+{
+    ne_texture_cache_stats.hits = 0;
+    ne_texture_cache_stats.misses = 0;
+    ne_texture_cache_stats.evictions = 0;
+    ne_texture_cache_stats.failed = 0;
+}
+
+// Internal use. See NEGeneral.c
+void __NE_TextureCacheNewFrame(void)
+{
+    ne_texture_frame++;
 }
 
 int NE_TextureSystemReset(int max_textures, int max_palettes,
@@ -743,20 +1759,33 @@ int NE_TextureSystemReset(int max_textures, int max_palettes,
 
     NE_Texture = calloc(NE_MAX_TEXTURES, sizeof(ne_textureinfo_t));
     NE_UserMaterials = calloc(NE_MAX_TEXTURES, sizeof(NE_UserMaterials));
-    if ((NE_Texture == NULL) || (NE_UserMaterials == NULL))
+    ne_upload_queue = calloc(2 * NE_MAX_TEXTURES, sizeof(ne_upload_job_t));
+    if ((NE_Texture == NULL) || (NE_UserMaterials == NULL) ||
+        (ne_upload_queue == NULL))
         goto cleanup;
 
+    ne_upload_queue_size = 2 * NE_MAX_TEXTURES;
+    ne_upload_queue_head = 0;
+    ne_upload_queue_count = 0;
+
     if (NE_AllocInit(&NE_TexAllocList, VRAM_A, VRAM_E) != 0)
         goto cleanup;
 
+    ne_texture_alloc_policy = bank_flags & NE_TEXTURE_ALLOC_POLICY_MASK;
+
     // Prevent user from not selecting any bank
     if ((bank_flags & 0xF) == 0)
-        bank_flags = NE_VRAM_ABCD;
+        bank_flags |= NE_VRAM_ABCD;
 
     // VRAM_C and VRAM_D can't be used in dual 3D mode
     if (NE_CurrentExecutionMode() != NE_ModeSingle3D)
         bank_flags &= ~NE_VRAM_CD;
 
+    ne_texture_banks = bank_flags & NE_VRAM_ABCD;
+
+    ne_texture_frame = 0;
+    NE_TextureCacheResetStats();
+
     // Now, configure allocation system. The buffer size always sees the
     // four banks of VRAM. It is needed to allocate and lock one chunk per bank
     // that isn't allocated to Nitro Engine.
@@ -802,6 +1831,7 @@ int NE_TextureSystemReset(int max_textures, int max_palettes,
     }
 
     GFX_TEX_FORMAT = 0;
+    ne_gfx_state_invalidate(BIT(NE_STATE_TEX_FORMAT));
 
     ne_texture_system_inited = true;
     return 0;
@@ -811,6 +1841,7 @@ cleanup:
     NE_PaletteSystemEnd();
     free(NE_Texture);
     free(NE_UserMaterials);
+    free(ne_upload_queue);
     return -1;
 }
 
@@ -861,45 +1892,344 @@ int NE_TextureFreeMemPercent(void)
     return info.free_percent;
 }
 
-void NE_TextureDefragMem(void)
+int NE_TextureLargestFreeMem(void)
 {
-    NE_Assert(0, "This function doesn't work");
-    return;
-    /*
-    // REALLY OLD CODE -- DOESN'T WORK
-
     if (!ne_texture_system_inited)
-        return;
+        return 0;
+
+    NEMemInfo info;
+    NE_MemGetInformation(NE_TexAllocList, &info);
+
+    return info.largest_free;
+}
+
+// Copies data inside VRAM. Source and destination may overlap. Only the banks
+// that are read or written are mapped to the CPU. VRAM can't be written in
+// 8-bit units, so this copies 32 bits at a time.
+static void ne_vram_move(void *dest, const void *src, size_t size)
+{
+    uint32_t *d = dest;
+    const uint32_t *s = src;
+    size_t words = size >> 2;
+
+    u32 vramTemp = VRAM_CR;
 
-    uint32_t vramTemp = vramSetMainBanks(VRAM_A_LCD, VRAM_B_LCD, VRAM_C_LCD,
-                                       VRAM_D_LCD);
+    ne_vram_set_lcd(dest, size);
+    ne_vram_set_lcd(src, size);
 
-    bool ok = false;
-    while (!ok)
+    if (d < s)
     {
-        ok = true;
-        int i;
-        for (i = 0; i < NE_MAX_TEXTURES; i++)
-        {
-            int size = NE_GetSize(NE_TexAllocList, (void*)NE_Texture[i].address);
-            NE_Free(NE_TexAllocList,(void*)NE_Texture[i].address);
-            void *pointer = NE_Alloc(NE_TexAllocList, size);
-            // Aligned to 8 bytes
+        while (words--)
+            *d++ = *s++;
+    }
+    else if (d > s)
+    {
+        d += words;
+        s += words;
+        while (words--)
+            *--d = *--s;
+    }
+
+    vramRestorePrimaryBanks(vramTemp);
+}
+
+// Copies up to "max_bytes" bytes of the texture that is being moved. When all
+// the data has been copied the texture starts using the new location, and the
+// old one is freed. It returns the number of bytes copied.
+static size_t ne_texture_move_continue(size_t max_bytes)
+{
+    ne_texture_move_t *move = &ne_texture_move;
+    size_t copied = 0;
+
+    for (int i = 0; i < 2; i++)
+    {
+        size_t size = move->size[i] - move->done[i];
+        if (size > max_bytes - copied)
+            size = (max_bytes - copied) & ~3;
+        if (size == 0)
+            continue;
+
+        ne_vram_move(move->new[i] + move->done[i],
+                     move->old[i] + move->done[i], size);
+
+        move->done[i] += size;
+        copied += size;
+    }
+
+    if ((move->done[0] < move->size[0]) || (move->done[1] < move->size[1]))
+        return copied;
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (move->size[i] > 0)
+            NE_Free(NE_TexAllocList, move->old[i]);
+    }
+
+    ne_texture_set_address(move->slot, move->new[0]);
+    move->slot = NE_NO_TEXTURE;
+
+    return copied;
+}
+
+// Starts moving a texture over several calls to NE_TextureDefragMemStep(). The
+// new location must already be allocated. It returns the number of bytes
+// copied in this call.
+static size_t ne_texture_move_start(int slot, void *old02, void *new02,
+                                    size_t size02, void *old1, void *new1,
+                                    size_t size1, size_t max_bytes)
+{
+    ne_texture_move = (ne_texture_move_t) {
+        .slot = slot,
+        .old = { old02, old1 },
+        .new = { new02, new1 },
+        .size = { size02, size1 },
+        .done = { 0, 0 },
+    };
+
+    return ne_texture_move_continue(max_bytes);
+}
+
+// Returns true if a regular texture at address "new" is better placed than at
+// address "old" according to the placement policy. Textures are only moved if
+// this is true, so they can't be moved back and forth between two addresses.
+static bool ne_texture_defrag_is_better(void *new, void *old)
+{
+    switch (ne_texture_alloc_policy)
+    {
+        case NE_TEXTURE_ALLOC_FIRST_FIT:
+        case NE_TEXTURE_ALLOC_BEST_FIT:
+            return new < old;
 
-            NE_AssertPointer(pointer, "Couldn't reallocate texture");
+        case NE_TEXTURE_ALLOC_BANK_PARTITIONED:
+        {
+            void *ranges[NE_TEXTURE_PARTITION_RANGES][2];
+            int num_ranges = ne_alloc_tex_partitions(ranges);
 
-            if (pointer != NE_Texture[i].address)
+            // Ranges are filled from the end
+            int range_new = num_ranges;
+            int range_old = num_ranges;
+            for (int i = num_ranges - 1; i >= 0; i--)
             {
-                dmaCopy((void *)NE_Texture[i].address, pointer, size);
-                NE_Texture[i].address = pointer;
-                NE_Texture[i].param &= 0xFFFF0000;
-                NE_Texture[i].param |= ((uint32_t)pointer >> 3) & 0xFFFF;
-                ok = false;
+                if ((new >= ranges[i][0]) && (new < ranges[i][1]))
+                    range_new = i;
+                if ((old >= ranges[i][0]) && (old < ranges[i][1]))
+                    range_old = i;
             }
+
+            if (range_new != range_old)
+                return range_new < range_old;
+
+            return new > old;
+        }
+
+        case NE_TEXTURE_ALLOC_FROM_END:
+        default:
+            return new > old;
+    }
+}
+
+// Regular textures are moved to the best free location according to the
+// placement policy. With NE_TEXTURE_ALLOC_FROM_END that is the highest free
+// address where they fit, with NE_TEXTURE_ALLOC_FIRST_FIT and
+// NE_TEXTURE_ALLOC_BEST_FIT it is the lowest one, and with
+// NE_TEXTURE_ALLOC_BANK_PARTITIONED it's the first bank of the partition
+// order with enough space.
+//
+// If the texture is bigger than "max_size" it is only moved to a location that
+// doesn't overlap the old one, and the rest of the data is copied by the next
+// calls to NE_TextureDefragMemStep(). This function returns the number of
+// bytes copied, or 0 if the texture can't be moved.
+static int ne_texture_defrag_regular(int slot, size_t max_size)
+{
+    void *old = NE_Texture[slot].address;
+    size_t size = ne_texture_vram_size(slot);
+
+    bool split = size > max_size;
+
+    if (!split)
+        NE_Free(NE_TexAllocList, old);
+
+    // Best fit would move textures to small holes anywhere in VRAM. Compacting
+    // them towards the start leaves a single free block at the end, which is
+    // what best fit would end up using anyway.
+    void *new;
+    if (ne_texture_alloc_policy == NE_TEXTURE_ALLOC_BEST_FIT)
+        new = NE_Alloc(NE_TexAllocList, size);
+    else
+        new = ne_alloc_tex(size);
+
+    // If the old location is free the allocation can't fail
+    if (!split)
+        NE_AssertPointer(new, "Couldn't reallocate texture");
+
+    if (new == old)
+        return 0;
+
+    if ((new == NULL) || !ne_texture_defrag_is_better(new, old))
+    {
+        if (new != NULL)
+            NE_Free(NE_TexAllocList, new);
+        if (!split)
+            NE_AllocAddress(NE_TexAllocList, old, size);
+        return 0;
+    }
+
+    if (split)
+        return ne_texture_move_start(slot, old, new, size, NULL, NULL, 0,
+                                     max_size);
+
+    ne_vram_move(new, old, size);
+    ne_texture_set_address(slot, new);
+
+    return size;
+}
+
+// Tex4x4 textures are allocated from the start of slot 0 or 2, so they are
+// moved to the lowest addresses where both parts of the texture fit. The
+// return value is the same as in ne_texture_defrag_regular().
+static int ne_texture_defrag_tex4x4(int slot, size_t max_size)
+{
+    void *old02 = NE_Texture[slot].address;
+    void *old1 = (old02 < (void *)VRAM_B) ?
+                 slot0_to_slot1(old02) : slot2_to_slot1(old02);
+
+    size_t size02 = ne_texture_vram_size(slot);
+    size_t size1 = size02 >> 1;
+
+    bool split = (size02 + size1) > max_size;
+
+    if (!split)
+    {
+        NE_Free(NE_TexAllocList, old02);
+        NE_Free(NE_TexAllocList, old1);
+    }
+
+    // The search starts at the start of slot 0. If the old location is free,
+    // the new location can't be after the old one.
+    void *new02, *new1;
+    int ret = ne_alloc_compressed_tex(size02, &new02, &new1);
+    if ((ret != 0) || (new02 >= old02))
+    {
+        if (!split)
+        {
+            NE_AllocAddress(NE_TexAllocList, old02, size02);
+            NE_AllocAddress(NE_TexAllocList, old1, size1);
+        }
+        return 0;
+    }
+
+    NE_AllocAddress(NE_TexAllocList, new02, size02);
+    NE_AllocAddress(NE_TexAllocList, new1, size1);
+
+    if (split)
+        return ne_texture_move_start(slot, old02, new02, size02, old1, new1,
+                                     size1, max_size);
+
+    ne_vram_move(new02, old02, size02);
+    ne_vram_move(new1, old1, size1);
+    ne_texture_set_address(slot, new02);
+
+    return size02 + size1;
+}
+
+int NE_TextureDefragMemStep(size_t max_bytes)
+{
+    if (!ne_texture_system_inited)
+        return -1;
+
+    if (max_bytes == 0)
+        max_bytes = SIZE_MAX;
+    else if (max_bytes < 4)
+        max_bytes = 4;
+
+    size_t copied = 0;
+
+    // Continue moving the texture that the previous call couldn't finish
+    if (ne_texture_move.slot != NE_NO_TEXTURE)
+    {
+        copied = ne_texture_move_continue(max_bytes);
+        if (ne_texture_move.slot != NE_NO_TEXTURE)
+            return copied;
+    }
+
+    // Every texture that is moved ends at a better place according to the
+    // placement policy (regular textures) or at a lower address (tex4x4
+    // textures) than before, so this loop always ends.
+    bool moved = true;
+    while (moved)
+    {
+        moved = false;
+
+        for (int i = 0; i < NE_MAX_TEXTURES; i++)
+        {
+            // VRAM is copied in 32-bit units
+            if ((max_bytes - copied) < 4)
+                return copied;
+
+            // Textures that are waiting to be uploaded can't be moved
+            if ((NE_Texture[i].address == NULL) || NE_Texture[i].pending)
+                continue;
+
+            uint32_t fmt = (NE_Texture[i].param >> 26) & 7;
+
+            int size;
+            if (fmt == NE_TEX4X4)
+                size = ne_texture_defrag_tex4x4(i, max_bytes - copied);
+            else
+                size = ne_texture_defrag_regular(i, max_bytes - copied);
+
+            if (size == 0)
+                continue;
+
+            moved = true;
+            copied += size;
+
+            // The texture didn't fit in the budget, so it has used all of it
+            if (ne_texture_move.slot != NE_NO_TEXTURE)
+                return copied;
         }
     }
-    vramRestoreMainBanks(vramTemp);
-    */
+
+    return copied;
+}
+
+void NE_TextureDefragMem(void)
+{
+    NE_TextureDefragMemStep(0);
+}
+
+int NE_TextureTraceStart(size_t num_entries)
+{
+    if (!ne_texture_system_inited)
+        return -1;
+
+    return NE_AllocTraceStart(NE_TexAllocList, num_entries);
+}
+
+int NE_TextureTraceStop(void)
+{
+    if (!ne_texture_system_inited)
+        return -1;
+
+    return NE_AllocTraceStop(NE_TexAllocList);
+}
+
+int NE_TextureTraceSetTag(u16 tag)
+{
+    if (!ne_texture_system_inited)
+        return -1;
+
+    return NE_AllocTraceSetTag(NE_TexAllocList, tag);
+}
+
+int NE_TextureTraceDump(const char *path)
+{
+    if (!ne_texture_system_inited)
+        return -1;
+
+    NE_AssertPointer(path, "NULL path pointer");
+
+    return NE_AllocTraceDump(NE_TexAllocList, path);
 }
 
 void NE_TextureSystemEnd(void)
@@ -907,8 +2237,31 @@ void NE_TextureSystemEnd(void)
     if (!ne_texture_system_inited)
         return;
 
+    // Discard all pending uploads before the VBlank handler can see them
+    int oldIME = enterCriticalSection();
+    ne_upload_queue_count = 0;
+    leaveCriticalSection(oldIME);
+
+    ne_texture_move.slot = NE_NO_TEXTURE;
+
+    free(ne_upload_queue);
+    ne_upload_queue = NULL;
+
     NE_AllocEnd(&NE_TexAllocList);
 
+    for (int i = 0; i < NE_MAX_TEXTURES; i++)
+    {
+        ne_textureinfo_t *t = &NE_Texture[i];
+
+        if ((t->uses > 0) && !t->managed && (t->path != NULL))
+        {
+            __NE_AssetCacheCountFree(NE_ASSET_TEXTURE,
+                                     ne_texture_total_size(i));
+        }
+
+        free(t->path);
+    }
+
     free(NE_Texture);
 
     for (int i = 0; i < NE_MAX_TEXTURES; i++)
@@ -990,6 +2343,8 @@ void NE_MaterialSetDefaultProperties(u32 diffuse, u32 ambient,
 
     GFX_DIFFUSE_AMBIENT = ne_default_diffuse_ambient;
     GFX_SPECULAR_EMISSION = ne_default_specular_emission;
+    ne_gfx_state_invalidate(BIT(NE_STATE_DIFFUSE_AMBIENT) |
+                            BIT(NE_STATE_SPECULAR_EMISSION));
 }
 
 static u16 *drawingtexture_address = NULL;
@@ -1006,6 +2361,21 @@ void *NE_TextureDrawingStart(const NE_Material *tex)
     NE_Assert(drawingtexture_address == NULL,
               "Another texture is already active");
 
+    // Finish the upload of textures loaded with NE_MaterialTexLoadAsync()
+    if (NE_Texture[tex->texindex].pending)
+        NE_TextureUploadFlush();
+
+    // Managed textures may have been evicted from VRAM
+    if (NE_Texture[tex->texindex].address == NULL)
+    {
+        if (ne_texture_cache_upload(tex->texindex) != 0)
+            return NULL;
+    }
+
+    // The new pixels wouldn't be copied to the new location of the texture
+    if (ne_texture_move.slot == tex->texindex)
+        ne_texture_move_cancel();
+
     drawingtexture_x = NE_TextureGetSizeX(tex);
     drawingtexture_realx = NE_TextureGetRealSizeX(tex);
     drawingtexture_y = NE_TextureGetSizeY(tex);
@@ -7,6 +7,7 @@
 // Nitro Engine comes with a general-purpose memory allocator. This file
 // contains several tests for it.
 
+#include <malloc.h>
 #include <stdio.h>
 
 #include <nds.h>
@@ -294,6 +295,7 @@ void test_alloc_fail(void)
     ASSERT(ret == 0);
 
     ASSERT(info.free == (POOL_SIZE / 2));
+    ASSERT(info.largest_free == (POOL_SIZE / 4));
 
     fail = NE_Alloc(alloc, info.free);
     ASSERT(fail == NULL);
@@ -357,6 +359,10 @@ void test_statistics(void)
 
     ASSERT(info.free_percent == (100 * 5 / 7));
 
+    ASSERT(info.largest_free == (4 * POOL_SIZE / 8));
+    ASSERT(info.free_fragments == 2);
+    ASSERT(info.fragmentation == (100 - (100 * 4 / 5)));
+
     POOL_DEINITIALIZE();
 }
 
@@ -996,6 +1002,137 @@ void test_stress(void)
     POOL_DEINITIALIZE();
 }
 
+// Benchmark that simulates the churn of textures and palettes during level
+// transitions while the rest of the game also uses the heap. It prints the time
+// it takes and the state of the heap before and after the benchmark. Chunks of
+// the allocator are taken from its pool of nodes, so the heap shouldn't become
+// more fragmented as the benchmark runs.
+void benchmark_churn(void)
+{
+    printf("%s\n", __func__);
+
+    POOL_INITIALIZE();
+
+#define BENCH_PTRS          128
+#define BENCH_HEAP_PTRS     64
+#define BENCH_ITERATIONS    100000
+
+    void *ptr[BENCH_PTRS];
+    void *heap[BENCH_HEAP_PTRS];
+
+    for (int i = 0; i < BENCH_PTRS; i++)
+        ptr[i] = NULL;
+    for (int i = 0; i < BENCH_HEAP_PTRS; i++)
+        heap[i] = NULL;
+
+    struct mallinfo before = mallinfo();
+
+    cpuStartTiming(0);
+
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        unsigned int selected = my_rand() % BENCH_PTRS;
+
+        if (ptr[selected] == NULL)
+        {
+            size_t size = (my_rand() & 0x3FFF) + 1;
+
+            if (size & 1)
+                ptr[selected] = NE_Alloc(alloc, size);
+            else
+                ptr[selected] = NE_AllocFromEnd(alloc, size);
+
+            ASSERT(ptr[selected] != NULL);
+        }
+        else
+        {
+            int ret = NE_Free(alloc, ptr[selected]);
+            ASSERT(ret == 0);
+            ptr[selected] = NULL;
+        }
+
+        // Other small allocations done by the game at the same time
+        if ((i & 7) == 0)
+        {
+            unsigned int h = my_rand() % BENCH_HEAP_PTRS;
+            free(heap[h]);
+            heap[h] = malloc((my_rand() & 0x7F) + 4);
+        }
+    }
+
+    uint32_t ticks = cpuEndTiming();
+
+    struct mallinfo after = mallinfo();
+
+    for (int i = 0; i < BENCH_HEAP_PTRS; i++)
+        free(heap[i]);
+
+    printf("  Time: %u us\n", (unsigned int)timerTicks2usec(ticks));
+    printf("  Heap size: %u -> %u\n", (unsigned int)before.arena,
+           (unsigned int)after.arena);
+    printf("  Heap used: %u -> %u\n", (unsigned int)before.uordblks,
+           (unsigned int)after.uordblks);
+    printf("  Heap free: %u -> %u\n", (unsigned int)before.fordblks,
+           (unsigned int)after.fordblks);
+    printf("  Free blocks: %u -> %u\n", (unsigned int)before.ordblks,
+           (unsigned int)after.ordblks);
+
+    POOL_DEINITIALIZE();
+}
+
+void benchmark_many_chunks(void)
+{
+    printf("%s\n", __func__);
+
+    POOL_INITIALIZE();
+
+#define MANY_PTRS           4096
+#define MANY_ITERATIONS     20000
+
+    static void *ptr[MANY_PTRS];
+
+    // Fill the pool with lots of small chunks
+    for (int i = 0; i < MANY_PTRS; i++)
+    {
+        ptr[i] = NE_Alloc(alloc, ((my_rand() & 0xF) + 1) * 16);
+        ASSERT(ptr[i] != NULL);
+    }
+
+    cpuStartTiming(0);
+
+    for (int i = 0; i < MANY_ITERATIONS; i++)
+    {
+        unsigned int selected = my_rand() % MANY_PTRS;
+
+        int ret = NE_Lock(alloc, ptr[selected]);
+        ASSERT(ret == 0);
+        ret = NE_Unlock(alloc, ptr[selected]);
+        ASSERT(ret == 0);
+
+        ret = NE_Free(alloc, ptr[selected]);
+        ASSERT(ret == 0);
+
+        size_t size = ((my_rand() & 0xF) + 1) * 16;
+
+        if (i & 1)
+            ptr[selected] = NE_Alloc(alloc, size);
+        else
+            ptr[selected] = NE_AllocFromEnd(alloc, size);
+
+        ASSERT(ptr[selected] != NULL);
+    }
+
+    uint32_t ticks = cpuEndTiming();
+
+    int ret = verify_consistency(alloc, POOL_START, POOL_END);
+    ASSERT(ret == 0);
+
+    printf("  Chunks: %d\n", count_num_chunks(alloc));
+    printf("  Time: %u us\n", (unsigned int)timerTicks2usec(ticks));
+
+    POOL_DEINITIALIZE();
+}
+
 int main(int argc, char *argv[])
 {
     // This test doesn't use Nitro Engine at all. Initialize the default console
@@ -1015,6 +1152,9 @@ int main(int argc, char *argv[])
     test_find_range();
     test_stress();
 
+    benchmark_churn();
+    benchmark_many_chunks();
+
     printf("Done!");
 
     while (1)
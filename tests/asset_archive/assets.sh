@@ -0,0 +1,20 @@
+#!/bin/sh
+
+NITRO_ENGINE=../..
+EXAMPLES=$NITRO_ENGINE/examples/loading
+TOOLS=$NITRO_ENGINE/tools
+PACK_FILES=$TOOLS/pack_files/pack_files.py
+
+rm -rf nitrofiles
+mkdir -p nitrofiles/files
+
+# Use the files of the filesystem examples
+cp -r $EXAMPLES/filesystem_multiple_textures/nitrofiles nitrofiles/files/textures
+mkdir -p nitrofiles/files/robot
+cp $EXAMPLES/filesystem_animated_model/nitrofiles/robot.dsm \
+   $EXAMPLES/filesystem_animated_model/nitrofiles/robot_wave.dsa \
+   nitrofiles/files/robot
+
+python3 $PACK_FILES \
+    --input nitrofiles/files \
+    --output nitrofiles/assets.pak
@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Antonio Niño Díaz, 2024
+//
+// This file is part of Nitro Engine
+
+// This test loads the same files from NitroFS and from an archive created with
+// tools/pack_files, checks that they are the same, and prints the time it takes
+// to load them both ways.
+
+#include <filesystem.h>
+
+#include <NEMain.h>
+
+#define ITERATIONS 8
+
+static const char *files[] = {
+    "robot/robot.dsm",
+    "robot/robot_wave.dsa",
+    "textures/cube.bin",
+    "textures/spiral_blue_pal32.img.bin",
+    "textures/spiral_blue_pal32.pal.bin",
+    "textures/spiral_red_pal32.img.bin",
+    "textures/spiral_red_pal32.pal.bin",
+};
+
+#define NUM_FILES (sizeof(files) / sizeof(files[0]))
+
+// Returns the time it takes to load all files in microseconds, or -1 on error.
+static int benchmark(const char *prefix)
+{
+    char path[128];
+
+    cpuStartTiming(0);
+
+    for (int j = 0; j < ITERATIONS; j++)
+    {
+        for (size_t i = 0; i < NUM_FILES; i++)
+        {
+            snprintf(path, sizeof(path), "%s%s", prefix, files[i]);
+
+            char *data = NE_FATLoadData(path);
+            if (data == NULL)
+            {
+                cpuEndTiming();
+                return -1;
+            }
+
+            free(data);
+        }
+    }
+
+    uint32_t ticks = cpuEndTiming();
+
+    return timerTicks2usec(ticks) / ITERATIONS;
+}
+
+static bool check_files(void)
+{
+    char path[128];
+    bool ok = true;
+
+    for (size_t i = 0; i < NUM_FILES; i++)
+    {
+        snprintf(path, sizeof(path), "files/%s", files[i]);
+        size_t size = NE_FATFileSize(path);
+        char *a = NE_FATLoadData(path);
+
+        snprintf(path, sizeof(path), "assets:%s", files[i]);
+        size_t size_archive = NE_FATFileSize(path);
+        char *b = NE_FATLoadData(path);
+
+        if ((a == NULL) || (b == NULL) || (size != size_archive) ||
+            (memcmp(a, b, size) != 0))
+        {
+            printf("Mismatch: %s\n", files[i]);
+            ok = false;
+        }
+
+        free(a);
+        free(b);
+    }
+
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    NE_Init3D();
+    // libnds uses VRAM_C for the text console, reserve A and B only
+    NE_TextureSystemReset(0, 0, NE_VRAM_AB);
+
+    // This is needed to print text
+    consoleDemoInit();
+
+    if (!nitroFSInit(NULL))
+    {
+        printf("nitroFSInit failed.\n");
+        while (1)
+            NE_WaitForVBL(0);
+    }
+
+    cpuStartTiming(0);
+    int ret = NE_FATArchiveOpen("assets", "assets.pak");
+    uint32_t open_us = timerTicks2usec(cpuEndTiming());
+
+    if (ret == 0)
+    {
+        printf("Can't open archive\n");
+        while (1)
+            NE_WaitForVBL(0);
+    }
+
+    printf("Archive opened: %u us\n", (unsigned int)open_us);
+
+    if (check_files())
+        printf("All files match\n");
+
+    // The engine loaders accept paths inside the archive too
+    NE_Material *mat = NE_MaterialCreate();
+    NE_Palette *pal = NE_PaletteCreate();
+    if ((NE_MaterialTexLoadFAT(mat, NE_A3PAL32, 64, 64, NE_TEXGEN_TEXCOORD,
+                        "assets:textures/spiral_blue_pal32.img.bin") == 0) ||
+        (NE_PaletteLoadFAT(pal, "assets:textures/spiral_blue_pal32.pal.bin",
+                           NE_A3PAL32) == 0))
+    {
+        printf("Can't load texture from archive\n");
+    }
+    NE_MaterialDelete(mat);
+    NE_PaletteDelete(pal);
+
+    int us_files = benchmark("files/");
+    int us_archive = benchmark("assets:");
+
+    printf("\n");
+    printf("Load all files\n");
+    printf("  NitroFS: %7d us\n", us_files);
+    printf("  Archive: %7d us\n", us_archive);
+
+    NE_FATArchiveClose("assets");
+
+    printf("Done!\n");
+
+    while (1)
+        NE_WaitForVBL(0);
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Antonio Niño Díaz, 2024
+//
+// This file is part of Nitro Engine
+
+// This test loads the same model, animation and texture from NitroFS for
+// several robots, first with the asset cache enabled and then with it
+// disabled. It prints the statistics of the cache and the free VRAM and the
+// time it takes to load all the robots in each case.
+
+#include <filesystem.h>
+
+#include <NEMain.h>
+
+// Each texture uses 128 KB of VRAM, so only two of them fit in banks A and B
+// when the cache is disabled.
+#define NUM_ROBOTS 2
+
+static const char *type_names[NE_ASSET_TYPES] = {
+    [NE_ASSET_MESH] = "Mesh",
+    [NE_ASSET_ANIMATION] = "Anim",
+    [NE_ASSET_TEXTURE] = "Texture",
+};
+
+typedef struct {
+    NE_Model *model;
+    NE_Animation *anim;
+    NE_Material *material;
+} robot_t;
+
+static robot_t robots[NUM_ROBOTS];
+
+static int load_robots(void)
+{
+    for (int i = 0; i < NUM_ROBOTS; i++)
+    {
+        robot_t *r = &robots[i];
+
+        r->model = NE_ModelCreate(NE_Animated);
+        r->anim = NE_AnimationCreate();
+        r->material = NE_MaterialCreate();
+
+        if (NE_ModelLoadDSMFAT(r->model, "robot.dsm") == 0)
+            return 0;
+        if (NE_AnimationLoadFAT(r->anim, "robot_wave.dsa") == 0)
+            return 0;
+        if (NE_MaterialTexLoadFAT(r->material, NE_A1RGB5, 256, 256,
+                                  NE_TEXGEN_TEXCOORD, "texture.img.bin") == 0)
+            return 0;
+
+        NE_ModelSetAnimation(r->model, r->anim);
+        NE_ModelSetMaterial(r->model, r->material);
+    }
+
+    return 1;
+}
+
+static void delete_robots(void)
+{
+    for (int i = 0; i < NUM_ROBOTS; i++)
+    {
+        robot_t *r = &robots[i];
+
+        // Robots after the one that failed to load haven't been created
+        if (r->model == NULL)
+            break;
+
+        NE_ModelDelete(r->model);
+        NE_AnimationDelete(r->anim);
+        NE_MaterialDelete(r->material);
+
+        r->model = NULL;
+    }
+}
+
+static void run_test(bool enabled)
+{
+    printf("Cache %s\n", enabled ? "enabled" : "disabled");
+
+    NE_AssetCacheSetEnabled(enabled);
+    NE_AssetCacheResetStats();
+
+    cpuStartTiming(0);
+    int ret = load_robots();
+    uint32_t ticks = cpuEndTiming();
+
+    if (ret == 0)
+    {
+        printf("  Failed to load robots\n");
+        delete_robots();
+        return;
+    }
+
+    printf("  Time: %lu us\n", timerTicks2usec(ticks));
+    printf("  Free VRAM: %d B\n", NE_TextureFreeMem());
+    printf("  Type    Hit Miss  Saved Res\n");
+
+    for (int i = 0; i < NE_ASSET_TYPES; i++)
+    {
+        NE_AssetCacheStats stats;
+        NE_AssetCacheGetStats(i, &stats);
+
+        printf("  %-7s %3lu %4lu %6lu %3lu\n", type_names[i], stats.hits,
+               stats.misses, stats.bytes_saved, stats.resident);
+    }
+
+    delete_robots();
+}
+
+int main(int argc, char *argv[])
+{
+    NE_Init3D();
+    // libnds uses VRAM_C for the text console, reserve A and B only
+    NE_TextureSystemReset(0, 0, NE_VRAM_AB);
+
+    // This is needed to print text
+    consoleDemoInit();
+
+    if (!nitroFSInit(NULL))
+    {
+        printf("nitroFSInit failed.\n");
+        while (1)
+            NE_WaitForVBL(0);
+    }
+
+    run_test(true);
+    printf("\n");
+    run_test(false);
+
+    // Everything has been freed, so nothing should be left in the cache
+    printf("\n");
+    for (int i = 0; i < NE_ASSET_TYPES; i++)
+    {
+        NE_AssetCacheStats stats;
+        NE_AssetCacheGetStats(i, &stats);
+        printf("%s resident: %lu\n", type_names[i], stats.resident);
+    }
+
+    printf("Done!\n");
+
+    while (1)
+        NE_WaitForVBL(0);
+
+    return 0;
+}
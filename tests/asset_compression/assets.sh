@@ -0,0 +1,38 @@
+#!/bin/sh
+
+NITRO_ENGINE=../..
+ASSETS=$NITRO_ENGINE/examples/assets
+TOOLS=$NITRO_ENGINE/tools
+MD5_TO_DSMA=$TOOLS/md5_to_dsma/md5_to_dsma.py
+LZ77=$TOOLS/common/lz77.py
+BLOCKSDS="${BLOCKSDS:-/opt/blocksds/core/}"
+GRIT=$BLOCKSDS/tools/grit/grit
+
+rm -rf nitrofiles
+mkdir -p nitrofiles/raw nitrofiles/lz
+
+python3 $MD5_TO_DSMA \
+    --model $ASSETS/robot/Robot.md5mesh \
+    --name robot \
+    --output nitrofiles/raw \
+    --texture 256 256 \
+    --anim $ASSETS/robot/Wave.md5anim \
+    --skip-frames 1 \
+    --blender-fix
+
+python3 $MD5_TO_DSMA \
+    --model $ASSETS/robot/Robot.md5mesh \
+    --name robot \
+    --output nitrofiles/lz \
+    --texture 256 256 \
+    --anim $ASSETS/robot/Wave.md5anim \
+    --skip-frames 1 \
+    --blender-fix \
+    --compress
+
+$GRIT \
+    $NITRO_ENGINE/examples/loading/filesystem_animated_model/graphics/texture.png \
+    -ftb -fh! -gx -gb -gB16 -gT! -W1 \
+    -onitrofiles/raw/texture
+
+python3 $LZ77 nitrofiles/raw/texture.img.bin nitrofiles/lz/texture.img.bin
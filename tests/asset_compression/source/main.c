@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Antonio Niño Díaz, 2024
+//
+// This file is part of Nitro Engine
+
+// This test loads the same assets from NitroFS uncompressed and compressed
+// with the "--compress" option of the tools, and it prints the size of the
+// files and the time it takes to load them.
+
+#include <filesystem.h>
+
+#include <NEMain.h>
+
+#define ITERATIONS 8
+
+typedef enum {
+    ASSET_MODEL,
+    ASSET_ANIMATION,
+    ASSET_TEXTURE,
+} asset_type_t;
+
+typedef struct {
+    const char *name;
+    asset_type_t type;
+} asset_t;
+
+static const asset_t assets[] = {
+    { "robot.dsm", ASSET_MODEL },
+    { "robot_wave.dsa", ASSET_ANIMATION },
+    { "texture.img.bin", ASSET_TEXTURE },
+};
+
+#define NUM_ASSETS (sizeof(assets) / sizeof(assets[0]))
+
+static int load_asset(const asset_t *asset, const char *path)
+{
+    int ret = 0;
+
+    switch (asset->type)
+    {
+        case ASSET_MODEL:
+        {
+            NE_Model *model = NE_ModelCreate(NE_Animated);
+            ret = NE_ModelLoadDSMFAT(model, path);
+            NE_ModelDelete(model);
+            break;
+        }
+        case ASSET_ANIMATION:
+        {
+            NE_Animation *anim = NE_AnimationCreate();
+            ret = NE_AnimationLoadFAT(anim, path);
+            NE_AnimationDelete(anim);
+            break;
+        }
+        case ASSET_TEXTURE:
+        {
+            NE_Material *mat = NE_MaterialCreate();
+            ret = NE_MaterialTexLoadFAT(mat, NE_A1RGB5, 256, 256,
+                                        NE_TEXGEN_TEXCOORD, path);
+            NE_MaterialDelete(mat);
+            break;
+        }
+    }
+
+    return ret;
+}
+
+// Returns the average time it takes to load an asset in microseconds, or -1
+// on error.
+static int benchmark_asset(const asset_t *asset, const char *path)
+{
+    cpuStartTiming(0);
+
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        if (load_asset(asset, path) == 0)
+        {
+            cpuEndTiming();
+            return -1;
+        }
+    }
+
+    uint32_t ticks = cpuEndTiming();
+
+    return timerTicks2usec(ticks) / ITERATIONS;
+}
+
+int main(int argc, char *argv[])
+{
+    NE_Init3D();
+    // libnds uses VRAM_C for the text console, reserve A and B only
+    NE_TextureSystemReset(0, 0, NE_VRAM_AB);
+
+    // This is needed to print text
+    consoleDemoInit();
+
+    if (!nitroFSInit(NULL))
+    {
+        printf("nitroFSInit failed.\n");
+        while (1)
+            NE_WaitForVBL(0);
+    }
+
+    size_t total_raw = 0, total_lz = 0;
+    int time_raw = 0, time_lz = 0;
+
+    for (size_t i = 0; i < NUM_ASSETS; i++)
+    {
+        const asset_t *asset = &assets[i];
+
+        char path_raw[64], path_lz[64];
+        snprintf(path_raw, sizeof(path_raw), "raw/%s", asset->name);
+        snprintf(path_lz, sizeof(path_lz), "lz/%s", asset->name);
+
+        size_t size_raw = NE_FATFileSize(path_raw);
+        size_t size_lz = NE_FATFileSize(path_lz);
+
+        int us_raw = benchmark_asset(asset, path_raw);
+        int us_lz = benchmark_asset(asset, path_lz);
+
+        printf("%s\n", asset->name);
+        if ((us_raw < 0) || (us_lz < 0))
+        {
+            printf("  Failed to load\n");
+            continue;
+        }
+
+        printf("  Raw: %6u B %7d us\n", (unsigned int)size_raw, us_raw);
+        printf("  LZ:  %6u B %7d us\n", (unsigned int)size_lz, us_lz);
+
+        total_raw += size_raw;
+        total_lz += size_lz;
+        time_raw += us_raw;
+        time_lz += us_lz;
+    }
+
+    printf("\n");
+    printf("Total\n");
+    printf("  Raw: %6u B %7d us\n", (unsigned int)total_raw, time_raw);
+    printf("  LZ:  %6u B %7d us\n", (unsigned int)total_lz, time_lz);
+    printf("  Size: %d%%\n", (int)((total_lz * 100) / total_raw));
+
+    printf("Done!\n");
+
+    while (1)
+        NE_WaitForVBL(0);
+
+    return 0;
+}
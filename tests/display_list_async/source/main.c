@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Antonio Niño Díaz, 2024
+//
+// This file is part of Nitro Engine
+
+// This test draws the same model several times per frame, and it does some
+// CPU work after sending each model to the GPU, like a game would do while
+// updating its objects. It prints the CPU time that the scene takes when the
+// display lists are sent synchronously and asynchronously.
+//
+// In the "Async" test NE_ModelDraw() returns while the mesh is still being sent
+// to the GPU, so the work of each object is done during the transfer. The test
+// also counts how many times the work has started while the DMA was still
+// busy, which shows that the CPU and the transfer have really overlapped. The
+// last test sends the display lists directly.
+
+#include <NEMain.h>
+
+#include "teapot_bin.h"
+
+#define NUM_MODELS 6
+#define NUM_FRAMES 60
+
+typedef enum {
+    TEST_SYNC,
+    TEST_ASYNC,
+    TEST_ASYNC_PREFLUSHED,
+} test_mode_t;
+
+static const char *mode_names[] = {
+    [TEST_SYNC] = "Sync",
+    [TEST_ASYNC] = "Async",
+    [TEST_ASYNC_PREFLUSHED] = "Async flushed",
+};
+
+static NE_Camera *camera;
+static NE_Model *models[NUM_MODELS];
+static test_mode_t mode;
+static uint32_t scene_ticks;
+static uint32_t overlapped;
+
+static volatile int32_t work_result;
+
+// Simulates the update of the logic of one object
+static void do_work(void)
+{
+    int32_t value = work_result;
+
+    for (int i = 0; i < 2000; i++)
+        value = value * 1103515245 + 12345;
+
+    work_result = value;
+}
+
+static void draw_scene(void)
+{
+    cpuStartTiming(0);
+
+    NE_CameraUse(camera);
+
+    for (int i = 0; i < NUM_MODELS; i++)
+    {
+        if (mode == TEST_ASYNC_PREFLUSHED)
+        {
+            // Send the display list directly. It has been flushed from the
+            // data cache at the start of the test.
+            NE_DisplayListWait();
+
+            MATRIX_PUSH = 0;
+            MATRIX_TRANSLATE = floattof32(-2.5 + i);
+            MATRIX_TRANSLATE = 0;
+            MATRIX_TRANSLATE = 0;
+            MATRIX_SCALE = floattof32(0.5);
+            MATRIX_SCALE = floattof32(0.5);
+            MATRIX_SCALE = floattof32(0.5);
+
+            NE_DisplayListDrawAsync(teapot_bin, NE_DL_PREFLUSHED);
+
+            if (dmaBusy(0))
+                overlapped++;
+
+            do_work();
+
+            NE_DisplayListWait();
+
+            MATRIX_POP = 1;
+        }
+        else
+        {
+            NE_ModelDraw(models[i]);
+
+            if (dmaBusy(0))
+                overlapped++;
+
+            do_work();
+        }
+    }
+
+    // The wait before GFX_FLUSH is included in the time
+    NE_DisplayListWait();
+
+    scene_ticks += cpuEndTiming();
+}
+
+static void run_test(test_mode_t test_mode)
+{
+    mode = test_mode;
+
+    if (mode == TEST_SYNC)
+        NE_DisplayListSetDefaultFunction(NE_DL_DMA_GFX_FIFO);
+    else
+        NE_DisplayListSetDefaultFunction(NE_DL_DMA_GFX_FIFO_ASYNC);
+
+    if (mode == TEST_ASYNC_PREFLUSHED)
+        DC_FlushRange(teapot_bin, teapot_bin_size);
+
+    scene_ticks = 0;
+    overlapped = 0;
+
+    for (int i = 0; i < NUM_FRAMES; i++)
+    {
+        NE_WaitForVBL(0);
+        NE_Process(draw_scene);
+    }
+
+    printf("%-13s: %6lu us/frame\n", mode_names[mode],
+           timerTicks2usec(scene_ticks) / NUM_FRAMES);
+    printf("  Overlapped: %lu/%d\n", overlapped, NUM_MODELS * NUM_FRAMES);
+}
+
+int main(int argc, char *argv[])
+{
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NE_VBLFunc);
+    irqSet(IRQ_HBLANK, NE_HBLFunc);
+
+    NE_Init3D();
+    // libnds uses VRAM_C for the text console, reserve A and B only
+    NE_TextureSystemReset(0, 0, NE_VRAM_AB);
+
+    // This is needed to print text
+    consoleDemoInit();
+
+    camera = NE_CameraCreate();
+    NE_CameraSet(camera,
+                 0, 2, 4,
+                 0, 0, 0,
+                 0, 1, 0);
+
+    for (int i = 0; i < NUM_MODELS; i++)
+    {
+        models[i] = NE_ModelCreate(NE_Static);
+        NE_ModelLoadStaticMesh(models[i], teapot_bin);
+        NE_ModelSetCoord(models[i], -2.5 + i, 0, 0);
+        NE_ModelScale(models[i], 0.5, 0.5, 0.5);
+    }
+
+    NE_LightSet(0, NE_White, 0, -1, -1);
+
+    run_test(TEST_SYNC);
+    run_test(TEST_ASYNC);
+    run_test(TEST_ASYNC_PREFLUSHED);
+
+    printf("Done!\n");
+
+    while (1)
+    {
+        NE_WaitForVBL(0);
+        NE_Process(draw_scene);
+    }
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Antonio Niño Díaz, 2024
+//
+// This file is part of Nitro Engine
+
+// This test draws a HUD made of many 2D quads and sprites. First it draws them
+// with the regular functions every frame, then it records them in a display
+// list and draws the display list every frame. It prints the CPU time that the
+// HUD takes in both cases and the size of the display list.
+//
+// The top half of the screen should look the same during the whole test.
+
+#include <NEMain.h>
+
+#define NUM_QUADS   64
+#define NUM_SPRITES 32
+#define NUM_FRAMES  60
+
+static NE_Material *material;
+static NE_DisplayListBuilder *builder;
+static bool use_builder;
+static uint32_t hud_ticks;
+
+static u16 texture_data[32 * 32];
+
+static void draw_hud(void)
+{
+    NE_2DViewInit();
+
+    for (int i = 0; i < NUM_QUADS; i++)
+    {
+        int x = (i % 16) * 16;
+        int y = (i / 16) * 12;
+
+        if (i & 1)
+        {
+            NE_2DDrawQuad(x, y, x + 14, y + 10, 1, RGB15(i & 31, 0, 31));
+        }
+        else
+        {
+            NE_2DDrawQuadGradient(x, y, x + 14, y + 10, 1,
+                                  NE_Red, NE_Green, NE_Blue, NE_White);
+        }
+    }
+
+    NE_SpriteDrawAll();
+}
+
+static void draw_scene(void)
+{
+    cpuStartTiming(0);
+
+    // The display list includes the call to NE_2DViewInit()
+    if (use_builder)
+        NE_DisplayListBuilderDraw(builder);
+    else
+        draw_hud();
+
+    hud_ticks += cpuEndTiming();
+}
+
+static void run_test(bool builder_enabled)
+{
+    use_builder = builder_enabled;
+    hud_ticks = 0;
+
+    for (int i = 0; i < NUM_FRAMES; i++)
+    {
+        NE_WaitForVBL(0);
+        NE_Process(draw_scene);
+    }
+
+    printf("%-9s: %5lu us/frame\n", use_builder ? "Recorded" : "Immediate",
+           timerTicks2usec(hud_ticks) / NUM_FRAMES);
+}
+
+int main(int argc, char *argv[])
+{
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NE_VBLFunc);
+    irqSet(IRQ_HBLANK, NE_HBLFunc);
+
+    NE_Init3D();
+    // libnds uses VRAM_C for the text console, reserve A and B only
+    NE_TextureSystemReset(0, 0, NE_VRAM_AB);
+
+    // This is needed to print text
+    consoleDemoInit();
+
+    for (int i = 0; i < 32 * 32; i++)
+        texture_data[i] = RGB15(i & 31, (i >> 5) & 31, 16) | BIT(15);
+
+    material = NE_MaterialCreate();
+    NE_MaterialTexLoad(material, NE_A1RGB5, 32, 32, NE_TEXGEN_TEXCOORD,
+                       texture_data);
+
+    NE_SpriteSystemReset(NUM_SPRITES);
+
+    for (int i = 0; i < NUM_SPRITES; i++)
+    {
+        NE_Sprite *sprite = NE_SpriteCreate();
+        NE_SpriteSetMaterial(sprite, material);
+        NE_SpriteSetPos(sprite, (i % 16) * 16, 48 + (i / 16) * 20);
+        NE_SpriteSetSize(sprite, 16, 16);
+        NE_SpriteSetPriority(sprite, 2);
+        NE_SpriteSetRot(sprite, i * 16);
+    }
+
+    run_test(false);
+
+    builder = NE_DisplayListBuilderCreate(1024);
+
+    NE_DisplayListBuilderBegin(builder);
+    draw_hud();
+    if (NE_DisplayListBuilderEnd(builder) == 0)
+    {
+        printf("Failed to record HUD\n");
+        while (1)
+            NE_WaitForVBL(0);
+    }
+
+    printf("Display list: %u words\n", (unsigned int)builder->used);
+
+    run_test(true);
+
+    printf("Done!\n");
+
+    while (1)
+    {
+        NE_WaitForVBL(0);
+        NE_Process(draw_scene);
+    }
+
+    return 0;
+}
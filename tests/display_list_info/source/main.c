@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Antonio Niño Díaz, 2024
+//
+// This file is part of Nitro Engine
+
+// This test analyzes a display list, and it checks that corrupted display lists
+// are detected.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <NEMain.h>
+
+#include "teapot_bin.h"
+
+static void print_result(const char *name, const NE_DisplayListInfo *info)
+{
+    const char *errors[] = {
+        [NE_DL_VALID] = "Valid",
+        [NE_DL_ERROR_TRUNCATED] = "Truncated",
+        [NE_DL_ERROR_INVALID_COMMAND] = "Invalid command",
+        [NE_DL_ERROR_INVALID_RESTORE] = "Invalid restore",
+    };
+
+    printf("%s: %s (%lu)\n", name, errors[info->error], info->error_offset);
+}
+
+int main(int argc, char *argv[])
+{
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NE_VBLFunc);
+    irqSet(IRQ_HBLANK, NE_HBLFunc);
+
+    // This is needed to print text
+    consoleDemoInit();
+
+    NE_DisplayListInfo info;
+
+    NE_DisplayListAnalyze(teapot_bin, teapot_bin_size, 0, &info);
+
+    printf("teapot.bin\n");
+    printf("  Words:     %lu\n", info.words);
+    printf("  Commands:  %lu\n", info.commands);
+    printf("  Vertices:  %lu\n", info.vertices);
+    printf("  Triangles: %lu\n", info.triangles);
+    printf("  Quads:     %lu\n", info.quads);
+    printf("  Cycles:    %lu\n", info.cycles);
+    print_result("  Result", &info);
+    printf("\n");
+
+    // Make a copy of the display list to corrupt it
+
+    u32 *list = malloc(teapot_bin_size);
+    if (list == NULL)
+    {
+        printf("Not enough memory");
+        while (1)
+            swiWaitForVBlank();
+    }
+
+    memcpy(list, teapot_bin, teapot_bin_size);
+    NE_DisplayListAnalyze(list, teapot_bin_size - 8, 0, &info);
+    print_result("Truncated", &info);
+
+    // Replace the first command by SWAP_BUFFERS
+    memcpy(list, teapot_bin, teapot_bin_size);
+    list[1] = (list[1] & ~0xFF) | 0x50;
+    NE_DisplayListAnalyze(list, teapot_bin_size, 0, &info);
+    print_result("Swap buffers", &info);
+
+    // Restore matrix 0 in a model with 4 joints
+    u32 restore[] = { 2, 0x14, 0 };
+    NE_DisplayListAnalyze(restore, sizeof(restore), 4, &info);
+    print_result("Restore 0", &info);
+
+    restore[2] = 27;
+    NE_DisplayListAnalyze(restore, sizeof(restore), 4, &info);
+    print_result("Restore 27", &info);
+
+    free(list);
+
+    printf("\nDone!\n");
+
+    while (1)
+        swiWaitForVBlank();
+
+    return 0;
+}
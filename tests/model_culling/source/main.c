@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Antonio Niño Díaz, 2024
+//
+// This file is part of Nitro Engine
+
+// This test draws a grid of 500 models around the camera, so most of them are
+// outside of the view. It draws the scene with culling disabled, with the box
+// test culling, with the CPU culling of NE_ModelDraw() and with the CPU culling
+// of NE_ModelCullBatch(). It prints the time that the scene takes and the
+// number of models tested, culled and drawn in a frame of each test.
+//
+// Without culling there are more polygons than the GPU can draw, so some of
+// the models may be missing. With culling all visible models should be drawn.
+
+#include <NEMain.h>
+
+#include "cube_bin.h"
+
+#define GRID_WIDTH  25
+#define GRID_DEPTH  20
+#define NUM_MODELS  (GRID_WIDTH * GRID_DEPTH)
+#define NUM_FRAMES  60
+
+typedef enum {
+    TEST_NONE,
+    TEST_BOX_TEST,
+    TEST_CPU,
+    TEST_CPU_BATCH,
+} test_mode_t;
+
+static const char *mode_names[] = {
+    [TEST_NONE] = "None",
+    [TEST_BOX_TEST] = "Box test",
+    [TEST_CPU] = "CPU",
+    [TEST_CPU_BATCH] = "CPU batch",
+};
+
+static NE_Camera *camera;
+static NE_Model *models[NUM_MODELS];
+static NE_Model *visible[NUM_MODELS];
+static test_mode_t mode;
+static uint32_t scene_ticks;
+
+static void draw_scene(void)
+{
+    cpuStartTiming(0);
+
+    NE_CameraUse(camera);
+
+    if (mode == TEST_CPU_BATCH)
+    {
+        int count = NE_ModelCullBatch(camera, models, NUM_MODELS, visible);
+
+        for (int i = 0; i < count; i++)
+            NE_ModelDraw(visible[i]);
+    }
+    else
+    {
+        for (int i = 0; i < NUM_MODELS; i++)
+            NE_ModelDraw(models[i]);
+    }
+
+    // Make sure that the GPU has received all commands
+    NE_DisplayListWait();
+
+    scene_ticks += cpuEndTiming();
+}
+
+static void run_test(test_mode_t test_mode)
+{
+    mode = test_mode;
+
+    if (mode == TEST_BOX_TEST)
+        NE_ModelCullingSetMode(NE_MODEL_CULLING_BOX_TEST);
+    else if (mode == TEST_CPU)
+        NE_ModelCullingSetMode(NE_MODEL_CULLING_CPU);
+    else
+        NE_ModelCullingSetMode(NE_MODEL_CULLING_NONE);
+
+    scene_ticks = 0;
+
+    for (int i = 0; i < NUM_FRAMES; i++)
+    {
+        NE_WaitForVBL(0);
+        NE_Process(draw_scene);
+    }
+
+    // These are the statistics of the frame before the last one
+    NE_ModelCullingStats stats;
+    NE_ModelCullingGetStats(&stats);
+
+    printf("%-9s: %5lu us/frame\n", mode_names[mode],
+           timerTicks2usec(scene_ticks) / NUM_FRAMES);
+    printf("  Tested %lu, culled %lu, drawn %lu\n",
+           stats.tested, stats.culled, stats.drawn);
+}
+
+int main(int argc, char *argv[])
+{
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NE_VBLFunc);
+    irqSet(IRQ_HBLANK, NE_HBLFunc);
+
+    NE_Init3D();
+    // libnds uses VRAM_C for the text console, reserve A and B only
+    NE_TextureSystemReset(0, 0, NE_VRAM_AB);
+
+    // This is needed to print text
+    consoleDemoInit();
+
+    NE_ClippingPlanesSet(0.1, 20);
+
+    camera = NE_CameraCreate();
+    NE_CameraSet(camera,
+                 0, 1, 0,
+                 0, 0.8, -1,
+                 0, 1, 0);
+
+    for (int i = 0; i < NUM_MODELS; i++)
+    {
+        models[i] = NE_ModelCreate(NE_Static);
+
+        // The first model calculates the bounds of the mesh, the others
+        // share them.
+        if (i == 0)
+            NE_ModelLoadStaticMesh(models[i], cube_bin);
+        else
+            NE_ModelClone(models[i], models[0]);
+
+        int x = i % GRID_WIDTH - GRID_WIDTH / 2;
+        int z = i / GRID_WIDTH - GRID_DEPTH / 2;
+
+        NE_ModelSetCoordI(models[i], inttof32(x), 0, inttof32(z));
+        NE_ModelSetRot(models[i], 0, i & 511, 0);
+        NE_ModelScale(models[i], 0.25, 0.25, 0.25);
+    }
+
+    NE_LightSet(0, NE_White, 0, -1, -1);
+
+    run_test(TEST_NONE);
+    run_test(TEST_BOX_TEST);
+    run_test(TEST_CPU);
+    run_test(TEST_CPU_BATCH);
+
+    printf("Done!\n");
+
+    while (1)
+    {
+        NE_WaitForVBL(0);
+        NE_Process(draw_scene);
+    }
+
+    return 0;
+}
@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Antonio Niño Díaz, 2024
+//
+// This file is part of Nitro Engine
+
+// This test draws a grid of 200 cubes. First it draws 200 models with
+// NE_ModelDraw(), then it draws one model 200 times with
+// NE_ModelDrawInstances() and NE_ModelDrawInstancesMatrix(). It prints the time
+// that the scene takes with each method.
+//
+// At the end it draws a few instances of an animated model, each one of them
+// at a different frame of the animation.
+
+#include <NEMain.h>
+
+#include "cube_bin.h"
+#include "robot_dsm_bin.h"
+#include "robot_wave_dsa_bin.h"
+
+#define GRID_WIDTH      20
+#define GRID_HEIGHT     10
+#define NUM_MODELS      (GRID_WIDTH * GRID_HEIGHT)
+#define NUM_ROBOTS      4
+#define NUM_FRAMES      60
+
+typedef enum {
+    TEST_MODELS,
+    TEST_INSTANCES,
+    TEST_INSTANCES_MATRIX,
+    TEST_ANIMATED,
+} test_mode_t;
+
+static const char *mode_names[] = {
+    [TEST_MODELS] = "Models",
+    [TEST_INSTANCES] = "Instances",
+    [TEST_INSTANCES_MATRIX] = "Matrices",
+};
+
+static NE_Camera *camera;
+static NE_Model *models[NUM_MODELS];
+static NE_ModelInstance instances[NUM_MODELS];
+static m4x3 matrices[NUM_MODELS];
+
+static NE_Model *robot;
+static NE_ModelInstance robot_instances[NUM_ROBOTS];
+
+static test_mode_t mode;
+static uint32_t scene_ticks;
+
+static void draw_scene(void)
+{
+    cpuStartTiming(0);
+
+    NE_CameraUse(camera);
+
+    NE_PolyFormat(31, 0, NE_LIGHT_0, NE_CULL_BACK, 0);
+
+    if (mode == TEST_MODELS)
+    {
+        for (int i = 0; i < NUM_MODELS; i++)
+            NE_ModelDraw(models[i]);
+    }
+    else if (mode == TEST_INSTANCES)
+    {
+        NE_ModelDrawInstances(models[0], instances, NUM_MODELS);
+    }
+    else if (mode == TEST_INSTANCES_MATRIX)
+    {
+        NE_ModelDrawInstancesMatrix(models[0], matrices, NULL, NUM_MODELS);
+    }
+    else // if (mode == TEST_ANIMATED)
+    {
+        NE_ModelDrawInstances(robot, robot_instances, NUM_ROBOTS);
+    }
+
+    // Make sure that the GPU has received all commands
+    NE_DisplayListWait();
+
+    scene_ticks += cpuEndTiming();
+}
+
+static void run_test(test_mode_t test_mode)
+{
+    mode = test_mode;
+
+    scene_ticks = 0;
+
+    for (int i = 0; i < NUM_FRAMES; i++)
+    {
+        NE_WaitForVBL(0);
+        NE_Process(draw_scene);
+    }
+
+    // These are the statistics of the frame before the last one
+    NE_ModelCullingStats stats;
+    NE_ModelCullingGetStats(&stats);
+
+    printf("%-9s: %5lu us/frame\n", mode_names[mode],
+           timerTicks2usec(scene_ticks) / NUM_FRAMES);
+    printf("  Drawn %lu\n", stats.drawn);
+}
+
+static void update_robots(void)
+{
+    int32_t numframes = inttof32(robot->animinfo[0]->numframes);
+
+    for (int i = 0; i < NUM_ROBOTS; i++)
+    {
+        robot_instances[i].frame += floattof32(0.1);
+        if (robot_instances[i].frame >= numframes)
+            robot_instances[i].frame -= numframes;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NE_VBLFunc);
+    irqSet(IRQ_HBLANK, NE_HBLFunc);
+
+    NE_Init3D();
+    // libnds uses VRAM_C for the text console, reserve A and B only
+    NE_TextureSystemReset(0, 0, NE_VRAM_AB);
+
+    // This is needed to print text
+    consoleDemoInit();
+
+    camera = NE_CameraCreate();
+    NE_CameraSet(camera,
+                 0, 0, 8,
+                 0, 0, 0,
+                 0, 1, 0);
+
+    for (int i = 0; i < NUM_MODELS; i++)
+    {
+        models[i] = NE_ModelCreate(NE_Static);
+
+        if (i == 0)
+            NE_ModelLoadStaticMesh(models[i], cube_bin);
+        else
+            NE_ModelClone(models[i], models[0]);
+
+        int x = floattof32(0.5) * (i % GRID_WIDTH - GRID_WIDTH / 2);
+        int y = floattof32(0.5) * (i / GRID_WIDTH - GRID_HEIGHT / 2);
+        int ry = (i * 8) & 511;
+
+        NE_ModelSetCoordI(models[i], x, y, 0);
+        NE_ModelSetRot(models[i], 0, ry, 0);
+        NE_ModelScale(models[i], 0.15, 0.15, 0.15);
+
+        // Same transformation, but as an instance of the first model
+        instances[i] = (NE_ModelInstance) {
+            .x = x, .y = y, .z = 0,
+            .rx = 0, .ry = ry, .rz = 0,
+            .sx = floattof32(0.15), .sy = floattof32(0.15),
+            .sz = floattof32(0.15),
+        };
+
+        // Same transformation, as a matrix
+        int32_t sine = mulf32(sinLerp(ry << 6), floattof32(0.15));
+        int32_t cosine = mulf32(cosLerp(ry << 6), floattof32(0.15));
+        matrices[i] = (m4x3) {{
+            cosine, 0, -sine,
+            0, floattof32(0.15), 0,
+            sine, 0, cosine,
+            x, y, 0
+        }};
+    }
+
+    robot = NE_ModelCreate(NE_Animated);
+    NE_Animation *animation = NE_AnimationCreate();
+    NE_AnimationLoad(animation, robot_wave_dsa_bin);
+    NE_ModelLoadDSM(robot, robot_dsm_bin);
+    NE_ModelSetAnimation(robot, animation);
+
+    int32_t numframes = inttof32(robot->animinfo[0]->numframes);
+
+    for (int i = 0; i < NUM_ROBOTS; i++)
+    {
+        robot_instances[i] = (NE_ModelInstance) {
+            .x = floattof32(-3) + floattof32(2) * i, .y = floattof32(-2),
+            .z = 0,
+            .rx = 0, .ry = 0, .rz = 0,
+            .sx = floattof32(0.6), .sy = floattof32(0.6),
+            .sz = floattof32(0.6),
+            .frame = numframes * i / NUM_ROBOTS,
+        };
+    }
+
+    NE_LightSet(0, NE_White, 0, -1, -1);
+
+    run_test(TEST_MODELS);
+    run_test(TEST_INSTANCES);
+    run_test(TEST_INSTANCES_MATRIX);
+
+    printf("Done!\n");
+
+    mode = TEST_ANIMATED;
+
+    while (1)
+    {
+        NE_WaitForVBL(0);
+        update_robots();
+        NE_Process(draw_scene);
+    }
+
+    return 0;
+}
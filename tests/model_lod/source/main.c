@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Antonio Niño Díaz, 2024
+//
+// This file is part of Nitro Engine
+
+// This test draws a grid of models with three levels of detail: a teapot, a
+// sphere and a cube. First it draws them with the levels of detail selected
+// only by distance. That uses more polygons than the GPU can draw. Then it
+// enables the polygon budget. After a few frames the distant models should use
+// simpler meshes and all models should be visible.
+//
+// It prints the number of polygons and vertices drawn in the last frame of each
+// test, and the bias applied to the depth of the models.
+
+#include <NEMain.h>
+
+#include "cube_bin.h"
+#include "sphere_bin.h"
+#include "teapot_bin.h"
+
+#define GRID_WIDTH  8
+#define GRID_DEPTH  6
+#define NUM_MODELS  (GRID_WIDTH * GRID_DEPTH)
+#define NUM_FRAMES  60
+
+static NE_Camera *camera;
+static NE_Model *models[NUM_MODELS];
+
+static void draw_scene(void)
+{
+    NE_CameraUse(camera);
+
+    for (int i = 0; i < NUM_MODELS; i++)
+        NE_ModelDraw(models[i]);
+}
+
+static void run_test(const char *name, int polygons, int vertices)
+{
+    NE_ModelLodSetBudget(polygons, vertices);
+
+    for (int i = 0; i < NUM_FRAMES; i++)
+    {
+        NE_WaitForVBL(0);
+        NE_Process(draw_scene);
+    }
+
+    printf("%s\n", name);
+    printf("  Polygons %d, vertices %d\n",
+           NE_GetPolygonCount(), NE_GetVertexCount());
+    printf("  Bias %.3f\n", f32tofloat(NE_ModelLodGetBias()));
+}
+
+int main(int argc, char *argv[])
+{
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NE_VBLFunc);
+    irqSet(IRQ_HBLANK, NE_HBLFunc);
+
+    NE_Init3D();
+    // libnds uses VRAM_C for the text console, reserve A and B only
+    NE_TextureSystemReset(0, 0, NE_VRAM_AB);
+
+    // This is needed to print text
+    consoleDemoInit();
+
+    camera = NE_CameraCreate();
+    NE_CameraSet(camera,
+                 0, 2, 2,
+                 0, 0, -4,
+                 0, 1, 0);
+
+    for (int i = 0; i < NUM_MODELS; i++)
+    {
+        models[i] = NE_ModelCreate(NE_Static);
+
+        if (i == 0)
+        {
+            NE_ModelLoadStaticMesh(models[i], teapot_bin);
+            NE_ModelLodAdd(models[i], sphere_bin, floattof32(4));
+            NE_ModelLodAdd(models[i], cube_bin, floattof32(8));
+        }
+        else
+        {
+            // Clones share the levels of detail of the first model
+            NE_ModelClone(models[i], models[0]);
+        }
+
+        int x = i % GRID_WIDTH - GRID_WIDTH / 2;
+        int z = -(i / GRID_WIDTH) * 2;
+
+        NE_ModelSetCoordI(models[i], inttof32(x), 0, inttof32(z));
+        NE_ModelScale(models[i], 0.3, 0.3, 0.3);
+    }
+
+    NE_LightSet(0, NE_White, 0, -1, -1);
+
+    run_test("Distance only", 0, 0);
+    run_test("Budget", 1800, 5400);
+
+    printf("Done!\n");
+
+    while (1)
+    {
+        NE_WaitForVBL(0);
+        NE_Process(draw_scene);
+    }
+
+    return 0;
+}
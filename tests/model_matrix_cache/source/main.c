@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Antonio Niño Díaz, 2024
+//
+// This file is part of Nitro Engine
+
+// This test measures how long it takes the geometry engine to set the
+// transformation of a model. It compares sending the translation, rotations
+// and scale of the model as individual commands (what NE_ModelDraw() used to
+// do) against sending the matrix cached by the model. The timer used to
+// measure time runs at the same frequency as the geometry engine, so the
+// results are in geometry engine cycles.
+//
+// Then it measures how long NE_ModelDraw() takes when the models don't move,
+// so that the cached matrices are reused, and when all models are rotated
+// every frame, so that the matrices have to be calculated again.
+
+#include <NEMain.h>
+
+#include "cube_bin.h"
+
+#define GRID_WIDTH  10
+#define GRID_HEIGHT 6
+#define NUM_MODELS  (GRID_WIDTH * GRID_HEIGHT)
+#define NUM_FRAMES  60
+
+typedef enum {
+    TRANSFORM_NONE,
+    TRANSFORM_COMMANDS,
+    TRANSFORM_CACHED,
+} transform_mode_t;
+
+static NE_Camera *camera;
+static NE_Model *models[NUM_MODELS];
+
+static bool rotate_models;
+static bool run_benchmark;
+static uint32_t scene_ticks;
+
+// Same commands that NE_ModelDraw() used to send to the GPU
+static void transform_commands(const NE_Model *model)
+{
+    MATRIX_TRANSLATE = model->x;
+    MATRIX_TRANSLATE = model->y;
+    MATRIX_TRANSLATE = model->z;
+
+    if (model->rx != 0)
+        glRotateXi(model->rx << 6);
+    if (model->ry != 0)
+        glRotateYi(model->ry << 6);
+    if (model->rz != 0)
+        glRotateZi(model->rz << 6);
+
+    MATRIX_SCALE = model->sx;
+    MATRIX_SCALE = model->sy;
+    MATRIX_SCALE = model->sz;
+}
+
+static uint32_t benchmark_transform(transform_mode_t mode)
+{
+    // Wait until the geometry engine is idle
+    while (GFX_STATUS & BIT(27));
+
+    cpuStartTiming(0);
+
+    for (int i = 0; i < NUM_MODELS; i++)
+    {
+        MATRIX_PUSH = 0;
+
+        if (mode == TRANSFORM_COMMANDS)
+            transform_commands(models[i]);
+        else if (mode == TRANSFORM_CACHED)
+            glMultMatrix4x3(&models[i]->transform);
+
+        MATRIX_POP = 1;
+    }
+
+    while (GFX_STATUS & BIT(27));
+
+    return cpuEndTiming();
+}
+
+static void draw_scene(void)
+{
+    NE_CameraUse(camera);
+
+    if (rotate_models)
+    {
+        for (int i = 0; i < NUM_MODELS; i++)
+            NE_ModelRotate(models[i], 1, 2, 3);
+    }
+
+    cpuStartTiming(0);
+
+    for (int i = 0; i < NUM_MODELS; i++)
+        NE_ModelDraw(models[i]);
+
+    // Make sure that the GPU has received all commands
+    NE_DisplayListWait();
+
+    scene_ticks += cpuEndTiming();
+
+    if (run_benchmark)
+    {
+        // The matrices of the models have been updated by NE_ModelDraw()
+        uint32_t none = benchmark_transform(TRANSFORM_NONE);
+        uint32_t commands = benchmark_transform(TRANSFORM_COMMANDS);
+        uint32_t cached = benchmark_transform(TRANSFORM_CACHED);
+
+        printf("Cycles per model:\n");
+        printf("  Push and pop:  %lu\n", none / NUM_MODELS);
+        printf("  Commands:      %lu\n", (commands - none) / NUM_MODELS);
+        printf("  Cached matrix: %lu\n", (cached - none) / NUM_MODELS);
+
+        run_benchmark = false;
+    }
+}
+
+static void run_test(const char *name, bool rotate)
+{
+    rotate_models = rotate;
+
+    scene_ticks = 0;
+
+    for (int i = 0; i < NUM_FRAMES; i++)
+    {
+        NE_WaitForVBL(0);
+        NE_Process(draw_scene);
+    }
+
+    printf("%-14s: %5lu us/frame\n", name,
+           timerTicks2usec(scene_ticks) / NUM_FRAMES);
+}
+
+int main(int argc, char *argv[])
+{
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NE_VBLFunc);
+    irqSet(IRQ_HBLANK, NE_HBLFunc);
+
+    NE_Init3D();
+    // libnds uses VRAM_C for the text console, reserve A and B only
+    NE_TextureSystemReset(0, 0, NE_VRAM_AB);
+
+    // This is needed to print text
+    consoleDemoInit();
+
+    camera = NE_CameraCreate();
+    NE_CameraSet(camera,
+                 0, 0, 6,
+                 0, 0, 0,
+                 0, 1, 0);
+
+    for (int i = 0; i < NUM_MODELS; i++)
+    {
+        models[i] = NE_ModelCreate(NE_Static);
+
+        if (i == 0)
+            NE_ModelLoadStaticMesh(models[i], cube_bin);
+        else
+            NE_ModelClone(models[i], models[0]);
+
+        int x = i % GRID_WIDTH - GRID_WIDTH / 2;
+        int y = i / GRID_WIDTH - GRID_HEIGHT / 2;
+
+        // Rotate the models by all axes, which is the worst case when sending
+        // individual commands.
+        NE_ModelSetCoordI(models[i], inttof32(x), inttof32(y), 0);
+        NE_ModelSetRot(models[i], 1 + i, 2 + i * 2, 3 + i * 3);
+        NE_ModelScale(models[i], 0.3, 0.3, 0.3);
+    }
+
+    NE_LightSet(0, NE_White, 0, -1, -1);
+
+    run_benchmark = true;
+
+    NE_WaitForVBL(0);
+    NE_Process(draw_scene);
+
+    run_test("Static models", false);
+    run_test("Moving models", true);
+
+    printf("Done!\n");
+
+    while (1)
+    {
+        NE_WaitForVBL(0);
+        NE_Process(draw_scene);
+    }
+
+    return 0;
+}
@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Antonio Niño Díaz, 2024
+//
+// This file is part of Nitro Engine
+
+// This test fragments palette VRAM by loading palettes and deleting every other
+// one. Then it checks that NE_PaletteDefragMemDryRun() reports the same figure
+// as NE_PaletteDefragMem() without moving any palette, and that the colors of
+// all palettes are still correct after defragmenting the memory.
+
+#include <NEMain.h>
+
+#define NUM_PALETTES    16
+#define NUM_COLORS      256
+
+static NE_Palette *palettes[NUM_PALETTES];
+
+static u16 palette_data[NUM_COLORS];
+
+static u16 palette_color(int index, int color)
+{
+    return ((index << 10) ^ (color * 37)) & 0x7FFF;
+}
+
+static void load_palettes(void)
+{
+    for (int i = 0; i < NUM_PALETTES; i++)
+    {
+        for (int c = 0; c < NUM_COLORS; c++)
+            palette_data[c] = palette_color(i, c);
+
+        palettes[i] = NE_PaletteCreate();
+        NE_PaletteLoad(palettes[i], palette_data, NUM_COLORS, NE_PAL256);
+    }
+
+    // Leave a hole before every palette that is left
+    for (int i = 0; i < NUM_PALETTES; i += 2)
+    {
+        NE_PaletteDelete(palettes[i]);
+        palettes[i] = NULL;
+    }
+}
+
+static bool check_palettes(void)
+{
+    bool ok = true;
+
+    for (int i = 0; i < NUM_PALETTES; i++)
+    {
+        if (palettes[i] == NULL)
+            continue;
+
+        u16 *data = NE_PaletteModificationStart(palettes[i]);
+
+        for (int c = 0; c < NUM_COLORS; c++)
+        {
+            if (data[c] != palette_color(i, c))
+            {
+                ok = false;
+                break;
+            }
+        }
+
+        NE_PaletteModificationEnd();
+    }
+
+    return ok;
+}
+
+static void get_addresses(u16 **addresses)
+{
+    for (int i = 0; i < NUM_PALETTES; i++)
+    {
+        addresses[i] = NULL;
+
+        if (palettes[i] == NULL)
+            continue;
+
+        addresses[i] = NE_PaletteModificationStart(palettes[i]);
+        NE_PaletteModificationEnd();
+    }
+}
+
+static void test_defrag(void)
+{
+    load_palettes();
+
+    u16 *addresses_before[NUM_PALETTES];
+    u16 *addresses_after[NUM_PALETTES];
+
+    int free_mem = NE_PaletteFreeMem();
+    int before = NE_PaletteLargestFreeMem();
+
+    get_addresses(addresses_before);
+    int dry_run = NE_PaletteDefragMemDryRun();
+    get_addresses(addresses_after);
+
+    bool unchanged = (NE_PaletteLargestFreeMem() == before) &&
+                     (memcmp(addresses_before, addresses_after,
+                             sizeof(addresses_before)) == 0);
+
+    printf("NE_PaletteDefragMemDryRun()\n");
+    printf("  Recovered: %d\n", dry_run);
+    printf("  Layout: %s\n", unchanged ? "UNCHANGED" : "MODIFIED");
+    printf("  Contents: %s\n", check_palettes() ? "OK" : "CORRUPTED");
+
+    int recovered = NE_PaletteDefragMem();
+    int after = NE_PaletteLargestFreeMem();
+
+    // All the free memory should be in one block after defragmenting it
+    bool figures_ok = (recovered == dry_run) &&
+                      (after - before == recovered) &&
+                      (after == free_mem);
+
+    printf("NE_PaletteDefragMem()\n");
+    printf("  Largest free: %d -> %d\n", before, after);
+    printf("  Recovered: %d\n", recovered);
+    printf("  Figures: %s\n", figures_ok ? "OK" : "WRONG");
+    printf("  Contents: %s\n", check_palettes() ? "OK" : "CORRUPTED");
+
+    for (int i = 0; i < NUM_PALETTES; i++)
+    {
+        if (palettes[i] != NULL)
+            NE_PaletteDelete(palettes[i]);
+        palettes[i] = NULL;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NE_VBLFunc);
+    irqSet(IRQ_HBLANK, NE_HBLFunc);
+
+    NE_Init3D();
+    // libnds uses VRAM_C for the text console, reserve A and B only
+    NE_TextureSystemReset(0, 0, NE_VRAM_AB);
+
+    // This is needed to print text
+    consoleDemoInit();
+
+    test_defrag();
+
+    printf("Done!\n");
+
+    while (1)
+        NE_WaitForVBL(0);
+
+    return 0;
+}
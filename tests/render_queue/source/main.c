@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Antonio Niño Díaz, 2024
+//
+// This file is part of Nitro Engine
+
+// This test draws a grid of cubes and a row of 2D quads. Consecutive objects
+// use different materials, which is the worst case for the state of the GPU.
+// First it draws them in order with NE_ModelDraw() and NE_2DDrawTexturedQuad(),
+// then it adds them to the render queue, which sorts them by material.
+//
+// It prints the number of writes to registers of the state cache done during the
+// last frame of each test, and the number of writes that have been skipped
+// because the register already had the same value.
+
+#include <NEMain.h>
+
+#include "cube_bin.h"
+
+#define GRID_WIDTH      8
+#define GRID_HEIGHT     6
+#define NUM_MODELS      (GRID_WIDTH * GRID_HEIGHT)
+#define NUM_QUADS       16
+#define NUM_MATERIALS   4
+#define NUM_FRAMES      30
+
+static NE_Camera *camera;
+static NE_Model *models[NUM_MODELS];
+static NE_Material *materials[NUM_MATERIALS];
+
+static u16 texture_data[NUM_MATERIALS][16 * 16];
+
+static bool use_queue;
+
+static void draw_scene(void)
+{
+    NE_CameraUse(camera);
+
+    NE_PolyFormat(31, 0, NE_LIGHT_0, NE_CULL_BACK, 0);
+
+    if (use_queue)
+    {
+        for (int i = 0; i < NUM_MODELS; i++)
+            NE_RenderQueueAddModel(models[i]);
+
+        for (int i = 0; i < NUM_QUADS; i++)
+        {
+            NE_RenderQueueAddQuad(i * 16, 176, i * 16 + 16, 192, 0,
+                                  materials[i % NUM_MATERIALS], NE_White);
+        }
+
+        NE_RenderQueueFlush();
+    }
+    else
+    {
+        for (int i = 0; i < NUM_MODELS; i++)
+            NE_ModelDraw(models[i]);
+
+        NE_2DViewInit();
+
+        for (int i = 0; i < NUM_QUADS; i++)
+        {
+            NE_2DDrawTexturedQuad(i * 16, 176, i * 16 + 16, 192, 0,
+                                  materials[i % NUM_MATERIALS]);
+        }
+    }
+}
+
+static void run_test(const char *name, bool queue)
+{
+    use_queue = queue;
+
+    for (int i = 0; i < NUM_FRAMES; i++)
+    {
+        NE_WaitForVBL(0);
+        NE_Process(draw_scene);
+    }
+
+    // The statistics are the ones of the previous frame
+    NE_RenderQueueStats stats;
+    NE_RenderQueueGetStats(&stats);
+
+    printf("%s\n", name);
+    printf("  Queued objects: %u\n", (unsigned int)stats.drawn);
+    printf("  State changes:  %u\n", (unsigned int)stats.state_changes);
+    printf("  Skipped writes: %u\n", (unsigned int)stats.state_skipped);
+}
+
+int main(int argc, char *argv[])
+{
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NE_VBLFunc);
+    irqSet(IRQ_HBLANK, NE_HBLFunc);
+
+    NE_Init3D();
+    // libnds uses VRAM_C for the text console, reserve A and B only
+    NE_TextureSystemReset(0, 0, NE_VRAM_AB);
+
+    // This is needed to print text
+    consoleDemoInit();
+
+    NE_RenderQueueReset(NUM_MODELS + NUM_QUADS);
+
+    const u16 colors[NUM_MATERIALS] = {
+        RGB15(31, 0, 0), RGB15(0, 31, 0), RGB15(0, 0, 31), RGB15(31, 31, 0)
+    };
+
+    for (int i = 0; i < NUM_MATERIALS; i++)
+    {
+        for (int j = 0; j < 16 * 16; j++)
+            texture_data[i][j] = colors[i] | BIT(15);
+
+        materials[i] = NE_MaterialCreate();
+        NE_MaterialTexLoad(materials[i], NE_A1RGB5, 16, 16,
+                           NE_TEXGEN_TEXCOORD, texture_data[i]);
+    }
+
+    camera = NE_CameraCreate();
+    NE_CameraSet(camera,
+                 0, 0, 6,
+                 0, 0, 0,
+                 0, 1, 0);
+
+    for (int i = 0; i < NUM_MODELS; i++)
+    {
+        models[i] = NE_ModelCreate(NE_Static);
+
+        if (i == 0)
+            NE_ModelLoadStaticMesh(models[i], cube_bin);
+        else
+            NE_ModelClone(models[i], models[0]);
+
+        NE_ModelSetMaterial(models[i], materials[i % NUM_MATERIALS]);
+
+        int x = i % GRID_WIDTH - GRID_WIDTH / 2;
+        int y = i / GRID_WIDTH - GRID_HEIGHT / 2;
+
+        NE_ModelSetCoordI(models[i], inttof32(x), inttof32(y), 0);
+        NE_ModelScale(models[i], 0.3, 0.3, 0.3);
+    }
+
+    NE_LightSet(0, NE_White, 0, -1, -1);
+
+    run_test("Draw in order", false);
+    run_test("Render queue", true);
+
+    printf("Done!\n");
+
+    while (1)
+    {
+        NE_WaitForVBL(0);
+        NE_Process(draw_scene);
+    }
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Antonio Niño Díaz, 2024
+//
+// This file is part of Nitro Engine
+
+// This test loads textures in the background while a quad is drawn, and prints
+// the number of frames that each upload takes with different budgets. The
+// quads of the textures that are being loaded are drawn without texture.
+
+#include <NEMain.h>
+
+#define NUM_TEXTURES 3
+
+// 256x256 NE_A1RGB5 textures use 128 KB each, so each one fills one VRAM bank
+static u16 texture_data[256 * 256];
+
+static NE_Material *materials[NUM_TEXTURES];
+
+static void draw_scene(void)
+{
+    NE_2DViewInit();
+
+    for (int i = 0; i < NUM_TEXTURES; i++)
+        NE_2DDrawTexturedQuad(i * 64, 0, i * 64 + 64, 64, 0, materials[i]);
+}
+
+static void run_test(size_t budget)
+{
+    NE_TextureUploadSetBudget(budget);
+
+    for (int i = 0; i < NUM_TEXTURES; i++)
+    {
+        if (materials[i] != NULL)
+            NE_MaterialDelete(materials[i]);
+
+        materials[i] = NE_MaterialCreate();
+        NE_MaterialTexLoadAsync(materials[i], NE_A1RGB5, 256, 256,
+                                NE_TEXGEN_TEXCOORD, texture_data);
+    }
+
+    int frames = 0;
+
+    while (1)
+    {
+        bool pending = false;
+        for (int i = 0; i < NUM_TEXTURES; i++)
+            pending |= NE_MaterialTexIsPending(materials[i]);
+
+        if (!pending)
+            break;
+
+        NE_WaitForVBL(0);
+        NE_Process(draw_scene);
+        frames++;
+    }
+
+    printf("Budget %5u B: %3d frames\n", (unsigned int)budget, frames);
+}
+
+int main(int argc, char *argv[])
+{
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NE_VBLFunc);
+    irqSet(IRQ_HBLANK, NE_HBLFunc);
+
+    NE_Init3D();
+
+    // Bank C is used by the console of libnds
+    NE_TextureSystemReset(0, 0, NE_VRAM_ABD);
+
+    // This is needed to print text
+    consoleDemoInit();
+
+    for (int i = 0; i < 256 * 256; i++)
+        texture_data[i] = RGB15(i & 31, (i >> 5) & 31, (i >> 10) & 31) | BIT(15);
+
+    run_test(4 * 1024);
+    run_test(NE_DEFAULT_UPLOAD_BUDGET);
+    run_test(64 * 1024);
+
+    printf("Done!\n");
+
+    while (1)
+    {
+        NE_WaitForVBL(0);
+        NE_Process(draw_scene);
+    }
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Antonio Niño Díaz, 2024
+//
+// This file is part of Nitro Engine
+
+// This test packs images of random sizes into a texture atlas and draws all of
+// them as sprites. It prints how much VRAM would be needed to load each image
+// as an individual texture, and how much VRAM the atlas uses.
+
+#include <NEMain.h>
+
+#define MAX_IMAGES  64
+
+#define ATLAS_SIZE  128
+
+static NE_AtlasImage images[MAX_IMAGES];
+static NE_Sprite *sprites[MAX_IMAGES];
+static int num_images;
+
+static uint32_t my_rand_state = 1234;
+
+static uint32_t my_rand(void)
+{
+    my_rand_state = my_rand_state * 1103515245 + 12345;
+    return my_rand_state >> 16;
+}
+
+// Size of a NE_A1RGB5 texture with the width rounded up to a power of two
+static int individual_texture_size(int width, int height)
+{
+    int real_width = 8;
+    while (real_width < width)
+        real_width <<= 1;
+
+    return real_width * height * 2;
+}
+
+static void draw_scene(void)
+{
+    NE_2DViewInit();
+    NE_SpriteDrawAll();
+}
+
+int main(int argc, char *argv[])
+{
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NE_VBLFunc);
+    irqSet(IRQ_HBLANK, NE_HBLFunc);
+
+    NE_Init3D();
+
+    // Bank C is used by the console of libnds
+    NE_TextureSystemReset(0, 0, NE_VRAM_ABD);
+
+    // This is needed to print text
+    consoleDemoInit();
+
+    NE_SpriteSystemReset(MAX_IMAGES);
+
+    NE_Atlas *atlas = NE_AtlasCreate(NE_A1RGB5, ATLAS_SIZE, ATLAS_SIZE,
+                                     NE_TEXGEN_TEXCOORD);
+    if (atlas == NULL)
+    {
+        printf("Can't create atlas\n");
+        goto end;
+    }
+
+    int individual_size = 0;
+
+    static u16 buffer[32 * 32];
+
+    while (num_images < MAX_IMAGES)
+    {
+        int w = 4 + (my_rand() % 28);
+        int h = 4 + (my_rand() % 28);
+
+        u16 color = RGB15(my_rand() & 31, my_rand() & 31, my_rand() & 31);
+        for (int i = 0; i < w * h; i++)
+            buffer[i] = color | BIT(15);
+
+        NE_AtlasImage *image = &images[num_images];
+        if (NE_AtlasAdd(atlas, buffer, w, h, image) == 0)
+            break;
+
+        individual_size += individual_texture_size(w, h);
+
+        NE_Sprite *sprite = NE_SpriteCreate();
+        NE_SpriteSetAtlasImage(sprite, image);
+        NE_SpriteSetPos(sprite, image->tl, image->tt);
+        sprites[num_images] = sprite;
+
+        num_images++;
+    }
+
+    printf("Images: %d\n", num_images);
+    printf("Atlas used: %d%%\n", NE_AtlasUsedPercent(atlas));
+    printf("Individual textures: %d B\n", individual_size);
+    printf("Atlas: %d B\n", ATLAS_SIZE * ATLAS_SIZE * 2);
+
+end:
+    while (1)
+    {
+        NE_WaitForVBL(0);
+        NE_Process(draw_scene);
+    }
+
+    return 0;
+}
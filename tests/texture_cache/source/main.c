@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Antonio Niño Díaz, 2024
+//
+// This file is part of Nitro Engine
+
+// This test loads more managed textures than fit in VRAM and draws a different
+// group of them every few frames. It prints the statistics of the texture cache
+// for several sizes of the group of textures used in each frame.
+
+#include <NEMain.h>
+
+#define NUM_TEXTURES        40
+#define FRAMES_PER_GROUP    30
+#define GROUPS              8
+
+// All materials use the same data, they are never displayed. Each texture uses
+// 32 KB, so only 12 of them fit in banks A, B and D.
+static u32 texture_data[128 * 128 * 2 / 4];
+
+static NE_Material *materials[NUM_TEXTURES];
+
+typedef struct {
+    int first;
+    int count;
+} scene_t;
+
+static void draw_scene(void *arg)
+{
+    scene_t *scene = arg;
+
+    NE_2DViewInit();
+
+    for (int i = 0; i < scene->count; i++)
+    {
+        NE_Material *mat = materials[(scene->first + i) % NUM_TEXTURES];
+
+        NE_2DDrawTexturedQuad(i * 8, 0, i * 8 + 8, 8, 0, mat);
+    }
+}
+
+static void run_test(int working_set)
+{
+    NE_TextureCacheResetStats();
+
+    scene_t scene = { 0, working_set };
+
+    for (int group = 0; group < GROUPS; group++)
+    {
+        for (int frame = 0; frame < FRAMES_PER_GROUP; frame++)
+        {
+            NE_WaitForVBL(0);
+            NE_ProcessArg(draw_scene, &scene);
+        }
+
+        scene.first += working_set;
+    }
+
+    NE_TextureCacheStats stats;
+    NE_TextureCacheGetStats(&stats);
+
+    printf("Working set: %d textures\n", working_set);
+    printf("  Hits %u, misses %u\n",
+           (unsigned int)stats.hits, (unsigned int)stats.misses);
+    printf("  Evictions %u, failed %u\n",
+           (unsigned int)stats.evictions, (unsigned int)stats.failed);
+    printf("  Resident %u (%u KB)\n", (unsigned int)stats.resident,
+           (unsigned int)stats.resident_bytes / 1024);
+}
+
+int main(int argc, char *argv[])
+{
+    // NE_VBLFunc() copies the textures that have to be uploaded again
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NE_VBLFunc);
+    irqSet(IRQ_HBLANK, NE_HBLFunc);
+
+    NE_Init3D();
+
+    // Bank C is used by the console of libnds
+    NE_TextureSystemReset(0, 0, NE_VRAM_ABD);
+
+    // This is needed to print text
+    consoleDemoInit();
+
+    for (int i = 0; i < NUM_TEXTURES; i++)
+    {
+        materials[i] = NE_MaterialCreate();
+        if (NE_MaterialTexLoadManaged(materials[i], NE_A1RGB5, 128, 128,
+                                      NE_TEXGEN_TEXCOORD, texture_data) == 0)
+        {
+            printf("Failed to load texture %d\n", i);
+        }
+    }
+
+    NE_TextureCacheStats stats;
+    NE_TextureCacheGetStats(&stats);
+    printf("Managed %u, resident %u\n\n",
+           (unsigned int)stats.managed, (unsigned int)stats.resident);
+
+    // The textures used in the previous frame can't be evicted, so groups
+    // bigger than half of the VRAM start failing when they change.
+    run_test(4);
+    run_test(6);
+    run_test(8);
+
+    printf("Done!\n");
+
+    while (1)
+        NE_WaitForVBL(0);
+
+    return 0;
+}
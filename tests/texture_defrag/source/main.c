@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Antonio Niño Díaz, 2024
+//
+// This file is part of Nitro Engine
+
+// This test fragments texture VRAM by loading textures of different sizes and
+// deleting some of them. Then it defragments VRAM with
+// NE_TextureDefragMemStep() and NE_TextureDefragMem(), and checks that the data
+// of all textures is still correct and that no call to
+// NE_TextureDefragMemStep() copies more data than its budget.
+
+#include <NEMain.h>
+
+#define NUM_TEXTURES    24
+#define STEP_BUDGET     (4 * 1024)
+
+static NE_Material *materials[NUM_TEXTURES];
+
+// Big enough for the biggest texture (128x128 NE_A1RGB5)
+static u32 texture_data[128 * 128 * 2 / 4];
+
+static int texture_size(int index)
+{
+    // Every fourth texture is bigger than the budget of a step
+    return (index % 4 == 0) ? 128 : 32;
+}
+
+static u32 texture_word(int index, int word)
+{
+    return ((u32)index << 24) ^ (word * 0x9E3779B1);
+}
+
+static void load_textures(void)
+{
+    for (int i = 0; i < NUM_TEXTURES; i++)
+    {
+        int size = texture_size(i);
+
+        for (int w = 0; w < size * size * 2 / 4; w++)
+            texture_data[w] = texture_word(i, w);
+
+        materials[i] = NE_MaterialCreate();
+        NE_MaterialTexLoad(materials[i], NE_A1RGB5, size, size,
+                           NE_TEXGEN_TEXCOORD, texture_data);
+    }
+
+    // Leave holes of both sizes between the textures that are left, so that
+    // some big textures can be moved to locations that don't overlap their
+    // current location.
+    for (int i = 0; i < NUM_TEXTURES; i += 3)
+    {
+        NE_MaterialDelete(materials[i]);
+        materials[i] = NULL;
+    }
+}
+
+static bool check_textures(void)
+{
+    bool ok = true;
+
+    for (int i = 0; i < NUM_TEXTURES; i++)
+    {
+        if (materials[i] == NULL)
+            continue;
+
+        int size = texture_size(i);
+        const u32 *data = NE_TextureDrawingStart(materials[i]);
+
+        for (int w = 0; w < size * size * 2 / 4; w++)
+        {
+            if (data[w] != texture_word(i, w))
+            {
+                ok = false;
+                break;
+            }
+        }
+
+        NE_TextureDrawingEnd();
+    }
+
+    return ok;
+}
+
+static void delete_textures(void)
+{
+    for (int i = 0; i < NUM_TEXTURES; i++)
+    {
+        if (materials[i] != NULL)
+            NE_MaterialDelete(materials[i]);
+        materials[i] = NULL;
+    }
+}
+
+static void test_step(void)
+{
+    load_textures();
+
+    int before = NE_TextureLargestFreeMem();
+    int steps = 0;
+    int max_copied = 0;
+
+    while (1)
+    {
+        NE_WaitForVBL(0);
+
+        int copied = NE_TextureDefragMemStep(STEP_BUDGET);
+        if (copied <= 0)
+            break;
+
+        if (copied > max_copied)
+            max_copied = copied;
+
+        steps++;
+    }
+
+    printf("NE_TextureDefragMemStep()\n");
+    printf("  Largest free: %d -> %d\n", before, NE_TextureLargestFreeMem());
+    printf("  Steps: %d\n", steps);
+    printf("  Max copied: %d (budget %d)\n", max_copied, STEP_BUDGET);
+    printf("  Budget: %s\n", (max_copied <= STEP_BUDGET) ? "OK" : "EXCEEDED");
+    printf("  Contents: %s\n", check_textures() ? "OK" : "CORRUPTED");
+
+    delete_textures();
+}
+
+static void test_full(void)
+{
+    load_textures();
+
+    int before = NE_TextureLargestFreeMem();
+
+    NE_TextureDefragMem();
+
+    printf("NE_TextureDefragMem()\n");
+    printf("  Largest free: %d -> %d\n", before, NE_TextureLargestFreeMem());
+    printf("  Contents: %s\n", check_textures() ? "OK" : "CORRUPTED");
+
+    delete_textures();
+}
+
+int main(int argc, char *argv[])
+{
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NE_VBLFunc);
+    irqSet(IRQ_HBLANK, NE_HBLFunc);
+
+    NE_Init3D();
+    // libnds uses VRAM_C for the text console, reserve A and B only
+    NE_TextureSystemReset(0, 0, NE_VRAM_AB);
+
+    // This is needed to print text
+    consoleDemoInit();
+
+    test_step();
+    test_full();
+
+    printf("Done!\n");
+
+    while (1)
+        NE_WaitForVBL(0);
+
+    return 0;
+}
@@ -0,0 +1,182 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Antonio Niño Díaz, 2024
+//
+// This file is part of Nitro Engine
+
+// This test loads and deletes a mix of textures of different formats and sizes
+// with each texture placement policy, and prints how many textures fit in VRAM
+// at the end.
+//
+// All policies see the same sequence of operations, so the results can be
+// compared directly. They are the reference numbers for the policies: run this
+// test on hardware or in an emulator when the allocator or the policies are
+// modified.
+
+#include <NEMain.h>
+
+#define MAX_TEXTURES    256
+#define CHURN_TEXTURES  64
+#define ITERATIONS      2000
+
+typedef struct {
+    NE_TextureFormat fmt;
+    int width, height;
+} texture_type_t;
+
+// Mix of textures that could be found in a game. Some of them are compressed,
+// which need space in slot 0 or 2 as well as in slot 1.
+static const texture_type_t texture_types[] = {
+    { NE_PAL4, 16, 16 },        // 64 B: Small GUI elements
+    { NE_PAL16, 32, 32 },       // 512 B: Sprites
+    { NE_PAL16, 64, 64 },       // 2 KB
+    { NE_PAL256, 64, 64 },      // 4 KB
+    { NE_A3PAL32, 64, 64 },     // 4 KB: Particles
+    { NE_A5PAL8, 128, 64 },     // 8 KB: Fonts
+    { NE_PAL256, 128, 128 },    // 16 KB: Characters
+    { NE_A1RGB5, 64, 64 },      // 8 KB
+    { NE_A1RGB5, 128, 128 },    // 32 KB: Backgrounds
+    { NE_TEX4X4, 64, 64 },      // 1 KB + 512 B: Environment
+    { NE_TEX4X4, 128, 128 },    // 4 KB + 2 KB
+    { NE_TEX4X4, 256, 256 },    // 16 KB + 8 KB
+};
+
+#define NUM_TEXTURE_TYPES (sizeof(texture_types) / sizeof(texture_types[0]))
+
+// The contents of the textures don't matter, they are never displayed
+static u32 texture_data[128 * 128 * 2 / 4];
+
+static NE_Material *materials[MAX_TEXTURES];
+
+static uint32_t my_rand_state;
+
+static uint32_t my_rand(void)
+{
+    my_rand_state = my_rand_state * 1103515245 + 12345;
+    return my_rand_state >> 16;
+}
+
+static int failed_compressed;
+
+static int load_random_texture(NE_Material *mat)
+{
+    const texture_type_t *type = &texture_types[my_rand() % NUM_TEXTURE_TYPES];
+
+    int ret = NE_MaterialTexLoad(mat, type->fmt, type->width, type->height,
+                                 NE_TEXGEN_TEXCOORD, texture_data);
+    if ((ret == 0) && (type->fmt == NE_TEX4X4))
+        failed_compressed++;
+
+    return ret;
+}
+
+static void run_benchmark(const char *name, NE_VRAMBankFlags policy)
+{
+    // Bank C is used by the console of libnds
+    NE_TextureSystemReset(MAX_TEXTURES, 0, NE_VRAM_ABD | policy);
+
+    // All policies see the same sequence of operations
+    my_rand_state = 1234;
+
+    for (int i = 0; i < MAX_TEXTURES; i++)
+        materials[i] = NULL;
+
+    int failed = 0;
+    failed_compressed = 0;
+
+    cpuStartTiming(0);
+
+    // Load and delete textures randomly, like when moving between areas of a
+    // game. Keep around half of the first CHURN_TEXTURES slots in use.
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        int slot = my_rand() % CHURN_TEXTURES;
+
+        if (materials[slot] != NULL)
+        {
+            if (my_rand() & 1)
+            {
+                NE_MaterialDelete(materials[slot]);
+                materials[slot] = NULL;
+            }
+            continue;
+        }
+
+        materials[slot] = NE_MaterialCreate();
+        if (load_random_texture(materials[slot]) == 0)
+        {
+            NE_MaterialDelete(materials[slot]);
+            materials[slot] = NULL;
+            failed++;
+        }
+    }
+
+    uint32_t ticks = cpuEndTiming();
+
+    int churn_failed_compressed = failed_compressed;
+
+    // Fill VRAM with more textures until they don't fit anymore
+    int consecutive_fails = 0;
+    while (consecutive_fails < 32)
+    {
+        int slot = -1;
+        for (int i = 0; i < MAX_TEXTURES; i++)
+        {
+            if (materials[i] == NULL)
+            {
+                slot = i;
+                break;
+            }
+        }
+
+        if (slot == -1)
+            break;
+
+        materials[slot] = NE_MaterialCreate();
+        if (load_random_texture(materials[slot]) == 0)
+        {
+            NE_MaterialDelete(materials[slot]);
+            materials[slot] = NULL;
+            consecutive_fails++;
+        }
+        else
+        {
+            consecutive_fails = 0;
+        }
+    }
+
+    int loaded = 0;
+    for (int i = 0; i < MAX_TEXTURES; i++)
+    {
+        if (materials[i] != NULL)
+            loaded++;
+    }
+
+    printf("%s\n", name);
+    printf("  Failed loads: %d (%d compressed)\n", failed,
+           churn_failed_compressed);
+    printf("  Textures at the end: %d\n", loaded);
+    printf("  Free: %d B (largest %d B)\n", NE_TextureFreeMem(),
+           NE_TextureLargestFreeMem());
+    printf("  Time: %u us\n", (unsigned int)timerTicks2usec(ticks));
+}
+
+int main(int argc, char *argv[])
+{
+    NE_Init3D();
+
+    // This is needed to print text
+    consoleDemoInit();
+
+    run_benchmark("From end", NE_TEXTURE_ALLOC_FROM_END);
+    run_benchmark("First fit", NE_TEXTURE_ALLOC_FIRST_FIT);
+    run_benchmark("Best fit", NE_TEXTURE_ALLOC_BEST_FIT);
+    run_benchmark("Bank partitioned", NE_TEXTURE_ALLOC_BANK_PARTITIONED);
+
+    printf("Done!\n");
+
+    while (1)
+        NE_WaitForVBL(0);
+
+    return 0;
+}
@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2024 Antonio Niño Díaz
+//
+// This file is part of Nitro Engine
+
+// Runs the benchmarks of tests/allocator with the allocator of Nitro Engine
+// built for the host. This makes it possible to compare two versions of
+// source/NEAlloc.c quickly. The times are only useful to compare versions built
+// on the same PC, they aren't the times of the NDS.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "NEMain.h"
+#include "NEAlloc.h"
+
+// The allocator doesn't access the memory it manages, so any range works
+#define POOL_START      (void *)0x1000000
+#define POOL_END        (void *)0x2000000
+
+#define ASSERT(cond)                                                    \
+    do {                                                                \
+        if (!(cond))                                                    \
+        {                                                               \
+            fprintf(stderr, "%s:%d: %s\n", __func__, __LINE__, #cond);  \
+            exit(1);                                                    \
+        }                                                               \
+    } while (0)
+
+// Same random number generator as tests/allocator, so that the sequence of
+// operations is the same.
+static int my_rand(void)
+{
+    static unsigned long int next = 1;
+    next = next * 1103515245 + 12345;
+    return (unsigned int)(next / 65536) % 32768;
+}
+
+static double time_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Same as benchmark_churn() in tests/allocator, without the allocations of the
+// heap that are done at the same time.
+static void benchmark_churn(void)
+{
+#define BENCH_PTRS          128
+#define BENCH_ITERATIONS    100000
+
+    NEChunk *alloc;
+    ASSERT(NE_AllocInit(&alloc, POOL_START, POOL_END) == 0);
+
+    void *ptr[BENCH_PTRS] = { NULL };
+
+    double start = time_ms();
+
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        unsigned int selected = my_rand() % BENCH_PTRS;
+
+        if (ptr[selected] == NULL)
+        {
+            size_t size = (my_rand() & 0x3FFF) + 1;
+
+            if (size & 1)
+                ptr[selected] = NE_Alloc(alloc, size);
+            else
+                ptr[selected] = NE_AllocFromEnd(alloc, size);
+
+            ASSERT(ptr[selected] != NULL);
+        }
+        else
+        {
+            ASSERT(NE_Free(alloc, ptr[selected]) == 0);
+            ptr[selected] = NULL;
+        }
+    }
+
+    printf("benchmark_churn: %.2f ms\n", time_ms() - start);
+
+    NE_AllocEnd(&alloc);
+}
+
+// Same as benchmark_many_chunks() in tests/allocator
+static void benchmark_many_chunks(void)
+{
+#define MANY_PTRS           4096
+#define MANY_ITERATIONS     20000
+
+    NEChunk *alloc;
+    ASSERT(NE_AllocInit(&alloc, POOL_START, POOL_END) == 0);
+
+    static void *ptr[MANY_PTRS];
+
+    // Fill the pool with lots of small chunks
+    for (int i = 0; i < MANY_PTRS; i++)
+    {
+        ptr[i] = NE_Alloc(alloc, ((my_rand() & 0xF) + 1) * 16);
+        ASSERT(ptr[i] != NULL);
+    }
+
+    double start = time_ms();
+
+    for (int i = 0; i < MANY_ITERATIONS; i++)
+    {
+        unsigned int selected = my_rand() % MANY_PTRS;
+
+        ASSERT(NE_Lock(alloc, ptr[selected]) == 0);
+        ASSERT(NE_Unlock(alloc, ptr[selected]) == 0);
+        ASSERT(NE_Free(alloc, ptr[selected]) == 0);
+
+        size_t size = ((my_rand() & 0xF) + 1) * 16;
+
+        if (i & 1)
+            ptr[selected] = NE_Alloc(alloc, size);
+        else
+            ptr[selected] = NE_AllocFromEnd(alloc, size);
+
+        ASSERT(ptr[selected] != NULL);
+    }
+
+    printf("benchmark_many_chunks: %.2f ms\n", time_ms() - start);
+
+    NE_AllocEnd(&alloc);
+}
+
+int main(void)
+{
+    benchmark_churn();
+    benchmark_many_chunks();
+
+    return 0;
+}
@@ -0,0 +1,364 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2024 Antonio Niño Díaz
+//
+// This file is part of Nitro Engine
+
+// Replays a trace saved with NE_TextureTraceDump() or NE_PaletteTraceDump()
+// using the allocator of Nitro Engine, and prints fragmentation statistics.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "NEMain.h"
+#include "NEAlloc.h"
+
+static const char *op_names[] = {
+    [NE_TRACE_ALLOC] = "alloc",
+    [NE_TRACE_ALLOC_FROM_END] = "alloc_from_end",
+    [NE_TRACE_ALLOC_ADDRESS] = "alloc_address",
+    [NE_TRACE_FREE] = "free",
+    [NE_TRACE_LOCK] = "lock",
+    [NE_TRACE_UNLOCK] = "unlock",
+    [NE_TRACE_ALLOC_BEST_FIT] = "alloc_best_fit",
+};
+
+#define NUM_OPS (NE_TRACE_ALLOC_BEST_FIT + 1)
+
+typedef struct {
+    unsigned int calls[NUM_OPS];
+    unsigned int failed_trace[NUM_OPS];  // Failed in the original trace
+    unsigned int failed_replay[NUM_OPS]; // Failed in the replay
+    unsigned int moved;        // Allocations placed at a different address
+    unsigned int skipped;      // Operations on allocations that failed before
+    size_t min_largest_free;
+    unsigned int max_fragmentation;
+    size_t max_free_fragments;
+} stats_t;
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [-v] [-p policy] trace.bin\n", name);
+    printf("\n");
+    printf("  -v         Print all operations and the state of the pool\n");
+    printf("  -p policy  Replace the placement of all allocations that don't\n");
+    printf("             use a fixed address: first, end or best\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = NULL;
+    bool verbose = false;
+    int policy = 0; // 0 means using the same operations as the trace
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-v") == 0)
+        {
+            verbose = true;
+        }
+        else if ((strcmp(argv[i], "-p") == 0) && (i + 1 < argc))
+        {
+            i++;
+            if (strcmp(argv[i], "first") == 0)
+            {
+                policy = NE_TRACE_ALLOC;
+            }
+            else if (strcmp(argv[i], "end") == 0)
+            {
+                policy = NE_TRACE_ALLOC_FROM_END;
+            }
+            else if (strcmp(argv[i], "best") == 0)
+            {
+                policy = NE_TRACE_ALLOC_BEST_FIT;
+            }
+            else
+            {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (path == NULL)
+        {
+            path = argv[i];
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (path == NULL)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Can't open %s\n", path);
+        return 1;
+    }
+
+    NETraceHeader header;
+    const char magic[4] = NE_TRACE_MAGIC;
+
+    if ((fread(&header, sizeof(header), 1, f) != 1) ||
+        (memcmp(header.magic, magic, sizeof(magic)) != 0))
+    {
+        fprintf(stderr, "%s isn't a valid trace file\n", path);
+        fclose(f);
+        return 1;
+    }
+
+    if (header.version != NE_TRACE_VERSION)
+    {
+        fprintf(stderr, "Unsupported trace version: %u\n", header.version);
+        fclose(f);
+        return 1;
+    }
+
+    NETraceEntry *entries = malloc(header.num_entries * sizeof(NETraceEntry));
+    if (entries == NULL)
+    {
+        fprintf(stderr, "Not enough memory\n");
+        fclose(f);
+        return 1;
+    }
+
+    if (fread(entries, sizeof(NETraceEntry), header.num_entries, f) !=
+        header.num_entries)
+    {
+        fprintf(stderr, "Trace file is truncated\n");
+        free(entries);
+        fclose(f);
+        return 1;
+    }
+
+    fclose(f);
+
+    printf("Pool size: %u bytes\n", header.pool_size);
+    printf("Entries: %u\n", header.num_entries);
+    if (header.dropped > 0)
+    {
+        printf("WARNING: %u entries were dropped because the buffer was full.\n"
+               "The replay doesn't match the real state of the pool.\n",
+               header.dropped);
+    }
+
+    // The pool doesn't need to be backed by real memory because the allocator
+    // never accesses it, but it needs a valid base address. Use an address that
+    // is aligned like the start of VRAM.
+    void *pool_start = (void *)(uintptr_t)0x6800000;
+    void *pool_end = (void *)((uintptr_t)pool_start + header.pool_size);
+
+    NEChunk *pool;
+    if (NE_AllocInit(&pool, pool_start, pool_end) != 0)
+    {
+        fprintf(stderr, "Can't initialize allocator\n");
+        free(entries);
+        return 1;
+    }
+
+    // Allocations may end up in a different place than in the original trace.
+    // This table translates offsets of the trace into offsets of the replay.
+    // An entry of 0 means that there is no allocation at that offset, so all
+    // offsets are saved plus one.
+    size_t map_size = header.pool_size / NE_ALLOC_MIN_SIZE;
+    uint32_t *map = calloc(map_size, sizeof(uint32_t));
+    if (map == NULL)
+    {
+        fprintf(stderr, "Not enough memory\n");
+        NE_AllocEnd(&pool);
+        free(entries);
+        return 1;
+    }
+
+    stats_t stats = { 0 };
+    stats.min_largest_free = header.pool_size;
+
+    for (uint32_t i = 0; i < header.num_entries; i++)
+    {
+        NETraceEntry *e = &entries[i];
+
+        if ((e->op < NE_TRACE_ALLOC) || (e->op >= NUM_OPS))
+        {
+            fprintf(stderr, "Entry %u: Invalid operation %u\n", i, e->op);
+            continue;
+        }
+
+        stats.calls[e->op]++;
+
+        if (e->failed)
+            stats.failed_trace[e->op]++;
+
+        size_t slot = e->offset / NE_ALLOC_MIN_SIZE;
+        bool valid_offset = (e->offset % NE_ALLOC_MIN_SIZE == 0) &&
+                            (slot < map_size);
+
+        void *result = NULL;
+        int ret = 0;
+        bool skipped = false;
+
+        switch (e->op)
+        {
+            case NE_TRACE_ALLOC:
+            case NE_TRACE_ALLOC_FROM_END:
+            case NE_TRACE_ALLOC_BEST_FIT:
+            {
+                int op = (policy != 0) ? policy : e->op;
+
+                if (op == NE_TRACE_ALLOC)
+                    result = NE_Alloc(pool, e->size);
+                else if (op == NE_TRACE_ALLOC_FROM_END)
+                    result = NE_AllocFromEnd(pool, e->size);
+                else
+                    result = NE_AllocBestFit(pool, e->size);
+
+                if (result == NULL)
+                {
+                    stats.failed_replay[e->op]++;
+                    break;
+                }
+
+                uint32_t offset = (uintptr_t)result - (uintptr_t)pool_start;
+
+                if (e->failed)
+                {
+                    // This allocation failed in the original trace, so it will
+                    // never be freed. Don't keep it allocated.
+                    NE_Free(pool, result);
+                    break;
+                }
+
+                if (offset != e->offset)
+                    stats.moved++;
+
+                if (valid_offset)
+                    map[slot] = offset + 1;
+                break;
+            }
+            case NE_TRACE_ALLOC_ADDRESS:
+            {
+                // The address was chosen by the caller, so it can't be moved.
+                result = (void *)((uintptr_t)pool_start + e->offset);
+                ret = NE_AllocAddress(pool, result, e->size);
+                if (ret != 0)
+                {
+                    stats.failed_replay[e->op]++;
+                    break;
+                }
+
+                if (e->failed)
+                {
+                    NE_Free(pool, result);
+                    break;
+                }
+
+                if (valid_offset)
+                    map[slot] = e->offset + 1;
+                break;
+            }
+            case NE_TRACE_FREE:
+            case NE_TRACE_LOCK:
+            case NE_TRACE_UNLOCK:
+            {
+                if (e->failed)
+                {
+                    skipped = true;
+                    break;
+                }
+
+                if (!valid_offset || (map[slot] == 0))
+                {
+                    stats.skipped++;
+                    skipped = true;
+                    break;
+                }
+
+                result = (void *)((uintptr_t)pool_start + map[slot] - 1);
+
+                if (e->op == NE_TRACE_FREE)
+                {
+                    ret = NE_Free(pool, result);
+                    map[slot] = 0;
+                }
+                else if (e->op == NE_TRACE_LOCK)
+                {
+                    ret = NE_Lock(pool, result);
+                }
+                else
+                {
+                    ret = NE_Unlock(pool, result);
+                }
+
+                if (ret != 0)
+                    stats.failed_replay[e->op]++;
+                break;
+            }
+        }
+
+        NEMemInfo info;
+        NE_MemGetInformation(pool, &info);
+
+        if (stats.min_largest_free > info.largest_free)
+            stats.min_largest_free = info.largest_free;
+        if (stats.max_fragmentation < info.fragmentation)
+            stats.max_fragmentation = info.fragmentation;
+        if (stats.max_free_fragments < info.free_fragments)
+            stats.max_free_fragments = info.free_fragments;
+
+        if (verbose)
+        {
+            printf("%6u [%5u] %-14s 0x%06X %6u -> ", i, e->tag,
+                   op_names[e->op], e->offset, e->size);
+
+            if (skipped)
+                printf("skipped");
+            else if (result == NULL || ret != 0)
+                printf("failed");
+            else
+                printf("0x%06X", (uint32_t)((uintptr_t)result -
+                                            (uintptr_t)pool_start));
+
+            printf(" | free %zu, largest %zu, fragments %zu, frag %u%%\n",
+                   info.free, info.largest_free, info.free_fragments,
+                   info.fragmentation);
+        }
+    }
+
+    NEMemInfo info;
+    NE_MemGetInformation(pool, &info);
+
+    printf("\n");
+    printf("Operation         Calls  Failed (trace)  Failed (replay)\n");
+    for (int op = NE_TRACE_ALLOC; op < NUM_OPS; op++)
+    {
+        printf("%-15s %7u %15u %16u\n", op_names[op], stats.calls[op],
+               stats.failed_trace[op], stats.failed_replay[op]);
+    }
+
+    printf("\n");
+    printf("Allocations placed at a different address: %u\n", stats.moved);
+    printf("Operations skipped: %u\n", stats.skipped);
+    printf("\n");
+    printf("Final state:\n");
+    printf("  Free: %zu bytes (%u%%)\n", info.free, info.free_percent);
+    printf("  Largest free block: %zu bytes\n", info.largest_free);
+    printf("  Free fragments: %zu\n", info.free_fragments);
+    printf("  Fragmentation: %u%%\n", info.fragmentation);
+    printf("Worst state:\n");
+    printf("  Smallest largest free block: %zu bytes\n",
+           stats.min_largest_free);
+    printf("  Free fragments: %zu\n", stats.max_free_fragments);
+    printf("  Fragmentation: %u%%\n", stats.max_fragmentation);
+
+    free(map);
+    NE_AllocEnd(&pool);
+    free(entries);
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+
+# SPDX-License-Identifier: MIT
+#
+# Copyright (c) 2024 Antonio Niño Díaz <antonio_nd@outlook.com>
+
+# Compresses files in the format that Nitro Engine detects and decompresses
+# while loading files from the filesystem: the magic string "NELZ", followed by
+# a header and data in the LZ77 format of the BIOS of the NDS (type 0x10).
+
+MAGIC = b"NELZ"
+
+WINDOW_SIZE = 4096
+MIN_MATCH = 3
+MAX_MATCH = 18
+
+# Max number of previous positions checked for each match. Higher values give
+# slightly better compression, but they make the compressor slower.
+MAX_CHAIN = 128
+
+
+def compress(data):
+    data = bytes(data)
+    size = len(data)
+
+    if size >= (1 << 24):
+        raise Exception(f"File too big to be compressed ({size} bytes)")
+
+    out = bytearray(MAGIC)
+    header = 0x10 | (size << 8)
+    out.extend(header.to_bytes(4, "little"))
+
+    # Positions where each 3-byte sequence has been seen, most recent last
+    chains = {}
+
+    def add_position(pos):
+        if pos + MIN_MATCH <= size:
+            key = data[pos:pos + MIN_MATCH]
+            chains.setdefault(key, []).append(pos)
+
+    pos = 0
+    while pos < size:
+        flags_index = len(out)
+        out.append(0)
+
+        for block in range(8):
+            if pos >= size:
+                break
+
+            best_len = 0
+            best_disp = 0
+
+            key = data[pos:pos + MIN_MATCH]
+            candidates = chains.get(key, [])
+            max_len = min(MAX_MATCH, size - pos)
+
+            for start in reversed(candidates[-MAX_CHAIN:]):
+                disp = pos - start
+                if disp > WINDOW_SIZE:
+                    break
+
+                length = MIN_MATCH
+                while (length < max_len) and \
+                      (data[start + length] == data[pos + length]):
+                    length += 1
+
+                if length > best_len:
+                    best_len = length
+                    best_disp = disp
+                    if length == max_len:
+                        break
+
+            if best_len >= MIN_MATCH:
+                out[flags_index] |= 0x80 >> block
+                disp = best_disp - 1
+                out.append(((best_len - MIN_MATCH) << 4) | (disp >> 8))
+                out.append(disp & 0xFF)
+                for i in range(best_len):
+                    add_position(pos + i)
+                pos += best_len
+            else:
+                out.append(data[pos])
+                add_position(pos)
+                pos += 1
+
+    # Keep the size of the file a multiple of 4 bytes
+    while len(out) % 4 != 0:
+        out.append(0)
+
+    return bytes(out)
+
+
+def decompress(data):
+    data = bytes(data)
+
+    if data[0:4] != MAGIC or data[4] != 0x10:
+        raise Exception("Not a compressed file")
+
+    size = int.from_bytes(data[4:8], "little") >> 8
+    out = bytearray()
+    pos = 8
+
+    while len(out) < size:
+        flags = data[pos]
+        pos += 1
+        for block in range(8):
+            if len(out) >= size:
+                break
+            if flags & (0x80 >> block):
+                length = (data[pos] >> 4) + MIN_MATCH
+                disp = (((data[pos] & 0xF) << 8) | data[pos + 1]) + 1
+                pos += 2
+                for i in range(length):
+                    out.append(out[-disp])
+            else:
+                out.append(data[pos])
+                pos += 1
+
+    return bytes(out[:size])
+
+
+def save_compressed_file(path, data):
+    with open(path, "wb") as f:
+        f.write(compress(data))
+
+
+if __name__ == "__main__":
+
+    import argparse
+    import sys
+
+    parser = argparse.ArgumentParser(
+            description='Compress files so that Nitro Engine can load them.')
+
+    parser.add_argument("input", help="input file")
+    parser.add_argument("output", help="output file")
+
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as f:
+        data = f.read()
+
+    compressed = compress(data)
+    if decompress(compressed) != data:
+        print("ERROR: Compression failed")
+        sys.exit(1)
+
+    with open(args.output, "wb") as f:
+        f.write(compressed)
+
+    print(f"{args.input}: {len(data)} -> {len(compressed)} bytes")
+
+    sys.exit(0)
@@ -0,0 +1,423 @@
+# SPDX-License-Identifier: MIT
+#
+# Copyright (c) 2024 Antonio Niño Díaz <antonio_nd@outlook.com>
+
+# Mesh simplification based on quadric error metrics (Garland and Heckbert).
+# It is used to generate levels of detail of models.
+#
+# Polygons are lists of vertices, like in strips.py. Vertices can be any
+# hashable object, and the caller provides a function that returns the position
+# of a vertex. Polygons are split into triangles, and the result is always a
+# list of triangles.
+#
+# The simplification is done with half-edge collapses: a vertex is removed by
+# moving it to the position of one of its neighbors. No new vertices are
+# created, so the attributes of the vertices (texture coordinates, normals,
+# colors, joints...) are never interpolated. The following vertices are never
+# removed:
+#
+# - Vertices with more than one vertex object at the same position. This
+#   happens in texture seams, hard edges, color borders or in the border between
+#   two joints, so seams are preserved.
+#
+# - Vertices in the border of the mesh or in non-manifold edges.
+#
+# The cost of a collapse is the sum of the squared distances from the new
+# position to the planes of the original triangles around the vertices that
+# have been merged. Collapses are done in order of increasing cost.
+#
+# The error of a level of detail is the max distance between a vertex that has
+# been removed and the triangles of the simplified mesh around the vertex it has
+# been merged with, in the same units as the positions of the vertices.
+
+import heapq
+
+def _sub(a, b):
+    return (a[0] - b[0], a[1] - b[1], a[2] - b[2])
+
+def _cross(a, b):
+    return (a[1] * b[2] - a[2] * b[1],
+            a[2] * b[0] - a[0] * b[2],
+            a[0] * b[1] - a[1] * b[0])
+
+def _dot(a, b):
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]
+
+def _triangle_normal(p0, p1, p2):
+    return _cross(_sub(p1, p0), _sub(p2, p0))
+
+def _plane_quadric(p0, p1, p2):
+    """
+    Returns the quadric of the plane of a triangle as a list with the 10 unique
+    values of the symmetric 4x4 matrix, or None if the triangle is degenerate.
+    """
+    n = _triangle_normal(p0, p1, p2)
+    length = _dot(n, n) ** 0.5
+    if length == 0:
+        return None
+    a, b, c = n[0] / length, n[1] / length, n[2] / length
+    d = -(a * p0[0] + b * p0[1] + c * p0[2])
+    return [a * a, a * b, a * c, a * d,
+                   b * b, b * c, b * d,
+                          c * c, c * d,
+                                 d * d]
+
+def _quadric_add(q, r):
+    for i in range(10):
+        q[i] += r[i]
+
+def _quadric_error(q, p):
+    x, y, z = p
+    e = (q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+         + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+         + q[7] * z * z + 2 * q[8] * z
+         + q[9])
+    return max(e, 0.0)
+
+def _point_triangle_distance(p, a, b, c):
+    """
+    Returns the distance between a point and a triangle. See "Real-Time
+    Collision Detection" by Christer Ericson, section 5.1.5.
+    """
+    ab = _sub(b, a)
+    ac = _sub(c, a)
+    ap = _sub(p, a)
+
+    def distance_to(q):
+        d = _sub(p, q)
+        return _dot(d, d) ** 0.5
+
+    def lerp(o, d, t):
+        return (o[0] + d[0] * t, o[1] + d[1] * t, o[2] + d[2] * t)
+
+    d1 = _dot(ab, ap)
+    d2 = _dot(ac, ap)
+    if d1 <= 0 and d2 <= 0:
+        return distance_to(a)
+
+    bp = _sub(p, b)
+    d3 = _dot(ab, bp)
+    d4 = _dot(ac, bp)
+    if d3 >= 0 and d4 <= d3:
+        return distance_to(b)
+
+    vc = d1 * d4 - d3 * d2
+    if vc <= 0 and d1 >= 0 and d3 <= 0:
+        return distance_to(lerp(a, ab, d1 / (d1 - d3)))
+
+    cp = _sub(p, c)
+    d5 = _dot(ab, cp)
+    d6 = _dot(ac, cp)
+    if d6 >= 0 and d5 <= d6:
+        return distance_to(c)
+
+    vb = d5 * d2 - d1 * d6
+    if vb <= 0 and d2 >= 0 and d6 <= 0:
+        return distance_to(lerp(a, ac, d2 / (d2 - d6)))
+
+    va = d3 * d6 - d5 * d4
+    if va <= 0 and (d4 - d3) >= 0 and (d5 - d6) >= 0:
+        t = (d4 - d3) / ((d4 - d3) + (d5 - d6))
+        return distance_to(lerp(b, _sub(c, b), t))
+
+    denom = va + vb + vc
+    if denom == 0:
+        return distance_to(a)
+    v = vb / denom
+    w = vc / denom
+    return distance_to(lerp(lerp(a, ab, v), ac, w))
+
+def triangulate(polygons):
+    """Splits quads into triangles. Triangles are returned unchanged."""
+    triangles = []
+    for polygon in polygons:
+        for i in range(1, len(polygon) - 1):
+            triangles.append([polygon[0], polygon[i], polygon[i + 1]])
+    return triangles
+
+class _Simplifier():
+
+    def __init__(self, polygons, position, group):
+        self.group = group
+
+        # Split the mesh in triangles. Vertex positions are identified by an
+        # index so that vertices with different attributes but the same position
+        # are treated as the same point of the mesh.
+        self.pos = []
+        pos_index = {}
+        vertex_pid = {}
+        self.tri_vtx = []
+        self.tri_pid = []
+
+        for triangle in triangulate(polygons):
+            pids = []
+            for vertex in triangle:
+                pid = vertex_pid.get(vertex)
+                if pid is None:
+                    p = tuple(position(vertex))
+                    pid = pos_index.get(p)
+                    if pid is None:
+                        pid = len(self.pos)
+                        pos_index[p] = pid
+                        self.pos.append(p)
+                    vertex_pid[vertex] = pid
+                pids.append(pid)
+
+            # Triangles with two vertices in the same position aren't visible
+            if len(set(pids)) < 3:
+                continue
+
+            self.tri_vtx.append(list(triangle))
+            self.tri_pid.append(pids)
+
+        num_pos = len(self.pos)
+        self.alive = [True] * len(self.tri_pid)
+        self.num_triangles = len(self.tri_pid)
+
+        # Triangles around each position and neighbors of each position
+        self.tris = [set() for _ in range(num_pos)]
+        self.neighbors = [set() for _ in range(num_pos)]
+        edge_count = {}
+        for t, pids in enumerate(self.tri_pid):
+            for i in range(3):
+                a, b = pids[i], pids[(i + 1) % 3]
+                self.tris[a].add(t)
+                self.neighbors[a].add(b)
+                self.neighbors[b].add(a)
+                edge = (min(a, b), max(a, b))
+                edge_count[edge] = edge_count.get(edge, 0) + 1
+
+        # Vertices that can't be removed
+        self.locked = [False] * num_pos
+        objects = [set() for _ in range(num_pos)]
+        for vertex, pid in vertex_pid.items():
+            objects[pid].add(vertex)
+        for pid in range(num_pos):
+            if len(objects[pid]) != 1:
+                self.locked[pid] = True
+        for (a, b), count in edge_count.items():
+            if count != 2:
+                self.locked[a] = True
+                self.locked[b] = True
+
+        self.quadric = [[0.0] * 10 for _ in range(num_pos)]
+        for pids in self.tri_pid:
+            q = _plane_quadric(*[self.pos[pid] for pid in pids])
+            if q is None:
+                continue
+            for pid in pids:
+                _quadric_add(self.quadric[pid], q)
+
+        # Vertex that each vertex has been merged with
+        self.merged = list(range(num_pos))
+
+        self.version = [0] * num_pos
+        self.heap = []
+        for a in range(num_pos):
+            for b in self.neighbors[a]:
+                self.push(a, b)
+
+
+    def vertex_at(self, t, pid):
+        """Returns the vertex object of a triangle at the provided position."""
+        return self.tri_vtx[t][self.tri_pid[t].index(pid)]
+
+    def cost(self, a, b):
+        q = list(self.quadric[a])
+        _quadric_add(q, self.quadric[b])
+        return _quadric_error(q, self.pos[b])
+
+    def push(self, a, b):
+        if self.locked[a]:
+            return
+        heapq.heappush(self.heap, (self.cost(a, b), a, b, self.version[a],
+                                   self.version[b]))
+
+    def push_collapses(self, pid):
+        for n in self.neighbors[pid]:
+            self.push(pid, n)
+            self.push(n, pid)
+
+    def check_collapse(self, a, b):
+        """
+        Checks if a can be moved to b. It returns the vertex object that
+        replaces the vertex of a in all triangles, or None.
+        """
+        shared = self.tris[a] & self.tris[b]
+
+        # Link condition: The only vertices that are neighbors of both vertices
+        # must be the ones of the two triangles that are removed. If not, the
+        # collapse would create non-manifold edges.
+        if len(shared) != 2:
+            return None
+        if len(self.neighbors[a] & self.neighbors[b]) != 2:
+            return None
+
+        # The vertex of b must be the same in the triangles that are removed, or
+        # it wouldn't be clear which one has to replace a.
+        replacement = set(self.vertex_at(t, b) for t in shared)
+        if len(replacement) != 1:
+            return None
+        replacement = replacement.pop()
+
+        if self.group is not None:
+            va = self.vertex_at(next(iter(self.tris[a])), a)
+            if self.group(va) != self.group(replacement):
+                return None
+
+        # Triangles that aren't removed can't be flipped or become degenerate
+        for t in self.tris[a] - shared:
+            pids = self.tri_pid[t]
+            before = _triangle_normal(*[self.pos[pid] for pid in pids])
+            after = _triangle_normal(*[self.pos[b if pid == a else pid]
+                                       for pid in pids])
+            if _dot(before, after) <= 0:
+                return None
+            if _dot(after, after) <= _dot(before, before) * 1e-6:
+                return None
+
+        return replacement
+
+    def collapse(self, a, b, replacement):
+        for t in self.tris[a] & self.tris[b]:
+            self.alive[t] = False
+            self.num_triangles -= 1
+            for pid in self.tri_pid[t]:
+                self.tris[pid].discard(t)
+
+        for t in self.tris[a]:
+            i = self.tri_pid[t].index(a)
+            self.tri_pid[t][i] = b
+            self.tri_vtx[t][i] = replacement
+            self.tris[b].add(t)
+        self.tris[a] = set()
+
+        for n in self.neighbors[a]:
+            self.neighbors[n].discard(a)
+            if n != b:
+                self.neighbors[n].add(b)
+                self.neighbors[b].add(n)
+        self.neighbors[a] = set()
+
+        _quadric_add(self.quadric[b], self.quadric[a])
+        self.merged[a] = b
+
+        self.version[a] += 1
+        self.version[b] += 1
+        self.push_collapses(b)
+
+    def measure_error(self):
+        error = 0.0
+        for pid in range(len(self.pos)):
+            if self.merged[pid] == pid:
+                continue
+
+            final = pid
+            while self.merged[final] != final:
+                final = self.merged[final]
+
+            distance = min(_point_triangle_distance(self.pos[pid],
+                                *[self.pos[i] for i in self.tri_pid[t]])
+                           for t in self.tris[final])
+            error = max(error, distance)
+
+        return error
+
+    def run(self, target):
+        while self.num_triangles > target and len(self.heap) > 0:
+            cost, a, b, version_a, version_b = heapq.heappop(self.heap)
+            if version_a != self.version[a] or version_b != self.version[b]:
+                continue
+            if b not in self.neighbors[a]:
+                continue
+
+            replacement = self.check_collapse(a, b)
+            if replacement is None:
+                continue
+
+            self.collapse(a, b, replacement)
+
+        triangles = [list(vertices) for vertices, alive in
+                     zip(self.tri_vtx, self.alive) if alive]
+        return triangles, self.measure_error()
+
+def simplify(polygons, position, target, group=None):
+    """
+    Simplifies a mesh until it has the target number of triangles or until no
+    more vertices can be removed. The function position(vertex) returns the
+    position of a vertex as a tuple (x, y, z). If group(vertex) is provided,
+    vertices are only moved to neighbors in the same group (for example, to
+    vertices that belong to the same joint).
+
+    It returns the list of triangles of the simplified mesh and its error.
+    """
+    return _Simplifier(polygons, position, group).run(target)
+
+def parse_target(value, num_triangles):
+    """
+    Converts the value of a --lod argument to a number of triangles. Values
+    lower than 1.0 are a ratio of the original number of triangles, any other
+    value is a number of triangles.
+    """
+    if value < 1.0:
+        return max(int(num_triangles * value), 1)
+    return int(value)
+
+def print_report(levels):
+    """Prints the number of triangles and the error of each level of detail."""
+    print("Levels of detail:")
+    for i, (triangles, error) in enumerate(levels):
+        print(f"  LOD {i}: {len(triangles)} triangles, error {error:.6f}")
+
+def save_report(levels, file_names, output_file):
+    """Saves the information of all levels of detail to a text file."""
+    with open(output_file, "w") as f:
+        f.write("# level file triangles error\n")
+        for i, ((triangles, error), name) in enumerate(zip(levels, file_names)):
+            f.write(f"{i} {name} {len(triangles)} {error:.6f}\n")
+
+if __name__ == "__main__":
+    import math
+
+    # UV sphere. Vertices are (position, texture coordinate). The column of
+    # vertices with u = 0 and u = 1 is a texture seam.
+    rings = 16
+    segments = 24
+
+    def vertex(ring, segment):
+        theta = math.pi * ring / rings
+        phi = 2 * math.pi * (segment % segments) / segments
+        if ring == 0 or ring == rings:
+            segment = 0
+        p = (round(math.sin(theta) * math.cos(phi), 6),
+             round(math.cos(theta), 6),
+             round(math.sin(theta) * math.sin(phi), 6))
+        return (p, (segment / segments, ring / rings))
+
+    polygons = []
+    for ring in range(rings):
+        for segment in range(segments):
+            a = vertex(ring, segment)
+            b = vertex(ring + 1, segment)
+            c = vertex(ring + 1, segment + 1)
+            d = vertex(ring, segment + 1)
+            polygons.append([p for i, p in enumerate([a, b, c, d])
+                             if [a, b, c, d].index(p) == i])
+
+    original = triangulate(polygons)
+    seam = set(v for t in original for v in t
+               if v[1][0] in [0, 1] and 0 < v[1][1] < 1)
+
+    for ratio in [0.5, 0.25, 0.1]:
+        target = parse_target(ratio, len(original))
+        triangles, error = simplify(polygons, lambda v: v[0], target)
+
+        # All seam vertices must still be there. All the vertices of the
+        # sphere are at distance 1 from the center, and the simplified mesh is
+        # inside the sphere, so the error can't be bigger than that.
+        assert len(triangles) <= target
+        assert seam <= set(v for t in triangles for v in t)
+        assert 0 < error < 1
+
+        print(f"{ratio}: {len(original)} -> {len(triangles)} triangles, "
+              f"error {error:.4f}")
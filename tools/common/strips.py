@@ -0,0 +1,267 @@
+# SPDX-License-Identifier: MIT
+#
+# Copyright (c) 2024 Antonio Niño Díaz <antonio_nd@outlook.com>
+
+# Greedy generator of triangle strips and quad strips.
+#
+# Polygons are lists of vertices in the order in which they are drawn. Vertices
+# can be any hashable object, and two polygons are only joined in a strip if
+# they use the same vertex objects. The vertices must include all the
+# information that is sent to the GPU with them (texture coordinates, normal,
+# color, matrix...) so that strips don't join polygons across seams.
+#
+# The GPU of the NDS draws strips like this (GBATEK):
+#
+#   Triangle strips: ABC, CBD, CDE, EDF...
+#   Quad strips:     ABDC, CDFE, EFHG...
+#
+# Polygons that share an edge in opposite directions (so that they have the
+# same winding) are joined. Polygons that can't be joined with any other
+# polygon are returned separately so that they can be drawn as a list of
+# independent polygons, which is cheaper than a strip with just one polygon.
+
+import vertex_order
+
+def _polygon_edges(polygon):
+    """Returns all directed edges of a polygon and the position of each one."""
+    n = len(polygon)
+    return [((polygon[i], polygon[(i + 1) % n]), i) for i in range(n)]
+
+class _StripBuilder():
+
+    def __init__(self, polygons):
+        self.polygons = polygons
+        self.used = [False] * len(polygons)
+
+        # Directed edge -> List of (polygon index, position of the edge)
+        self.edges = {}
+        for index, polygon in enumerate(polygons):
+            if not self.is_valid(index):
+                continue
+            for edge, pos in _polygon_edges(polygon):
+                self.edges.setdefault(edge, []).append((index, pos))
+
+    def is_valid(self, index):
+        # Degenerate polygons can't be part of a strip
+        polygon = self.polygons[index]
+        return len(set(polygon)) == len(polygon)
+
+    def neighbors(self, index):
+        """Number of unused polygons that can be joined to this polygon."""
+        count = 0
+        for (a, b), pos in _polygon_edges(self.polygons[index]):
+            for other, _ in self.edges.get((b, a), []):
+                if other != index and not self.used[other]:
+                    count += 1
+        return count
+
+    def find_next(self, edge, taken):
+        """
+        Looks for an unused polygon that contains the provided directed edge.
+        If there are several of them, it returns the one with the fewest
+        neighbors so that polygons with many neighbors are left for later
+        strips. It returns (polygon index, position of the edge).
+        """
+        best = None
+        best_neighbors = None
+        for index, pos in self.edges.get(edge, []):
+            if self.used[index] or index in taken:
+                continue
+            n = self.neighbors(index)
+            if best is None or n < best_neighbors:
+                best = (index, pos)
+                best_neighbors = n
+        return best
+
+    def build(self, walk):
+        """
+        Generates strips with the provided walk function. It returns a list of
+        strips (vertices in the order they have to be sent to the GPU) and a
+        list of polygons that aren't part of any strip.
+        """
+        strips = []
+        single = []
+
+        # Start with the polygons that have fewer neighbors. They are the
+        # hardest ones to add to a strip later.
+        order = sorted(range(len(self.polygons)), key=self.neighbors)
+
+        for start in order:
+            if self.used[start]:
+                continue
+
+            if not self.is_valid(start):
+                self.used[start] = True
+                single.append(self.polygons[start])
+                continue
+
+            # Try all possible first edges and keep the longest strip
+            best_strip = None
+            best_taken = None
+            for rotation in range(len(self.polygons[start])):
+                strip, taken = walk(self, start, rotation)
+                if best_taken is None or len(taken) > len(best_taken):
+                    best_strip = strip
+                    best_taken = taken
+
+            for index in best_taken:
+                self.used[index] = True
+
+            if len(best_taken) > 1:
+                strips.append(best_strip)
+            else:
+                single.append(self.polygons[start])
+
+        return strips, single
+
+def _walk_triangles(builder, start, rotation):
+    a, b, c = builder.polygons[start][rotation:] + \
+              builder.polygons[start][:rotation]
+    strip = [a, b, c]
+    taken = [start]
+
+    while True:
+        # Odd triangles of the strip are drawn with the first two vertices
+        # swapped, so the edge shared with the next triangle alternates.
+        if len(taken) % 2 == 1:
+            edge = (strip[-1], strip[-2])
+        else:
+            edge = (strip[-2], strip[-1])
+
+        found = builder.find_next(edge, taken)
+        if found is None:
+            break
+
+        index, pos = found
+        triangle = builder.polygons[index]
+        strip.append(triangle[(pos + 2) % 3])
+        taken.append(index)
+
+    return strip, taken
+
+def _walk_quads(builder, start, rotation):
+    a, b, c, d = builder.polygons[start][rotation:] + \
+                 builder.polygons[start][:rotation]
+    strip = [a, b, d, c]
+    taken = [start]
+
+    while True:
+        edge = (strip[-2], strip[-1])
+
+        found = builder.find_next(edge, taken)
+        if found is None:
+            break
+
+        index, pos = found
+        quad = builder.polygons[index]
+        strip.append(quad[(pos + 3) % 4])
+        strip.append(quad[(pos + 2) % 4])
+        taken.append(index)
+
+    return strip, taken
+
+def make_triangle_strips(triangles):
+    """
+    Joins triangles into triangle strips. It returns a list of strips and a list
+    of triangles that aren't part of any strip.
+    """
+    return _StripBuilder(triangles).build(_walk_triangles)
+
+def make_quad_strips(quads):
+    """
+    Joins quads into quad strips. It returns a list of strips and a list of quads
+    that aren't part of any strip.
+    """
+    return _StripBuilder(quads).build(_walk_quads)
+
+def strip_to_polygons(strip, poly_type):
+    """Returns the polygons drawn by a strip, with their original winding."""
+    polygons = []
+    if poly_type == "triangle_strip":
+        for i in range(len(strip) - 2):
+            a, b, c = strip[i:i + 3]
+            if i % 2 == 1:
+                a, b = b, a
+            polygons.append([a, b, c])
+    elif poly_type == "quad_strip":
+        for i in range(0, len(strip) - 2, 2):
+            a, b, c, d = strip[i:i + 4]
+            polygons.append([a, b, d, c])
+    return polygons
+
+def draw_polygons(dl, polygons, emit_vertex, use_strips, reorder=False,
+                  verbose=False):
+    """
+    Adds triangles and quads to a display list. The function emit_vertex(dl,
+    vertex) must add all the commands needed by one vertex. If use_strips and
+    reorder are False the polygons are added in the same order as they are
+    provided. If reorder is True, the order is changed to make the display list
+    smaller (see vertex_order.py).
+    """
+    if use_strips:
+        triangles = [p for p in polygons if len(p) == 3]
+        quads = [p for p in polygons if len(p) == 4]
+
+        tri_strips, single_triangles = make_triangle_strips(triangles)
+        quad_strips, single_quads = make_quad_strips(quads)
+
+        if verbose:
+            print(f"  Triangle strips: {len(tri_strips)} "
+                  f"({len(triangles) - len(single_triangles)} triangles)")
+            print(f"  Quad strips:     {len(quad_strips)} "
+                  f"({len(quads) - len(single_quads)} quads)")
+            print(f"  Separate:        {len(single_triangles)} triangles, "
+                  f"{len(single_quads)} quads")
+
+        primitives = [("triangle_strip", s) for s in tri_strips] + \
+                     [("quad_strip", s) for s in quad_strips] + \
+                     [("triangles", p) for p in single_triangles] + \
+                     [("quads", p) for p in single_quads]
+    else:
+        primitives = [("triangles" if len(p) == 3 else "quads", p)
+                      for p in polygons]
+
+    if reorder:
+        primitives = vertex_order.reorder_primitives(dl, primitives,
+                                                     emit_vertex)
+
+    for primitive in primitives:
+        vertex_order.emit_primitive(dl, primitive, emit_vertex)
+
+def print_report(dl_before, dl_after):
+    """Compares the display lists generated with different options."""
+    size_before = len(dl_before.display_list) * 4
+    size_after = len(dl_after.display_list) * 4
+    print(f"  Vertices: {dl_before.num_vertices} -> {dl_after.num_vertices}")
+    print(f"  Size:     {size_before} -> {size_after} bytes "
+          f"({size_before - size_after} bytes saved)")
+
+def _normalize(polygon):
+    """Rotates a polygon so that it starts with its smallest vertex."""
+    i = polygon.index(min(polygon))
+    return tuple(polygon[i:] + polygon[:i])
+
+if __name__ == "__main__":
+    # Grid of 4x4 squares drawn as triangles and as quads
+    size = 4
+    quads = []
+    for y in range(size):
+        for x in range(size):
+            v = y * (size + 1) + x
+            quads.append([v, v + size + 1, v + size + 2, v + 1])
+    triangles = []
+    for a, b, c, d in quads:
+        triangles.extend([[a, b, c], [a, c, d]])
+
+    for polygons, make, poly_type in [
+            (triangles, make_triangle_strips, "triangle_strip"),
+            (quads, make_quad_strips, "quad_strip")]:
+        strips, single = make(polygons)
+        result = list(single)
+        for strip in strips:
+            result.extend(strip_to_polygons(strip, poly_type))
+        assert sorted(map(_normalize, result)) == \
+               sorted(map(_normalize, polygons))
+        vertices = sum(len(s) for s in strips) + sum(len(p) for p in single)
+        print(f"{poly_type}: {len(strips)} strips, {len(single)} single, "
+              f"{vertices} vertices")
@@ -0,0 +1,104 @@
+# SPDX-License-Identifier: MIT
+#
+# Copyright (c) 2024 Antonio Niño Díaz <antonio_nd@outlook.com>
+
+# Changes the order of the primitives of a model to reduce the size of its
+# display list.
+#
+# The size of each vertex depends on the previous one. VTX_XY, VTX_XZ, VTX_YZ
+# and VTX_DIFF take half the size of VTX_16, but they can only be used if the
+# new vertex is close to the previous one, and texture coordinates and normals
+# are skipped if they are the same as the previous ones. The order of the faces
+# in the original model isn't designed with this in mind.
+#
+# Primitives are tuples of (type, vertices). The type is the name of the
+# polygon type used by DisplayList.begin_vtxs(). The last element of each
+# vertex must be its position.
+#
+# This is a greedy algorithm: the next primitive is the one that adds the
+# fewest bytes to the display list, checked with all the possible first
+# vertices of independent triangles and quads (this doesn't change their
+# winding). Only a few primitives are checked each time: the next ones in the
+# original order and the ones that share a vertex position with the last one.
+
+# Number of primitives of the original order checked as next primitive
+WINDOW = 32
+
+def emit_primitive(dl, primitive, emit_vertex):
+    poly_type, vertices = primitive
+
+    if poly_type in ["triangles", "quads"]:
+        dl.switch_vtxs(poly_type)
+    else:
+        # END_VTXS is a dummy command, a BEGIN_VTXS is enough to start a new
+        # strip
+        dl.begin_vtxs(poly_type)
+
+    for vertex in vertices:
+        emit_vertex(dl, vertex)
+
+def _rotations(primitive):
+    poly_type, vertices = primitive
+
+    # Strips can't be rotated
+    if poly_type not in ["triangles", "quads"]:
+        return [primitive]
+
+    return [(poly_type, vertices[i:] + vertices[:i])
+            for i in range(len(vertices))]
+
+def reorder_primitives(dl, primitives, emit_vertex):
+    """
+    Returns the primitives in the order that makes the display list smaller
+    when they are added after the current contents of the display list.
+    """
+    count = len(primitives)
+    placed = [False] * count
+
+    # Vertex position -> Primitives that use it
+    users = {}
+    for index, (_, vertices) in enumerate(primitives):
+        for vertex in vertices:
+            users.setdefault(vertex[-1], []).append(index)
+
+    state = dl.fork()
+    result = []
+    first = 0 # First primitive that hasn't been placed
+    last = None
+
+    for _ in range(count):
+        while placed[first]:
+            first += 1
+
+        candidates = set()
+
+        index = first
+        while index < count and len(candidates) < WINDOW:
+            if not placed[index]:
+                candidates.add(index)
+            index += 1
+
+        if last is not None:
+            for vertex in last[1]:
+                for index in users[vertex[-1]]:
+                    if not placed[index]:
+                        candidates.add(index)
+
+        best = None
+        best_key = None
+        for index in sorted(candidates):
+            for option in _rotations(primitives[index]):
+                scratch = state.fork()
+                emit_primitive(scratch, option, emit_vertex)
+                key = (scratch.size, index)
+                if best is None or key < best_key:
+                    best = (index, option)
+                    best_key = key
+
+        index, option = best
+        placed[index] = True
+        emit_primitive(state, option, emit_vertex)
+        result.append(option)
+        last = option
+
+    return result
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2024 Antonio Niño Díaz
+//
+// This file is part of Nitro Engine
+
+// Minimal replacement of NEMain.h used to build source/NEDisplayListInfo.c on
+// a PC.
+
+#ifndef NE_MAIN_H__
+#define NE_MAIN_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef int8_t s8;
+typedef uint8_t u8;
+typedef uint32_t u32;
+
+// Polygon types of libnds
+#define GL_TRIANGLES        0
+#define GL_QUADS            1
+#define GL_TRIANGLE_STRIP   2
+#define GL_QUAD_STRIP       3
+
+#define NE_DebugPrint(...)                                              \
+    do {                                                                \
+        fprintf(stderr, "%s:%d: ", __func__, __LINE__);                 \
+        fprintf(stderr, __VA_ARGS__);                                   \
+        fprintf(stderr, "\n");                                          \
+    } while (0)
+
+#define NE_Assert(cond, ...)                                            \
+    do {                                                                \
+        if (!(cond))                                                    \
+        {                                                               \
+            NE_DebugPrint(__VA_ARGS__);                                 \
+            abort();                                                    \
+        }                                                               \
+    } while (0)
+
+#define NE_AssertPointer(ptr, ...) NE_Assert((ptr) != NULL, __VA_ARGS__)
+
+#include "NEDisplayList.h"
+
+#endif // NE_MAIN_H__
@@ -0,0 +1,249 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2024 Antonio Niño Díaz
+//
+// This file is part of Nitro Engine
+
+// Disassembles and validates display lists generated by obj2dl, md5_to_dsma or
+// any other tool, and estimates the time that the geometry engine needs to
+// process them.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "NEMain.h"
+
+static const char *error_names[] = {
+    [NE_DL_VALID] = "valid",
+    [NE_DL_ERROR_TRUNCATED] = "truncated",
+    [NE_DL_ERROR_INVALID_COMMAND] = "invalid command",
+    [NE_DL_ERROR_INVALID_RESTORE] = "MTX_RESTORE outside of joint matrices",
+};
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [-d] [-r] [-j joints | -a anim.dsa] list.bin...\n", name);
+    printf("\n");
+    printf("  -d          Print all commands of the display list\n");
+    printf("  -r          Print one line per file, and skip files that aren't\n");
+    printf("              display lists\n");
+    printf("  -j joints   Number of joints of the model (md5_to_dsma models)\n");
+    printf("  -a anim.dsa Read the number of joints from a DSA file\n");
+}
+
+// Loads a file to RAM. The size of the buffer is rounded up to a multiple of
+// 4 bytes so that it can be accessed as words.
+static void *load_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Can't open %s\n", path);
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long file_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    if (file_size < 0)
+    {
+        fprintf(stderr, "Can't get size of %s\n", path);
+        fclose(f);
+        return NULL;
+    }
+
+    void *data = calloc(1, (file_size + 3) & ~3);
+    if (data == NULL)
+    {
+        fprintf(stderr, "Not enough memory\n");
+        fclose(f);
+        return NULL;
+    }
+
+    if (fread(data, 1, file_size, f) != (size_t)file_size)
+    {
+        fprintf(stderr, "Can't read %s\n", path);
+        free(data);
+        fclose(f);
+        return NULL;
+    }
+
+    fclose(f);
+
+    *size = file_size;
+    return data;
+}
+
+// Returns the number of joints of a DSA file, or -1 on error.
+static int read_dsa_joints(const char *path)
+{
+    size_t size;
+    uint32_t *dsa = load_file(path, &size);
+    if (dsa == NULL)
+        return -1;
+
+    int joints = -1;
+
+    if ((size < 12) || (dsa[0] != 1))
+        fprintf(stderr, "%s isn't a valid DSA file\n", path);
+    else
+        joints = dsa[2];
+
+    free(dsa);
+    return joints;
+}
+
+static void print_command(u32 offset, u32 cmd, const u32 *params,
+                          int num_params, void *arg)
+{
+    (void)arg;
+
+    printf("%6u: %-14s", offset, NE_DisplayListCommandName(cmd));
+
+    for (int i = 0; i < num_params; i++)
+        printf(" 0x%08X", params[i]);
+
+    printf("\n");
+}
+
+static void print_info(const NE_DisplayListInfo *info)
+{
+    printf("  Size:      %u words\n", info->words);
+    printf("  Commands:  %u\n", info->commands);
+    printf("  Vertices:  %u\n", info->vertices);
+    printf("  Triangles: %u\n", info->triangles);
+    printf("  Quads:     %u\n", info->quads);
+    printf("  Cycles:    %u (estimated)\n", info->cycles);
+    printf("  Commands by type:\n");
+
+    for (u32 cmd = 1; cmd < NE_DL_NUM_COMMAND_IDS; cmd++)
+    {
+        if (info->command_count[cmd] == 0)
+            continue;
+
+        printf("    %-14s %u\n", NE_DisplayListCommandName(cmd),
+               info->command_count[cmd]);
+    }
+
+    if (info->error == NE_DL_VALID)
+    {
+        printf("  Status:    valid\n");
+    }
+    else
+    {
+        printf("  Status:    ERROR: %s (word %u)\n", error_names[info->error],
+               info->error_offset);
+    }
+}
+
+static void print_report(const char *path, const NE_DisplayListInfo *info)
+{
+    printf("%s: %u words, %u commands, %u vertices, %u triangles, %u quads, "
+           "%u cycles, %s\n", path, info->words, info->commands,
+           info->vertices, info->triangles, info->quads, info->cycles,
+           error_names[info->error]);
+}
+
+// Returns 0 if the file is valid, 1 if not.
+static int inspect_file(const char *path, int num_joints, bool disassemble,
+                        bool report)
+{
+    size_t size;
+    uint32_t *list = load_file(path, &size);
+    if (list == NULL)
+        return 1;
+
+    int ret = 0;
+
+    if ((size >= 4) && (memcmp(list, "NELZ", 4) == 0))
+    {
+        // Compressed files have to be decompressed with lz77.py first
+        if (report)
+            printf("%s: compressed file, skipped\n", path);
+        else
+            fprintf(stderr, "%s is compressed\n", path);
+
+        ret = report ? 0 : 1;
+        goto end;
+    }
+
+    // Display lists generated by the tools of Nitro Engine have the exact size
+    // of the display list. Any other file in the folders of the examples is a
+    // texture, palette, animation...
+    if (report && ((size < 4) || ((size_t)(list[0] + 1) * 4 != size)))
+        goto end;
+
+    if (!report)
+        printf("%s\n", path);
+
+    if (disassemble)
+        NE_DisplayListDecode(list, size, print_command, NULL, NULL);
+
+    NE_DisplayListInfo info;
+    if (NE_DisplayListAnalyze(list, size, num_joints, &info) == 0)
+        ret = 1;
+
+    if (report)
+        print_report(path, &info);
+    else
+        print_info(&info);
+
+end:
+    free(list);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    bool disassemble = false;
+    bool report = false;
+    int num_joints = 0;
+    int first_file = argc;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-d") == 0)
+        {
+            disassemble = true;
+        }
+        else if (strcmp(argv[i], "-r") == 0)
+        {
+            report = true;
+        }
+        else if ((strcmp(argv[i], "-j") == 0) && (i + 1 < argc))
+        {
+            num_joints = atoi(argv[++i]);
+        }
+        else if ((strcmp(argv[i], "-a") == 0) && (i + 1 < argc))
+        {
+            num_joints = read_dsa_joints(argv[++i]);
+            if (num_joints < 0)
+                return 1;
+        }
+        else if (argv[i][0] == '-')
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            first_file = i;
+            break;
+        }
+    }
+
+    if (first_file == argc)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int ret = 0;
+
+    for (int i = first_file; i < argc; i++)
+        ret |= inspect_file(argv[i], num_joints, disassemble, report);
+
+    return ret;
+}
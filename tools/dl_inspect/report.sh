@@ -0,0 +1,32 @@
+#!/bin/sh
+
+# SPDX-License-Identifier: MIT
+#
+# Copyright (c) 2024 Antonio Niño Díaz
+
+# Analyzes all the display lists in the data folders of the examples. Models
+# exported with md5_to_dsma are checked against the number of joints of the
+# first animation in the same folder.
+
+EXAMPLES="${1:-../../examples}"
+DL_INSPECT="$(cd "$(dirname "$0")" && pwd)/dl_inspect"
+
+cd "$EXAMPLES" || exit 1
+
+ret=0
+
+for file in $(find . -path "*/data/*.bin" | sort); do
+    case "$file" in
+        *_dsm.bin)
+            anim=$(ls "$(dirname "$file")"/*_dsa.bin 2> /dev/null | head -n 1)
+            if [ -n "$anim" ]; then
+                "$DL_INSPECT" -r -a "$anim" "$file" || ret=1
+                continue
+            fi
+            ;;
+    esac
+
+    "$DL_INSPECT" -r "$file" || ret=1
+done
+
+exit $ret
@@ -7,10 +7,16 @@
 # This tool depends on pillow: pip3 install pillow (tested with version 9.0.1)
 
 import os
+import sys
+
+# Modules shared by several tools
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                "..", "common"))
 
 from PIL import Image
 
 from palette import Palette
+import lz77
 
 VALID_TEXTURE_SIZES = [8, 16, 32, 64, 128, 256, 512, 1024]
 VALID_FORMATS = ["A1RGB5", "PAL256", "PAL16", "PAL4", "A3PAL32", "A5PAL8",
@@ -21,9 +27,12 @@ def is_valid_texture_size(size):
     return size in VALID_TEXTURE_SIZES
 
 
-def save_binary_file(path, byte_list):
+def save_binary_file(path, byte_list, compress):
     with open(path, "wb") as f:
-        f.write(bytearray(byte_list))
+        if compress:
+            f.write(lz77.compress(byte_list))
+        else:
+            f.write(bytearray(byte_list))
 
 
 def convert_a1rgb5(img):
@@ -305,7 +314,7 @@ def convert_depthbmp(img):
     return texture, palette
 
 
-def convert_img(in_path, out_name, out_folder, out_format):
+def convert_img(in_path, out_name, out_folder, out_format, compress):
 
     if out_format not in VALID_FORMATS:
         raise Exception(f"Unknown format {out_format}. Valid: {VALID_FORMATS}")
@@ -342,11 +351,11 @@ def convert_img(in_path, out_name, out_folder, out_format):
             texture, palette = convert_a5pal8(img)
 
     print(f"Saving texture to: {texture_path}")
-    save_binary_file(texture_path, texture)
+    save_binary_file(texture_path, texture, compress)
 
     if len(palette) > 0:
         print(f"Saving palette to: {palette_path}")
-        save_binary_file(palette_path, palette)
+        save_binary_file(palette_path, palette, compress)
 
 
 if __name__ == "__main__":
@@ -373,10 +382,16 @@ if __name__ == "__main__":
     parser.add_argument("--format", required=True, choices=VALID_FORMATS,
                         help="format of the texture")
 
+    # Optional arguments
+    parser.add_argument("--compress", required=False,
+                        action='store_true',
+                        help="compress the output files with LZ77")
+
     args = parser.parse_args()
 
     try:
-        convert_img(args.input, args.name, args.output, args.format)
+        convert_img(args.input, args.name, args.output, args.format,
+                    args.compress)
     except BaseException as e:
         print("ERROR: " + str(e))
         traceback.print_exc()
@@ -5,11 +5,19 @@
 # Copyright (c) 2022 Antonio Niño Díaz <antonio_nd@outlook.com>
 
 import os
+import sys
+
+# Modules shared by several tools
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                "..", "common"))
 
 from collections import namedtuple
 from math import sqrt
 
 from display_list import DisplayList, float_to_f32
+import lz77
+import simplify
+import strips
 
 class MD5FormatError(Exception):
     pass
@@ -550,7 +558,7 @@ def parse_md5anim(input_file):
 
     return frames
 
-def save_animation(frames, output_file, blender_fix):
+def save_animation(frames, output_file, blender_fix, compress):
 
     version = 1
     num_frames = len(frames)
@@ -582,17 +590,118 @@ def save_animation(frames, output_file, blender_fix):
             u32_array.extend(pos)
             u32_array.extend(orient)
 
+    data = bytearray()
+    for u32 in u32_array:
+        data.extend(u32.to_bytes(4, "little"))
+
     with open(output_file, "wb") as f:
-        for u32 in u32_array:
-            b = [u32 & 0xFF, \
-                (u32 >> 8) & 0xFF, \
-                (u32 >> 16) & 0xFF, \
-                (u32 >> 24) & 0xFF]
-            f.write(bytearray(b))
+        if compress:
+            f.write(lz77.compress(data))
+        else:
+            f.write(data)
+
+def normal_to_joint_space(norm, joint):
+    """Transforms a normal by the inverted orientation of a joint."""
+    q = joint.orient
+    qt = q.complement()
+    n = norm.to_q()
+
+    n = qt.mul(n).mul(q).to_v3()
+    if n.length() > 0:
+        n = n.normalize()
+
+    return n
+
+def lod_polygons(triangles, joints):
+    """
+    Generates the polygons of a level of detail. The vertices of the triangles
+    are (u, v, joint index, position in joint space, position in model space).
+    The normal of each triangle is calculated again from the positions of the
+    simplified triangle, like for the original model.
+    """
+    polygons = []
+
+    for triangle in triangles:
+        vtx = [Vector(*vertex[4]) for vertex in triangle]
+
+        a = vtx[0].sub(vtx[1])
+        b = vtx[1].sub(vtx[2])
+
+        norm = a.cross(b)
+        if norm.length() > 0:
+            norm = norm.normalize()
+
+        polygon = []
+        for u, v, joint_index, pos, _ in triangle:
+            n = normal_to_joint_space(norm, joints[joint_index])
+            polygon.append((u, v, joint_index, (n.x, n.y, n.z), pos))
+
+        polygons.append(polygon)
+
+    return polygons
+
+def generate_display_list(polygons, base_matrix, use_strips, optimize,
+                          max_error, normal_polygons=None, verbose=False):
+    """
+    Generates the display list of a model. If normal_polygons isn't None, it
+    draws a polygon that shows the normal of each triangle after the triangle.
+    """
+    dl = DisplayList(max_error if optimize else None)
+    dl.switch_vtxs("triangles")
+
+    def emit_vertex(dl, vertex):
+        u, v, joint_index, n, pos = vertex
+
+        dl.texcoord(u, v)
+
+        # Load joint matrix. When drawing normal polygons it has to be loaded
+        # every time, because drawing the normal restores the original matrix.
+        matrix = base_matrix + joint_index
+        if normal_polygons is not None or matrix != dl.mtx_restore_last:
+            dl.mtx_restore(matrix)
+
+        dl.normal(*n)
+        dl.vtx(*pos)
+
+    if normal_polygons is None:
+        strips.draw_polygons(dl, polygons, emit_vertex, use_strips, optimize,
+                             verbose)
+    else:
+        for polygon, (vert_avg, vert_avg_end) in zip(polygons, normal_polygons):
+            for vertex in polygon:
+                emit_vertex(dl, vertex)
+
+            # Don't use any of the joint transformation matrices
+            dl.mtx_restore(1)
+
+            dl.texcoord(0, 0)
+
+            dl.color(1, 0, 0)
+            dl.vtx(vert_avg.x + 0.1, vert_avg.y, vert_avg.z)
+            dl.vtx(vert_avg.x, vert_avg.y, vert_avg.z)
+            dl.color(0, 1, 0)
+            dl.vtx(vert_avg_end.x, vert_avg_end.y, vert_avg_end.z)
+
+            dl.color(1, 0, 0)
+            dl.vtx(vert_avg.x, vert_avg.y, vert_avg.z)
+            dl.vtx(vert_avg.x, vert_avg.y + 0.1, vert_avg.z)
+            dl.color(0, 1, 0)
+            dl.vtx(vert_avg_end.x, vert_avg_end.y, vert_avg_end.z)
+
+            dl.color(1, 0, 0)
+            dl.vtx(vert_avg.x, vert_avg.y, vert_avg.z)
+            dl.vtx(vert_avg.x, vert_avg.y, vert_avg.z + 0.1)
+            dl.color(0, 1, 0)
+            dl.vtx(vert_avg_end.x, vert_avg_end.y, vert_avg_end.z)
+
+    dl.end_vtxs()
+    dl.finalize()
+    return dl
 
 def convert_md5mesh(model_file, name, output_folder, texture_size,
                     draw_normal_polygons, extension_mesh, extension_anim,
-                    blender_fix, export_base_pose):
+                    blender_fix, export_base_pose, use_strips, optimize,
+                    max_error, compress, lod=[]):
 
     print(f"Converting model: {model_file}")
 
@@ -611,16 +720,26 @@ def convert_md5mesh(model_file, name, output_folder, texture_size,
 
         save_animation([joints],
                        os.path.join(output_folder, f"{name}{extension_anim}"),
-                       blender_fix)
+                       blender_fix, compress)
 
     print("Converting meshes...")
 
-    # Display list shared between all meshes
-    dl = DisplayList()
-    dl.switch_vtxs("triangles")
-
     base_matrix = 30 - len(joints) + 1
-    last_joint_index = None
+
+    # Triangles of all meshes. Each vertex is (u, v, joint index, normal,
+    # position), with the normal and the position in joint space. Vertices are
+    # only shared between triangles if all the values are the same, so strips
+    # never join triangles across texture or normal seams, and vertices that
+    # belong to different joints are never merged.
+    polygons = []
+
+    # Origin and end of the polygon that shows the normal of each triangle
+    normal_polygons = [] if draw_normal_polygons else None
+
+    # Triangles used to generate levels of detail. Each vertex is (u, v, joint
+    # index, position in joint space, position in model space). Normals are
+    # calculated after simplifying the mesh.
+    lod_triangles = []
 
     for mesh in meshes:
         print(f"  Vertices: {mesh.numverts}")
@@ -652,13 +771,15 @@ def convert_md5mesh(model_file, name, output_folder, texture_size,
             else:
                 tri_normal.append(Vector(0, 0, 0))
 
-        print("  Generating display list...")
+        print("  Generating triangles...")
 
         for tri, norm in zip(mesh.tris, tri_normal):
             verts = [mesh.verts[i] for i in tri]
             weights = [mesh.weights[v.startWeight] for v in verts]
 
+            polygon = []
             finals = []
+            lod_triangle = []
 
             for vert, weight in zip(verts, weights):
 
@@ -670,37 +791,29 @@ def convert_md5mesh(model_file, name, output_folder, texture_size,
                 # the GPU of the DS expects.
                 u = st[0] * texture_size[0]
                 v = st[1] * texture_size[1]
-                dl.texcoord(u, v)
-
-                # Vertex and normal
-                # -----------------
 
-                # Load joint matrix. When drawing normal polygons it has to be
-                # loaded every time, because drawing the normal restores the
-                # original matrix.
-
-                joint_index = weight.joint
-                if draw_normal_polygons or joint_index != last_joint_index:
-                    dl.mtx_restore(base_matrix + joint_index)
-                    last_joint_index = joint_index
+                # Normal
+                # ------
 
                 # Calculate normal in joint space
 
+                joint_index = weight.joint
                 joint = joints[joint_index]
 
-                q = joint.orient
-                qt = q.complement()
-                n = norm.to_q()
-
-                # Transform by the inverted quaternion
-                n = qt.mul(n).mul(q).to_v3()
-                if n.length() > 0:
-                    n = n.normalize()
-                dl.normal(n.x, n.y, n.z)
+                n = normal_to_joint_space(norm, joint)
 
                 # The vertex is already in joint space
+                pos = weight.pos
 
-                dl.vtx(weight.pos.x, weight.pos.y, weight.pos.z)
+                polygon.append((u, v, joint_index, (n.x, n.y, n.z),
+                                (pos.x, pos.y, pos.z)))
+
+                if len(lod) > 0:
+                    m = joint_info_to_m4x3(joint.orient, joint.pos)
+                    final = pos.mul_m4x3(m)
+                    lod_triangle.append((u, v, joint_index,
+                                         (pos.x, pos.y, pos.z),
+                                         (final.x, final.y, final.z)))
 
                 if draw_normal_polygons:
                     # Calculate actual location of the vertex so that the
@@ -715,11 +828,12 @@ def convert_md5mesh(model_file, name, output_folder, texture_size,
                     final = joint.pos.add(delta)
                     finals.append(final)
 
-            if draw_normal_polygons:
+            polygons.append(polygon)
 
-                # Don't use any of the joint transformation matrices
-                dl.mtx_restore(1)
+            if len(lod) > 0:
+                lod_triangles.append(lod_triangle)
 
+            if draw_normal_polygons:
                 vert_avg = Vector(
                     (finals[0].x + finals[1].x + finals[2].x) / 3,
                     (finals[0].y + finals[1].y + finals[2].y) / 3,
@@ -728,34 +842,72 @@ def convert_md5mesh(model_file, name, output_folder, texture_size,
 
                 vert_avg_end = vert_avg.add(norm)
 
-                dl.texcoord(0, 0)
+                normal_polygons.append((vert_avg, vert_avg_end))
 
-                dl.color(1, 0, 0)
-                dl.vtx(vert_avg.x + 0.1, vert_avg.y, vert_avg.z)
-                dl.vtx(vert_avg.x, vert_avg.y, vert_avg.z)
-                dl.color(0, 1, 0)
-                dl.vtx(vert_avg_end.x, vert_avg_end.y, vert_avg_end.z)
+    print("Generating display list...")
 
-                dl.color(1, 0, 0)
-                dl.vtx(vert_avg.x, vert_avg.y, vert_avg.z)
-                dl.vtx(vert_avg.x, vert_avg.y + 0.1, vert_avg.z)
-                dl.color(0, 1, 0)
-                dl.vtx(vert_avg_end.x, vert_avg_end.y, vert_avg_end.z)
+    dl = generate_display_list(polygons, base_matrix, use_strips, optimize,
+                               max_error, normal_polygons, True)
 
-                dl.color(1, 0, 0)
-                dl.vtx(vert_avg.x, vert_avg.y, vert_avg.z)
-                dl.vtx(vert_avg.x, vert_avg.y, vert_avg.z + 0.1)
-                dl.color(0, 1, 0)
-                dl.vtx(vert_avg_end.x, vert_avg_end.y, vert_avg_end.z)
+    if use_strips:
+        print("Strips:")
+        dl_polygons = generate_display_list(polygons, base_matrix, False,
+                                            optimize, max_error)
+        strips.print_report(dl_polygons, dl)
 
-    dl.end_vtxs()
-    dl.finalize()
+    if optimize:
+        print("Vertex optimization:")
+        dl_unoptimized = generate_display_list(polygons, base_matrix,
+                                               use_strips, False, None,
+                                               normal_polygons)
+        strips.print_report(dl_unoptimized, dl)
 
-    dl.save_to_file(os.path.join(output_folder, f"{name}{extension_mesh}"))
+    dl.save_to_file(os.path.join(output_folder, f"{name}{extension_mesh}"),
+                    compress)
+
+    if len(lod) > 0:
+        convert_lods(lod_triangles, joints, base_matrix, name, output_folder,
+                     extension_mesh, use_strips, optimize, max_error, compress,
+                     lod)
+
+def convert_lods(triangles, joints, base_matrix, name, output_folder,
+                 extension_mesh, use_strips, optimize, max_error, compress,
+                 lod):
+    """
+    Generates one display list for each level of detail requested with --lod.
+    The original model is level 0. The mesh is simplified in model space (in
+    the base pose), and vertices are only merged with vertices of the same
+    joint, so each vertex keeps the joint it was assigned to.
+    """
+    levels = [(triangles, 0.0)]
+    file_names = [f"{name}{extension_mesh}"]
+
+    for i, value in enumerate(lod, start=1):
+        target = simplify.parse_target(value, len(triangles))
+        print(f"Generating LOD {i} ({target} triangles)...")
+
+        lod_triangles, error = simplify.simplify(triangles, lambda v: v[4],
+                                                 target, lambda v: v[2])
+        levels.append((lod_triangles, error))
+
+        if len(lod_triangles) > target:
+            print(f"WARNING: LOD {i} can't be simplified below "
+                  f"{len(lod_triangles)} triangles without breaking seams")
+
+        dl = generate_display_list(lod_polygons(lod_triangles, joints),
+                                   base_matrix, use_strips, optimize,
+                                   max_error)
+
+        file_names.append(f"{name}_lod{i}{extension_mesh}")
+        dl.save_to_file(os.path.join(output_folder, file_names[-1]), compress)
+
+    simplify.print_report(levels)
+    simplify.save_report(levels, file_names,
+                         os.path.join(output_folder, f"{name}_lod.txt"))
 
 
 def convert_md5anim(name, output_folder, anim_file, skip_frames, extension_anim,
-                    blender_fix):
+                    blender_fix, compress):
 
     print(f"Converting animation: {anim_file}")
 
@@ -767,7 +919,8 @@ def convert_md5anim(name, output_folder, anim_file, skip_frames, extension_anim,
 
     frames = frames[::skip_frames+1]
     save_animation(frames, os.path.join(output_folder,
-                   f"{name}_{anim_name}{extension_anim}"), blender_fix)
+                   f"{name}_{anim_name}{extension_anim}"), blender_fix,
+                   compress)
 
 
 if __name__ == "__main__":
@@ -776,7 +929,7 @@ if __name__ == "__main__":
     import sys
     import traceback
 
-    print("md5_to_dsma v0.1.1")
+    print("md5_to_dsma v0.1.2")
     print("Copyright (c) 2022-2024 Antonio Niño Díaz <antonio_nd@outlook.com>")
     print("All rights reserved")
     print("")
@@ -814,6 +967,24 @@ if __name__ == "__main__":
     parser.add_argument("--draw-normal-polygons", required=False,
                         action='store_true',
                         help="draw polygons with the shape of normals for debugging")
+    parser.add_argument("--strips", required=False,
+                        action='store_true',
+                        help="join triangles into triangle strips")
+    parser.add_argument("--optimize", required=False,
+                        action='store_true',
+                        help="reorder triangles and pick vertex commands to "
+                             "reduce the size of the display list")
+    parser.add_argument("--max-error", default=0.0, type=float,
+                        help="max error of vertex coordinates allowed by "
+                             "--optimize (in joint space)")
+    parser.add_argument("--compress", required=False,
+                        action='store_true',
+                        help="compress the output files with LZ77")
+    parser.add_argument("--lod", required=False, type=float, default=[],
+                        nargs="+", action="extend",
+                        help="generate simplified levels of detail with the "
+                             "provided number of triangles (or ratio of the "
+                             "original number of triangles if lower than 1.0)")
 
     args = parser.parse_args()
 
@@ -830,6 +1001,12 @@ if __name__ == "__main__":
             print(f"Invalid texture height. Valid values: {VALID_TEXTURE_SIZES}")
             sys.exit(1)
 
+    if (args.strips or args.optimize or args.lod) and \
+            args.draw_normal_polygons:
+        print("--strips, --optimize and --lod can't be used with "
+              "--draw-normal-polygons")
+        sys.exit(1)
+
     # Create output directory if it doesn't exist
     os.makedirs(args.output, exist_ok=True)
 
@@ -842,11 +1019,13 @@ if __name__ == "__main__":
             convert_md5mesh(args.model, args.name, args.output, args.texture,
                             args.draw_normal_polygons, extension_mesh,
                             extension_anim, args.blender_fix,
-                            args.export_base_pose)
+                            args.export_base_pose, args.strips,
+                            args.optimize, args.max_error, args.compress,
+                            args.lod)
 
         for anim_file in args.anims:
             convert_md5anim(args.name, args.output, anim_file, args.skip_frames,
-                            extension_anim, args.blender_fix)
+                            extension_anim, args.blender_fix, args.compress)
 
     except BaseException as e:
         print("ERROR: " + str(e))
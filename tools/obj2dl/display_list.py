@@ -2,6 +2,10 @@
 #
 # Copyright (c) 2022 Antonio Niño Díaz <antonio_nd@outlook.com>
 
+import copy
+
+import lz77
+
 def float_to_v16(val):
     res = int(val * (1 << 12))
     if res < -0x8000:
@@ -63,48 +67,49 @@ def float_to_n10(val):
         res = 0x400 + res
     return res
 
+COMMANDS = {
+    "NOP": 0x00, # (0) No Operation (for padding packed GXFIFO commands)
+    "MTX_MODE": 0x10, # (1) Set Matrix Mode
+    "MTX_PUSH": 0x11,  # (0) Push Current Matrix on Stack
+    "MTX_POP": 0x12, # (1) Pop Current Matrix from Stack
+    "MTX_STORE": 0x13, # (1) Store Current Matrix on Stack
+    "MTX_RESTORE": 0x14, # (1) Restore Current Matrix from Stack
+    "MTX_IDENTITY": 0x15, # (0) Load Unit Matrix to Current Matrix
+    "MTX_LOAD_4x4": 0x16, # (16) Load 4x4 Matrix to Current Matrix
+    "MTX_LOAD_4x3": 0x17, # (12) Load 4x3 Matrix to Current Matrix
+    "MTX_MULT_4x4": 0x18, # (16) Multiply Current Matrix by 4x4 Matrix
+    "MTX_MULT_4x3": 0x19, # (12) Multiply Current Matrix by 4x3 Matrix
+    "MTX_MULT_3x3": 0x1A, # (9) Multiply Current Matrix by 3x3 Matrix
+    "MTX_SCALE": 0x1B, # (3) Multiply Current Matrix by Scale Matrix
+    "MTX_TRANS": 0x1C, # (3) Mult. Curr. Matrix by Translation Matrix
+    "COLOR": 0x20, # (1) Directly Set Vertex Color
+    "NORMAL": 0x21, # (1) Set Normal Vector
+    "TEXCOORD": 0x22, # (1) Set Texture Coordinates
+    "VTX_16": 0x23, # (2) Set Vertex XYZ Coordinates
+    "VTX_10": 0x24, # (1) Set Vertex XYZ Coordinates
+    "VTX_XY": 0x25, # (1) Set Vertex XY Coordinates
+    "VTX_XZ": 0x26, # (1) Set Vertex XZ Coordinates
+    "VTX_YZ": 0x27, # (1) Set Vertex YZ Coordinates
+    "VTX_DIFF": 0x28, # (1) Set Relative Vertex Coordinates
+    "POLYGON_ATTR": 0x29, # (1) Set Polygon Attributes
+    "TEXIMAGE_PARAM": 0x2A, # (1) Set Texture Parameters
+    "PLTT_BASE": 0x2B, # (1) Set Texture Palette Base Address
+    "DIF_AMB": 0x30, # (1) MaterialColor0 # Diffuse/Ambient Reflect.
+    "SPE_EMI": 0x31, # (1) MaterialColor1 # Specular Ref. & Emission
+    "LIGHT_VECTOR": 0x32, # (1) Set Light's Directional Vector
+    "LIGHT_COLOR": 0x33, # (1) Set Light Color
+    "SHININESS": 0x34, # (32) Specular Reflection Shininess Table
+    "BEGIN_VTXS": 0x40, # (1) Start of Vertex List
+    "END_VTXS": 0x41, # (0) End of Vertex List
+    "SWAP_BUFFERS": 0x50, # (1) Swap Rendering Engine Buffer
+    "VIEWPORT": 0x60, # (1) Set Viewport
+    "BOX_TEST": 0x70, # (3) Test if Cuboid Sits inside View Volume
+    "POS_TEST": 0x71, # (2) Set Position Coordinates for Test
+    "VEC_TEST": 0x72, # (1) Set Directional Vector for Test
+}
+
 def command_name_to_id(name):
-    commands = {
-        "NOP": 0x00, # (0) No Operation (for padding packed GXFIFO commands)
-        "MTX_MODE": 0x10, # (1) Set Matrix Mode
-        "MTX_PUSH": 0x11,  # (0) Push Current Matrix on Stack
-        "MTX_POP": 0x12, # (1) Pop Current Matrix from Stack
-        "MTX_STORE": 0x13, # (1) Store Current Matrix on Stack
-        "MTX_RESTORE": 0x14, # (1) Restore Current Matrix from Stack
-        "MTX_IDENTITY": 0x15, # (0) Load Unit Matrix to Current Matrix
-        "MTX_LOAD_4x4": 0x16, # (16) Load 4x4 Matrix to Current Matrix
-        "MTX_LOAD_4x3": 0x17, # (12) Load 4x3 Matrix to Current Matrix
-        "MTX_MULT_4x4": 0x18, # (16) Multiply Current Matrix by 4x4 Matrix
-        "MTX_MULT_4x3": 0x19, # (12) Multiply Current Matrix by 4x3 Matrix
-        "MTX_MULT_3x3": 0x1A, # (9) Multiply Current Matrix by 3x3 Matrix
-        "MTX_SCALE": 0x1B, # (3) Multiply Current Matrix by Scale Matrix
-        "MTX_TRANS": 0x1C, # (3) Mult. Curr. Matrix by Translation Matrix
-        "COLOR": 0x20, # (1) Directly Set Vertex Color
-        "NORMAL": 0x21, # (1) Set Normal Vector
-        "TEXCOORD": 0x22, # (1) Set Texture Coordinates
-        "VTX_16": 0x23, # (2) Set Vertex XYZ Coordinates
-        "VTX_10": 0x24, # (1) Set Vertex XYZ Coordinates
-        "VTX_XY": 0x25, # (1) Set Vertex XY Coordinates
-        "VTX_XZ": 0x26, # (1) Set Vertex XZ Coordinates
-        "VTX_YZ": 0x27, # (1) Set Vertex YZ Coordinates
-        "VTX_DIFF": 0x28, # (1) Set Relative Vertex Coordinates
-        "POLYGON_ATTR": 0x29, # (1) Set Polygon Attributes
-        "TEXIMAGE_PARAM": 0x2A, # (1) Set Texture Parameters
-        "PLTT_BASE": 0x2B, # (1) Set Texture Palette Base Address
-        "DIF_AMB": 0x30, # (1) MaterialColor0 # Diffuse/Ambient Reflect.
-        "SPE_EMI": 0x31, # (1) MaterialColor1 # Specular Ref. & Emission
-        "LIGHT_VECTOR": 0x32, # (1) Set Light's Directional Vector
-        "LIGHT_COLOR": 0x33, # (1) Set Light Color
-        "SHININESS": 0x34, # (32) Specular Reflection Shininess Table
-        "BEGIN_VTXS": 0x40, # (1) Start of Vertex List
-        "END_VTXS": 0x41, # (0) End of Vertex List
-        "SWAP_BUFFERS": 0x50, # (1) Swap Rendering Engine Buffer
-        "VIEWPORT": 0x60, # (1) Set Viewport
-        "BOX_TEST": 0x70, # (3) Test if Cuboid Sits inside View Volume
-        "POS_TEST": 0x71, # (2) Set Position Coordinates for Test
-        "VEC_TEST": 0x72, # (1) Set Directional Vector for Test
-    }
-    return commands[name]
+    return COMMANDS[name]
 
 def poly_type_to_id(name):
     types = {
@@ -118,19 +123,105 @@ def poly_type_to_id(name):
 def error(x1, x2, y1, y2, z1, z2):
     return (abs(x1 - x2) ** 2) + (abs(y1 - y2) ** 2) + (abs(z1 - z2) ** 2)
 
+def to_signed_bits(val, bits):
+    """Returns the two's complement representation of a value."""
+    if val < 0:
+        val += 1 << bits
+    return val
+
+# Results of vtx_bounded(). The vertex optimizer of vertex_order.py tries the
+# same vertices many times.
+_vtx_bounded_cache = {}
+
+def _vtx_bounded_pick(last, x, y, z, max_error):
+    """
+    Returns (command, arguments, final coordinates) for vtx_bounded(). The
+    coordinates are in the units of VTX_16 (20.12 fixed point).
+    """
+    exact = (x * (1 << 12), y * (1 << 12), z * (1 << 12))
+    v16 = tuple(int(v) for v in exact)
+    for v, f in zip(v16, (x, y, z)):
+        if v < -0x8000 or v > 0x7FFF:
+            raise OverflowError(f"{f} doesn't fit in a vertex")
+
+    bound = max_error * (1 << 12)
+    limits = [max(bound, abs(v - e)) for v, e in zip(v16, exact)]
+
+    # List of (command, coordinates of the vertex, encoded coordinates). All
+    # commands except for VTX_16 use one word.
+    options = []
+
+    v10 = tuple(int(v * (1 << 6)) for v in (x, y, z))
+    if all(-0x200 <= v <= 0x1FF for v in v10):
+        options.append(("VTX_10", tuple(v << 6 for v in v10), v10))
+
+    if last is not None:
+        options.append(("VTX_XY", (v16[0], v16[1], last[2]), v16[0:2]))
+        options.append(("VTX_XZ", (v16[0], last[1], v16[2]), v16[0::2]))
+        options.append(("VTX_YZ", (last[0], v16[1], v16[2]), v16[1:3]))
+
+        # VTX_DIFF is relative to the coordinates of the GPU, not to the ones
+        # of the model, so the error never grows.
+        diff = tuple(round((v - l) / 8) for v, l in zip(v16, last))
+        if all(-0x200 <= d <= 0x1FF for d in diff):
+            final = tuple(l + d * 8 for l, d in zip(last, diff))
+            options.append(("VTX_DIFF", final, diff))
+
+    best = None
+    best_error = None
+    for name, final, encoded in options:
+        errors = [abs(f - e) for f, e in zip(final, exact)]
+        if any(err > limit for err, limit in zip(errors, limits)):
+            continue
+        error = sum(err * err for err in errors)
+        if best is None or error < best_error:
+            best = (name, final, encoded)
+            best_error = error
+
+    if best is None:
+        args = [to_signed_bits(v16[0], 16) | (to_signed_bits(v16[1], 16) << 16),
+                to_signed_bits(v16[2], 16)]
+        return ("VTX_16", args, v16)
+
+    name, final, encoded = best
+    if name in ["VTX_10", "VTX_DIFF"]:
+        arg = to_signed_bits(encoded[0], 10) | \
+              (to_signed_bits(encoded[1], 10) << 10) | \
+              (to_signed_bits(encoded[2], 10) << 20)
+    else:
+        arg = to_signed_bits(encoded[0], 16) | \
+              (to_signed_bits(encoded[1], 16) << 16)
+
+    return (name, [arg], final)
+
 class DisplayList():
 
-    def __init__(self):
+    def __init__(self, max_error=None):
+        # If max_error is None, vtx() uses the same commands as older versions
+        # of this tool. If not, see vtx_bounded().
+        self.max_error = max_error
+        self.vtx_last_fixed = None
+        self.mtx_restore_last = None
+        self.size = 0
+
         self.commands = []
         self.parameters = []
         self.vtx_last = None
         self.texcoord_last = None
         self.normal_last = None
         self.begin_vtx_last = None
+        self.num_vertices = 0
 
         self.display_list = []
 
     def add_command(self, command, *args):
+        # VTX_16 to VTX_DIFF
+        if 0x23 <= command <= 0x28:
+            self.num_vertices += 1
+
+        # Size in bytes, without counting the padding of the last header
+        self.size += 1 + 4 * len(args)
+
         self.commands.append(command)
         if len(args) > 0:
             self.parameters.extend(args)
@@ -145,6 +236,19 @@ class DisplayList():
             self.commands = []
             self.parameters = []
 
+    def fork(self):
+        """
+        Returns an empty display list that has the same state as this one (last
+        vertex, last normal...). It's used to check the size of a sequence of
+        commands without adding them to this display list.
+        """
+        dl = copy.copy(self)
+        dl.commands = []
+        dl.parameters = []
+        dl.display_list = []
+        dl.size = 0
+        return dl
+
     def finalize(self):
         # If there are pending commands, add NOPs to complete the display list
         if len(self.commands) > 0:
@@ -155,20 +259,23 @@ class DisplayList():
         # Prepend size to the list
         self.display_list.insert(0, len(self.display_list))
 
-    def save_to_file(self, path):
+    def save_to_file(self, path, compress=False):
+        data = bytearray()
+        for u32 in self.display_list:
+            data.extend(u32.to_bytes(4, "little"))
+
         with open(path, "wb") as f:
-            for u32 in self.display_list:
-                b = [u32 & 0xFF, \
-                    (u32 >> 8) & 0xFF, \
-                    (u32 >> 16) & 0xFF, \
-                    (u32 >> 24) & 0xFF]
-                f.write(bytearray(b))
+            if compress:
+                f.write(lz77.compress(data))
+            else:
+                f.write(data)
 
     def nop(self):
         self.add_command(command_name_to_id("NOP"))
 
     def mtx_restore(self, index):
         self.add_command(command_name_to_id("MTX_RESTORE"), index)
+        self.mtx_restore_last = index
 
     def color(self, r, g, b):
         arg = int(r * 31) | (int(g * 31) << 5) | (int(b * 31) << 10)
@@ -227,11 +334,33 @@ class DisplayList():
         self.add_command(command_name_to_id("VTX_DIFF"), arg)
         self.vtx_last = (x, y, z)
 
+    def vtx_bounded(self, x, y, z):
+        """
+        Picks the smallest vtx command that places the vertex with an error
+        smaller than max_error in all coordinates, or the error of VTX_16 if it
+        is bigger. It keeps track of the coordinates that the GPU will really
+        use so that the errors of VTX_DIFF don't accumulate.
+        """
+        key = (self.vtx_last_fixed, x, y, z, self.max_error)
+        result = _vtx_bounded_cache.get(key)
+        if result is None:
+            result = _vtx_bounded_pick(*key)
+            _vtx_bounded_cache[key] = result
+
+        name, args, final = result
+        self.add_command(command_name_to_id(name), *args)
+        self.vtx_last_fixed = final
+        self.vtx_last = tuple(v / (1 << 12) for v in final)
+
     def vtx(self, x, y, z):
         """
         Picks the best vtx command based on the previous vertex and the error of
         the conversion.
         """
+        if self.max_error is not None:
+            self.vtx_bounded(x, y, z)
+            return
+
         # Allow {vtx_xy, vtx_yz, vtx_xz, vtx_diff} if there is a previous vertex
         allow_diff = self.vtx_last is not None
 
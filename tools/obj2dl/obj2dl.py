@@ -4,7 +4,18 @@
 #
 # Copyright (c) 2022-2024 Antonio Niño Díaz <antonio_nd@outlook.com>
 
+import os
+import sys
+
+# Modules shared by several tools
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                "..", "common"))
+
+from math import sqrt
+
 from display_list import DisplayList
+import simplify
+import strips
 
 class OBJFormatError(Exception):
     pass
@@ -14,8 +25,33 @@ VALID_TEXTURE_SIZES = [8, 16, 32, 64, 128, 256, 512, 1024]
 def is_valid_texture_size(size):
     return size in VALID_TEXTURE_SIZES
 
+def emit_vertex(dl, vertex):
+    texcoord, normal, color, vtx = vertex
+
+    if texcoord is not None:
+        dl.texcoord(*texcoord)
+
+    if normal is not None:
+        dl.normal(*normal)
+
+    if color is not None:
+        dl.color(*color)
+
+    # Let the DisplayList class pick the best vtx command
+    dl.vtx(*vtx)
+
+def generate_display_list(polygons, use_strips, optimize, max_error,
+                          verbose=False):
+    dl = DisplayList(max_error if optimize else None)
+    strips.draw_polygons(dl, polygons, emit_vertex, use_strips, optimize,
+                         verbose)
+    dl.end_vtxs()
+    dl.finalize()
+    return dl
+
 def convert_obj(input_file, output_file, texture_size,
-                model_scale, model_translation, use_vertex_color):
+                model_scale, model_translation, use_vertex_color, use_strips,
+                optimize, max_error, compress, lod=[]):
 
     vertices = []
     texcoords = []
@@ -73,22 +109,22 @@ def convert_obj(input_file, output_file, texture_size,
     print("Faces:     " + str(len(faces)))
     print("")
 
-    dl = DisplayList()
+    # Each vertex of a polygon is (texcoord, normal, color, vtx). Vertices are
+    # only shared between polygons if all the values are the same.
+    polygons = []
 
     for face in faces:
 
         # Check the polygon type
         faces_number = len(face)
-        if faces_number == 3:
-            dl.switch_vtxs("triangles")
-        elif faces_number == 4:
-            dl.switch_vtxs("quads")
-        else:
+        if faces_number not in [3, 4]:
             raise OBJFormatError(
                 f"Unsupported polygons with {faces_number} faces. "
                 "Please, split the polygons in your model to triangles."
             )
 
+        polygon = []
+
         # Read vertices
         for vertex in face:
             tokens = vertex.split('/')
@@ -128,6 +164,7 @@ def convert_obj(input_file, output_file, texture_size,
                     raise OBJFormatError(f"Unsupported negative indices")
                 normal_index -= 1
 
+            texcoord = None
             if texcoord_index is not None:
                 u, v = texcoords[texcoord_index]
                 # In the OBJ format (0, 0) is the bottom-left corner. In the DS,
@@ -135,11 +172,11 @@ def convert_obj(input_file, output_file, texture_size,
                 v = 1.0 - v
                 u *= texture_size[0]
                 v *= texture_size[1]
-                dl.texcoord(u, v)
+                texcoord = (u, v)
 
+            normal = None
             if normal_index is not None:
-                n = normals[normal_index]
-                dl.normal(n[0], n[1], n[2])
+                normal = normals[normal_index]
 
             vtx = []
             for i in range(3):
@@ -148,16 +185,121 @@ def convert_obj(input_file, output_file, texture_size,
                 v *= model_scale
                 vtx.append(v)
 
+            color = None
             if use_vertex_color:
-                rgb = [vertices[vertex_index][i] for i in range(3, 6)]
-                dl.color(*rgb)
+                color = tuple(vertices[vertex_index][i] for i in range(3, 6))
 
-            # Let the DisplayList class pick the best vtx command
-            dl.vtx(vtx[0], vtx[1], vtx[2])
+            polygon.append((texcoord, normal, color, tuple(vtx)))
 
-    dl.end_vtxs()
-    dl.finalize()
-    dl.save_to_file(output_file)
+        polygons.append(polygon)
+
+    print("Generating display list...")
+
+    dl = generate_display_list(polygons, use_strips, optimize, max_error, True)
+
+    if use_strips:
+        print("Strips:")
+        dl_polygons = generate_display_list(polygons, False, optimize,
+                                            max_error)
+        strips.print_report(dl_polygons, dl)
+
+    if optimize:
+        print("Vertex optimization:")
+        dl_unoptimized = generate_display_list(polygons, use_strips, False,
+                                               None)
+        strips.print_report(dl_unoptimized, dl)
+
+    print("")
+
+    dl.save_to_file(output_file, compress)
+
+    if len(lod) > 0:
+        convert_lods(polygons, output_file, use_strips, optimize, max_error,
+                     compress, lod)
+
+def lod_polygons(triangles, normals):
+    """
+    Adds normals to the triangles of a level of detail. Vertices that had only
+    one normal in the original model keep it. Vertices with more than one
+    normal (hard edges and flat shaded models) use the normal of the simplified
+    triangle.
+    """
+    polygons = []
+
+    for triangle in triangles:
+        p0, p1, p2 = [vertex[3] for vertex in triangle]
+        u = [p1[i] - p0[i] for i in range(3)]
+        v = [p2[i] - p0[i] for i in range(3)]
+        n = (u[1] * v[2] - u[2] * v[1],
+             u[2] * v[0] - u[0] * v[2],
+             u[0] * v[1] - u[1] * v[0])
+        length = sqrt(n[0] ** 2 + n[1] ** 2 + n[2] ** 2)
+        if length > 0:
+            n = tuple(c / length for c in n)
+
+        polygon = []
+        for texcoord, _, color, vtx in triangle:
+            normal = normals[(texcoord, None, color, vtx)]
+            if normal is False:
+                normal = n
+            polygon.append((texcoord, normal, color, vtx))
+
+        polygons.append(polygon)
+
+    return polygons
+
+def convert_lods(polygons, output_file, use_strips, optimize, max_error,
+                 compress, lod):
+    """
+    Generates one display list for each level of detail requested with --lod.
+    The original model is level 0. The other levels are saved next to it, with
+    the same name and a '_lod<level>' suffix.
+    """
+    root, ext = os.path.splitext(output_file)
+
+    # Normals aren't used to simplify the mesh, or all vertices of flat shaded
+    # models would be treated as seams. Save the normal of each vertex, or False
+    # if it has more than one normal.
+    normals = {}
+    base_polygons = []
+    for polygon in polygons:
+        base_polygon = []
+        for texcoord, normal, color, vtx in polygon:
+            vertex = (texcoord, None, color, vtx)
+            if normals.get(vertex, normal) != normal:
+                normals[vertex] = False
+            else:
+                normals[vertex] = normal
+            base_polygon.append(vertex)
+        base_polygons.append(base_polygon)
+
+    num_triangles = len(simplify.triangulate(polygons))
+    levels = [(simplify.triangulate(polygons), 0.0)]
+    file_names = [os.path.basename(output_file)]
+
+    for i, value in enumerate(lod, start=1):
+        target = simplify.parse_target(value, num_triangles)
+        print(f"Generating LOD {i} ({target} triangles)...")
+
+        triangles, error = simplify.simplify(base_polygons, lambda v: v[3],
+                                             target)
+        levels.append((triangles, error))
+
+        if len(triangles) > target:
+            print(f"WARNING: LOD {i} can't be simplified below "
+                  f"{len(triangles)} triangles without breaking seams")
+
+        dl = generate_display_list(lod_polygons(triangles, normals),
+                                   use_strips, optimize, max_error)
+
+        lod_file = f"{root}_lod{i}{ext}"
+        dl.save_to_file(lod_file, compress)
+        file_names.append(os.path.basename(lod_file))
+
+    simplify.print_report(levels)
+    simplify.save_report(levels, file_names, f"{root}_lod.txt")
+
+    print("")
 
 if __name__ == "__main__":
 
@@ -165,7 +307,7 @@ if __name__ == "__main__":
     import sys
     import traceback
 
-    print("obj2dl v0.1.2")
+    print("obj2dl v0.1.3")
     print("Copyright (c) 2022-2024 Antonio Niño Díaz <antonio_nd@outlook.com>")
     print("All rights reserved")
     print("")
@@ -191,6 +333,24 @@ if __name__ == "__main__":
     parser.add_argument("--use-vertex-color", required=False,
                         action='store_true',
                         help="use vertex colors instead of normals")
+    parser.add_argument("--strips", required=False,
+                        action='store_true',
+                        help="join polygons into triangle and quad strips")
+    parser.add_argument("--optimize", required=False,
+                        action='store_true',
+                        help="reorder polygons and pick vertex commands to "
+                             "reduce the size of the display list")
+    parser.add_argument("--max-error", default=0.0, type=float,
+                        help="max error of vertex coordinates allowed by "
+                             "--optimize (after scaling the model)")
+    parser.add_argument("--compress", required=False,
+                        action='store_true',
+                        help="compress the output file with LZ77")
+    parser.add_argument("--lod", required=False, type=float, default=[],
+                        nargs="+", action="extend",
+                        help="generate simplified levels of detail with the "
+                             "provided number of triangles (or ratio of the "
+                             "original number of triangles if lower than 1.0)")
 
     args = parser.parse_args()
 
@@ -211,7 +371,9 @@ if __name__ == "__main__":
 
     try:
         convert_obj(args.input, args.output, args.texture,
-                    args.scale, args.translation, args.use_vertex_color)
+                    args.scale, args.translation, args.use_vertex_color,
+                    args.strips, args.optimize, args.max_error,
+                    args.compress, args.lod)
     except BaseException as e:
         print("ERROR: " + str(e))
         traceback.print_exc()
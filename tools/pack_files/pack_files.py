@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+
+# SPDX-License-Identifier: MIT
+#
+# Copyright (c) 2024 Antonio Niño Díaz <antonio_nd@outlook.com>
+
+# Packs all the files of a folder into an archive that can be opened with
+# NE_FATArchiveOpen(). The format is described in NEFAT.h.
+
+import os
+import struct
+
+MAGIC = b"NEPK"
+VERSION = 1
+
+TYPE_RAW = 0
+TYPE_LZ77 = 1
+
+LZ77_MAGIC = b"NELZ"
+
+EMPTY = 0xFFFFFFFF
+
+
+def fnv1a_hash(name):
+    h = 2166136261
+    for c in name.encode("utf-8"):
+        h ^= c
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def align(value, alignment):
+    return (value + alignment - 1) & ~(alignment - 1)
+
+
+def list_files(input_folder, exclude):
+    files = []
+    for root, dirs, names in os.walk(input_folder):
+        dirs.sort()
+        for name in sorted(names):
+            path = os.path.join(root, name)
+            if os.path.abspath(path) in exclude:
+                continue
+            rel = os.path.relpath(path, input_folder).replace(os.sep, "/")
+            files.append((rel, path))
+    return files
+
+
+def pack_files(input_folder, output_file):
+    files = list_files(input_folder, [os.path.abspath(output_file)])
+    if len(files) == 0:
+        raise Exception(f"No files found in {input_folder}")
+
+    # Keep the hash table at most half full so that lookups are short
+    num_buckets = 1
+    while num_buckets < len(files) * 2:
+        num_buckets *= 2
+
+    names = bytearray()
+    name_offsets = []
+    for rel, path in files:
+        name_offsets.append(len(names))
+        names.extend(rel.encode("utf-8") + b"\0")
+
+    header_size = 16
+    table_size = num_buckets * 20
+    data_offset = align(header_size + table_size + len(names), 4)
+
+    buckets = [None] * num_buckets
+    data = bytearray()
+
+    for i, (rel, path) in enumerate(files):
+        with open(path, "rb") as f:
+            content = f.read()
+
+        file_type = TYPE_LZ77 if content[0:4] == LZ77_MAGIC else TYPE_RAW
+
+        # Keep all files aligned to 4 bytes so that they can be copied to VRAM
+        # with DMA.
+        offset = data_offset + len(data)
+        data.extend(content)
+        data.extend(bytes(align(len(data), 4) - len(data)))
+
+        h = fnv1a_hash(rel)
+        index = h & (num_buckets - 1)
+        while buckets[index] is not None:
+            index = (index + 1) & (num_buckets - 1)
+
+        buckets[index] = (h, name_offsets[i], offset, len(content), file_type)
+
+        print(f"  {rel}: {len(content)} bytes" +
+              (" (compressed)" if file_type == TYPE_LZ77 else ""))
+
+    out = bytearray()
+    out.extend(MAGIC)
+    out.extend(struct.pack("<III", VERSION, num_buckets, len(names)))
+
+    for bucket in buckets:
+        if bucket is None:
+            out.extend(struct.pack("<IIIII", 0, EMPTY, 0, 0, 0))
+        else:
+            out.extend(struct.pack("<IIIII", *bucket))
+
+    out.extend(names)
+    out.extend(bytes(data_offset - len(out)))
+    out.extend(data)
+
+    with open(output_file, "wb") as f:
+        f.write(out)
+
+    print(f"{len(files)} files, {len(out)} bytes")
+
+
+if __name__ == "__main__":
+
+    import argparse
+    import sys
+    import traceback
+
+    print("pack_files v0.1.0")
+    print("Copyright (c) 2024 Antonio Niño Díaz <antonio_nd@outlook.com>")
+    print("All rights reserved")
+    print("")
+
+    parser = argparse.ArgumentParser(
+            description='Pack files into an archive for Nitro Engine.')
+
+    # Required arguments
+    parser.add_argument("--input", required=True,
+                        help="folder with the files to pack")
+    parser.add_argument("--output", required=True,
+                        help="output archive")
+
+    args = parser.parse_args()
+
+    try:
+        pack_files(args.input, args.output)
+    except BaseException as e:
+        print("ERROR: " + str(e))
+        traceback.print_exc()
+        sys.exit(1)
+
+    print("Done!")
+
+    sys.exit(0)